@@ -5,7 +5,9 @@ import collections
 import ctypes
 import math
 import opcodes
+import struct
 import sys
+import zlib
 
 class ParseError(Exception):
     def __init__(self, value):
@@ -16,6 +18,8 @@ class ParseError(Exception):
 
 class Parser:
     __MAGIC_JUMP = 'FIXME'
+    # String pool goes in front of the first source line
+    POOL_LINE = -1
 
     def __init__(self, data):
         self.data = data
@@ -26,6 +30,14 @@ class Parser:
         self.line = 0
         self.regmap = {}
         self.postdata = {}
+        self.fuse_loops = True
+        self.pool_strings = True
+        self.strings = collections.OrderedDict()
+        # Sectioned container output, see core/program.hh
+        self.container = False
+        self.data_lines = set()
+        self.reserved = {}
+        self.entry = None
         self.opers = {
             '==': 0,
             '<': 1,
@@ -36,8 +48,60 @@ class Parser:
             '&&': 8,
             '||': 9,
             '^': 14,
-            '%': 15
+            '%': 15,
+            '<s': 16,
+            '>s': 17,
+            '<=s': 18,
+            '>=s': 19
             }
+        self.jumps = {
+            '==': 'JEQ',
+            '!=': 'JNE',
+            '<': 'JLT',
+            '>': 'JGT',
+            '<=': 'JLE',
+            '>=': 'JGE',
+            '<s': 'JSLT',
+            '>s': 'JSGT',
+            '<=s': 'JSLE',
+            '>=s': 'JSGE'
+            }
+        # Float compares, > and >= swap the operands
+        self.fjumps = {
+            '==f': ('JFEQ', False),
+            '!=f': ('JFNE', False),
+            '<f': ('JFLT', False),
+            '<=f': ('JFLE', False),
+            '>f': ('JFLT', True),
+            '>=f': ('JFLE', True)
+            }
+        self.wider = {
+            opcodes.JMP_LE8: (opcodes.JMP_LE16, 2),
+            opcodes.JMP_LE16: (opcodes.JMP_LE32, 4),
+            opcodes.JMP_LE32: (opcodes.JMP_LE64, 8),
+            opcodes.JMP_LE_IMM8: (opcodes.JMP_LE_IMM16, 2),
+            opcodes.JMP_LE_IMM16: (opcodes.JMP_LE_IMM32, 4)
+            }
+        for name in ['LOOP_INC', 'LOOP_DEC', 'LOOP_INC_IMM', 'LOOP_DEC_IMM']:
+            self.wider[getattr(opcodes, name + '8')] = (getattr(opcodes, name + '16'), 2)
+            self.wider[getattr(opcodes, name + '16')] = (getattr(opcodes, name + '32'), 4)
+        for name in self.jumps.values():
+            for form in ['', '_IMM']:
+                short = getattr(opcodes, name + form + '8')
+                self.wider[short] = (getattr(opcodes, name + form + '32'), 4)
+        for (name, swap) in self.fjumps.values():
+            self.wider[getattr(opcodes, name + '8')] = (getattr(opcodes, name + '32'), 4)
+        self.wider[opcodes.MAP_GET8] = (opcodes.MAP_GET32, 4)
+        # String compares, operator byte like JMP_LE
+        self.sjumps = {
+            '==$': 0,
+            '<$': 1,
+            '>$': 2,
+            '<=$': 3,
+            '>=$': 4,
+            '!=$': 5
+            }
+        self.wider[opcodes.JSTR8] = (opcodes.JSTR32, 4)
 
     def hexstr(self, s):
         """
@@ -246,7 +310,11 @@ class Parser:
         True
         >>> p.is_float('1.000.05')
         False
+        >>> p.is_float('-0.5')
+        True
         """
+        if val and val[0] == '-':
+            val = val[1:]
         if not val:
             return False
         got_digit = False
@@ -322,6 +390,104 @@ class Parser:
             return res
         return res[1]
 
+    def output_imm(self, val):
+        """
+        >>> p = Parser('')
+        >>> p.output_imm(0)
+        '\\x00'
+        >>> p.output_imm(16)
+        '\\x01\\x10'
+        >>> p.output_imm(100000)
+        '\\x03\\x01\\x86\\xa0'
+        >>> p.output_imm(-1)
+        '\\x08\\xff\\xff\\xff\\xff\\xff\\xff\\xff\\xff'
+        """
+        if val < 0:
+            val = ctypes.c_uint64(val).value
+        num = self.raw_number(val)
+        return chr(len(num)) + num
+
+    def output_simm(self, val):
+        """
+        Sign extended immediate, shortest two's complement form.
+
+        >>> p = Parser('')
+        >>> p.output_simm(0)
+        '\\x00'
+        >>> p.output_simm(-1)
+        '\\x01\\xff'
+        >>> p.output_simm(127)
+        '\\x01\\x7f'
+        >>> p.output_simm(128)
+        '\\x02\\x00\\x80'
+        >>> p.output_simm(-1000)
+        '\\x02\\xfc\\x18'
+        """
+        size = 0
+        while val != 0 and not self.fits(val, size):
+            size += 1
+        return chr(size) + self.output_fixed(val, size)
+
+    def output_fixed(self, val, size):
+        """
+        >>> p = Parser('')
+        >>> p.output_fixed(1, 2)
+        '\\x00\\x01'
+        >>> p.output_fixed(-6, 1)
+        '\\xfa'
+        >>> p.output_fixed(-6, 4)
+        '\\xff\\xff\\xff\\xfa'
+        >>> p.output_fixed(200, 1) # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: Value 200 does not fit in 1 bytes @0
+        """
+        if not self.fits(val, size):
+            raise ParseError('Value %s does not fit in %s bytes @%s' % (val, size, self.line))
+        res = ''
+        for _ in range(size):
+            res = chr(val & 0xff) + res
+            val = val >> 8
+        return res
+
+    def fits(self, val, size):
+        """
+        >>> p = Parser('')
+        >>> p.fits(127, 1)
+        True
+        >>> p.fits(-128, 1)
+        True
+        >>> p.fits(128, 1)
+        False
+        >>> p.fits(-129, 2)
+        True
+        """
+        if size == 0:
+            return val == 0
+        limit = 1 << (size * 8 - 1)
+        return val >= -limit and val < limit
+
+    def is_wide_imm(self, data):
+        """
+        Integers not encodable inline as register operand.
+
+        >>> p = Parser('')
+        >>> p.is_wide_imm('R1')
+        False
+        >>> p.is_wide_imm('15')
+        False
+        >>> p.is_wide_imm('0')
+        True
+        >>> p.is_wide_imm('16')
+        True
+        >>> p.is_wide_imm('-1')
+        True
+        """
+        if not self.is_int(data):
+            return False
+        val = int(data)
+        return val < 1 or val > 15
+
     def format_string(self, s):
         """
         >>> p = Parser('')
@@ -358,9 +524,52 @@ class Parser:
                 res += c
         return res
 
+    def output_address(self, address, name):
+        """
+        Outputs 64 bit address, labels with optional offset are
+        resolved when all the code is known.
+
+        >>> p = Parser('')
+        >>> p.output_address('300', 'LOAD')
+        '\\x00\\x00\\x00\\x00\\x00\\x00\\x01,'
+        >>> p.output_address('data', 'LOAD') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: Invalid argument for LOAD: data @0
+        """
+        address_entries = address.split(' ')
+        address = address_entries[0]
+
+        if address.isdigit():
+            self.code += self.output_fixed(int(address), 8)
+        elif address in self.labels:
+            target = self.labels[address]
+            oper = 0
+            diff = 0
+            if len(address_entries) == 3:
+                oper = address_entries[1]
+                if oper != '+' and oper != '-':
+                    raise ParseError('Invalid argument for %s: %s (%s) @%s' % (name, oper, address, self.line))
+                diff = address_entries[2]
+                if not diff.isdigit():
+                    raise ParseError('Invalid argument for %s: %s (%s) @%s' % (name, diff, address, self.line))
+                diff = int(diff)
+            self.code += '\x00' * 8
+            self.postdata[self.line] = (None, target, oper, diff)
+        else:
+            raise ParseError('Invalid argument for %s: %s @%s' % (name, address, self.line))
+        return self.code
+
     def parse_load_2args(self, data):
         """
         >>> p = Parser('')
+        >>> p.parse_load_2args(['R1', '-1'])
+        >>> p.code
+        '\\x08\\x01\\xff\\xff\\xff\\xff\\xff\\xff\\xff\\xff'
+        >>> p.code = ''
+        >>> p.parse_load_2args(['R2', '[16]'])
+        >>> p.code
+        '\\n\\x02\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x10'
         """
         reg = self.parse_reg(data[0])
 
@@ -369,7 +578,11 @@ class Parser:
         if self.is_int(value):
             # Int
             val = int(value)
-            (cnt, val) = self.output_num(val)
+            if val < 0:
+                # Loads are zero extended, negative needs all the bits
+                (cnt, val) = (8, self.output_fixed(val, 8))
+            else:
+                (cnt, val) = self.output_num(val)
             if cnt == 1:
                 self.code += chr(opcodes.LOAD_INT8)
             elif cnt == 2:
@@ -383,16 +596,42 @@ class Parser:
             self.code += self.output_num(reg, False)
             self.code += val
         elif self.is_float(value):
-            # TODO
-            # Float
+            # Float, short form if exactly representable in single precision
+            val = float(value)
+            try:
+                short = struct.pack('>f', val)
+            except OverflowError:
+                short = None
+            if short is not None and struct.unpack('>f', short)[0] == val:
+                self.code += chr(opcodes.LOAD_FLOAT32)
+                self.code += self.output_num(reg, False)
+                self.code += short
+            else:
+                self.code += chr(opcodes.LOAD_FLOAT)
+                self.code += self.output_num(reg, False)
+                self.code += struct.pack('>d', val)
             self.regmap[reg] = 'float'
-            pass
-        elif value[0] == '"' and value[-1] == '"':
-            # String
-            self.code += chr(opcodes.LOAD_STR)
+        elif value[0] == '[' and value[-1] == ']':
+            # NUL terminated string from memory
+            self.code += chr(opcodes.LOAD_STR_MEM)
             self.code += self.output_num(reg, False)
+            self.output_address(value[1:-1], 'LOAD')
+            self.regmap[reg] = 'str'
+        elif value[0] == '"' and value[-1] == '"':
+            # String, deduplicated to pool unless inline is asked for
+            val = self.format_string(value[1:-1])
+            if self.pool_strings:
+                idx = self.strings.setdefault(val, len(self.strings))
+                if idx > 0xffff:
+                    raise ParseError('Too many strings: %s @%s' % (value, self.line))
+                self.code += chr(opcodes.LOAD_STR_CONST)
+                self.code += self.output_num(reg, False)
+                self.code += self.output_fixed(idx, 2)
+            else:
+                self.code += chr(opcodes.LOAD_STR)
+                self.code += self.output_num(reg, False)
+                self.code += val + '\x00'
             self.regmap[reg] = 'str'
-            self.code += self.format_string(value[1:-1]) + '\x00'
         else:
             raise ParseError('Invalid argument for LOAD: %s @%s' % (value, self.line))
 
@@ -414,35 +653,7 @@ class Parser:
             self.code += self.output_num(reg, False)
             self.code += self.output_num(cnt, False)
 
-            address_entries = address.split(' ')
-            if len(address_entries) == 0:
-                raise ParseError('Invalid argument for LOAD: %s @%s' % (data[2], self.line))
-
-            address = address_entries[0]
-
-            if address.isdigit():
-                address = int(address)
-                self.code += self.output_num(address, False)
-            elif address in self.labels:
-                target = self.labels[address]
-                oper = 0
-                diff = 0
-                if len(address_entries) == 3:
-                    oper = address_entries[1]
-                    if oper != '+' and oper != '-':
-                        raise ParseError('Invalid argument for LOAD: %s (%s) @%s' % (oper, data[2], self.line))
-                    diff = address_entries[2]
-                    if not diff.isdigit():
-                        raise ParseError('Invalid argument for LOAD: %s (%s) @%s' % (diff, data[2], self.line))
-                    diff = int(diff)
-                self.code += '\x00' * 8
-                self.postdata[self.line] = (opcodes.LOAD_INT_MEM, target, oper, diff)
-                #self.code = '%s %s,%s,%s,%s,%s:' % (Parser.__MAGIC_JUMP, 0, 8, target, oper, diff) + self.code
-                #self.code = '%s %s,%s,%s,%s,%s:' % (Parser.__MAGIC_JUMP, 0, 8, target, oper, diff) + self.code
-            else:
-                raise ParseError('Invalid argument for LOAD: %s @%s' % (data[2], self.line))
-
-                #self.code += self.output_num(address, False)
+            self.output_address(address, 'LOAD')
             self.regmap[reg] = 'int'
         elif opt[0] == 'R':
             reg2 = self.parse_reg(opt)
@@ -485,12 +696,33 @@ class Parser:
         ParseError: Invalid number argument for LOAD: 3 (R1, R2, 3) @0
         >>> p.code = ''
         >>> p.parse_load('R1, "abc"')
+        '\\xaa\\x01\\x00\\x00'
+        >>> p.code = ''
+        >>> p.parse_load('R2, "def"')
+        '\\xaa\\x02\\x00\\x01'
+        >>> p.code = ''
+        >>> p.parse_load('R3, "abc"')
+        '\\xaa\\x03\\x00\\x00'
+        >>> p.output_pool()
+        '\\xa9\\x00\\x00\\x00\\x08abc\\x00def\\x00'
+        >>> p.code = ''
+        >>> p.pool_strings = False
+        >>> p.parse_load('R1, "abc"')
         '\\t\\x01abc\\x00'
         >>> p.code = ''
-        >>> p.parse_load('R1, 1.234') # FIXME: Unimplemented
-        ''
+        >>> p.parse_load('R1, ","')
+        '\\t\\x01,\\x00'
+        >>> p.code = ''
+        >>> p.parse_load('R1, 2.5')
+        '\\x84\\x01@ \\x00\\x00'
+        >>> p.code = ''
+        >>> p.parse_load('R1, 0.1')
+        '\\x83\\x01?\\xb9\\x99\\x99\\x99\\x99\\x99\\x9a'
         """
         data = [x.strip() for x in opts.split(',')]
+        if len(data) > 2 and data[1][:1] == '"':
+            # Commas within string literal
+            data = [x.strip() for x in opts.split(',', 1)]
         if len(data) == 2:
             self.parse_load_2args(data)
         elif len(data) == 3:
@@ -500,6 +732,17 @@ class Parser:
 
         return self.code
 
+    def output_pool(self):
+        """
+        STR_POOL instruction interning the pooled strings in index order.
+
+        >>> p = Parser('')
+        >>> p.output_pool()
+        '\\xa9\\x00\\x00\\x00\\x00'
+        """
+        data = ''.join([x + '\x00' for x in self.strings])
+        return chr(opcodes.STR_POOL) + self.output_fixed(len(data), 4) + data
+
     def parse_print(self, opts):
         """
         >>> p = Parser('')
@@ -526,6 +769,10 @@ class Parser:
         >>> p.code = ''
         >>> p.parse_print('R2')
         '\\x16\\x02'
+        >>> p.regmap[3] = "float"
+        >>> p.code = ''
+        >>> p.parse_print('R3')
+        '\\x15\\x03'
         """
         opts = opts.strip()
         if not opts:
@@ -538,6 +785,8 @@ class Parser:
                 self.code += chr(opcodes.PRINT_INT)
             elif self.regmap[reg] == 'str':
                 self.code += chr(opcodes.PRINT_STR)
+            elif self.regmap[reg] == 'float':
+                self.code += chr(opcodes.PRINT_FLOAT)
             self.code += self.output_num(reg, False)
         else:
             raise ParseError('Unsupported PRINT: %s @%s' % (opts, self.line))
@@ -728,6 +977,57 @@ class Parser:
         # Does not result optimal code, but it should work in most cases
         return (True, (jlen + 10 + estlines) * 5)
 
+    def loop_counter(self, reg, oper, bound):
+        """
+        Finds INC or DEC of the compared register right before current line,
+        which can be combined with the compare-branch to a loop instruction.
+
+        >>> p = Parser('')
+        >>> p.line = 3
+        >>> p.output[1] = '\\x0d\\x00'
+        >>> p.loop_counter(0, '<', 'R1')
+        (1, 'LOOP_INC')
+        >>> p.loop_counter(0, '>', 'R1') is None
+        True
+        >>> p.loop_counter(1, '<', 'R1') is None
+        True
+        >>> p.output[1] = '\\x0e\\x00'
+        >>> p.loop_counter(0, '>', '5')
+        (1, 'LOOP_DEC')
+        >>> p.loop_counter(0, '!=', '0')
+        (1, 'LOOP_DEC')
+        >>> p.loop_counter(0, '!=', '1') is None
+        True
+        >>> p.output[2] = ''
+        >>> p.labels['label'] = 2
+        >>> p.loop_counter(0, '>', '5') is None
+        True
+        >>> p.fuse_loops = False
+        >>> p.labels = {}
+        >>> p.loop_counter(0, '>', '5') is None
+        True
+        """
+        if not self.fuse_loops or reg < 0 or reg > 0xf:
+            return None
+        if self.line in self.labels.values():
+            return None
+
+        prev = self.line - 1
+        while prev >= 0 and not self.output.get(prev):
+            if prev in self.labels.values():
+                return None
+            prev -= 1
+        if prev < 0:
+            return None
+
+        code = self.output[prev]
+        if oper == '<' and code == chr(opcodes.INC_INT) + chr(reg):
+            return (prev, 'LOOP_INC')
+        if code == chr(opcodes.DEC_INT) + chr(reg):
+            if oper == '>' or (oper == '!=' and self.is_int(bound) and int(bound) == 0):
+                return (prev, 'LOOP_DEC')
+        return None
+
     def parse_jmp(self, opts):
         """
         >>> p = Parser('')
@@ -747,14 +1047,45 @@ class Parser:
         >>> p.labels['label2'] = 20
         >>> p.line = 4
         >>> p.parse_jmp('R1 < R2, label')
-        '\\x1d\\x01\\x01\\x02\\x01'
+        '/\\x01\\x02\\xfd'
+        >>> p.code = ''
+        >>> p.parse_jmp('R1 && R2, label')
+        '\\x1d\\x08\\x01\\x02\\xfc'
         >>> p.code = ''
         >>> p.parse_jmp('R1 < R2, label2')
-        'FIXME 1,1,20,0,0:\\x1d\\x01\\x01\\x02'
+        'FIXME 1,1,20,0,0:/\\x01\\x02'
         >>> p.code = ''
         >>> p.labels['label2'] = 2000
         >>> p.parse_jmp('R1 < R2, label2')
-        'FIXME 1,2,2000,0,0:\\x1e\\x01\\x01\\x02'
+        'FIXME 1,1,2000,0,0:/\\x01\\x02'
+        >>> p.code = ''
+        >>> p.output[1] = 'a' * 300
+        >>> p.parse_jmp('R1 < R2, label')
+        '5\\x01\\x02\\xff\\xff\\xfe\\xd1'
+        >>> p.code = ''
+        >>> p.parse_jmp('R1 < 100000, label2')
+        'FIXME 1,1,2000,0,0:;\\x01\\x03\\x01\\x86\\xa0'
+        >>> p.code = ''
+        >>> p.parse_jmp('R1 != 0, label2')
+        'FIXME 1,1,2000,0,0::\\x01\\x00'
+        >>> p.code = ''
+        >>> p.parse_jmp('R1 < 15, label2')
+        'FIXME 1,1,2000,0,0:/\\x01\\xf0'
+        >>> p.code = ''
+        >>> p.parse_jmp('R1 ^ 300, label2')
+        'FIXME 1,1,2000,0,0:*\\x0e\\x01\\x02\\x01,'
+        >>> p.code = ''
+        >>> p.parse_jmp('R1 <s -1, label2')
+        'FIXME 1,1,2000,0,0:{\\x01\\x01\\xff'
+        >>> p.code = ''
+        >>> p.parse_jmp('R1 <f R2, label')
+        '\\x95\\x01\\x02\\xff\\xff\\xfe\\xd1'
+        >>> p.code = ''
+        >>> p.parse_jmp('R1 >=f 1, label2')
+        'FIXME 1,1,2000,0,0:\\x92\\x10\\x01'
+        >>> p.code = ''
+        >>> p.parse_jmp('R1 <=$ R2, label')
+        '\\xb0\\x03\\x01\\x02\\xff\\xff\\xfe\\xd0'
         >>> p.code = ''
         >>> p.parse_jmp('R1 R2, label2') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
         Traceback (most recent call last):
@@ -765,14 +1096,50 @@ class Parser:
         if len(data) == 2:
             cmp_ops = [x.strip() for x in data[0].split(' ')]
             cmp_op = 0
-            if len(cmp_ops) == 3:
+            (ttype, target) = self.parse_target(data[1].strip())
+            if len(cmp_ops) == 3 and cmp_ops[1] in self.fjumps:
+                (form, swap) = self.fjumps[cmp_ops[1]]
+                regs = [self.parse_reg(cmp_ops[0]), self.parse_reg(cmp_ops[2])]
+                if swap:
+                    regs.reverse()
+                head = self.output_num(regs[0], False)
+                head += self.output_num(regs[1], False)
+            elif len(cmp_ops) == 3 and cmp_ops[1] in self.sjumps:
+                form = 'JSTR'
+                head = self.output_num(self.sjumps[cmp_ops[1]], False)
+                head += self.output_num(self.parse_reg(cmp_ops[0]), False)
+                head += self.output_num(self.parse_reg(cmp_ops[2]), False)
+            elif len(cmp_ops) == 3:
                 cmp_op = self.opers[cmp_ops[1]]
                 reg1 = self.parse_reg(cmp_ops[0])
-                reg2 = self.parse_reg(cmp_ops[2])
+                imm = self.is_wide_imm(cmp_ops[2])
+                form = '_IMM' if imm else ''
+                loop = None
+                if ttype == 'label':
+                    loop = self.loop_counter(reg1, cmp_ops[1], cmp_ops[2])
+                if loop is not None:
+                    # Counter update is done by the loop instruction
+                    (step_line, name) = loop
+                    self.output[step_line] = ''
+                    head = ''
+                    form = name + form
+                elif cmp_ops[1] in self.jumps:
+                    # Comparison encoded in opcode
+                    head = ''
+                    form = self.jumps[cmp_ops[1]] + form
+                else:
+                    head = self.output_num(cmp_op, False)
+                    form = 'JMP_LE' + form
+                head += self.output_num(reg1, False)
+                if imm and cmp_op >= 16:
+                    head += self.output_simm(int(cmp_ops[2]))
+                elif imm:
+                    head += self.output_imm(int(cmp_ops[2]))
+                else:
+                    head += self.output_num(self.parse_reg(cmp_ops[2]), False)
             else:
                 raise ParseError('Unsupported JMP: %s @%s' % (opts, self.line))
 
-            (ttype, target) = self.parse_target(data[1].strip())
             if ttype == 'imm':
                 (cnt, val) = self.output_num(target)
                 if cnt == 1:
@@ -785,33 +1152,7 @@ class Parser:
                     self.code += chr(opcodes.JMP64)
                 self.code += val
             elif ttype == 'label':
-                (est, est_size) = self.estimate_jump_len(target)
-                if est_size < 0xff:
-                    bits = 1
-                    self.code += chr(opcodes.JMP_LE8)
-                elif est_size < 0xffff:
-                    bits = 2
-                    self.code += chr(opcodes.JMP_LE16)
-                elif est_size < 0xffffffff:
-                    bits = 4
-                    self.code += chr(opcodes.JMP_LE32)
-                else:
-                    bits = 8
-                    self.code += chr(opcodes.JMP_LE64)
-
-                self.code += self.output_num(cmp_op, False)
-                self.code += self.output_num(reg1, False)
-                self.code += self.output_num(reg2, False)
-
-                if not est:
-                    if est_size < 0:
-                        est_size -= 4
-                    else:
-                        (extra_bytes, _) = self.output_num(est_size + 8)
-                        est_size += extra_bytes
-                    self.code += self.output_num(est_size, False)
-                else:
-                    self.code = '%s %s,%s,%s,0,0:' % (Parser.__MAGIC_JUMP, 1, bits, target) + self.code
+                self.output_branch(form, head, target)
             else:
                 raise ParseError('Unsupported JMP target: %s @%s' % (data[1], self.line))
 
@@ -824,6 +1165,152 @@ class Parser:
 
         return self.code
 
+    def output_branch(self, form, head, target):
+        """
+        Branch to label, opcode is form with displacement size suffix.
+
+        >>> p = Parser('')
+        >>> p.line = 4
+        >>> p.output_branch('MAP_GET', '\\x01\\x02\\x03', 1)
+        '\\xa5\\x01\\x02\\x03\\xfc'
+        >>> p.code = ''
+        >>> p.output_branch('MAP_GET', '\\x01\\x02\\x03', 20)
+        'FIXME 1,1,20,0,0:\\xa5\\x01\\x02\\x03'
+        """
+        (est, est_size) = self.estimate_jump_len(target)
+        opcode = getattr(opcodes, form + '8')
+        if not est:
+            # Backward jump with all the code in between known,
+            # displacement is relative to the displacement itself
+            diff = est_size - 1 - len(head)
+            bits = 1
+            while not self.fits(diff, bits) and opcode in self.wider:
+                (opcode, bits) = self.wider[opcode]
+            if bits == 8:
+                raise ParseError('Jump too long @%s' % (self.line))
+            self.code += chr(opcode) + head
+            self.code += self.output_fixed(diff, bits)
+        else:
+            # Start from the shortest form, fix_line widens if needed
+            self.code += chr(opcode) + head
+            self.code = '%s %s,%s,%s,0,0:' % (Parser.__MAGIC_JUMP, 1, 1, target) + self.code
+        return self.code
+
+    def parse_map(self, name, opts):
+        """
+        Keys are integer or string registers, MAP_GET jumps to label
+        when key is missing.
+
+        >>> p = Parser('')
+        >>> p.parse_map('MAP_NEW', 'R1')
+        '\\xa3\\x01'
+        >>> p.code = ''
+        >>> p.parse_map('MAP_PUT', 'R1, R2, 5')
+        '\\xa4\\x01\\x02P'
+        >>> p.code = ''
+        >>> p.labels['missing'] = 1
+        >>> p.line = 4
+        >>> p.parse_map('MAP_GET', 'R3, R1, R2, missing')
+        '\\xa5\\x03\\x01\\x02\\xfc'
+        >>> p.parse_map('MAP_DEL', 'R1') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: Unsupported MAP_DEL: R1 @4
+        """
+        counts = {'MAP_NEW': 1, 'MAP_PUT': 3, 'MAP_GET': 4, 'MAP_DEL': 2, 'MAP_SIZE': 2}
+        data = [x.strip() for x in opts.split(',')]
+        if len(data) != counts[name]:
+            raise ParseError('Unsupported %s: %s @%s' % (name, opts, self.line))
+
+        if name == 'MAP_GET':
+            (ttype, target) = self.parse_target(data[3])
+            if ttype != 'label':
+                raise ParseError('Unsupported MAP_GET target: %s @%s' % (data[3], self.line))
+            regs = [self.parse_reg(x) for x in data[:3]]
+            head = ''.join([self.output_num(x, False) for x in regs])
+            # Value type is known only at run time
+            self.regmap[regs[0]] = 'int'
+            return self.output_branch('MAP_GET', head, target)
+
+        regs = [self.parse_reg(x) for x in data]
+        self.code += chr(getattr(opcodes, name))
+        for reg in regs:
+            self.code += self.output_num(reg, False)
+        if name in ('MAP_NEW', 'MAP_SIZE'):
+            self.regmap[regs[0]] = 'int'
+        return self.code
+
+    def parse_str(self, name, opts):
+        """
+        String operations, SUBSTR takes start and length.
+
+        >>> p = Parser('')
+        >>> p.parse_str('CONCAT', 'R1, R1, R2')
+        '\\xab\\x01\\x01\\x02'
+        >>> p.regmap[1]
+        'str'
+        >>> p.code = ''
+        >>> p.parse_str('SUBSTR', 'R1, R2, 3, R4')
+        '\\xac\\x01\\x020\\x04'
+        >>> p.code = ''
+        >>> p.parse_str('LEN', 'R5, R1')
+        '\\xae\\x05\\x01'
+        >>> p.regmap[5]
+        'int'
+        >>> p.parse_str('FIND', 'R1, R2') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: Unsupported FIND: R1, R2 @0
+        """
+        counts = {'CONCAT': 3, 'SUBSTR': 4, 'FIND': 3, 'LEN': 2, 'TO_INT': 2, 'FROM_INT': 2}
+        data = [x.strip() for x in opts.split(',')]
+        if len(data) != counts[name]:
+            raise ParseError('Unsupported %s: %s @%s' % (name, opts, self.line))
+
+        regs = [self.parse_reg(x) for x in data]
+        self.code += chr(getattr(opcodes, name))
+        for reg in regs:
+            self.code += self.output_num(reg, False)
+        if name in ('FIND', 'LEN', 'TO_INT'):
+            self.regmap[regs[0]] = 'int'
+        else:
+            self.regmap[regs[0]] = 'str'
+        return self.code
+
+    def parse_format(self, opts):
+        """
+        Arguments are consecutive registers, encoded as the first
+        one and count.
+
+        >>> p = Parser('')
+        >>> p.parse_format('R1, R2, R3, R4, R5')
+        '\\xb3\\x01\\x02\\x03\\x03'
+        >>> p.regmap[1]
+        'str'
+        >>> p.code = ''
+        >>> p.parse_format('R1, R2')
+        '\\xb3\\x01\\x02\\x00\\x00'
+        >>> p.parse_format('R1, R2, R3, R5') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: FORMAT arguments have to be consecutive registers: R1, R2, R3, R5 @0
+        """
+        data = [x.strip() for x in opts.split(',')]
+        if len(data) < 2:
+            raise ParseError('Unsupported FORMAT: %s @%s' % (opts, self.line))
+        regs = [self.parse_reg(x) for x in data]
+        args = regs[2:]
+        if args and args != range(args[0], args[0] + len(args)):
+            raise ParseError('FORMAT arguments have to be consecutive registers: %s @%s' % (opts, self.line))
+
+        self.code += chr(opcodes.FORMAT)
+        self.code += self.output_num(regs[0], False)
+        self.code += self.output_num(regs[1], False)
+        self.code += self.output_num(args[0] if args else 0, False)
+        self.code += self.output_num(len(args), False)
+        self.regmap[regs[0]] = 'str'
+        return self.code
+
     def parse_db(self, opts):
         """
         >>> p = Parser('')
@@ -848,6 +1335,7 @@ class Parser:
         >>> p.parse_db("'a', 'cd'")
         'acd'
         """
+        self.data_lines.add(self.line)
         data = [x.strip() for x in opts.split(',')]
         for val in data:
             if not val:
@@ -856,7 +1344,7 @@ class Parser:
                 self.code += self.format_string(val[1:-1])
             elif val[0] == '\"':
                 self.code += self.format_string(val[1:-1])
-            elif val[0] == '0' and val[1] == 'x':
+            elif val[:2] == '0x':
                 self.code += self.output_num(int(val, 16), False)
             elif val.isdigit():
                 self.code += self.output_num(int(val), False)
@@ -864,6 +1352,52 @@ class Parser:
                 raise ParseError('Invalid DB data: %s @%s' % (opts, self.line))
         return self.code
 
+    def parse_resb(self, opts):
+        """
+        Reserves zero initialized bytes after code and data, labels
+        point to start of heap.
+
+        >>> p = Parser('')
+        >>> p.parse_resb('8') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: RESB needs container output @0
+        >>> p.container = True
+        >>> p.parse_resb('8')
+        ''
+        >>> p.reserved
+        {0: 8}
+        >>> p.parse_resb('a') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: Invalid RESB size: a @0
+        """
+        if not self.container:
+            raise ParseError('RESB needs container output @%s' % (self.line))
+        size = opts.strip()
+        if not size.isdigit():
+            raise ParseError('Invalid RESB size: %s @%s' % (size, self.line))
+        self.reserved[self.line] = int(size)
+        return self.code
+
+    def parse_entry(self, opts):
+        """
+        >>> p = Parser('')
+        >>> p.parse_entry('main') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: ENTRY needs container output @0
+        >>> p.container = True
+        >>> p.parse_entry('main')
+        ''
+        >>> p.entry
+        ('main', 0)
+        """
+        if not self.container:
+            raise ParseError('ENTRY needs container output @%s' % (self.line))
+        self.entry = (opts.strip(), self.line)
+        return self.code
+
     def stub_2regs(self, opcode, name, opts):
         """
         >>> p = Parser('')
@@ -955,20 +1489,497 @@ class Parser:
         self.regmap[reg1] = self.regmap[reg2]
         return res
 
+    def parse_select(self, opts):
+        """
+        >>> p = Parser('')
+        >>> p.parse_select('R1, R2, R3, 5')
+        'Q\\x01\\x02\\x03P'
+        >>> p.regmap[1]
+        'int'
+        >>> p.parse_select('R1, R2, R3') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: Unsupported SELECT: R1, R2, R3 @0
+        """
+        data = [x.strip() for x in opts.split(',')]
+        if len(data) != 4:
+            raise ParseError('Unsupported SELECT: %s @%s' % (opts, self.line))
+        if [x for x in data if self.is_wide_imm(x)]:
+            raise ParseError('Immediate out of range for SELECT: %s @%s' % (opts, self.line))
+        regs = [self.parse_reg(x) for x in data]
+
+        self.code += chr(opcodes.SELECT)
+        for reg in regs:
+            self.code += self.output_num(reg, False)
+        self.regmap[regs[0]] = self.regmap.get(regs[2], 'int')
+        return self.code
+
+    def parse_set(self, opts):
+        """
+        >>> p = Parser('')
+        >>> p.parse_set('R1, R2 < R3')
+        'T\\x01\\x02\\x03'
+        >>> p.code = ''
+        >>> p.parse_set('R1, R2 != 1')
+        'S\\x01\\x02\\x10'
+        >>> p.code = ''
+        >>> p.parse_set('R1, R2 != 0') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: Immediate out of range for SET: R1, R2 != 0 @0
+        >>> p.parse_set('R1, R2 ^ R3') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: Unsupported SET: R1, R2 ^ R3 @0
+        """
+        data = [x.strip() for x in opts.split(',')]
+        cmp_ops = []
+        if len(data) == 2:
+            cmp_ops = [x.strip() for x in data[1].split(' ')]
+        if len(cmp_ops) != 3 or cmp_ops[1] not in self.jumps \
+                or not hasattr(opcodes, 'SET' + self.jumps[cmp_ops[1]][1:]):
+            raise ParseError('Unsupported SET: %s @%s' % (opts, self.line))
+        if self.is_wide_imm(cmp_ops[0]) or self.is_wide_imm(cmp_ops[2]):
+            raise ParseError('Immediate out of range for SET: %s @%s' % (opts, self.line))
+        reg = self.parse_reg(data[0])
+
+        self.code += chr(getattr(opcodes, 'SET' + self.jumps[cmp_ops[1]][1:]))
+        self.code += self.output_num(reg, False)
+        self.code += self.output_num(self.parse_reg(cmp_ops[0]), False)
+        self.code += self.output_num(self.parse_reg(cmp_ops[2]), False)
+        self.regmap[reg] = 'int'
+        return self.code
+
+    def stub_alu(self, opcode, imm_opcode, name, opts, commutative=False, signed=False):
+        """
+        >>> p = Parser('')
+        >>> p.stub_alu(15, 37, 'ADD', 'R1, R2, R3')
+        '\\x0f\\x01\\x02\\x03'
+        >>> p.code = ''
+        >>> p.stub_alu(15, 37, 'ADD', 'R1, R2, 5')
+        '\\x0f\\x01\\x02P'
+        >>> p.code = ''
+        >>> p.stub_alu(15, 37, 'ADD', 'R1, R2, 5678')
+        '%\\x01\\x02\\x02\\x16.'
+        >>> p.code = ''
+        >>> p.stub_alu(15, 37, 'ADD', 'R1, 5678, R2', True)
+        '%\\x01\\x02\\x02\\x16.'
+        >>> p.code = ''
+        >>> p.stub_alu(16, 38, 'SUB', 'R1, R2, 0')
+        '&\\x01\\x02\\x00'
+        >>> p.code = ''
+        >>> p.stub_alu(16, 38, 'SUB', 'R1, 5678, R2') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: Invalid register or immediate: 5678 @0
+        """
+        data = [x.strip() for x in opts.split(',')]
+        if len(data) == 3:
+            if commutative and self.is_wide_imm(data[1]) and not self.is_wide_imm(data[2]):
+                data = [data[0], data[2], data[1]]
+            if self.is_wide_imm(data[2]):
+                reg1 = self.parse_reg(data[0])
+                reg2 = self.parse_reg(data[1])
+
+                self.code += chr(imm_opcode)
+                self.code += self.output_num(reg1, False)
+                self.code += self.output_num(reg2, False)
+                if signed:
+                    self.code += self.output_simm(int(data[2]))
+                else:
+                    self.code += self.output_imm(int(data[2]))
+                self.regmap[reg1] = 'int'
+                return self.code
+
+        res = self.stub_3regs(opcode, name, ', '.join(data))
+        self.regmap[self.parse_reg(data[0])] = 'int'
+        return res
+
     def parse_add(self, opts):
-        return self.stub_3regs(opcodes.ADD_INT, 'ADD', opts)
+        return self.stub_alu(opcodes.ADD_INT, opcodes.ADD_IMM, 'ADD', opts, True)
 
     def parse_sub(self, opts):
-        return self.stub_3regs(opcodes.SUB_INT, 'SUB', opts)
+        return self.stub_alu(opcodes.SUB_INT, opcodes.SUB_IMM, 'SUB', opts)
 
     def parse_mul(self, opts):
-        return self.stub_3regs(opcodes.MUL_INT, 'MUL', opts)
+        return self.stub_alu(opcodes.MUL_INT, opcodes.MUL_IMM, 'MUL', opts, True)
 
     def parse_div(self, opts):
-        return self.stub_3regs(opcodes.DIV_INT, 'DIV', opts)
+        return self.stub_alu(opcodes.DIV_INT, opcodes.DIV_IMM, 'DIV', opts)
 
     def parse_mod(self, opts):
-        return self.stub_3regs(opcodes.MOD_INT, 'MOD', opts)
+        return self.stub_alu(opcodes.MOD_INT, opcodes.MOD_IMM, 'MOD', opts)
+
+    def parse_idiv(self, opts):
+        """
+        >>> p = Parser('')
+        >>> p.parse_idiv('R1, R2, -10')
+        'n\\x01\\x02\\x01\\xf6'
+        """
+        return self.stub_alu(opcodes.IDIV_INT, opcodes.IDIV_IMM, 'IDIV', opts, signed=True)
+
+    def parse_imod(self, opts):
+        return self.stub_alu(opcodes.IMOD_INT, opcodes.IMOD_IMM, 'IMOD', opts, signed=True)
+
+    def parse_mulh(self, name, opts):
+        """
+        >>> p = Parser('')
+        >>> p.parse_mulh('UMULH', 'R1, R2, R3')
+        'q\\x01\\x02\\x03'
+        """
+        res = self.stub_3regs(getattr(opcodes, name + '_INT'), name, opts)
+        self.regmap[self.parse_reg(opts.split(',')[0].strip())] = 'int'
+        return res
+
+    def parse_div128(self, opts):
+        """
+        Quotient and remainder of 128-bit high:low divided by 64-bit divisor.
+
+        >>> p = Parser('')
+        >>> p.parse_div128('R1, R2, R3, R4, R5')
+        'r\\x01\\x02\\x03\\x04\\x05'
+        >>> p.parse_div128('R1, R2, R3') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: Unsupported DIV128: R1, R2, R3 @0
+        """
+        data = [x.strip() for x in opts.split(',')]
+        if len(data) != 5:
+            raise ParseError('Unsupported DIV128: %s @%s' % (opts, self.line))
+        regs = [self.parse_reg(x) for x in data]
+
+        self.code += chr(opcodes.DIV128)
+        for reg in regs:
+            self.code += self.output_num(reg, False)
+        self.regmap[regs[0]] = 'int'
+        self.regmap[regs[1]] = 'int'
+        return self.code
+
+    def parse_store(self, opts):
+        """
+        Stores size lowest bytes of register to address in register.
+        Without size stores string with terminating NUL to address in
+        register or memory.
+
+        >>> p = Parser('')
+        >>> p.parse_store('R1, 4, R2')
+        '\\x01\\x01\\x04\\x02'
+        >>> p.code = ''
+        >>> p.parse_store('R1, R2')
+        '\\x0b\\x01\\x02'
+        >>> p.code = ''
+        >>> p.parse_store('R1, [300]')
+        '\\x0c\\x01\\x00\\x00\\x00\\x00\\x00\\x00\\x01,'
+        >>> p.code = ''
+        >>> p.parse_store('R1, 9, R2') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: Invalid argument for STORE: 9 @0
+        """
+        data = [x.strip() for x in opts.split(',')]
+        if len(data) == 2:
+            reg = self.parse_reg(data[0])
+            if data[1][0] == '[' and data[1][-1] == ']':
+                self.code += chr(opcodes.STORE_STR_MEM)
+                self.code += self.output_num(reg, False)
+                self.output_address(data[1][1:-1], 'STORE')
+            else:
+                self.code += chr(opcodes.STORE_STR)
+                self.code += self.output_num(reg, False)
+                self.code += self.output_num(self.parse_reg(data[1]), False)
+            return self.code
+        if len(data) != 3:
+            raise ParseError('Unsupported STORE: %s @%s' % (opts, self.line))
+        if not data[1].isdigit() or int(data[1]) > 8:
+            raise ParseError('Invalid argument for STORE: %s @%s' % (data[1], self.line))
+        reg1 = self.parse_reg(data[0])
+        reg2 = self.parse_reg(data[2])
+
+        self.code += chr(opcodes.STORE_INT)
+        self.code += self.output_num(reg1, False)
+        self.code += self.output_num(int(data[1]), False)
+        self.code += self.output_num(reg2, False)
+        return self.code
+
+    def parse_lane(self, lane):
+        """
+        >>> p = Parser('')
+        >>> p.parse_lane('i32')
+        6
+        >>> p.parse_lane('I128') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: Invalid lane type: I128 @0
+        """
+        lanes = ['U8', 'U16', 'U32', 'U64', 'I8', 'I16', 'I32', 'I64', 'F32', 'F64']
+        lane = lane.upper()
+        if lane not in lanes:
+            raise ParseError('Invalid lane type: %s @%s' % (lane, self.line))
+        return lanes.index(lane)
+
+    def parse_shape(self, shape):
+        """
+        Vector shape is lane type and count, for example I32X8.
+
+        >>> p = Parser('')
+        >>> p.parse_shape('I32X8')
+        134
+        >>> p.parse_shape('f64x2')
+        9
+        >>> p.parse_shape('U8X16')
+        0
+        >>> p.parse_shape('I32X2') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: Invalid vector shape: I32X2 @0
+        """
+        shape = shape.upper()
+        parts = shape.split('X')
+        if len(parts) != 2 or not parts[1].isdigit():
+            raise ParseError('Invalid vector shape: %s @%s' % (shape, self.line))
+        lane = self.parse_lane(parts[0])
+        bits = int(parts[0][1:]) * int(parts[1])
+        if bits == 128:
+            return lane
+        elif bits == 256:
+            return lane | 0x80
+        raise ParseError('Invalid vector shape: %s @%s' % (shape, self.line))
+
+    def parse_vreg(self, data):
+        """
+        >>> p = Parser('')
+        >>> p.parse_vreg('v15')
+        15
+        >>> p.parse_vreg('V16') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: Invalid vector register: V16 @0
+        """
+        data = data.upper()
+        if data[0] != 'V' or not data[1:].isdigit() or int(data[1:]) > 15:
+            raise ParseError('Invalid vector register: %s @%s' % (data, self.line))
+        return int(data[1:])
+
+    def parse_vector(self, name, shape, opts):
+        """
+        Vector load, store and splat take address or value register,
+        lane-wise operations vector registers, and reductions scalar
+        destination register.
+
+        >>> p = Parser('')
+        >>> p.parse_vector('VLOAD', 'I32X8', 'V1, R2')
+        '\\x97\\x01\\x86\\x02'
+        >>> p.code = ''
+        >>> p.parse_vector('VADD', 'F64X4', 'V0, V1, V2')
+        '\\x9a\\x00\\x00\\x89\\x01\\x02'
+        >>> p.code = ''
+        >>> p.parse_vector('VSUM', 'F64X4', 'R3, V0')
+        '\\x9b\\x03\\x00\\x89\\x00'
+        >>> p.regmap[3]
+        'float'
+        >>> p.parse_vector('VDIV', 'F64X4', 'V0, V1, V2') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: Unsupported command: VDIV @0
+        """
+        ops = ['VADD', 'VSUB', 'VMUL', 'VMIN', 'VMAX', 'VCMPEQ', 'VCMPGT',
+            'VAND', 'VOR', 'VXOR']
+        reductions = {'VSUM': 0, 'VHMIN': 3, 'VHMAX': 4}
+        moves = ['VLOAD', 'VSTORE', 'VSPLAT']
+        data = [x.strip() for x in opts.split(',')]
+        shape = self.parse_shape(shape)
+
+        if name in moves and len(data) == 2:
+            self.code += chr(getattr(opcodes, name))
+            self.code += self.output_num(self.parse_vreg(data[0]), False)
+            self.code += self.output_num(shape, False)
+            self.code += self.output_num(self.parse_reg(data[1]), False)
+        elif name in ops and len(data) == 3:
+            self.code += chr(opcodes.VOP)
+            self.code += self.output_num(self.parse_vreg(data[0]), False)
+            self.code += self.output_num(ops.index(name), False)
+            self.code += self.output_num(shape, False)
+            self.code += self.output_num(self.parse_vreg(data[1]), False)
+            self.code += self.output_num(self.parse_vreg(data[2]), False)
+        elif name in reductions and len(data) == 2:
+            reg = self.parse_reg(data[0])
+            self.code += chr(opcodes.VREDUCE)
+            self.code += self.output_num(reg, False)
+            self.code += self.output_num(reductions[name], False)
+            self.code += self.output_num(shape, False)
+            self.code += self.output_num(self.parse_vreg(data[1]), False)
+            self.regmap[reg] = 'float' if (shape & 0x7f) >= 8 else 'int'
+        elif name in ops or name in reductions or name in moves:
+            raise ParseError('Unsupported %s: %s @%s' % (name, opts, self.line))
+        else:
+            raise ParseError('Unsupported command: %s @%s' % (name, self.line))
+        return self.code
+
+    def parse_array(self, name, lane, opts):
+        """
+        Array intrinsics take base address and element count registers.
+
+        >>> p = Parser('')
+        >>> p.parse_array('ASUM', 'I32', 'R1, R2, R3')
+        '\\x9c\\x01\\x00\\x06\\x02\\x03'
+        >>> p.code = ''
+        >>> p.parse_array('ACOUNT', 'U8', 'R1, R2, R3, 0')
+        '\\x9d\\x01\\x00\\x02\\x03\\x00'
+        >>> p.code = ''
+        >>> p.parse_array('ASCAN', 'F64', 'R2, R3')
+        '\\x9e\\t\\x02\\x03'
+        >>> p.parse_array('AMAX', 'U8', 'R1, R2') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: Unsupported AMAX: R1, R2 @0
+
+        SORT and BSEARCH take optional record stride, element width by default.
+
+        >>> p.code = ''
+        >>> p.parse_array('SORT', 'I32', 'R2, R3')
+        '\\x9f\\x06\\x02\\x03@'
+        >>> p.code = ''
+        >>> p.parse_array('BSEARCH', 'U16', 'R1, R2, R3, R4, R5')
+        '\\xa0\\x01\\x01\\x02\\x03\\x04\\x05'
+        """
+        reductions = {'ASUM': 0, 'AMIN': 3, 'AMAX': 4}
+        lane = self.parse_lane(lane)
+        data = [x.strip() for x in opts.split(',')]
+        counts = {'ACOUNT': 4, 'ASCAN': 2, 'SORT': 2, 'BSEARCH': 4}
+        if name not in reductions and name not in counts:
+            raise ParseError('Unsupported command: %s @%s' % (name, self.line))
+        if name in ('SORT', 'BSEARCH'):
+            if len(data) == counts[name]:
+                data.append(str([1, 2, 4, 8, 1, 2, 4, 8, 4, 8][lane]))
+            counts[name] += 1
+        if len(data) != counts.get(name, 3):
+            raise ParseError('Unsupported %s: %s @%s' % (name, opts, self.line))
+        regs = [self.parse_reg(x) for x in data]
+
+        self.code += chr(getattr(opcodes, 'AREDUCE' if name in reductions else name))
+        if name in reductions:
+            self.code += self.output_num(regs[0], False)
+            self.code += self.output_num(reductions[name], False)
+            self.regmap[regs[0]] = 'float' if lane >= 8 else 'int'
+            regs = regs[1:]
+        elif name in ('ACOUNT', 'BSEARCH'):
+            self.code += self.output_num(regs[0], False)
+            self.regmap[regs[0]] = 'int'
+            regs = regs[1:]
+        self.code += self.output_num(lane, False)
+        for reg in regs:
+            self.code += self.output_num(reg, False)
+        return self.code
+
+    def parse_hash(self, name, opts):
+        """
+        CRC continues from value in destination, XXH64S uses it as seed.
+
+        >>> p = Parser('')
+        >>> p.parse_hash('CRC32', 'R1, R2, R3')
+        '\\xa1\\x01\\x01\\x02\\x03'
+        >>> p.code = ''
+        >>> p.parse_hash('XXH64S', 'R1, R2, 8')
+        '\\xa2\\x01\\x01\\x02\\x80'
+        >>> p.parse_hash('XXH64', 'R1, R2') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: Unsupported XXH64: R1, R2 @0
+        """
+        algos = {
+            'CRC32C': (opcodes.CRC, 0),
+            'CRC32': (opcodes.CRC, 1),
+            'XXH64': (opcodes.HASH, 0),
+            'XXH64S': (opcodes.HASH, 1),
+        }
+        data = [x.strip() for x in opts.split(',')]
+        if len(data) != 3:
+            raise ParseError('Unsupported %s: %s @%s' % (name, opts, self.line))
+        regs = [self.parse_reg(x) for x in data]
+        (opcode, algo) = algos[name]
+
+        self.code += chr(opcode)
+        self.code += self.output_num(regs[0], False)
+        self.code += self.output_num(algo, False)
+        self.code += self.output_num(regs[1], False)
+        self.code += self.output_num(regs[2], False)
+        self.regmap[regs[0]] = 'int'
+        return self.code
+
+    def parse_bitop(self, name, opts):
+        """
+        >>> p = Parser('')
+        >>> p.parse_bitop('AND', 'R1, R2, R3')
+        'X\\x01\\x02\\x03'
+        >>> p.code = ''
+        >>> p.parse_bitop('AND', 'R1, 255, R2')
+        '`\\x01\\x02\\x01\\xff'
+        >>> p.code = ''
+        >>> p.parse_bitop('SAR', 'R1, R2, 3')
+        ']\\x01\\x020'
+        >>> p.code = ''
+        >>> p.parse_bitop('ROL', 'R1, R2, 33')
+        'f\\x01\\x02\\x01!'
+        """
+        commutative = name in ['AND', 'OR', 'XOR']
+        return self.stub_alu(getattr(opcodes, name + '_INT'),
+            getattr(opcodes, name + '_IMM'), name, opts, commutative)
+
+    def parse_unary(self, name, opts):
+        """
+        >>> p = Parser('')
+        >>> p.parse_unary('POPCNT', 'R1, R2')
+        'i\\x01\\x02'
+        >>> p.code = ''
+        >>> p.parse_unary('NOT', 'R1, R1')
+        'h\\x01\\x01'
+        >>> p.code = ''
+        >>> p.parse_unary('CLZ', 'R1, 0') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: Immediate out of range for CLZ: R1, 0 @0
+        """
+        opcode = getattr(opcodes, 'NOT_INT' if name == 'NOT' else name)
+        if [x for x in opts.split(',') if self.is_wide_imm(x.strip())]:
+            raise ParseError('Immediate out of range for %s: %s @%s' % (name, opts, self.line))
+        (res, reg1, reg2) = self.stub_2regs(opcode, name, opts)
+        self.regmap[reg1] = 'int'
+        return res
+
+    def parse_float_op(self, name, opts):
+        """
+        >>> p = Parser('')
+        >>> p.parse_float_op('FADD', 'R1, R2, R3')
+        '\\x85\\x01\\x02\\x03'
+        >>> p.code = ''
+        >>> p.parse_float_op('FMA', 'R1, R2, R3, 1')
+        '\\x8b\\x01\\x02\\x03\\x10'
+        >>> p.code = ''
+        >>> p.parse_float_op('FTOI', 'R1, R2')
+        '\\x8e\\x01\\x02'
+        >>> p.regmap[1]
+        'int'
+        >>> p.parse_float_op('FMUL', 'R1, R2, 20') # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: Invalid register or immediate: 20 @0
+        """
+        opcode = getattr(opcodes, name)
+        if name == 'FMA':
+            regs = [self.parse_reg(x.strip()) for x in opts.split(',')]
+            if len(regs) != 4:
+                raise ParseError('Unsupported %s: %s @%s' % (name, opts, self.line))
+            self.code += chr(opcode)
+            for reg in regs:
+                self.code += self.output_num(reg, False)
+            reg1 = regs[0]
+        elif name in ['FSQRT', 'ITOF', 'FTOI']:
+            (res, reg1, reg2) = self.stub_2regs(opcode, name, opts)
+        else:
+            self.stub_3regs(opcode, name, opts)
+            reg1 = self.parse_reg(opts.split(',')[0].strip())
+        self.regmap[reg1] = 'int' if name == 'FTOI' else 'float'
+        return self.code
 
     def parse_heap(self, opts):
         """
@@ -1075,12 +2086,53 @@ class Parser:
             return self.parse_div(opts)
         elif cmd == 'MOD':
             return self.parse_mod(opts)
+        elif cmd == 'SELECT':
+            return self.parse_select(opts)
+        elif cmd == 'SET':
+            return self.parse_set(opts)
+        elif cmd == 'IDIV':
+            return self.parse_idiv(opts)
+        elif cmd == 'IMOD':
+            return self.parse_imod(opts)
+        elif cmd in ['MULH', 'UMULH']:
+            return self.parse_mulh(cmd, opts)
+        elif cmd == 'DIV128':
+            return self.parse_div128(opts)
+        elif cmd in ['AND', 'OR', 'XOR', 'SHL', 'SHR', 'SAR', 'ROL', 'ROR']:
+            return self.parse_bitop(cmd, opts)
+        elif cmd in ['NOT', 'POPCNT', 'CLZ', 'CTZ']:
+            return self.parse_unary(cmd, opts)
+        elif cmd in ['FADD', 'FSUB', 'FMUL', 'FDIV', 'FMIN', 'FMAX', 'FMA',
+                'FSQRT', 'ITOF', 'FTOI']:
+            return self.parse_float_op(cmd, opts)
+        elif cmd == 'STORE':
+            return self.parse_store(opts)
+        elif cmd in ['MAP_NEW', 'MAP_PUT', 'MAP_GET', 'MAP_DEL', 'MAP_SIZE']:
+            return self.parse_map(cmd, opts)
+        elif cmd in ['CONCAT', 'SUBSTR', 'FIND', 'LEN', 'TO_INT', 'FROM_INT']:
+            return self.parse_str(cmd, opts)
+        elif cmd == 'FORMAT':
+            return self.parse_format(opts)
+        elif cmd in ['CRC32C', 'CRC32', 'XXH64', 'XXH64S']:
+            return self.parse_hash(cmd, opts)
+        elif (cmd.startswith('A') or cmd.startswith('SORT.') or cmd.startswith('BSEARCH.')) and '.' in cmd:
+            (name, lane) = cmd.split('.', 1)
+            return self.parse_array(name, lane, opts)
+        elif cmd.startswith('V') and '.' in cmd:
+            (name, shape) = cmd.split('.', 1)
+            return self.parse_vector(name, shape, opts)
         elif cmd == 'DB':
             return self.parse_db(opts)
+        elif cmd == 'RESB':
+            return self.parse_resb(opts)
+        elif cmd == 'ENTRY':
+            return self.parse_entry(opts)
         elif cmd == 'HEAP':
             return self.parse_heap(opts)
         elif cmd == 'INFO':
             return self.parse_info(opts)
+        elif cmd == 'SNAPSHOT':
+            self.code += chr(opcodes.SNAPSHOT)
         elif cmd == 'STOP':
             self.code += chr(opcodes.STOP)
         else:
@@ -1172,6 +2224,14 @@ class Parser:
         >>> p.output[3] = 'FIXME 1, 1, 1, 0, 0: d'
         >>> p.try_fix(1)
         (False, 2)
+        >>> p.try_fix(3)
+        (False, 0)
+        >>> p.output[1] = 'abc'
+        >>> p.try_fix(3)
+        (True, -5)
+        >>> p.output[3] = 'FIXME 1, 1, 3, 0, 0: d'
+        >>> p.try_fix(3)
+        (True, 0)
         """
         if not line:
             return (False, 0)
@@ -1181,29 +2241,31 @@ class Parser:
         (_, bits, target, oper, diff) = [int(x) for x in data[0][6:].split(',')]
 
         if bits == 8:
-            tmp = 0
+            # Absolute address
+            (tmp, end) = (min(self.output), target)
+        elif target > line:
+            (tmp, end) = (line + 1, target)
         else:
-            tmp = line + 1
+            (tmp, end) = (target, line)
 
-        inc = 1
-        if tmp > target:
-            inc = -1
         size = 0
-        while tmp != target:
+        while tmp < end:
             if tmp == line:
-                pass
+                size += len(':'.join(data[1:])) + bits
             elif tmp in self.output:
                 if self.output[tmp][:5] == Parser.__MAGIC_JUMP:
                     return (False, size)
-                size += len(self.output[tmp])
-            tmp += inc
+                size += len(self.output[tmp]) + self.reserved.get(tmp, 0)
+            tmp += 1
 
         if oper == 1:
             size += diff
         elif oper == 2:
             size -= diff
 
-        return (True, size * inc)
+        if bits != 8 and target <= line:
+            size = -size
+        return (True, size)
 
     def fix_line(self, line, size):
         """
@@ -1211,25 +2273,52 @@ class Parser:
         >>> p.fix_line('', 0)
         >>> p.output[1] = 'FIXME 1, 1, 2, 0, 0: a'
         >>> p.fix_line(1, 0)
+        >>> p.output[1]
+        ' a\\x01'
+        >>> p.output[1] = 'FIXME 1, 1, 1, 0, 0:\\x1d\\x01\\x01\\x02'
+        >>> p.fix_line(1, -2)
+        >>> p.output[1]
+        '\\x1d\\x01\\x01\\x02\\xfa'
+        >>> p.output[1] = 'FIXME 1,1,9,0,0:\\x1d\\x01\\x01\\x02'
+        >>> p.fix_line(1, 300)
+        >>> p.output[1]
+        'FIXME 1,2,9,0,0:\\x1e\\x01\\x01\\x02'
+        >>> p.fix_line(1, 300)
+        >>> p.output[1]
+        '\\x1e\\x01\\x01\\x02\\x01.'
+        >>> p.output[1] = 'FIXME 1,1,9,0,0:/\\x01\\x02'
+        >>> p.fix_line(1, 300)
+        >>> p.output[1]
+        'FIXME 1,4,9,0,0:5\\x01\\x02'
         """
         if not line:
             return
         data = self.output[line].split(':')
-        (append_bits, bits, target, _, _) = [int(x) for x in data[0][6:].split(',')]
+        (append_bits, bits, target, oper, diff) = [int(x) for x in data[0][6:].split(',')]
         data = ':'.join(data[1:])
 
         outnum = size
-        if append_bits == 1:
-            if outnum < 0:
-                outnum -= bits
-            else:
+        if append_bits == 1 and bits != 8:
+            if target > line:
                 outnum += bits
-        if outnum < 0:
-            outnum -= len(data)
+            else:
+                outnum -= len(data)
+
+        if not self.fits(outnum, bits) and bits != 8:
+            # Widen and retry, size of this line changes
+            opcode = ord(data[0])
+            if opcode not in self.wider:
+                raise ParseError('Jump too long on line %s' % (line))
+            (opcode, bits) = self.wider[opcode]
+            self.output[line] = '%s %s,%s,%s,%s,%s:' % (Parser.__MAGIC_JUMP,
+                append_bits, bits, target, oper, diff) + chr(opcode) + data[1:]
+            return
 
-        num = self.output_num(outnum, False)
-        while len(num) < bits / 8:
-            num = '\x00' + num
+        if bits == 8:
+            num = self.output_num(outnum, False)
+            num = '\x00' * (8 - len(num)) + num
+        else:
+            num = self.output_fixed(outnum, bits)
 
         self.output[line] = data + num
 
@@ -1277,14 +2366,14 @@ class Parser:
         >>> p.apply_post_data()
         """
         for line in self.postdata:
-            tmp = 0
+            tmp = min(self.output)
             size = 0
             (opcode, target, oper, diff) = self.postdata[line]
             while tmp < target:
                 if tmp in self.output:
                     if self.output[tmp][:5] == Parser.__MAGIC_JUMP:
                         raise ParseError('Got invalid %s on %s' % (Parser.__MAGIC_JUMP, tmp))
-                    size += len(self.output[tmp])
+                    size += len(self.output[tmp]) + self.reserved.get(tmp, 0)
                 tmp += 1
             if oper == '+':
                 size += diff
@@ -1311,12 +2400,132 @@ class Parser:
 
             self.output[self.line] = self.code
 
+        # Container has the pool in its own section
+        if self.strings and not self.container:
+            self.output[Parser.POOL_LINE] = self.output_pool()
+        if self.reserved:
+            first = min(self.reserved)
+            for line in self.output:
+                if line > first and self.output[line]:
+                    raise ParseError('Code or data after RESB @%s' % (line))
         self.fix_fixmes()
         self.apply_post_data()
 
+    def addresses(self):
+        """
+        Address of each output line, and the end of the reserved bytes.
+
+        >>> p = Parser('')
+        >>> p.output[0] = 'ab'
+        >>> p.output[2] = ''
+        >>> p.output[3] = 'c'
+        >>> p.reserved[4] = 8
+        >>> p.output[4] = ''
+        >>> p.addresses()
+        ({0: 0, 2: 2, 3: 2, 4: 3}, 11)
+        """
+        res = {}
+        pos = 0
+        for line in sorted(self.output):
+            res[line] = pos
+            pos += len(self.output[line]) + self.reserved.get(line, 0)
+        return (res, pos)
+
+    def label_address(self, name, addrs, end):
+        """
+        >>> p = Parser('')
+        >>> p.output[0] = 'ab'
+        >>> p.labels = {'a': 0, 'b': 1}
+        >>> p.label_address('b', {0: 0}, 2)
+        2
+        >>> p.label_address('c', {0: 0}, 2) # doctest: +ELLIPSIS +IGNORE_EXCEPTION_DETAIL
+        Traceback (most recent call last):
+        ...
+        ParseError: Unknown label: c
+        """
+        if name not in self.labels:
+            raise ParseError('Unknown label: %s' % (name))
+        after = [l for l in addrs if l >= self.labels[name]]
+        if not after:
+            return end
+        return addrs[min(after)]
+
+    def generate_container(self, heap=0, strip=False):
+        """
+        Sectioned program, see core/program.hh for the layout. Trailing
+        DB lines go to read only data and RESB lines to zero initialized
+        data, both stay right after the code.
+
+        >>> p = Parser(['start: LOAD R1, "a"', 'STOP', 'msg: DB "b", 0', 'buf: RESB 4'])
+        >>> p.debug = False
+        >>> p.container = True
+        >>> p.parse()
+        >>> res = p.generate_container(16)
+        >>> res[:4]
+        '\\x7fMVM'
+        >>> struct.unpack('>HHQQQQQQQQ', res[4:72])
+        (1, 0, 0, 5, 2, 4, 16, 2, 38, 24)
+        >>> struct.unpack('>I', res[72:76])[0] == zlib.crc32(res[:72] + '\\x00' * 4 + res[76:]) & 0xffffffff
+        True
+        >>> res[80:]
+        '\\xaa\\x01\\x00\\x00\\xffb\\x00a\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x00start\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x05msg\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x07buf\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x01\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x04\\x00\\x00\\x00\\x02'
+        >>> len(p.generate_container(strip=True))
+        89
+        """
+        memory = self.generate()
+        (addrs, end) = self.addresses()
+
+        # Read only data is the data after the last instruction
+        rodata = len(memory)
+        for line in sorted(self.output, reverse=True):
+            if not self.output[line]:
+                continue
+            if line not in self.data_lines:
+                break
+            rodata = addrs[line]
+        code_size = rodata
+        rodata = len(memory) - code_size
+        bss = end - len(memory)
+
+        entry = 0
+        if self.entry is not None:
+            (name, self.line) = self.entry
+            entry = self.label_address(name, addrs, end)
+            if entry >= code_size:
+                raise ParseError('Entry point not in code: %s @%s' % (name, self.line))
+
+        strings = ''.join([x + '\x00' for x in self.strings])
+
+        symbols = ''
+        lines = ''
+        if not strip:
+            syms = sorted([(self.label_address(x, addrs, end), x) for x in self.labels])
+            for (addr, name) in syms:
+                symbols += struct.pack('>Q', addr) + name + '\x00'
+            for line in sorted(self.output):
+                if line >= 0 and self.output[line] and line not in self.data_lines:
+                    lines += struct.pack('>QI', addrs[line], line + 1)
+
+        sections = memory + strings + symbols + lines
+        header = struct.pack('>4sHHQQQQQQQQII', '\x7fMVM', 1, 0, entry,
+            code_size, rodata, bss, heap, len(strings), len(symbols),
+            len(lines), 0, 0)
+        crc = zlib.crc32(header + sections) & 0xffffffff
+        return header[:72] + struct.pack('>I', crc) + header[76:] + sections
+
 if __name__ == '__main__':
     parser = argparse.ArgumentParser(description='Assembler for MinVM')
     parser.add_argument('-q', '--quiet', action='store_true')
+    parser.add_argument('--no-loop', action='store_true',
+        help='Do not combine counter updates and branches to LOOP')
+    parser.add_argument('--no-pool', action='store_true',
+        help='Keep string literals inline instead of string pool')
+    parser.add_argument('--container', action='store_true',
+        help='Write sectioned container instead of raw bytecode')
+    parser.add_argument('--heap', type=int, default=0,
+        help='Initial heap size of container')
+    parser.add_argument('--strip', action='store_true',
+        help='Leave symbol and line tables out of container')
     parser.add_argument('input', type=argparse.FileType('rb'))
     parser.add_argument('output', type=argparse.FileType('wb'))
     res = vars(parser.parse_args())
@@ -1325,8 +2534,19 @@ if __name__ == '__main__':
     p = Parser(data)
     if res['quiet']:
         p.debug = False
+    if res['no_loop']:
+        p.fuse_loops = False
+    if res['no_pool']:
+        p.pool_strings = False
+    if res['container']:
+        p.container = True
+    elif res['heap'] or res['strip']:
+        parser.error('--heap and --strip need --container')
     p.parse()
 
     if not res['quiet']:
         print ('Code:\n%s' % (p))
-    res['output'].write(p.generate())
+    if p.container:
+        res['output'].write(p.generate_container(res['heap'], res['strip']))
+    else:
+        res['output'].write(p.generate())
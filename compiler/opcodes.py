@@ -39,4 +39,148 @@ JMP_LE_INT = 0x21
 MOV = 0x22
 HEAP = 0x23
 INFO = 0x24
+ADD_IMM = 0x25
+SUB_IMM = 0x26
+MUL_IMM = 0x27
+DIV_IMM = 0x28
+MOD_IMM = 0x29
+JMP_LE_IMM8 = 0x2a
+JMP_LE_IMM16 = 0x2b
+JMP_LE_IMM32 = 0x2c
+JEQ8 = 0x2d
+JNE8 = 0x2e
+JLT8 = 0x2f
+JGT8 = 0x30
+JLE8 = 0x31
+JGE8 = 0x32
+JEQ32 = 0x33
+JNE32 = 0x34
+JLT32 = 0x35
+JGT32 = 0x36
+JLE32 = 0x37
+JGE32 = 0x38
+JEQ_IMM8 = 0x39
+JNE_IMM8 = 0x3a
+JLT_IMM8 = 0x3b
+JGT_IMM8 = 0x3c
+JLE_IMM8 = 0x3d
+JGE_IMM8 = 0x3e
+JEQ_IMM32 = 0x3f
+JNE_IMM32 = 0x40
+JLT_IMM32 = 0x41
+JGT_IMM32 = 0x42
+JLE_IMM32 = 0x43
+JGE_IMM32 = 0x44
+LOOP_INC8 = 0x45
+LOOP_INC16 = 0x46
+LOOP_INC32 = 0x47
+LOOP_DEC8 = 0x48
+LOOP_DEC16 = 0x49
+LOOP_DEC32 = 0x4a
+LOOP_INC_IMM8 = 0x4b
+LOOP_INC_IMM16 = 0x4c
+LOOP_INC_IMM32 = 0x4d
+LOOP_DEC_IMM8 = 0x4e
+LOOP_DEC_IMM16 = 0x4f
+LOOP_DEC_IMM32 = 0x50
+SELECT = 0x51
+SETEQ = 0x52
+SETNE = 0x53
+SETLT = 0x54
+SETGT = 0x55
+SETLE = 0x56
+SETGE = 0x57
+AND_INT = 0x58
+OR_INT = 0x59
+XOR_INT = 0x5a
+SHL_INT = 0x5b
+SHR_INT = 0x5c
+SAR_INT = 0x5d
+ROL_INT = 0x5e
+ROR_INT = 0x5f
+AND_IMM = 0x60
+OR_IMM = 0x61
+XOR_IMM = 0x62
+SHL_IMM = 0x63
+SHR_IMM = 0x64
+SAR_IMM = 0x65
+ROL_IMM = 0x66
+ROR_IMM = 0x67
+NOT_INT = 0x68
+POPCNT = 0x69
+CLZ = 0x6a
+CTZ = 0x6b
+IDIV_INT = 0x6c
+IMOD_INT = 0x6d
+IDIV_IMM = 0x6e
+IMOD_IMM = 0x6f
+MULH_INT = 0x70
+UMULH_INT = 0x71
+DIV128 = 0x72
+JSLT8 = 0x73
+JSGT8 = 0x74
+JSLE8 = 0x75
+JSGE8 = 0x76
+JSLT32 = 0x77
+JSGT32 = 0x78
+JSLE32 = 0x79
+JSGE32 = 0x7a
+JSLT_IMM8 = 0x7b
+JSGT_IMM8 = 0x7c
+JSLE_IMM8 = 0x7d
+JSGE_IMM8 = 0x7e
+JSLT_IMM32 = 0x7f
+JSGT_IMM32 = 0x80
+JSLE_IMM32 = 0x81
+JSGE_IMM32 = 0x82
+LOAD_FLOAT = 0x83
+LOAD_FLOAT32 = 0x84
+FADD = 0x85
+FSUB = 0x86
+FMUL = 0x87
+FDIV = 0x88
+FMIN = 0x89
+FMAX = 0x8a
+FMA = 0x8b
+FSQRT = 0x8c
+ITOF = 0x8d
+FTOI = 0x8e
+JFEQ8 = 0x8f
+JFNE8 = 0x90
+JFLT8 = 0x91
+JFLE8 = 0x92
+JFEQ32 = 0x93
+JFNE32 = 0x94
+JFLT32 = 0x95
+JFLE32 = 0x96
+VLOAD = 0x97
+VSTORE = 0x98
+VSPLAT = 0x99
+VOP = 0x9a
+VREDUCE = 0x9b
+AREDUCE = 0x9c
+ACOUNT = 0x9d
+ASCAN = 0x9e
+SORT = 0x9f
+BSEARCH = 0xa0
+CRC = 0xa1
+HASH = 0xa2
+MAP_NEW = 0xa3
+MAP_PUT = 0xa4
+MAP_GET8 = 0xa5
+MAP_GET32 = 0xa6
+MAP_DEL = 0xa7
+MAP_SIZE = 0xa8
+STR_POOL = 0xa9
+LOAD_STR_CONST = 0xaa
+CONCAT = 0xab
+SUBSTR = 0xac
+FIND = 0xad
+LEN = 0xae
+JSTR8 = 0xaf
+JSTR32 = 0xb0
+TO_INT = 0xb1
+FROM_INT = 0xb2
+FORMAT = 0xb3
+SNAPSHOT = 0xb4
 STOP = 0xff
@@ -0,0 +1,357 @@
+#include "checkpoint.hh"
+#include "serial.hh"
+#include "snapshot.hh"
+#include "vm.hh"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using core::Checkpoint;
+using core::Heap;
+using core::Program;
+using core::Reader;
+using core::Snapshot;
+
+static const char magic[] = "\x7fMVC";
+static const uint64_t header_size = 24;
+static const uint64_t flag_full = 1;
+
+static uint64_t read_be(const uint8_t *data, unsigned size)
+{
+    uint64_t res = 0;
+    for (unsigned i = 0; i < size; ++i)
+        res = (res << 8) | data[i];
+    return res;
+}
+
+static bool pwrite_all(int fd, const char *data, uint64_t size,
+    uint64_t offset)
+{
+    while (size > 0) {
+        ssize_t res = ::pwrite(fd, data, size, offset);
+        if (res < 0 && errno == EINTR)
+            continue;
+        if (res <= 0)
+            return false;
+        data += res;
+        size -= res;
+        offset += res;
+    }
+    return true;
+}
+
+/* Bytes of page in heap, last one can be short */
+static uint64_t page_length(const Heap &heap, uint64_t page)
+{
+    uint64_t start = page << Heap::page_bits;
+    return heap.size() - start < Heap::page_size ?
+        heap.size() - start : Heap::page_size;
+}
+
+static bool is_zero(const uint8_t *data, uint64_t size)
+{
+    return data[0] == 0 && std::memcmp(data, data + 1, size - 1) == 0;
+}
+
+/* Calls func with payload of each intact record, returns where they end
+ */
+static uint64_t scan(const uint8_t *data, uint64_t size,
+    std::function<void (const uint8_t *, uint64_t)> func)
+{
+    uint64_t pos = header_size;
+    while (size - pos >= 12) {
+        uint64_t len = read_be(data + pos, 8);
+        if (len > size - pos - 12)
+            break;
+        const uint8_t *payload = data + pos + 8;
+        if (Program::checksum(payload, len) != read_be(payload + len, 4))
+            break;
+        func(payload, len);
+        pos += len + 12;
+    }
+    return pos;
+}
+
+/* Read only mapping of the whole log */
+class LogMap
+{
+public:
+    LogMap(int fd, uint64_t size) : m_size(size)
+    {
+        m_data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m_data == MAP_FAILED)
+            throw std::string("Can't map checkpoint log");
+    }
+    ~LogMap()
+    {
+        munmap(m_data, m_size);
+    }
+    inline const uint8_t *data() const
+    {
+        return (const uint8_t*)m_data;
+    }
+
+private:
+    void *m_data;
+    uint64_t m_size;
+};
+
+Checkpoint::Checkpoint(VM &vm, const std::string &path) :
+    m_vm(vm), m_path(path), m_fd(-1),
+    m_size(0), m_base_size(0), m_records(0), m_sequence(0),
+    m_synced(false)
+{
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (m_fd < 0)
+        throw std::string("Can't open checkpoint log: ") + path;
+    try {
+        open();
+    }
+    catch (...) {
+        close(m_fd);
+        throw;
+    }
+}
+
+Checkpoint::~Checkpoint()
+{
+    close(m_fd);
+}
+
+static std::string log_header(const core::VM &vm)
+{
+    std::string res(magic, 4);
+    core::put_be(res, Checkpoint::Version, 2);
+    core::put_be(res, 0, 2);
+    Snapshot::save_program(vm, res);
+    return res;
+}
+
+void Checkpoint::open()
+{
+    struct stat st;
+    if (fstat(m_fd, &st) != 0)
+        throw std::string("Can't open checkpoint log: ") + m_path;
+    uint64_t size = st.st_size;
+
+    if (size == 0) {
+        std::string header = log_header(m_vm);
+        if (!pwrite_all(m_fd, header.data(), header.size(), 0))
+            throw std::string("Can't write checkpoint log: ") + m_path;
+        m_size = m_base_size = header.size();
+        return;
+    }
+
+    LogMap map(m_fd, size);
+    Reader reader(map.data(), size, "checkpoint log");
+    if (size < header_size || std::memcmp(reader.take(4), magic, 4) != 0)
+        throw std::string("Invalid checkpoint log: ") + m_path;
+    uint64_t version = reader.get(2);
+    if (version != Version)
+        throw std::string("Unsupported checkpoint log version: ")
+            + std::to_string(version);
+    reader.get(2);
+    if (!Snapshot::check_program(m_vm, reader))
+        throw std::string("Checkpoint log doesn't match loaded program");
+
+    m_size = scan(map.data(), size, [&](const uint8_t *data, uint64_t) {
+        m_sequence = read_be(data, 8);
+        ++m_records;
+    });
+    // Torn record of interrupted write
+    if (m_size < size && ftruncate(m_fd, m_size) != 0)
+        throw std::string("Can't write checkpoint log: ") + m_path;
+    m_base_size = m_size;
+}
+
+uint64_t Checkpoint::append(int fd, uint64_t offset, bool full)
+{
+    std::vector<Heap> &heaps = m_vm.m_heap;
+
+    std::string head;
+    put_be(head, m_sequence + 1, 8);
+    put_be(head, full ? flag_full : 0, 8);
+    Snapshot::save_state(m_vm, head);
+    put_be(head, heaps.size(), 8);
+    for (auto &heap : heaps) {
+        put_be(head, heap.pos(), 8);
+        put_be(head, heap.size(), 8);
+    }
+
+    // Heap index and page of each page going to the record
+    std::vector<std::pair<uint64_t, uint64_t>> pages;
+    uint64_t payload = head.size() + 8;
+    for (uint64_t i = 0; i < heaps.size(); ++i) {
+        const Heap &heap = heaps[i];
+        for (uint64_t page = 0; page < heap.pages(); ++page) {
+            uint64_t start = page << Heap::page_bits;
+            uint64_t len = page_length(heap, page);
+            if (full ? is_zero(heap.data(heap.pos() + start, len), len)
+                    : !heap.dirty(page))
+                continue;
+            pages.push_back(std::make_pair(i, page));
+            payload += 16 + len;
+        }
+    }
+    put_be(head, pages.size(), 8);
+
+    std::string buf;
+    put_be(buf, payload, 8);
+    uint64_t written = 0;
+    uint32_t crc = Program::checksum((const uint8_t*)head.data(),
+        head.size());
+    buf += head;
+    auto flush = [&]() {
+        if (!pwrite_all(fd, buf.data(), buf.size(), offset + written))
+            throw std::string("Can't write checkpoint log: ") + m_path;
+        written += buf.size();
+        buf.clear();
+    };
+
+    for (auto &item : pages) {
+        const Heap &heap = heaps[item.first];
+        uint64_t start = item.second << Heap::page_bits;
+        uint64_t len = page_length(heap, item.second);
+        const uint8_t *data = heap.data(heap.pos() + start, len);
+
+        std::string tag;
+        put_be(tag, heap.pos(), 8);
+        put_be(tag, item.second, 8);
+        crc = Program::checksum((const uint8_t*)tag.data(), tag.size(), crc);
+        crc = Program::checksum(data, len, crc);
+        buf += tag;
+        buf.append((const char*)data, len);
+        if (buf.size() >= (1 << 20))
+            flush();
+    }
+    put_be(buf, crc, 4);
+    flush();
+
+    if (fdatasync(fd) != 0)
+        throw std::string("Can't write checkpoint log: ") + m_path;
+    return written;
+}
+
+void Checkpoint::write()
+{
+    uint64_t written;
+    try {
+        written = append(m_fd, m_size, !m_synced);
+    }
+    catch (...) {
+        // Leave log as it was, partial record would be cut anyway
+        if (ftruncate(m_fd, m_size) != 0) {
+        }
+        throw;
+    }
+
+    m_size += written;
+    ++m_records;
+    ++m_sequence;
+    m_synced = true;
+    for (auto &heap : m_vm.m_heap)
+        heap.clear_dirty();
+}
+
+void Checkpoint::compact()
+{
+    // Written aside and renamed, old log stays if this fails
+    std::string tmp = m_path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+        0644);
+    if (fd < 0)
+        throw std::string("Can't write checkpoint log: ") + tmp;
+
+    uint64_t size = 0;
+    try {
+        std::string header = log_header(m_vm);
+        if (!pwrite_all(fd, header.data(), header.size(), 0))
+            throw std::string("Can't write checkpoint log: ") + tmp;
+        size = header.size() + append(fd, header.size(), true);
+        if (rename(tmp.c_str(), m_path.c_str()) != 0)
+            throw std::string("Can't write checkpoint log: ") + m_path;
+    }
+    catch (...) {
+        close(fd);
+        unlink(tmp.c_str());
+        throw;
+    }
+
+    close(m_fd);
+    m_fd = fd;
+    m_size = m_base_size = size;
+    m_records = 1;
+    ++m_sequence;
+    m_synced = true;
+    for (auto &heap : m_vm.m_heap)
+        heap.clear_dirty();
+}
+
+/* Heap at pos in the current heap table */
+static Heap &find_heap(std::vector<Heap> &heaps, uint64_t pos)
+{
+    for (auto &heap : heaps) {
+        if (heap.pos() == pos && heap.size() > 0)
+            return heap;
+    }
+    throw std::string("Invalid checkpoint log page");
+}
+
+bool Checkpoint::restore()
+{
+    if (m_records == 0)
+        return false;
+
+    LogMap map(m_fd, m_size);
+    Snapshot::State state;
+    std::vector<Heap> heaps;
+    scan(map.data(), m_size, [&](const uint8_t *data, uint64_t size) {
+        Reader reader(data, size, "checkpoint log");
+        reader.get(8);
+        bool full = reader.get(8) & flag_full;
+        state = Snapshot::State();
+        Snapshot::load_state(reader, state);
+
+        // Unchanged heaps carry over, others start from zero
+        std::vector<Heap> next;
+        uint64_t count = reader.get(8);
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t pos = reader.get(8);
+            uint64_t size = reader.get(8);
+            auto it = std::find_if(heaps.begin(), heaps.end(),
+                [&](const Heap &heap) {
+                    return heap.pos() == pos && heap.size() == size;
+                });
+            if (!full && it != heaps.end())
+                next.push_back(std::move(*it));
+            else
+                next.emplace_back(pos, size);
+        }
+        heaps.swap(next);
+
+        uint64_t pages = reader.get(8);
+        for (uint64_t i = 0; i < pages; ++i) {
+            Heap &heap = find_heap(heaps, reader.get(8));
+            uint64_t page = reader.get(8);
+            if (page >= heap.pages())
+                throw std::string("Invalid checkpoint log page");
+            uint64_t start = page << Heap::page_bits;
+            uint64_t len = page_length(heap, page);
+            std::memcpy(heap.data(heap.pos() + start, len),
+                reader.take(len), len);
+        }
+    });
+    for (auto &heap : heaps)
+        heap.clear_dirty();
+
+    Snapshot::apply_state(m_vm, state);
+    m_vm.m_heap.swap(heaps);
+    m_synced = true;
+    return true;
+}
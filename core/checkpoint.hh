@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace core
+{
+
+class VM;
+
+/* Append-only log of incremental checkpoints, all numbers big endian.
+ * File starts with magic "\x7fMVC", u16 version, u16 flags, u64
+ * program memory size and u32 CRC-32 of program memory with u32
+ * reserved. Each record is
+ *   u64 payload size
+ *   payload:
+ *     u64 sequence number, u64 flags (1 for full record)
+ *     VM state as in snapshot
+ *     u64 heap count, u64 position and size of each
+ *     u64 page count, u64 heap position, u64 page index and page
+ *     content for each
+ *   u32 CRC-32 of payload
+ *
+ * Records carry heap pages written since the previous one, heap write
+ * barrier keeps track of them. Full record starts from zero heap and
+ * carries all nonzero pages. Torn record left by a crash fails its
+ * CRC and is cut off when the log is opened.
+ */
+class Checkpoint
+{
+public:
+    static const uint16_t Version = 1;
+
+    /* Opens log of program loaded to VM, creates it if needed */
+    Checkpoint(VM &vm, const std::string &path);
+    ~Checkpoint();
+
+    Checkpoint(const Checkpoint &) = delete;
+    Checkpoint &operator=(const Checkpoint &) = delete;
+
+    /* Appends state with heap pages written since previous checkpoint.
+     * Until VM is restored from the log, record is full.
+     */
+    void write();
+
+    /* Sets VM to the last checkpoint, false if log has none */
+    bool restore();
+
+    /* Replaces log with one full record of the current state */
+    void compact();
+
+    inline uint64_t records() const
+    {
+        return m_records;
+    }
+    inline uint64_t size() const
+    {
+        return m_size;
+    }
+    /* Log size after opening or last compaction */
+    inline uint64_t base_size() const
+    {
+        return m_base_size;
+    }
+
+private:
+    void open();
+    uint64_t append(int fd, uint64_t offset, bool full);
+
+    VM &m_vm;
+    std::string m_path;
+    int m_fd;
+    uint64_t m_size;
+    uint64_t m_base_size;
+    uint64_t m_records;
+    uint64_t m_sequence;
+    bool m_synced;
+};
+
+}
@@ -0,0 +1,42 @@
+#include "crc.hh"
+
+using core::Crc;
+
+static uint32_t read32(const uint8_t *ptr)
+{
+    return (uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8)
+        | ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+Crc::Crc(uint32_t poly)
+{
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t crc = n;
+        for (int bit = 0; bit < 8; ++bit)
+            crc = (crc >> 1) ^ ((crc & 1) ? poly : 0);
+        m_table[0][n] = crc;
+    }
+    for (uint32_t n = 0; n < 256; ++n)
+        for (int k = 1; k < 8; ++k)
+            m_table[k][n] = (m_table[k - 1][n] >> 8)
+                ^ m_table[0][m_table[k - 1][n] & 0xff];
+}
+
+uint32_t Crc::update(uint32_t crc, const uint8_t *data, uint64_t len) const
+{
+    const auto &t = m_table;
+    crc = ~crc;
+    while (len >= 8) {
+        uint32_t lo = crc ^ read32(data);
+        uint32_t hi = read32(data + 4);
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff]
+            ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24]
+            ^ t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff]
+            ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+        data += 8;
+        len -= 8;
+    }
+    while (len-- > 0)
+        crc = t[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+namespace core
+{
+
+/* Table driven reflected CRC-32 for any polynomial, eight bytes per
+ * step. Tables are filled by constructor, so keep instances as function
+ * local statics to build them once and thread safely.
+ */
+class Crc
+{
+public:
+    explicit Crc(uint32_t poly);
+
+    /* crc continues from earlier data, zero to start */
+    uint32_t update(uint32_t crc, const uint8_t *data, uint64_t len) const;
+
+private:
+    // Table k gives effect of byte followed by k zero bytes
+    uint32_t m_table[8][256];
+};
+
+}
@@ -1,29 +1,74 @@
 #pragma once
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
+#include <vector>
+#include <sys/mman.h>
 
 namespace core
 {
 
+/* Heap block with write barrier: every writable access marks the pages
+ * it covers dirty, so checkpoints save only what changed. Fresh block
+ * is zero and clean, mapped one is dirty as its content is not known.
+ */
 class Heap
 {
 public:
+    static const uint64_t page_bits = 12;
+    static const uint64_t page_size = 1 << page_bits;
+
     Heap(uint64_t pos, uint64_t size) :
-        m_pos(pos), m_size(size)
+        m_pos(pos), m_size(size), m_capacity(size), m_mapped(false),
+        m_dirty((pages() + 63) / 64)
     {
         m_data = new uint8_t[m_size]();
     }
 
+    /* Takes over writable mapping of size bytes */
+    Heap(uint64_t pos, uint64_t size, uint8_t *mapped) :
+        m_pos(pos), m_size(size), m_capacity(size),
+        m_data(mapped), m_mapped(true),
+        m_dirty((pages() + 63) / 64, ~0ULL)
+    {
+    }
+
     Heap(const Heap &other) :
-        m_pos(other.m_pos), m_size(other.m_size)
+        m_pos(other.m_pos), m_size(other.m_size), m_capacity(other.m_size),
+        m_mapped(false), m_dirty(other.m_dirty)
     {
         m_data = new uint8_t[m_size]();
         std::memmove(m_data, other.m_data, m_size);
     }
 
+    Heap(Heap &&other) noexcept :
+        m_pos(other.m_pos), m_size(other.m_size),
+        m_capacity(other.m_capacity),
+        m_data(other.m_data), m_mapped(other.m_mapped),
+        m_dirty(std::move(other.m_dirty))
+    {
+        other.m_data = nullptr;
+        other.m_mapped = false;
+    }
+
+    Heap &operator=(Heap &&other) noexcept
+    {
+        std::swap(m_pos, other.m_pos);
+        std::swap(m_size, other.m_size);
+        std::swap(m_capacity, other.m_capacity);
+        std::swap(m_data, other.m_data);
+        std::swap(m_mapped, other.m_mapped);
+        m_dirty.swap(other.m_dirty);
+        return *this;
+    }
+
     ~Heap()
     {
-        delete[] m_data;
+        if (m_mapped)
+            munmap(m_data, m_capacity);
+        else
+            delete[] m_data;
         m_data = nullptr;
     }
 
@@ -45,6 +90,30 @@ public:
             && (index < (m_pos + m_size));
     }
 
+    inline bool valid(uint64_t index, uint64_t size) const
+    {
+        return valid(index) && size <= m_pos + m_size - index;
+    }
+
+    uint8_t *data(uint64_t index, uint64_t size)
+    {
+        if (size == 0 || !valid(index, size))
+            throw std::string("Heap memory access out of bounds");
+        uint64_t last = (index - m_pos + size - 1) >> page_bits;
+        for (uint64_t page = (index - m_pos) >> page_bits; page <= last;
+                ++page)
+            mark(page);
+        return m_data + (index - m_pos);
+    }
+
+    /* For reading, doesn't mark pages dirty */
+    const uint8_t *data(uint64_t index, uint64_t size) const
+    {
+        if (size == 0 || !valid(index, size))
+            throw std::string("Heap memory access out of bounds");
+        return m_data + (index - m_pos);
+    }
+
     uint8_t &operator[](uint64_t index) const
     {
         if (!valid(index))
@@ -56,13 +125,56 @@ public:
     {
         if (!valid(index))
             throw std::string("Heap memory access out of bounds");
+        mark((index - m_pos) >> page_bits);
         return m_data[index - m_pos];
     }
 
+    inline bool mapped() const
+    {
+        return m_mapped;
+    }
+
+    /* Bytes allocated, more than size for reused block */
+    inline uint64_t capacity() const
+    {
+        return m_capacity;
+    }
+
+    /* Makes block zero size bytes at pos again without allocating,
+     * size has to fit capacity
+     */
+    void reuse(uint64_t pos, uint64_t size)
+    {
+        m_pos = pos;
+        m_size = size;
+        std::memset(m_data, 0, size);
+        m_dirty.assign((pages() + 63) / 64, 0);
+    }
+
+    inline uint64_t pages() const
+    {
+        return (m_size + page_size - 1) >> page_bits;
+    }
+    inline bool dirty(uint64_t page) const
+    {
+        return (m_dirty[page >> 6] >> (page & 63)) & 1;
+    }
+    inline void mark(uint64_t page)
+    {
+        m_dirty[page >> 6] |= 1ULL << (page & 63);
+    }
+    inline void clear_dirty()
+    {
+        std::fill(m_dirty.begin(), m_dirty.end(), 0);
+    }
+
 private:
     uint64_t m_pos;
     uint64_t m_size;
+    uint64_t m_capacity;
     uint8_t *m_data;
+    bool m_mapped;
+    std::vector<uint64_t> m_dirty;
 };
 
 }
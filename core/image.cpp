@@ -0,0 +1,85 @@
+#include "image.hh"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using core::Image;
+
+Image::Image() : m_map(nullptr), m_size(0)
+{
+}
+
+Image::~Image()
+{
+    unmap();
+}
+
+void Image::unmap()
+{
+    if (m_map)
+        munmap((void*)m_map, m_size);
+    m_map = nullptr;
+    m_size = 0;
+}
+
+void Image::open(const std::string &path, unsigned flags)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::string("Can't open file: ") + path;
+
+    try {
+        open(fd, flags);
+    }
+    catch (...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+}
+
+void Image::open(int fd, unsigned flags)
+{
+    unmap();
+    m_data.clear();
+
+    struct stat st;
+    if (!(flags & NoMap) && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)
+            && st.st_size > 0) {
+        int mflags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        if (flags & Populate)
+            mflags |= MAP_POPULATE;
+#endif
+        void *res = mmap(nullptr, st.st_size, PROT_READ, mflags, fd, 0);
+        if (res != MAP_FAILED) {
+            m_map = (const uint8_t*)res;
+            m_size = st.st_size;
+            if (flags & WillNeed)
+                madvise(res, m_size, MADV_WILLNEED);
+            return;
+        }
+    }
+
+    // Not mappable, read it all in large chunks
+    char buf[64 * 1024];
+    while (true) {
+        ssize_t got = read(fd, buf, sizeof(buf));
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got < 0)
+            throw std::string("Can't read file: ") + strerror(errno);
+        if (got == 0)
+            break;
+        m_data.append(buf, got);
+    }
+}
+
+void Image::assign(std::string code)
+{
+    unmap();
+    m_data.swap(code);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace core
+{
+
+/* Program image loaded from file.
+ *
+ * Regular files are mapped read only, so processes running the same
+ * program share page cache and nothing is copied. Pipes and other
+ * files which can't be mapped are read to memory instead.
+ */
+class Image
+{
+public:
+    enum Flags
+    {
+        Default = 0,
+        Populate = 1,   // Fault all pages in when mapping
+        WillNeed = 2,   // Start reading pages ahead
+        NoMap = 4       // Always read
+    };
+
+    Image();
+    ~Image();
+
+    Image(const Image &) = delete;
+    Image &operator=(const Image &) = delete;
+
+    /* Throws when file can't be opened or read */
+    void open(const std::string &path, unsigned flags = Default);
+    void open(int fd, unsigned flags = Default);
+
+    /* Image from memory, like optimizer output */
+    void assign(std::string code);
+
+    inline const uint8_t *data() const
+    {
+        return m_map ? m_map : (const uint8_t*)m_data.data();
+    }
+    inline uint64_t size() const
+    {
+        return m_map ? m_size : m_data.size();
+    }
+    inline bool mapped() const
+    {
+        return m_map != nullptr;
+    }
+
+private:
+    void unmap();
+
+    const uint8_t *m_map;
+    uint64_t m_size;
+    std::string m_data;
+};
+
+}
@@ -0,0 +1,205 @@
+#include "maps.hh"
+#include <cstring>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using core::HashMap;
+using core::Maps;
+using core::RegisterData;
+using core::RegisterType;
+
+static const uint8_t ctrl_empty = 0x80;
+static const uint8_t ctrl_deleted = 0xfe;
+static const uint64_t group_size = 16;
+
+static uint64_t mix(uint64_t val)
+{
+    val ^= val >> 30;
+    val *= 0xbf58476d1ce4e5b9ULL;
+    val ^= val >> 27;
+    val *= 0x94d049bb133111ebULL;
+    val ^= val >> 31;
+    return val;
+}
+
+/* Bit mask of control bytes in group equal to tag
+ */
+static uint32_t match(const uint8_t *group, uint8_t tag)
+{
+#if defined(__SSE2__)
+    __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(tag)));
+#else
+    uint32_t res = 0;
+    for (uint64_t i = 0; i < group_size; ++i)
+        res |= (uint32_t)(group[i] == tag) << i;
+    return res;
+#endif
+}
+
+HashMap::HashMap() : m_size(0), m_used(0)
+{
+}
+
+uint64_t HashMap::hash(const RegisterData &key)
+{
+    switch (key.m_type) {
+        case RegisterType::Integer:
+            return mix(key.m_int);
+        case RegisterType::String: {
+            core::StringRef ref = key.str();
+            // FNV-1a, mixed like integers
+            uint64_t res = 0xcbf29ce484222325ULL;
+            for (uint64_t i = 0; i < ref.size; ++i)
+                res = (res ^ (uint8_t)ref.data[i]) * 0x100000001b3ULL;
+            return mix(res);
+        }
+        default:
+            throw std::string("Invalid map key type");
+    }
+}
+
+bool HashMap::equal(const RegisterData &a, const RegisterData &b)
+{
+    if (a.m_type != b.m_type)
+        return false;
+    if (a.m_type == RegisterType::String) {
+        core::StringRef ref1 = a.str();
+        core::StringRef ref2 = b.str();
+        return ref1.size == ref2.size
+            && std::memcmp(ref1.data, ref2.data, ref1.size) == 0;
+    }
+    return a.m_int == b.m_int;
+}
+
+int64_t HashMap::locate(const RegisterData &key, uint64_t hash) const
+{
+    uint64_t groups = m_ctrl.size() / group_size;
+    if (groups == 0)
+        return -1;
+
+    uint8_t tag = hash & 0x7f;
+    uint64_t group = (hash >> 7) & (groups - 1);
+    // Triangular steps visit every group of power of two table
+    for (uint64_t probe = 1; probe <= groups; ++probe) {
+        uint64_t base = group * group_size;
+        uint32_t bits = match(&m_ctrl[base], tag);
+        while (bits) {
+            uint64_t pos = base + __builtin_ctz(bits);
+            if (equal(m_slots[pos].key, key))
+                return pos;
+            bits &= bits - 1;
+        }
+        if (match(&m_ctrl[base], ctrl_empty))
+            return -1;
+        group = (group + probe) & (groups - 1);
+    }
+    return -1;
+}
+
+uint64_t HashMap::free_slot(uint64_t hash) const
+{
+    uint64_t groups = m_ctrl.size() / group_size;
+    uint64_t group = (hash >> 7) & (groups - 1);
+    for (uint64_t probe = 1; ; ++probe) {
+        uint64_t base = group * group_size;
+        uint32_t bits = match(&m_ctrl[base], ctrl_empty)
+            | match(&m_ctrl[base], ctrl_deleted);
+        if (bits)
+            return base + __builtin_ctz(bits);
+        group = (group + probe) & (groups - 1);
+    }
+}
+
+void HashMap::rehash(uint64_t capacity)
+{
+    std::vector<uint8_t> ctrl(capacity, ctrl_empty);
+    std::vector<Slot> slots(capacity);
+    std::swap(ctrl, m_ctrl);
+    std::swap(slots, m_slots);
+    m_size = 0;
+    m_used = 0;
+
+    for (uint64_t i = 0; i < ctrl.size(); ++i) {
+        if (ctrl[i] & 0x80)
+            continue;
+        uint64_t pos = free_slot(hash(slots[i].key));
+        m_ctrl[pos] = ctrl[i];
+        m_slots[pos] = std::move(slots[i]);
+        ++m_size;
+        ++m_used;
+    }
+}
+
+const RegisterData *HashMap::find(const RegisterData &key) const
+{
+    int64_t pos = locate(key, hash(key));
+    if (pos < 0)
+        return nullptr;
+    return &m_slots[pos].val;
+}
+
+void HashMap::put(const RegisterData &key, const RegisterData &val)
+{
+    uint64_t h = hash(key);
+    int64_t pos = locate(key, h);
+    if (pos >= 0) {
+        m_slots[pos].val = val;
+        return;
+    }
+
+    // Keep at least one eighth empty, deleted slots count as used
+    uint64_t capacity = m_ctrl.size();
+    if ((m_used + 1) * 8 > capacity * 7) {
+        if (capacity == 0)
+            capacity = group_size;
+        else if ((m_size + 1) * 2 > capacity)
+            capacity *= 2;
+        rehash(capacity);
+    }
+
+    uint64_t slot = free_slot(h);
+    if (m_ctrl[slot] == ctrl_empty)
+        ++m_used;
+    m_ctrl[slot] = h & 0x7f;
+    m_slots[slot].key = key;
+    m_slots[slot].val = val;
+    ++m_size;
+}
+
+bool HashMap::erase(const RegisterData &key)
+{
+    int64_t pos = locate(key, hash(key));
+    if (pos < 0)
+        return false;
+
+    m_ctrl[pos] = ctrl_deleted;
+    m_slots[pos] = Slot();
+    --m_size;
+    return true;
+}
+
+void HashMap::each(std::function<void (const RegisterData &,
+    const RegisterData &)> func) const
+{
+    for (uint64_t i = 0; i < m_slots.size(); ++i) {
+        if (m_ctrl[i] < ctrl_empty)
+            func(m_slots[i].key, m_slots[i].val);
+    }
+}
+
+uint64_t Maps::create()
+{
+    m_maps.emplace_back();
+    return m_maps.size();
+}
+
+HashMap &Maps::get(uint64_t handle)
+{
+    if (handle == 0 || handle > m_maps.size())
+        throw std::string("Invalid map handle");
+    return m_maps[handle - 1];
+}
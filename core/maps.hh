@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "regs.hh"
+
+namespace core
+{
+
+/* Open addressing hash table in Swiss table style.
+ *
+ * Control bytes, one per slot, hold 7 bits of key hash or empty and
+ * deleted markers. Lookup compares whole group of 16 control bytes at
+ * once and touches slots only for matching ones. Keys are integers or
+ * strings, which never equal each other, values any register content.
+ */
+class HashMap
+{
+public:
+    HashMap();
+
+    /* Value of key or nullptr when it's not there */
+    const RegisterData *find(const RegisterData &key) const;
+    void put(const RegisterData &key, const RegisterData &val);
+    bool erase(const RegisterData &key);
+
+    /* Calls func for each key and value in no particular order */
+    void each(std::function<void (const RegisterData &,
+        const RegisterData &)> func) const;
+
+    inline uint64_t size() const
+    {
+        return m_size;
+    }
+
+private:
+    struct Slot
+    {
+        RegisterData key;
+        RegisterData val;
+    };
+
+    static uint64_t hash(const RegisterData &key);
+    static bool equal(const RegisterData &a, const RegisterData &b);
+
+    int64_t locate(const RegisterData &key, uint64_t hash) const;
+    uint64_t free_slot(uint64_t hash) const;
+    void rehash(uint64_t capacity);
+
+    std::vector<uint8_t> m_ctrl;
+    std::vector<Slot> m_slots;
+    uint64_t m_size;
+    uint64_t m_used;
+};
+
+/* Maps of VM, addressed by handle starting from one
+ */
+class Maps
+{
+public:
+    uint64_t create();
+    HashMap &get(uint64_t handle);
+
+    inline uint64_t count() const
+    {
+        return m_maps.size();
+    }
+    inline void clear()
+    {
+        m_maps.clear();
+    }
+
+private:
+    std::vector<HashMap> m_maps;
+};
+
+}
@@ -25,6 +25,7 @@ public:
     Opcode &operator=(const Opcode &other)
     {
         m_value = other.m_value;
+        return *this;
     }
 
     bool operator==(const Opcode &other) const
@@ -0,0 +1,230 @@
+#include "output.hh"
+#include "serial.hh"
+#include <algorithm>
+
+using core::Output;
+using core::StreamOutput;
+using core::FdOutput;
+using core::AsyncOutput;
+using core::BufferOutput;
+using core::CallbackOutput;
+using core::write_all;
+
+Output::Output(uint64_t capacity) : m_buf(capacity ? capacity : 1), m_used(0)
+{
+}
+
+void Output::write_slow(const char *data, uint64_t size)
+{
+    flush();
+    if (size >= m_buf.size()) {
+        // Too big to buffer, pass on as is
+        sink(data, size);
+        return;
+    }
+    std::memcpy(&m_buf[0], data, size);
+    m_used = size;
+}
+
+void Output::write_int(uint64_t val)
+{
+    static const char digits[] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+    char buf[20];
+    char *pos = buf + sizeof(buf);
+    while (val >= 100) {
+        uint64_t idx = (val % 100) * 2;
+        val /= 100;
+        *--pos = digits[idx + 1];
+        *--pos = digits[idx];
+    }
+    if (val >= 10) {
+        *--pos = digits[val * 2 + 1];
+        *--pos = digits[val * 2];
+    } else {
+        *--pos = '0' + val;
+    }
+    write(pos, buf + sizeof(buf) - pos);
+}
+
+void Output::flush()
+{
+    if (m_used == 0)
+        return;
+    // Emptied first, so failing sink doesn't write the same again
+    uint64_t used = m_used;
+    m_used = 0;
+    sink(&m_buf[0], used);
+}
+
+StreamOutput::StreamOutput(std::ostream &stream, uint64_t capacity) :
+    Output(capacity), m_stream(stream)
+{
+}
+
+StreamOutput::~StreamOutput()
+{
+    flush();
+}
+
+void StreamOutput::sink(const char *data, uint64_t size)
+{
+    m_stream.write(data, size);
+    m_stream.flush();
+}
+
+FdOutput::FdOutput(int fd, uint64_t capacity) : Output(capacity), m_fd(fd)
+{
+}
+
+FdOutput::~FdOutput()
+{
+    try {
+        flush();
+    }
+    catch (std::string) {
+    }
+}
+
+void FdOutput::sink(const char *data, uint64_t size)
+{
+    if (!write_all(m_fd, data, size))
+        throw std::string("Output write failed");
+}
+
+AsyncOutput::AsyncOutput(int fd, uint64_t ring_size, uint64_t capacity) :
+    Output(capacity), m_fd(fd), m_ring(ring_size ? ring_size : 1),
+    m_head(0), m_tail(0), m_stop(false), m_failed(false)
+{
+    m_thread = std::thread(&AsyncOutput::run, this);
+}
+
+AsyncOutput::~AsyncOutput()
+{
+    flush();
+    m_stop = true;
+    notify();
+    m_thread.join();
+}
+
+void AsyncOutput::notify()
+{
+    // Waiter checks the ring with the lock held, taking it here
+    // makes sure the change isn't missed
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+    }
+    m_cond.notify_all();
+}
+
+void AsyncOutput::sink(const char *data, uint64_t size)
+{
+    uint64_t ring = m_ring.size();
+    uint64_t head = m_head.load(std::memory_order_relaxed);
+    while (size > 0) {
+        uint64_t used = head - m_tail.load(std::memory_order_acquire);
+        if (used == ring) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [&] {
+                return head - m_tail.load(std::memory_order_acquire) < ring;
+            });
+            continue;
+        }
+
+        uint64_t pos = head % ring;
+        uint64_t count = std::min(std::min(size, ring - used), ring - pos);
+        std::memcpy(&m_ring[pos], data, count);
+        data += count;
+        size -= count;
+        head += count;
+        m_head.store(head, std::memory_order_release);
+        notify();
+    }
+}
+
+void AsyncOutput::run()
+{
+    uint64_t ring = m_ring.size();
+    uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    while (true) {
+        uint64_t head = m_head.load(std::memory_order_acquire);
+        if (head == tail) {
+            if (m_stop)
+                break;
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [&] {
+                return m_head.load(std::memory_order_acquire) != tail
+                    || m_stop;
+            });
+            continue;
+        }
+
+        uint64_t pos = tail % ring;
+        uint64_t count = std::min(head - tail, ring - pos);
+        if (!m_failed && !write_all(m_fd, &m_ring[pos], count))
+            m_failed = true;
+        tail += count;
+        m_tail.store(tail, std::memory_order_release);
+        notify();
+    }
+}
+
+void AsyncOutput::drain()
+{
+    flush();
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, [&] {
+            return m_tail.load(std::memory_order_acquire)
+                == m_head.load(std::memory_order_relaxed);
+        });
+    }
+    if (m_failed)
+        throw std::string("Output write failed");
+}
+
+BufferOutput::BufferOutput(uint64_t capacity) : Output(capacity)
+{
+}
+
+const std::string &BufferOutput::data()
+{
+    flush();
+    return m_data;
+}
+
+void BufferOutput::clear()
+{
+    flush();
+    m_data.clear();
+}
+
+void BufferOutput::sink(const char *data, uint64_t size)
+{
+    m_data.append(data, size);
+}
+
+CallbackOutput::CallbackOutput(Callback func, uint64_t capacity) :
+    Output(capacity), m_func(func)
+{
+}
+
+CallbackOutput::~CallbackOutput()
+{
+    flush();
+}
+
+void CallbackOutput::sink(const char *data, uint64_t size)
+{
+    m_func(data, size);
+}
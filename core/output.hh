@@ -0,0 +1,166 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace core
+{
+
+/* Buffered sink for program output.
+ *
+ * Writes are collected to buffer and passed on when it gets full or on
+ * flush. VM flushes on STOP and when instruction throws, so output is
+ * complete before error is reported. Subclasses decide where the
+ * data goes.
+ */
+class Output
+{
+public:
+    static const uint64_t default_capacity = 64 * 1024;
+
+    explicit Output(uint64_t capacity = default_capacity);
+    virtual ~Output() {}
+
+    inline void write(const char *data, uint64_t size)
+    {
+        if (m_used + size > m_buf.size()) {
+            write_slow(data, size);
+            return;
+        }
+        std::memcpy(&m_buf[m_used], data, size);
+        m_used += size;
+    }
+
+    /* Decimal unsigned integer */
+    void write_int(uint64_t val);
+    void flush();
+
+    /* Flushes and waits until everything is written, for output
+     * that's written in background
+     */
+    virtual void drain()
+    {
+        flush();
+    }
+
+protected:
+    virtual void sink(const char *data, uint64_t size) = 0;
+
+private:
+    void write_slow(const char *data, uint64_t size);
+
+    std::vector<char> m_buf;
+    uint64_t m_used;
+};
+
+/* Output to C++ stream, std::cout by default */
+class StreamOutput : public Output
+{
+public:
+    explicit StreamOutput(std::ostream &stream,
+        uint64_t capacity = default_capacity);
+    ~StreamOutput();
+
+protected:
+    void sink(const char *data, uint64_t size);
+
+private:
+    std::ostream &m_stream;
+};
+
+/* Output to file descriptor with write(2), not owned */
+class FdOutput : public Output
+{
+public:
+    explicit FdOutput(int fd, uint64_t capacity = default_capacity);
+    ~FdOutput();
+
+protected:
+    void sink(const char *data, uint64_t size);
+
+private:
+    int m_fd;
+};
+
+/* Output to file descriptor by background thread.
+ *
+ * Flushed data goes to single producer, single consumer ring buffer,
+ * which writer thread empties with write(2). Interpreter waits only
+ * when ring is full. Write error is reported by drain, data after it
+ * is dropped.
+ */
+class AsyncOutput : public Output
+{
+public:
+    static const uint64_t default_ring_size = 1024 * 1024;
+
+    explicit AsyncOutput(int fd, uint64_t ring_size = default_ring_size,
+        uint64_t capacity = default_capacity);
+    ~AsyncOutput();
+
+    void drain();
+
+protected:
+    void sink(const char *data, uint64_t size);
+
+private:
+    void run();
+    void notify();
+
+    int m_fd;
+    std::vector<char> m_ring;
+    // Total bytes put to ring and taken from it
+    std::atomic<uint64_t> m_head;
+    std::atomic<uint64_t> m_tail;
+    std::atomic<bool> m_stop;
+    std::atomic<bool> m_failed;
+
+    // Only for sleeping on full or empty ring
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::thread m_thread;
+};
+
+/* Output collected to memory */
+class BufferOutput : public Output
+{
+public:
+    explicit BufferOutput(uint64_t capacity = default_capacity);
+
+    /* Everything written so far */
+    const std::string &data();
+    void clear();
+
+protected:
+    void sink(const char *data, uint64_t size);
+
+private:
+    std::string m_data;
+};
+
+/* Output passed to function in chunks */
+class CallbackOutput : public Output
+{
+public:
+    typedef std::function<void (const char *, uint64_t)> Callback;
+
+    explicit CallbackOutput(Callback func,
+        uint64_t capacity = default_capacity);
+    ~CallbackOutput();
+
+protected:
+    void sink(const char *data, uint64_t size);
+
+private:
+    Callback m_func;
+};
+
+}
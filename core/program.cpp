@@ -0,0 +1,162 @@
+#include "program.hh"
+#include "crc.hh"
+#include <algorithm>
+#include <cstring>
+
+using core::Program;
+
+static const char magic[] = "\x7fMVM";
+static const uint64_t checksum_pos = 72;
+
+static uint64_t read_be(const uint8_t *data, unsigned size)
+{
+    uint64_t res = 0;
+    for (unsigned i = 0; i < size; ++i)
+        res = (res << 8) | data[i];
+    return res;
+}
+
+uint32_t Program::checksum(const uint8_t *data, uint64_t size, uint32_t crc)
+{
+    // Plain CRC-32 as in zlib, so assembler can use zlib.crc32
+    static const core::Crc table(0xedb88320);
+    return table.update(crc, data, size);
+}
+
+Program::Program() :
+    m_container(false), m_mem(nullptr),
+    m_code_size(0), m_rodata_size(0), m_entry(0),
+    m_bss_size(0), m_heap_size(0),
+    m_strings(nullptr), m_strings_size(0)
+{
+}
+
+void Program::load(const Image &image)
+{
+    load(image.data(), image.size());
+}
+
+void Program::load(const uint8_t *data, uint64_t size)
+{
+    *this = Program();
+    if (size < 4 || std::memcmp(data, magic, 4) != 0) {
+        // Raw bytecode, everything is code
+        m_mem = data;
+        m_code_size = size;
+        return;
+    }
+
+    if (size < HeaderSize)
+        throw std::string("Truncated program header");
+    uint64_t version = read_be(data + 4, 2);
+    if (version != Version)
+        throw std::string("Unsupported program version: ")
+            + std::to_string(version);
+
+    uint64_t sections[7];
+    uint64_t total = HeaderSize;
+    for (unsigned i = 0; i < 7; ++i) {
+        sections[i] = read_be(data + 16 + i * 8, 8);
+        // Zero initialized data and heap take no space in file
+        if (i == 2 || i == 3)
+            continue;
+        if (sections[i] > size - total)
+            throw std::string("Program section out of bounds");
+        total += sections[i];
+    }
+    if (total != size)
+        throw std::string("Program size mismatch");
+
+    uint8_t header[HeaderSize];
+    std::memcpy(header, data, HeaderSize);
+    std::memset(header + checksum_pos, 0, 4);
+    uint32_t crc = checksum(header, HeaderSize);
+    crc = checksum(data + HeaderSize, size - HeaderSize, crc);
+    if (crc != read_be(data + checksum_pos, 4))
+        throw std::string("Program checksum mismatch");
+
+    uint64_t entry = read_be(data + 8, 8);
+    if (entry != 0 && entry >= sections[0])
+        throw std::string("Invalid entry point: ") + std::to_string(entry);
+
+    m_container = true;
+    m_entry = entry;
+    m_code_size = sections[0];
+    m_rodata_size = sections[1];
+    m_bss_size = sections[2];
+    m_heap_size = sections[3];
+
+    const uint8_t *pos = data + HeaderSize;
+    m_mem = pos;
+    pos += m_code_size + m_rodata_size;
+    m_strings = (const char*)pos;
+    m_strings_size = sections[4];
+    pos += m_strings_size;
+    parse_symbols(pos, sections[5]);
+    pos += sections[5];
+    parse_lines(pos, sections[6]);
+}
+
+void Program::parse_symbols(const uint8_t *data, uint64_t size)
+{
+    const uint8_t *end = data + size;
+    while (data < end) {
+        if (end - data < 9)
+            throw std::string("Invalid symbol table");
+        uint64_t addr = read_be(data, 8);
+        data += 8;
+        const void *nul = std::memchr(data, 0, end - data);
+        if (nul == nullptr)
+            throw std::string("Invalid symbol table");
+        const char *name = (const char*)data;
+        m_symbols.push_back(std::make_pair(addr, std::string(name)));
+        data = (const uint8_t*)nul + 1;
+    }
+    std::stable_sort(m_symbols.begin(), m_symbols.end(),
+        [](const std::pair<uint64_t, std::string> &a,
+                const std::pair<uint64_t, std::string> &b) {
+            return a.first < b.first;
+        });
+}
+
+void Program::parse_lines(const uint8_t *data, uint64_t size)
+{
+    if (size % 12)
+        throw std::string("Invalid line table");
+    for (uint64_t i = 0; i < size; i += 12)
+        m_lines.push_back(std::make_pair(read_be(data + i, 8),
+            (uint32_t)read_be(data + i + 8, 4)));
+    std::sort(m_lines.begin(), m_lines.end());
+}
+
+void Program::set_memory(const uint8_t *data, uint64_t size)
+{
+    m_mem = data;
+    m_code_size = size;
+    m_rodata_size = 0;
+    m_symbols.clear();
+    m_lines.clear();
+}
+
+std::string Program::symbol(uint64_t addr) const
+{
+    auto it = std::upper_bound(m_symbols.begin(), m_symbols.end(), addr,
+        [](uint64_t addr, const std::pair<uint64_t, std::string> &item) {
+            return addr < item.first;
+        });
+    if (it == m_symbols.begin())
+        return "";
+    --it;
+    if (it->first == addr)
+        return it->second;
+    return it->second + "+" + std::to_string(addr - it->first);
+}
+
+uint32_t Program::line(uint64_t addr) const
+{
+    auto it = std::upper_bound(m_lines.begin(), m_lines.end(),
+        std::make_pair(addr, (uint32_t)0xffffffff));
+    if (it == m_lines.begin())
+        return 0;
+    return (--it)->second;
+}
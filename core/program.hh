@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "image.hh"
+
+namespace core
+{
+
+/* Program loaded from image, either raw bytecode or container.
+ *
+ * Container starts with fixed header, all numbers big endian:
+ *    0  magic "\x7fMVM"
+ *    4  u16 version, u16 flags
+ *    8  u64 entry point
+ *   16  u64 code size
+ *   24  u64 read only data size
+ *   32  u64 zero initialized data size
+ *   40  u64 initial heap size
+ *   48  u64 string pool size
+ *   56  u64 symbol table size
+ *   64  u64 line table size
+ *   72  u32 CRC-32 of the whole file with this field zero
+ *   76  u32 reserved
+ * Sections follow header in the same order. Code and read only data
+ * form program memory from address 0, zero initialized data is at
+ * start of heap right after it. String pool is NUL terminated strings,
+ * symbol table u64 address followed by NUL terminated name and line
+ * table u64 address with u32 source line per entry.
+ *
+ * Sections point to image data, which has to outlive the program and
+ * the VM running it.
+ */
+class Program
+{
+public:
+    static const uint16_t Version = 1;
+    static const uint64_t HeaderSize = 80;
+
+    Program();
+
+    /* Throws on broken container */
+    void load(const uint8_t *data, uint64_t size);
+    void load(const Image &image);
+
+    /* Replaces program memory, like with optimized code. Symbols and
+     * lines don't match it anymore and are dropped.
+     */
+    void set_memory(const uint8_t *data, uint64_t size);
+
+    inline bool container() const
+    {
+        return m_container;
+    }
+    inline const uint8_t *memory() const
+    {
+        return m_mem;
+    }
+    inline uint64_t memory_size() const
+    {
+        return m_code_size + m_rodata_size;
+    }
+    inline uint64_t code_size() const
+    {
+        return m_code_size;
+    }
+    inline uint64_t rodata_size() const
+    {
+        return m_rodata_size;
+    }
+    inline uint64_t entry() const
+    {
+        return m_entry;
+    }
+    inline uint64_t bss_size() const
+    {
+        return m_bss_size;
+    }
+    inline uint64_t heap_size() const
+    {
+        return m_heap_size;
+    }
+    inline const char *strings() const
+    {
+        return m_strings;
+    }
+    inline uint64_t strings_size() const
+    {
+        return m_strings_size;
+    }
+
+    /* Closest symbol at or before addr with offset, empty if none */
+    std::string symbol(uint64_t addr) const;
+    /* Source line of instruction at addr, 0 if not known */
+    uint32_t line(uint64_t addr) const;
+
+    /* CRC-32, crc continues from earlier data */
+    static uint32_t checksum(const uint8_t *data, uint64_t size,
+        uint32_t crc = 0);
+
+private:
+    void parse_symbols(const uint8_t *data, uint64_t size);
+    void parse_lines(const uint8_t *data, uint64_t size);
+
+    bool m_container;
+    const uint8_t *m_mem;
+    uint64_t m_code_size;
+    uint64_t m_rodata_size;
+    uint64_t m_entry;
+    uint64_t m_bss_size;
+    uint64_t m_heap_size;
+    const char *m_strings;
+    uint64_t m_strings_size;
+
+    std::vector<std::pair<uint64_t, std::string>> m_symbols;
+    std::vector<std::pair<uint64_t, uint32_t>> m_lines;
+};
+
+}
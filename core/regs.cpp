@@ -37,6 +37,37 @@ void Registers::put_string(uint8_t num, std::string val)
         throw std::string("Invalid register");
     m_reg[num].m_type = core::RegisterType::String;
     m_reg[num].m_str = val;
+    m_reg[num].m_view = nullptr;
+}
+
+void Registers::put_string_ref(uint8_t num, const char *data, uint64_t size)
+{
+    if (num >= num_registers)
+        throw std::string("Invalid register");
+    m_reg[num].m_type = core::RegisterType::String;
+    m_reg[num].m_str.clear();
+    m_reg[num].m_view = data;
+    m_reg[num].m_len = size;
+}
+
+void Registers::append_string(uint8_t num, const char *data, uint64_t size)
+{
+    if (num >= num_registers)
+        throw std::string("Invalid register");
+    if (m_reg[num].m_type != core::RegisterType::String)
+        throw std::string("Invalid register type, expected string");
+
+    RegisterData &reg = m_reg[num];
+    if (reg.m_view) {
+        std::string res;
+        res.reserve(reg.m_len + size);
+        res.append(reg.m_view, reg.m_len);
+        res.append(data, size);
+        reg.m_str.swap(res);
+        reg.m_view = nullptr;
+        return;
+    }
+    reg.m_str.append(data, size);
 }
 
 core::RegisterType Registers::type(uint8_t num)
@@ -73,7 +104,17 @@ std::string Registers::get_string(uint8_t num) const
         throw std::string("Invalid register");
     if (m_reg[num].m_type != core::RegisterType::String)
         throw std::string("Invalid register type, expected string");
-    return m_reg[num].m_str;
+    core::StringRef ref = m_reg[num].str();
+    return std::string(ref.data, ref.size);
+}
+
+core::StringRef Registers::get_string_ref(uint8_t num) const
+{
+    if (num >= num_registers)
+        throw std::string("Invalid register");
+    if (m_reg[num].m_type != core::RegisterType::String)
+        throw std::string("Invalid register type, expected string");
+    return m_reg[num].str();
 }
 
 void Registers::copy(uint8_t dest, uint8_t src)
@@ -85,6 +126,32 @@ void Registers::copy(uint8_t dest, uint8_t src)
     m_reg[dest] = m_reg[src];
 }
 
+const core::RegisterData &Registers::get(uint8_t num) const
+{
+    if (num >= num_registers)
+        throw std::string("Invalid register");
+    return m_reg[num];
+}
+
+void Registers::put(uint8_t num, const RegisterData &val)
+{
+    if (num >= num_registers)
+        throw std::string("Invalid register");
+    m_reg[num] = val;
+}
+
+void Registers::clear()
+{
+    m_pc = 0;
+    for (auto &reg : m_reg) {
+        reg.m_type = core::RegisterType::Integer;
+        reg.m_int = 0;
+        reg.m_str.clear();
+        reg.m_view = nullptr;
+        reg.m_len = 0;
+    }
+}
+
 std::string Registers::dump()
 {
     std::stringstream ss;
@@ -101,7 +168,7 @@ std::string Registers::dump()
         else if (m_reg[i].m_type == core::RegisterType::Float)
             ss << m_reg[i].m_float;
         else if (m_reg[i].m_type == core::RegisterType::String)
-            ss << m_reg[i].m_str;
+            ss << std::string(m_reg[i].str().data, m_reg[i].str().size);
         ss << "\n";
     }
     return ss.str();
@@ -18,9 +18,26 @@ enum class RegisterType : uint8_t
     String
 };
 
+/* Characters of string register without copying
+ */
+struct StringRef
+{
+    const char *data;
+    uint64_t size;
+};
+
 class RegisterData {
 public:
-    RegisterData() : m_type(RegisterType::Integer), m_int(0) {}
+    RegisterData() :
+        m_type(RegisterType::Integer), m_int(0),
+        m_view(nullptr), m_len(0) {}
+
+    inline StringRef str() const
+    {
+        if (m_view)
+            return StringRef{m_view, m_len};
+        return StringRef{m_str.data(), m_str.size()};
+    }
 
     RegisterType m_type;
     union {
@@ -28,6 +45,10 @@ public:
         double m_float;
     };
     std::string m_str;
+
+    // String not owned by register, like literal in program memory
+    const char *m_view;
+    uint64_t m_len;
 };
 
 class Registers
@@ -39,14 +60,31 @@ public:
     void put_float(uint8_t num, double val);
     void put_string(uint8_t num, std::string val);
 
+    /* String referring to memory which has to stay unchanged as long
+     * as the register holds it, used for program memory
+     */
+    void put_string_ref(uint8_t num, const char *data, uint64_t size);
+
+    /* Appends to string in place, referred string is copied first.
+     * Data may point to the register itself.
+     */
+    void append_string(uint8_t num, const char *data, uint64_t size);
+
     RegisterType type(uint8_t num);
 
     uint64_t get_int(uint8_t num) const;
     double get_float(uint8_t num) const;
     std::string get_string(uint8_t num) const;
 
+    /* Valid until register is changed */
+    StringRef get_string_ref(uint8_t num) const;
+
     void copy(uint8_t dest, uint8_t src);
 
+    /* Whole register content regardless of type */
+    const RegisterData &get(uint8_t num) const;
+    void put(uint8_t num, const RegisterData &val);
+
     inline uint64_t pc() const
     {
         return m_pc;
@@ -63,6 +101,8 @@ public:
     {
         m_pc = 0;
     }
+    /* Zero integers to all registers and PC, strings keep their memory */
+    void clear();
     std::string dump();
 
 private:
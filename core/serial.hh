@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <unistd.h>
+
+#include "regs.hh"
+
+namespace core
+{
+
+/* Big endian numbers and register contents for state files */
+
+inline void put_be(std::string &out, uint64_t val, unsigned size)
+{
+    for (unsigned i = size; i > 0; --i)
+        out.push_back((char)(val >> ((i - 1) * 8)));
+}
+
+inline void put_data(std::string &out, const RegisterData &val)
+{
+    out.push_back((char)val.m_type);
+    if (val.m_type == RegisterType::String) {
+        StringRef ref = val.str();
+        put_be(out, ref.size, 8);
+        out.append(ref.data, ref.size);
+    } else {
+        // Float bits go as they are
+        put_be(out, val.m_int, 8);
+    }
+}
+
+inline bool write_all(int fd, const char *data, uint64_t size)
+{
+    while (size > 0) {
+        ssize_t res = ::write(fd, data, size);
+        if (res < 0 && errno == EINTR)
+            continue;
+        if (res <= 0)
+            return false;
+        data += res;
+        size -= res;
+    }
+    return true;
+}
+
+/* Reads from memory, throws "Truncated <what>" at the end */
+class Reader
+{
+public:
+    Reader(const uint8_t *data, uint64_t size, const char *what) :
+        m_pos(data), m_end(data + size), m_what(what)
+    {
+    }
+
+    inline uint64_t left() const
+    {
+        return m_end - m_pos;
+    }
+
+    const uint8_t *take(uint64_t size)
+    {
+        if (size > left())
+            throw std::string("Truncated ") + m_what;
+        const uint8_t *res = m_pos;
+        m_pos += size;
+        return res;
+    }
+
+    uint64_t get(unsigned size)
+    {
+        const uint8_t *data = take(size);
+        uint64_t res = 0;
+        for (unsigned i = 0; i < size; ++i)
+            res = (res << 8) | data[i];
+        return res;
+    }
+
+    RegisterData data()
+    {
+        RegisterData res;
+        uint8_t type = get(1);
+        if (type > (uint8_t)RegisterType::String)
+            throw std::string("Invalid ") + m_what + " register type: "
+                + std::to_string((int)type);
+        res.m_type = (RegisterType)type;
+        uint64_t val = get(8);
+        if (res.m_type == RegisterType::String)
+            res.m_str.assign((const char*)take(val), val);
+        else
+            res.m_int = val;
+        return res;
+    }
+
+private:
+    const uint8_t *m_pos;
+    const uint8_t *m_end;
+    const char *m_what;
+};
+
+}
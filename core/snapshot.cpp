@@ -0,0 +1,212 @@
+#include "snapshot.hh"
+#include "serial.hh"
+#include "vm.hh"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using core::Snapshot;
+using core::VM;
+using core::RegisterData;
+using core::Reader;
+
+static const char magic[] = "\x7fMVS";
+
+void Snapshot::save_program(const VM &vm, std::string &out)
+{
+    put_be(out, vm.m_size, 8);
+    put_be(out, Program::checksum(vm.m_mem, vm.m_size), 4);
+    put_be(out, 0, 4);
+}
+
+bool Snapshot::check_program(const VM &vm, Reader &reader)
+{
+    uint64_t size = reader.get(8);
+    uint64_t crc = reader.get(4);
+    reader.get(4);
+    return size == vm.m_size && crc == Program::checksum(vm.m_mem, vm.m_size);
+}
+
+void Snapshot::save_state(VM &vm, std::string &out)
+{
+    put_be(out, vm.m_regs.pc(), 8);
+    put_be(out, vm.m_ticks, 8);
+    put_be(out, vm.m_heap_pos, 8);
+    put_be(out, vm.m_pool_size ? vm.m_pool_pos : 0, 8);
+    put_be(out, vm.m_pool_size, 8);
+
+    for (uint8_t i = 0; i < num_registers; ++i)
+        put_data(out, vm.m_regs.get(i));
+    for (uint8_t i = 0; i < num_vregisters; ++i)
+        out.append((const char*)vm.m_vregs.get(i), vector_bytes);
+    put_be(out, vm.m_maps.count(), 8);
+    for (uint64_t i = 1; i <= vm.m_maps.count(); ++i) {
+        const HashMap &map = vm.m_maps.get(i);
+        put_be(out, map.size(), 8);
+        map.each([&](const RegisterData &key, const RegisterData &val) {
+            put_data(out, key);
+            put_data(out, val);
+        });
+    }
+}
+
+void Snapshot::load_state(Reader &reader, State &state)
+{
+    state.pc = reader.get(8);
+    state.ticks = reader.get(8);
+    state.heap_pos = reader.get(8);
+    state.pool_pos = reader.get(8);
+    state.pool_size = reader.get(8);
+
+    for (uint8_t i = 0; i < num_registers; ++i)
+        state.regs[i] = reader.data();
+    for (uint8_t i = 0; i < num_vregisters; ++i)
+        std::memcpy(state.vregs.get(i), reader.take(vector_bytes),
+            vector_bytes);
+    uint64_t count = reader.get(8);
+    for (uint64_t i = 0; i < count; ++i) {
+        HashMap &map = state.maps.get(state.maps.create());
+        uint64_t items = reader.get(8);
+        for (uint64_t j = 0; j < items; ++j) {
+            RegisterData key = reader.data();
+            map.put(key, reader.data());
+        }
+    }
+}
+
+void Snapshot::apply_state(VM &vm, State &state)
+{
+    if (state.pool_size)
+        vm.intern_strings(state.pool_pos, state.pool_size);
+    for (uint8_t i = 0; i < num_registers; ++i)
+        vm.m_regs.put(i, state.regs[i]);
+    vm.m_vregs = state.vregs;
+    vm.m_maps = std::move(state.maps);
+    vm.m_heap_pos = state.heap_pos;
+    vm.m_regs.pc_update(state.pc);
+    vm.m_ticks = state.ticks;
+}
+
+void Snapshot::save(VM &vm, const std::string &path)
+{
+    std::string meta(magic, 4);
+    put_be(meta, Version, 2);
+    put_be(meta, 0, 2);
+    save_program(vm, meta);
+    save_state(vm, meta);
+
+    // Heap contents start at page boundary after the table
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t offset = meta.size() + 8 + vm.m_heap.size() * 24;
+    put_be(meta, vm.m_heap.size(), 8);
+    for (auto &heap : vm.m_heap) {
+        offset = (offset + page - 1) / page * page;
+        put_be(meta, heap.pos(), 8);
+        put_be(meta, heap.size(), 8);
+        put_be(meta, offset, 8);
+        offset += heap.size();
+    }
+
+    // Written aside and renamed, old snapshot stays if this fails
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+        0644);
+    if (fd < 0)
+        throw std::string("Can't write snapshot: ") + path;
+
+    bool ok = write_all(fd, meta.data(), meta.size());
+    uint64_t pos = meta.size();
+    std::string pad(page, 0);
+    for (auto &heap : vm.m_heap) {
+        if (!ok)
+            break;
+        uint64_t start = (pos + page - 1) / page * page;
+        ok = write_all(fd, pad.data(), start - pos);
+        if (ok && heap.size())
+            ok = write_all(fd, (const char*)((const Heap&)heap).data(
+                heap.pos(), heap.size()), heap.size());
+        pos = start + heap.size();
+    }
+    if (close(fd) != 0)
+        ok = false;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        throw std::string("Can't write snapshot: ") + path;
+    }
+}
+
+static void restore_heaps(Reader &reader, int fd, uint64_t file_size,
+    std::vector<core::Heap> &heaps)
+{
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t count = reader.get(8);
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t pos = reader.get(8);
+        uint64_t size = reader.get(8);
+        uint64_t offset = reader.get(8);
+        if (size == 0) {
+            heaps.emplace_back(pos, 0);
+            continue;
+        }
+        if (offset % page || offset > file_size
+                || size > file_size - offset)
+            throw std::string("Truncated snapshot");
+
+        // Private writable mapping, pages are copied when written
+        void *res = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE, fd, offset);
+        if (res == MAP_FAILED)
+            throw std::string("Can't map snapshot: ") + strerror(errno);
+        heaps.emplace_back(pos, size, (uint8_t*)res);
+    }
+}
+
+void Snapshot::restore(VM &vm, const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::string("Can't open snapshot: ") + path;
+
+    void *map = MAP_FAILED;
+    uint64_t size = 0;
+    State state;
+    std::vector<Heap> heaps;
+    try {
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < 4)
+            throw std::string("Invalid snapshot: ") + path;
+        size = st.st_size;
+        map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+            throw std::string("Can't map snapshot: ") + strerror(errno);
+
+        Reader reader((const uint8_t*)map, size, "snapshot");
+        if (std::memcmp(reader.take(4), magic, 4) != 0)
+            throw std::string("Invalid snapshot: ") + path;
+        uint64_t version = reader.get(2);
+        if (version != Version)
+            throw std::string("Unsupported snapshot version: ")
+                + std::to_string(version);
+        reader.get(2);
+        if (!check_program(vm, reader))
+            throw std::string("Snapshot doesn't match loaded program");
+        load_state(reader, state);
+        restore_heaps(reader, fd, size, heaps);
+    }
+    catch (...) {
+        if (map != MAP_FAILED)
+            munmap(map, size);
+        close(fd);
+        throw;
+    }
+    munmap(map, size);
+    close(fd);
+
+    // Everything read, VM changes only now
+    apply_state(vm, state);
+    vm.m_heap.swap(heaps);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "regs.hh"
+#include "vregs.hh"
+#include "maps.hh"
+
+namespace core
+{
+
+class VM;
+class Reader;
+
+/* VM state in file, all numbers big endian:
+ *    0  magic "\x7fMVS"
+ *    4  u16 version, u16 flags
+ *    8  u64 program memory size
+ *   16  u32 CRC-32 of program memory, u32 reserved
+ *   24  state
+ * followed by heap table of u64 position, size and file offset.
+ * Heap contents are at page aligned offsets, so they can be mapped
+ * directly.
+ *
+ * State is u64 PC, ticks, heap position, string pool address and size
+ * (zero if not in program memory), registers, vector registers and
+ * maps. Checkpoint log stores it the same way.
+ */
+class Snapshot
+{
+public:
+    static const uint16_t Version = 1;
+
+    static void save(VM &vm, const std::string &path);
+    static void restore(VM &vm, const std::string &path);
+
+    /* State without heap, read fully before VM is changed */
+    struct State
+    {
+        uint64_t pc;
+        uint64_t ticks;
+        uint64_t heap_pos;
+        uint64_t pool_pos;
+        uint64_t pool_size;
+        RegisterData regs[num_registers];
+        VectorRegisters vregs;
+        Maps maps;
+    };
+
+    static void save_program(const VM &vm, std::string &out);
+    static bool check_program(const VM &vm, Reader &reader);
+    static void save_state(VM &vm, std::string &out);
+    static void load_state(Reader &reader, State &state);
+    static void apply_state(VM &vm, State &state);
+};
+
+}
@@ -1,5 +1,7 @@
 #include "vm.hh"
 #include "opcodes.hh"
+#include "snapshot.hh"
+#include <cstring>
 #include <iostream>
 
 using core::VM;
@@ -7,7 +9,9 @@ using core::Opcode;
 
 
 VM::VM() :
+    m_stdout(std::cout), m_output(&m_stdout),
     m_mem(nullptr), m_size(0),
+    m_pool_pos(0), m_pool_size(0),
     m_heap_pos(0), m_ticks(0),
     m_debug(false)
 {
@@ -15,13 +19,32 @@ VM::VM() :
 }
 
 VM::VM(uint8_t *mem, uint64_t size) :
+    m_stdout(std::cout), m_output(&m_stdout),
     m_mem(mem), m_size(size),
+    m_pool_pos(0), m_pool_size(0),
     m_heap_pos(0), m_ticks(0),
     m_debug(false)
 {
     init();
 }
 
+VM::~VM()
+{
+    try {
+        m_output->flush();
+    }
+    catch (std::string) {
+    }
+}
+
+void VM::set_output(Output *output)
+{
+    // Switched even when flush of the old one throws
+    Output *old = m_output;
+    m_output = output ? output : &m_stdout;
+    old->flush();
+}
+
 void VM::init()
 {
     for (uint32_t i = 0; i < 256; ++i) {
@@ -29,13 +52,53 @@ void VM::init()
     }
 }
 
+void VM::reset()
+{
+    m_regs.clear();
+    for (uint8_t i = 0; i < num_vregisters; ++i)
+        m_vregs.clear(i);
+    m_maps.clear();
+    m_mem = nullptr;
+    m_size = 0;
+    m_strings.clear();
+    m_pool_pos = 0;
+    m_pool_size = 0;
+
+    // Mapped blocks belong to a snapshot file
+    for (auto &heap : m_heap) {
+        if (!heap.mapped())
+            m_spare.push_back(std::move(heap));
+    }
+    m_heap.clear();
+    m_heap_pos = 0;
+    m_ticks = 0;
+}
+
 void VM::load(uint8_t *mem, uint64_t size)
 {
     m_mem = mem;
     m_size = size;
+    m_strings.clear();
+    m_pool_size = 0;
     m_regs.pc_reset();
 }
 
+void VM::load(const Image &image)
+{
+    Program program;
+    program.load(image);
+    load(program);
+}
+
+void VM::load(const Program &program)
+{
+    load((uint8_t*)program.memory(), program.memory_size());
+    m_regs.pc_update(program.entry());
+    intern_strings(program.strings(), program.strings_size());
+    if (program.bss_size() + program.heap_size() > 0)
+        add_heap(program.bss_size() + program.heap_size());
+}
+
 uint8_t VM::fetch8()
 {
     uint64_t pos = m_regs.pc();
@@ -49,6 +112,31 @@ uint8_t VM::fetch8()
     return res;
 }
 
+uint64_t VM::fetch_int(uint8_t size)
+{
+    if (size > 8)
+        throw std::string("Invalid size: ") + std::to_string((int)size);
+
+    uint64_t res = 0;
+    for (uint8_t i = 0; i < size; ++i) {
+        res <<= 8;
+        res |= fetch8();
+    }
+    return res;
+}
+
+/* Like fetch_int, but sign extends from the topmost fetched bit
+ */
+uint64_t VM::fetch_sint(uint8_t size)
+{
+    uint64_t res = fetch_int(size);
+    if (size > 0 && size < 8) {
+        uint64_t sign = 1ULL << (size * 8 - 1);
+        res = (res ^ sign) - sign;
+    }
+    return res;
+}
+
 Opcode VM::fetch()
 {
     m_opcode = Opcode(fetch8());
@@ -62,15 +150,40 @@ Opcode VM::current_opcode() const
 
 bool VM::step()
 {
-    Opcode op = fetch();
-    ++m_ticks;
+    try {
+        Opcode op = fetch();
+        ++m_ticks;
 
-    return m_opcodes[op()](this);
+        if (m_opcodes[op()](this))
+            return true;
+    }
+    catch (...) {
+        // Output before the trap goes out before it's reported
+        m_output->flush();
+        throw;
+    }
+    m_output->flush();
+    return false;
 }
 
 void VM::add_heap(uint64_t size)
 {
-    m_heap.emplace_back(m_heap_pos, size);
+    // Smallest block left by reset which fits
+    auto best = m_spare.end();
+    for (auto it = m_spare.begin(); it != m_spare.end(); ++it) {
+        if (size > 0 && it->capacity() >= size
+                && (best == m_spare.end()
+                    || it->capacity() < best->capacity()))
+            best = it;
+    }
+
+    if (best != m_spare.end()) {
+        best->reuse(m_heap_pos, size);
+        m_heap.push_back(std::move(*best));
+        m_spare.erase(best);
+    } else {
+        m_heap.emplace_back(m_heap_pos, size);
+    }
     m_heap_pos += size;
 }
 
@@ -118,6 +231,69 @@ core::Heap &VM::heap(uint64_t pos)
     throw std::string("Invalid heap access");
 }
 
+uint8_t *VM::heap_range(uint64_t pos, uint64_t size)
+{
+    if (pos < m_size)
+        throw std::string("Heap memory access out of bounds");
+    return heap(pos - m_size).data(pos - m_size, size);
+}
+
+const uint8_t *VM::heap_read(uint64_t pos, uint64_t size) const
+{
+    if (pos < m_size)
+        throw std::string("Heap memory access out of bounds");
+    for (auto &item : m_heap) {
+        if (item.valid(pos - m_size))
+            return item.data(pos - m_size, size);
+    }
+    throw std::string("Invalid heap access");
+}
+
+const uint8_t *VM::code_range(uint64_t pos) const
+{
+    if (pos >= m_size)
+        throw std::string("Memory access out of bounds");
+    if (m_mem == nullptr)
+        throw std::string("Invalid memory");
+    return m_mem + pos;
+}
+
+void VM::intern_strings(uint64_t pos, uint64_t size)
+{
+    if (size == 0)
+        return;
+    if (pos + size > m_size || pos + size < pos)
+        throw std::string("Memory access out of bounds");
+    intern_strings((const char*)code_range(pos), size);
+    m_pool_pos = pos;
+    m_pool_size = size;
+}
+
+void VM::intern_strings(const char *data, uint64_t size)
+{
+    if (size == 0)
+        return;
+    if (data[size - 1] != 0)
+        throw std::string("Unterminated string pool");
+
+    m_strings.clear();
+    m_pool_size = 0;
+    const char *end = data + size;
+    while (data < end) {
+        const char *nul = (const char*)std::memchr(data, 0, end - data);
+        m_strings.push_back(StringRef{data, (uint64_t)(nul - data)});
+        data = nul + 1;
+    }
+}
+
+core::StringRef VM::string_const(uint64_t idx) const
+{
+    if (idx >= m_strings.size())
+        throw std::string("Invalid string constant: ")
+            + std::to_string(idx);
+    return m_strings[idx];
+}
+
 uint8_t VM::mem(uint64_t pos) const
 {
     if (pos >= m_size)
@@ -134,6 +310,16 @@ void VM::set_mem(uint64_t pos, uint8_t val)
         throw std::string("Write attempt to read only memory");
 }
 
+void VM::snapshot(const std::string &path)
+{
+    Snapshot::save(*this, path);
+}
+
+void VM::restore(const std::string &path)
+{
+    Snapshot::restore(*this, path);
+}
+
 bool VM::invalid_opcode(VM *vm)
 {
     throw std::string("Invalid opcode: ")
@@ -3,27 +3,50 @@
 #include <functional>
 
 #include "regs.hh"
+#include "vregs.hh"
+#include "maps.hh"
 #include "opcodes.hh"
 #include "heap.hh"
+#include "output.hh"
+#include "program.hh"
 
 namespace core
 {
 
+class Snapshot;
+class Checkpoint;
+
 class VM
 {
 public:
     VM();
     VM(uint8_t *mem, uint64_t size);
+    ~VM();
 
     inline void set_debug()
     {
         m_debug = true;
     }
 
+    /* Back to state before load: registers, PC, ticks, maps, string
+     * constants and heap are cleared. Handlers, output and debug stay,
+     * heap blocks are kept for reuse by add_heap.
+     */
+    void reset();
+
     void load(uint8_t *mem, uint64_t size);
+    /* Image has to live as long as the VM runs it, code is never
+     * written so read only mapping is fine */
+    void load(const Image &image);
+    /* Starts from entry point with string pool interned and zero
+     * initialized data and initial heap as the first heap block
+     */
+    void load(const Program &program);
     Opcode fetch();
     Opcode current_opcode() const;
     uint8_t fetch8();
+    uint64_t fetch_int(uint8_t size);
+    uint64_t fetch_sint(uint8_t size);
 
     bool step();
     inline void opcode(
@@ -59,6 +82,25 @@ public:
         return m_regs;
     }
 
+    inline VectorRegisters &vregs()
+    {
+        return m_vregs;
+    }
+
+    inline Maps &maps()
+    {
+        return m_maps;
+    }
+
+    /* Program output, buffered std::cout unless set. Output has to
+     * outlive the VM, nullptr returns to the default.
+     */
+    inline Output &output()
+    {
+        return *m_output;
+    }
+    void set_output(Output *output);
+
     inline uint64_t ticks() const
     {
         return m_ticks;
@@ -69,6 +111,13 @@ public:
     uint8_t get_heap(uint64_t pos) const;
     void set_heap(uint64_t pos, uint8_t val);
     Heap &heap(uint64_t pos);
+
+    /* Direct access to size bytes of heap at memory address pos,
+     * range has to be within single heap block
+     */
+    uint8_t *heap_range(uint64_t pos, uint64_t size);
+    /* Same for reading only, doesn't mark pages dirty */
+    const uint8_t *heap_read(uint64_t pos, uint64_t size) const;
     inline uint64_t heap_size() const
     {
         return m_heap_pos;
@@ -77,19 +126,56 @@ public:
     {
         return m_size;
     }
+    /* Program memory from pos to its end, for reading in place */
+    const uint8_t *code_range(uint64_t pos) const;
+
+    /* Interns size bytes of NUL terminated strings at program memory
+     * address pos as string constants, numbered from zero
+     */
+    void intern_strings(uint64_t pos, uint64_t size);
+    /* Same for strings outside of program memory, data has to outlive
+     * the VM
+     */
+    void intern_strings(const char *data, uint64_t size);
+    StringRef string_const(uint64_t idx) const;
+    inline uint64_t string_count() const
+    {
+        return m_strings.size();
+    }
+
     uint8_t mem(uint64_t pos) const;
     void set_mem(uint64_t pos, uint8_t val);
 
+    /* Saves registers, PC, ticks, maps and heap to file. Restore needs
+     * the same program loaded, heap is mapped copy-on-write from file
+     * so it has to stay unchanged while the VM runs.
+     */
+    void snapshot(const std::string &path);
+    void restore(const std::string &path);
+
 private:
+    friend class Snapshot;
+    friend class Checkpoint;
+
     static bool invalid_opcode(VM *);
     void init();
 
     std::function<bool (VM *)> m_opcodes[256];
     Registers m_regs;
+    VectorRegisters m_vregs;
+    Maps m_maps;
+    StreamOutput m_stdout;
+    Output *m_output;
     uint8_t *m_mem;
     uint64_t m_size;
+    std::vector<StringRef> m_strings;
+    // Where string pool is in program memory, if it's there
+    uint64_t m_pool_pos;
+    uint64_t m_pool_size;
 
     std::vector<Heap> m_heap;
+    // Blocks left by reset
+    std::vector<Heap> m_spare;
     uint64_t m_heap_pos;
 
     uint64_t m_ticks;
@@ -0,0 +1,44 @@
+#include "vregs.hh"
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+
+using core::VectorRegisters;
+
+VectorRegisters::VectorRegisters()
+{
+    std::memset(m_data, 0, sizeof(m_data));
+}
+
+uint8_t *VectorRegisters::get(uint8_t num)
+{
+    if (num >= num_vregisters)
+        throw std::string("Invalid vector register");
+    return m_data[num];
+}
+
+const uint8_t *VectorRegisters::get(uint8_t num) const
+{
+    if (num >= num_vregisters)
+        throw std::string("Invalid vector register");
+    return m_data[num];
+}
+
+void VectorRegisters::clear(uint8_t num)
+{
+    std::memset(get(num), 0, vector_bytes);
+}
+
+std::string VectorRegisters::dump() const
+{
+    std::stringstream ss;
+    ss << "Vector registers:\n";
+    for (uint8_t i = 0; i < num_vregisters; ++i) {
+        ss << std::setw(2) << std::setfill('0') << (int)i << ":";
+        for (uint8_t j = 0; j < vector_bytes; ++j)
+            ss << " " << std::hex << std::setw(2) << (int)m_data[i][j]
+               << std::dec;
+        ss << "\n";
+    }
+    return ss.str();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace core
+{
+
+/* Vector registers V0..Vf, 256 bits each. 128-bit operations use
+ * lower half and clear the upper.
+ */
+static const uint8_t num_vregisters = 16;
+static const uint8_t vector_bytes = 32;
+
+/* Lane type, low bits of vector shape byte
+ */
+enum class Lane : uint8_t
+{
+    U8 = 0,
+    U16,
+    U32,
+    U64,
+    I8,
+    I16,
+    I32,
+    I64,
+    F32,
+    F64
+};
+
+/* Shape byte is lane type, with 0x80 set for 256-bit vector
+ */
+static const uint8_t vector_wide = 0x80;
+
+class VectorRegisters
+{
+public:
+    VectorRegisters();
+
+    uint8_t *get(uint8_t num);
+    const uint8_t *get(uint8_t num) const;
+
+    void clear(uint8_t num);
+
+    std::string dump() const;
+
+private:
+    alignas(32) uint8_t m_data[num_vregisters][vector_bytes];
+};
+
+}
@@ -0,0 +1,36 @@
+; Array intrinsics over heap array of 1000 32-bit values
+
+LOAD R15, "\n"
+
+INFO R0, 3
+LOAD R1, 4000
+HEAP R1
+
+LOAD R1, 1000
+LOAD R2, 0
+MOV R3, R0
+fill:
+MOD R4, R2, 7
+STORE R4, 4, R3
+ADD R3, R3, 4
+INC R2
+JMP R2 < R1, fill
+
+ASUM.I32 R5, R0, R1
+PRINT R5
+PRINT R15
+AMAX.U32 R5, R0, R1
+PRINT R5
+PRINT R15
+ACOUNT.I32 R5, R0, R1, 3
+PRINT R5
+PRINT R15
+
+; Prefix sum in place, last element holds total
+ASCAN.I32 R0, R1
+ADD R3, R0, 3996
+LOAD R5, 4, R3
+PRINT R5
+PRINT R15
+
+STOP
@@ -2,8 +2,6 @@ LOAD R0, 0
 LOAD R1, 0
 LOAD R2, 0
 LOAD R3, 0
-LOAD R4, 100000
-LOAD R5, 5678
 LOAD R9, "\n"
 
 
@@ -11,14 +9,14 @@ loop:
     ADD R1, R1, R2
     ADD R1, R1, R0
 
-    MUL R2, R1, R5
+    MUL R2, R1, 5678
     MUL R2, R2, R0
 
     MUL R3, R0, R0
 
     INC R0
 
-    JMP R0 < R4, loop
+    JMP R0 < 100000, loop
 
 ;PRINT R0
 ;PRINT R9
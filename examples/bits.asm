@@ -0,0 +1,36 @@
+; Bit manipulation
+
+LOAD R9, "\n"
+LOAD R0, 0
+LOAD R1, 0
+
+; Rotate-xor hash of numbers 0..999
+hash:
+    ROL R1, R1, 5
+    XOR R1, R1, R0
+    INC R0
+    JMP R0 < 1000, hash
+
+PRINT R1
+PRINT R9
+
+; Bits set in the hash, lowest and highest set bit
+POPCNT R2, R1
+PRINT R2
+PRINT R9
+
+CTZ R3, R1
+PRINT R3
+PRINT R9
+
+CLZ R4, R1
+PRINT R4
+PRINT R9
+
+; Second byte with shift and mask
+SHR R5, R1, 8
+AND R5, R5, 255
+PRINT R5
+PRINT R9
+
+STOP
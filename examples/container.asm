@@ -0,0 +1,38 @@
+; Sectioned container, assemble with --container --heap 64
+; Read only data, zero initialized buffer and initial heap need no
+; setup at runtime
+
+ENTRY main
+
+; Execution starts from main, this is skipped
+LOAD R1, "skipped\n"
+PRINT R1
+STOP
+
+main:
+LOAD R15, "\n"
+LOAD R1, [greeting]
+PRINT R1
+PRINT R15
+
+; Buffer is zero, then gets a copy of the greeting
+LOAD R2, [buf]
+LEN R3, R2
+PRINT R3
+PRINT R15
+STORE R1, [buf]
+LOAD R2, [buf + 6]
+PRINT R2
+PRINT R15
+
+; Buffer and initial heap in one block
+INFO R4, 2
+PRINT R4
+PRINT R15
+
+STOP
+
+greeting:
+    DB "Hello world", 0
+buf:
+    RESB 16
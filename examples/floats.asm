@@ -0,0 +1,51 @@
+; Float arithmetic: Newton iteration for square root of 2
+
+LOAD R9, "\n"
+
+LOAD R0, 2.0
+LOAD R1, 2.0
+newton:
+MOV R2, R1
+FDIV R3, R0, R1
+FADD R1, R1, R3
+LOAD R4, 0.5
+FMUL R1, R1, R4
+JMP R1 !=f R2, newton
+PRINT R1
+PRINT R9
+
+FSQRT R2, R0
+PRINT R2
+PRINT R9
+
+; Hardware square root of integer, and back
+LOAD R5, 1764
+ITOF R6, R5
+FSQRT R6, R6
+PRINT R6
+PRINT R9
+FTOI R7, R6
+PRINT R7
+PRINT R9
+
+; Shortest round trip output
+LOAD R0, 0.1
+LOAD R1, 0.2
+FADD R2, R0, R1
+PRINT R2
+PRINT R9
+
+; Fused multiply-add, min and max
+FMA R3, R0, 10, R1
+PRINT R3
+PRINT R9
+FMIN R4, R0, R1
+FMAX R5, R0, R1
+JMP R4 >=f R5, skip
+PRINT R4
+PRINT R9
+skip:
+PRINT R5
+PRINT R9
+
+STOP
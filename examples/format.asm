@@ -0,0 +1,21 @@
+; Records built with FORMAT and printed once each
+
+LOAD R15, "\n"
+LOAD R1, "id={03} value={.2} hex={x} name={}"
+LOAD R5, "item"
+
+LOAD R2, 1
+LOAD R3, 0.5
+LOAD R6, 3.0
+row:
+MUL R4, R2, 4096
+FORMAT R0, R1, R2, R3, R4, R5
+PRINT R0
+PRINT R15
+FMUL R3, R3, R6
+INC R2
+JMP R2 <= 4, row
+
+FORMAT R0, R15
+PRINT R0
+STOP
@@ -0,0 +1,38 @@
+; Checksums of "123456789" stored to heap
+
+LOAD R15, "\n"
+
+INFO R0, 3
+LOAD R1, 9
+HEAP R1
+
+LOAD R2, 49
+MOV R3, R0
+fill:
+STORE R2, 1, R3
+INC R3
+INC R2
+JMP R2 <= 57, fill
+
+LOAD R5, 0
+CRC32 R5, R0, R1
+PRINT R5
+PRINT R15
+LOAD R5, 0
+CRC32C R5, R0, R1
+PRINT R5
+PRINT R15
+
+; Same CRC in two parts
+LOAD R5, 0
+CRC32C R5, R0, 4
+ADD R3, R0, 4
+CRC32C R5, R3, 5
+PRINT R5
+PRINT R15
+
+XXH64 R6, R0, R1
+PRINT R6
+PRINT R15
+
+STOP
@@ -0,0 +1,38 @@
+; Wide immediate operands
+
+LOAD R0, 0
+LOAD R9, "\n"
+
+ADD R1, R0, 100000
+PRINT R1
+PRINT R9
+
+SUB R2, R1, 1000
+PRINT R2
+PRINT R9
+
+MUL R3, 300, R2
+PRINT R3
+PRINT R9
+
+DIV R4, R3, 1000
+PRINT R4
+PRINT R9
+
+MOD R5, R3, 7777
+PRINT R5
+PRINT R9
+
+loop:
+    ADD R0, R0, 1000
+    JMP R0 < 100000, loop
+
+PRINT R0
+PRINT R9
+
+JMP R0 == 100000, done
+
+PRINT R1
+PRINT R9
+
+done: STOP
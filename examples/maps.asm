@@ -0,0 +1,43 @@
+; Count occurrences of values with built-in hash map
+
+LOAD R15, "\n"
+
+MAP_NEW R0
+LOAD R1, 0
+count:
+MOD R2, R1, 7
+MAP_GET R3, R0, R2, first
+INC R3
+JMP R3 > 0, store
+first:
+LOAD R3, 1
+store:
+MAP_PUT R0, R2, R3
+INC R1
+JMP R1 < 1000, count
+
+MAP_SIZE R4, R0
+PRINT R4
+PRINT R15
+MAP_GET R3, R0, 3, missing
+PRINT R3
+PRINT R15
+
+; String keys live beside integer ones
+LOAD R5, "three"
+MAP_PUT R0, R5, 3
+MAP_GET R6, R0, R5, missing
+PRINT R6
+PRINT R15
+
+MAP_DEL R0, R5
+MAP_GET R6, R0, R5, missing
+PRINT R6
+PRINT R15
+
+missing:
+LOAD R7, "missing"
+PRINT R7
+PRINT R15
+
+STOP
@@ -0,0 +1,61 @@
+; Signed and 128-bit arithmetic
+
+LOAD R9, "\n"
+LOAD R8, "-"
+LOAD R7, "."
+LOAD R6, 0
+
+; Signed quotient and remainder of -17 / 5
+LOAD R0, -17
+IDIV R1, R0, 5
+IMOD R2, R0, 5
+
+SUB R3, R6, R1
+JMP R1 >=s 0, quot_pos
+PRINT R8
+MOV R1, R3
+quot_pos:
+PRINT R1
+PRINT R9
+
+SUB R3, R6, R2
+JMP R2 >=s 0, rem_pos
+PRINT R8
+MOV R2, R3
+rem_pos:
+PRINT R2
+PRINT R9
+
+; 32.32 fixed point: 1.5 * 2.25 with 128-bit product
+LOAD R0, 6442450944
+LOAD R1, 9663676416
+UMULH R2, R0, R1
+MUL R3, R0, R1
+SHL R2, R2, 32
+SHR R3, R3, 32
+OR R4, R2, R3
+
+SHR R5, R4, 32
+PRINT R5
+PRINT R7
+AND R5, R4, 4294967295
+MUL R5, R5, 1000
+SHR R5, R5, 32
+PRINT R5
+PRINT R9
+
+; And back: (product << 32) / 1.5 with 128/64 division
+SHR R2, R4, 32
+SHL R3, R4, 32
+DIV128 R4, R5, R2, R3, R0
+
+SHR R5, R4, 32
+PRINT R5
+PRINT R7
+AND R5, R4, 4294967295
+MUL R5, R5, 1000
+SHR R5, R5, 32
+PRINT R5
+PRINT R9
+
+STOP
@@ -0,0 +1,40 @@
+; Table of squares built once, SNAPSHOT saves the state so later
+; runs continue from the next instruction without building it:
+;   minvm --snapshot squares.snap snapshot.bin
+;   minvm --restore squares.snap snapshot.bin
+
+MAP_NEW R0
+LOAD R1, 0
+build:
+MUL R2, R1, R1
+MAP_PUT R0, R1, R2
+INC R1
+JMP R1 < 1000, build
+
+; Heap copy of a string survives as well
+LOAD R2, 16
+HEAP R2
+LOAD R3, "from heap"
+STORE R3, [heap]
+
+SNAPSHOT
+
+LOAD R15, "\n"
+LOAD R6, 999
+MAP_GET R4, R0, R6, missing
+PRINT R4
+PRINT R15
+MAP_SIZE R4, R0
+PRINT R4
+PRINT R15
+LOAD R5, [heap]
+PRINT R5
+PRINT R15
+STOP
+
+missing:
+LOAD R5, "missing\n"
+PRINT R5
+STOP
+
+heap:
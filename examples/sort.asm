@@ -0,0 +1,35 @@
+; Sort shuffled array of 1000 32-bit values and search from it
+
+LOAD R15, "\n"
+
+INFO R0, 3
+LOAD R1, 4000
+HEAP R1
+
+LOAD R1, 1000
+LOAD R2, 0
+MOV R3, R0
+fill:
+MUL R4, R2, 7919
+MOD R4, R4, R1
+STORE R4, 4, R3
+ADD R3, R3, 4
+INC R2
+JMP R2 < R1, fill
+
+SORT.U32 R0, R1
+ADD R3, R0, 492
+LOAD R5, 4, R3
+PRINT R5
+PRINT R15
+
+; Index of first element not less than value
+LOAD R6, 500
+BSEARCH.U32 R5, R0, R1, R6
+PRINT R5
+PRINT R15
+BSEARCH.U32 R5, R0, R1, R1
+PRINT R5
+PRINT R15
+
+STOP
@@ -2,8 +2,6 @@
 LOAD R0, 1764
 
 ; Other variables
-LOAD R11, -1
-LOAD R3, 0
 MOV R2, R0
 
 ; Newtons method for square root
@@ -16,12 +14,12 @@ sqrt:
     ADD R2, R2, R1
     DIV R2, R2, 2
 
+    ; R3 = |R1 - R2| without branching
     SUB R3, R1, R2
-    JMP R3 >= 0, sqrt_end
+    SUB R4, R2, R1
+    SET R5, R1 > R2
+    SELECT R3, R5, R3, R4
 
-    MUL R3, R3, R11
-
-sqrt_end:
     JMP R3 > 1, sqrt
 
 ; Print result
@@ -0,0 +1,29 @@
+; Strings loaded from program memory and copied through heap
+
+LOAD R15, "\n"
+
+LOAD R1, [greeting]
+PRINT R1
+PRINT R15
+
+LOAD R1, [greeting + 6]
+PRINT R1
+PRINT R15
+
+; Heap starts right after the code
+LOAD R2, 16
+HEAP R2
+STORE R1, [heap]
+LOAD R3, "copy of "
+STORE R3, [heap + 6]
+LOAD R4, [heap + 6]
+PRINT R4
+LOAD R4, [heap]
+PRINT R4
+PRINT R15
+
+STOP
+
+greeting:
+    DB "Hello world", 0
+heap:
@@ -0,0 +1,49 @@
+; Builds comma separated list of numbers and picks it apart
+
+LOAD R15, "\n"
+LOAD R14, ","
+
+LOAD R1, ""
+LOAD R2, 0
+build:
+FROM_INT R3, R2
+CONCAT R1, R1, R3
+CONCAT R1, R1, R14
+INC R2
+JMP R2 < 12, build
+
+PRINT R1
+PRINT R15
+
+LEN R4, R1
+PRINT R4
+PRINT R15
+
+LOAD R5, "10"
+FIND R6, R1, R5
+PRINT R6
+PRINT R15
+
+SUBSTR R7, R1, R6, 5
+PRINT R7
+PRINT R15
+
+SUBSTR R8, R7, 0, 2
+TO_INT R9, R8
+ADD R9, R9, R9
+PRINT R9
+PRINT R15
+
+JMP R8 ==$ R5, same
+LOAD R10, "different"
+PRINT R10
+same:
+LOAD R10, "abc"
+LOAD R11, "abd"
+JMP R10 <$ R11, less
+PRINT R11
+less:
+PRINT R10
+PRINT R15
+
+STOP
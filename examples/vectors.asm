@@ -0,0 +1,47 @@
+; Vector arithmetic over heap array of 16 32-bit squares
+
+LOAD R15, "\n"
+
+INFO R0, 3
+LOAD R1, 64
+HEAP R1
+
+LOAD R2, 0
+MOV R3, R0
+fill:
+MUL R4, R2, R2
+STORE R4, 4, R3
+ADD R3, R3, 4
+INC R2
+JMP R2 < 16, fill
+
+; Sum and maximum, eight lanes at a time
+VLOAD.I32X8 V0, R0
+ADD R5, R0, 32
+VLOAD.I32X8 V1, R5
+VADD.I32X8 V2, V0, V1
+VSUM.I32X8 R6, V2
+PRINT R6
+PRINT R15
+VHMAX.I32X8 R6, V1
+PRINT R6
+PRINT R15
+
+; Scale in place and read back single element
+VSPLAT.I32X8 V3, 10
+VMUL.I32X8 V4, V0, V3
+VSTORE.I32X8 V4, R0
+ADD R5, R0, 12
+LOAD R7, 4, R5
+PRINT R7
+PRINT R15
+
+; Float lanes
+LOAD R9, 0.5
+VSPLAT.F64X4 V5, R9
+VADD.F64X4 V6, V5, V5
+VSUM.F64X4 R10, V6
+PRINT R10
+PRINT R15
+
+STOP
@@ -0,0 +1,451 @@
+#include "arrays.hh"
+#include "opcodes.hh"
+#include "pool.hh"
+#include "simd.hh"
+#include "vectors.hh"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using core::VM;
+using core::Lane;
+using impl::Opcode;
+using impl::Arrays;
+using impl::Simd;
+using impl::ThreadPool;
+
+namespace
+{
+
+enum class Kernel : uint8_t
+{
+    Sum,
+    Min,
+    Max,
+    Count,
+    Scan
+};
+
+/* Part of array, integer results and inputs are in ival,
+ * float ones in fval
+ */
+struct Chunk
+{
+    Kernel kernel;
+    Lane lane;
+    uint8_t *data;
+    uint64_t count;
+    uint64_t ival;
+    double fval;
+};
+
+}
+
+static uint64_t s_threshold = 1 << 20;
+
+void Arrays::set_parallel_threshold(uint64_t bytes)
+{
+    s_threshold = bytes;
+}
+
+uint64_t Arrays::parallel_threshold()
+{
+    return s_threshold;
+}
+
+template<typename T>
+ALWAYS_INLINE T from_bits(uint64_t val)
+{
+    return (T)val;
+}
+
+template<>
+ALWAYS_INLINE float from_bits<float>(uint64_t val)
+{
+    uint32_t bits = val;
+    float res;
+    std::memcpy(&res, &bits, sizeof(res));
+    return res;
+}
+
+template<>
+ALWAYS_INLINE double from_bits<double>(uint64_t val)
+{
+    double res;
+    std::memcpy(&res, &val, sizeof(res));
+    return res;
+}
+
+template<typename T>
+ALWAYS_INLINE uint64_t to_bits(T val)
+{
+    return (uint64_t)val;
+}
+
+template<>
+ALWAYS_INLINE uint64_t to_bits<float>(float val)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &val, sizeof(bits));
+    return bits;
+}
+
+template<>
+ALWAYS_INLINE uint64_t to_bits<double>(double val)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &val, sizeof(bits));
+    return bits;
+}
+
+template<typename T>
+ALWAYS_INLINE T load(const uint8_t *ptr)
+{
+    uint64_t val = 0;
+    for (unsigned i = 0; i < sizeof(T); ++i)
+        val = (val << 8) | ptr[i];
+    return from_bits<T>(val);
+}
+
+template<typename T>
+ALWAYS_INLINE void store(uint8_t *ptr, T val)
+{
+    uint64_t bits = to_bits<T>(val);
+    for (unsigned i = sizeof(T); i > 0; --i) {
+        ptr[i - 1] = bits & 0xff;
+        bits >>= 8;
+    }
+}
+
+template<typename T>
+ALWAYS_INLINE void set_result(Chunk &chunk, T val)
+{
+    chunk.ival = (uint64_t)val;
+}
+
+template<>
+ALWAYS_INLINE void set_result<float>(Chunk &chunk, float val)
+{
+    chunk.fval = val;
+}
+
+template<>
+ALWAYS_INLINE void set_result<double>(Chunk &chunk, double val)
+{
+    chunk.fval = val;
+}
+
+template<typename T, typename Acc>
+ALWAYS_INLINE Acc initial(const Chunk &chunk)
+{
+    return (Acc)chunk.ival;
+}
+
+template<>
+ALWAYS_INLINE double initial<float, double>(const Chunk &chunk)
+{
+    return chunk.fval;
+}
+
+template<>
+ALWAYS_INLINE double initial<double, double>(const Chunk &chunk)
+{
+    return chunk.fval;
+}
+
+/* Plain loops, written so that compiler vectorizes them for
+ * instruction set of the calling kernel
+ */
+template<typename T, typename Acc>
+ALWAYS_INLINE void run(Chunk &chunk)
+{
+    uint8_t *data = chunk.data;
+    uint64_t count = chunk.count;
+
+    switch (chunk.kernel) {
+        case Kernel::Sum: {
+            Acc acc = 0;
+            for (uint64_t i = 0; i < count; ++i)
+                acc += (Acc)load<T>(data + i * sizeof(T));
+            set_result<Acc>(chunk, acc);
+            break;
+        }
+        case Kernel::Min: {
+            T res = load<T>(data);
+            for (uint64_t i = 1; i < count; ++i) {
+                T val = load<T>(data + i * sizeof(T));
+                res = val < res ? val : res;
+            }
+            set_result<T>(chunk, res);
+            break;
+        }
+        case Kernel::Max: {
+            T res = load<T>(data);
+            for (uint64_t i = 1; i < count; ++i) {
+                T val = load<T>(data + i * sizeof(T));
+                res = val > res ? val : res;
+            }
+            set_result<T>(chunk, res);
+            break;
+        }
+        case Kernel::Count: {
+            T match = (T)initial<T, Acc>(chunk);
+            uint64_t res = 0;
+            for (uint64_t i = 0; i < count; ++i)
+                res += load<T>(data + i * sizeof(T)) == match;
+            chunk.ival = res;
+            break;
+        }
+        case Kernel::Scan: {
+            Acc acc = initial<T, Acc>(chunk);
+            for (uint64_t i = 0; i < count; ++i) {
+                acc += (Acc)load<T>(data + i * sizeof(T));
+                store<T>(data + i * sizeof(T), (T)acc);
+            }
+            break;
+        }
+    }
+}
+
+ALWAYS_INLINE void run_lane(Chunk &chunk)
+{
+    switch (chunk.lane) {
+        case Lane::U8: run<uint8_t, uint64_t>(chunk); break;
+        case Lane::U16: run<uint16_t, uint64_t>(chunk); break;
+        case Lane::U32: run<uint32_t, uint64_t>(chunk); break;
+        case Lane::U64: run<uint64_t, uint64_t>(chunk); break;
+        case Lane::I8: run<int8_t, uint64_t>(chunk); break;
+        case Lane::I16: run<int16_t, uint64_t>(chunk); break;
+        case Lane::I32: run<int32_t, uint64_t>(chunk); break;
+        case Lane::I64: run<int64_t, uint64_t>(chunk); break;
+        case Lane::F32: run<float, double>(chunk); break;
+        case Lane::F64: run<double, double>(chunk); break;
+    }
+}
+
+static void run_generic(Chunk &chunk)
+{
+    run_lane(chunk);
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+static void run_avx2(Chunk &chunk)
+{
+    run_lane(chunk);
+}
+#endif
+
+static void run_chunk(Chunk &chunk)
+{
+#if defined(__x86_64__)
+    if (Simd::isa() == Simd::Isa::Avx2) {
+        run_avx2(chunk);
+        return;
+    }
+#endif
+    run_generic(chunk);
+}
+
+static bool is_float(Lane lane)
+{
+    return lane == Lane::F32 || lane == Lane::F64;
+}
+
+static bool is_signed(Lane lane)
+{
+    return lane >= Lane::I8 && lane <= Lane::I64;
+}
+
+/* Splits to one chunk per pool thread when array is large enough
+ */
+static std::vector<Chunk> split(const Chunk &whole, bool parallel)
+{
+    unsigned width = Simd::lane_size(whole.lane);
+    unsigned parts = 1;
+    if (parallel && whole.count * width >= s_threshold)
+        parts = ThreadPool::shared().size();
+    if (parts > whole.count)
+        parts = whole.count;
+
+    std::vector<Chunk> res;
+    uint64_t per_part = (whole.count + parts - 1) / parts;
+    for (uint64_t pos = 0; pos < whole.count; pos += per_part) {
+        Chunk chunk = whole;
+        chunk.data = whole.data + pos * width;
+        chunk.count = std::min(per_part, whole.count - pos);
+        res.push_back(chunk);
+    }
+    return res;
+}
+
+static void run_all(std::vector<Chunk> &chunks)
+{
+    if (chunks.size() == 1) {
+        run_chunk(chunks[0]);
+        return;
+    }
+    ThreadPool::shared().parallel_for(chunks.size(), [&](unsigned idx) {
+        run_chunk(chunks[idx]);
+    });
+}
+
+static bool less(Lane lane, const Chunk &a, const Chunk &b)
+{
+    if (is_float(lane))
+        return a.fval < b.fval;
+    if (is_signed(lane))
+        return (int64_t)a.ival < (int64_t)b.ival;
+    return a.ival < b.ival;
+}
+
+static Chunk reduce(Chunk whole)
+{
+    bool ordered = is_float(whole.lane) && whole.kernel == Kernel::Sum;
+    std::vector<Chunk> chunks = split(whole, !ordered);
+    run_all(chunks);
+
+    Chunk res = chunks[0];
+    for (size_t i = 1; i < chunks.size(); ++i) {
+        const Chunk &part = chunks[i];
+        if (whole.kernel == Kernel::Min && less(whole.lane, part, res))
+            res = part;
+        else if (whole.kernel == Kernel::Max && less(whole.lane, res, part))
+            res = part;
+        else if (whole.kernel == Kernel::Sum || whole.kernel == Kernel::Count)
+            res.ival += part.ival;
+    }
+    return res;
+}
+
+/* Chunk sums first, then each chunk scanned from sum of ones before it
+ */
+static void scan(Chunk whole)
+{
+    std::vector<Chunk> chunks = split(whole, !is_float(whole.lane));
+    if (chunks.size() > 1) {
+        std::vector<Chunk> sums = chunks;
+        for (auto &chunk : sums)
+            chunk.kernel = Kernel::Sum;
+        run_all(sums);
+
+        uint64_t offset = 0;
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            chunks[i].ival = offset;
+            offset += sums[i].ival;
+        }
+    }
+    run_all(chunks);
+}
+
+static Chunk make_chunk(VM *vm, Kernel kernel, uint8_t shape,
+    uint8_t base, uint8_t count)
+{
+    Chunk res;
+    res.kernel = kernel;
+    res.lane = impl::Vectors::lane(shape);
+    res.count = (count>0xf)?(count>>4):vm->regs().get_int(count);
+    res.ival = 0;
+    res.fval = 0;
+    res.data = nullptr;
+
+    uint64_t width = Simd::lane_size(res.lane);
+    if (res.count > UINT64_MAX / width)
+        throw std::string("Heap memory access out of bounds");
+    // Only scan writes, reductions leave pages clean
+    if (res.count > 0 && kernel == Kernel::Scan)
+        res.data = vm->heap_range(
+            vm->regs().get_int(base), res.count * width);
+    else if (res.count > 0)
+        res.data = (uint8_t*)vm->heap_read(
+            vm->regs().get_int(base), res.count * width);
+    return res;
+}
+
+static void put_result(VM *vm, uint8_t reg, const Chunk &chunk)
+{
+    if (is_float(chunk.lane) && chunk.kernel != Kernel::Count)
+        vm->regs().put_float(reg, chunk.fval);
+    else
+        vm->regs().put_int(reg, chunk.ival);
+}
+
+Arrays::Arrays(VM *vm)
+{
+    vm->opcode(Opcode::AREDUCE(), Arrays::areduce);
+    vm->opcode(Opcode::ACOUNT(), Arrays::acount);
+    vm->opcode(Opcode::ASCAN(), Arrays::ascan);
+}
+
+bool Arrays::areduce(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "AREDUCE\n";
+    uint8_t reg = vm->fetch8();
+    uint8_t op = vm->fetch8();
+    uint8_t shape = vm->fetch8();
+    uint8_t base = vm->fetch8();
+    uint8_t count = vm->fetch8();
+
+    Kernel kernel;
+    switch ((Simd::Op)op) {
+        case Simd::Op::Add:
+            kernel = Kernel::Sum;
+            break;
+        case Simd::Op::Min:
+            kernel = Kernel::Min;
+            break;
+        case Simd::Op::Max:
+            kernel = Kernel::Max;
+            break;
+        default:
+            throw std::string("Invalid array reduction: ")
+                + std::to_string((int)op);
+    }
+
+    Chunk chunk = make_chunk(vm, kernel, shape, base, count);
+    if (chunk.count == 0 && kernel != Kernel::Sum)
+        throw std::string("Empty array");
+    if (chunk.count > 0)
+        chunk = reduce(chunk);
+    put_result(vm, reg, chunk);
+
+    return true;
+}
+
+bool Arrays::acount(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "ACOUNT\n";
+    uint8_t reg = vm->fetch8();
+    uint8_t shape = vm->fetch8();
+    uint8_t base = vm->fetch8();
+    uint8_t count = vm->fetch8();
+    uint8_t value = vm->fetch8();
+
+    Chunk chunk = make_chunk(vm, Kernel::Count, shape, base, count);
+    if (is_float(chunk.lane))
+        chunk.fval = vm->regs().get_float(value);
+    else
+        chunk.ival = (value>0xf)?(value>>4):vm->regs().get_int(value);
+    if (chunk.count > 0)
+        chunk = reduce(chunk);
+    else
+        chunk.ival = 0;
+    put_result(vm, reg, chunk);
+
+    return true;
+}
+
+bool Arrays::ascan(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "ASCAN\n";
+    uint8_t shape = vm->fetch8();
+    uint8_t base = vm->fetch8();
+    uint8_t count = vm->fetch8();
+
+    Chunk chunk = make_chunk(vm, Kernel::Scan, shape, base, count);
+    if (chunk.count > 0)
+        scan(chunk);
+
+    return true;
+}
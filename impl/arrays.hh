@@ -0,0 +1,36 @@
+#pragma once
+
+#include "vm.hh"
+
+namespace impl
+{
+
+/* Intrinsics over heap arrays of big endian elements.
+ *
+ * Element type is lane byte like in vector shape, array is given by
+ * base address and element count registers. Whole range is validated
+ * once before touching it. Arrays of at least parallel_threshold()
+ * bytes are split to shared thread pool, except float sums and scans
+ * which keep sequential order. Sums accumulate in 64 bits, or double
+ * for floats.
+ */
+class Arrays
+{
+public:
+    Arrays(core::VM *vm);
+
+    static void set_parallel_threshold(uint64_t bytes);
+    static uint64_t parallel_threshold();
+
+private:
+    /* Sum, minimum or maximum to register */
+    static bool areduce(core::VM *vm);
+
+    /* Number of elements equal to value */
+    static bool acount(core::VM *vm);
+
+    /* Inclusive prefix sum in place, wraps in element width */
+    static bool ascan(core::VM *vm);
+};
+
+}
@@ -0,0 +1,130 @@
+#include "batch.hh"
+#include <cerrno>
+#include <cstdlib>
+#include <sstream>
+
+using impl::Batch;
+
+Batch::Batch(unsigned threads) :
+    m_pool(threads ? threads : std::thread::hardware_concurrency())
+{
+}
+
+std::vector<Batch::Job> Batch::parse(const std::string &text)
+{
+    std::vector<Job> res;
+    std::istringstream lines(text);
+    std::string line;
+    for (unsigned num = 1; std::getline(lines, line); ++num) {
+        std::istringstream words(line);
+        Job job;
+        if (!(words >> job.path) || job.path[0] == '#')
+            continue;
+
+        std::string word;
+        while (words >> word) {
+            if (job.args.size() == core::num_registers)
+                throw std::string("Too many arguments at line ")
+                    + std::to_string(num);
+            char *end = nullptr;
+            errno = 0;
+            uint64_t val = word[0] == '-' ?
+                (uint64_t)std::strtoll(word.c_str(), &end, 0) :
+                std::strtoull(word.c_str(), &end, 0);
+            if (*end != 0 || errno != 0)
+                throw std::string("Invalid argument at line ")
+                    + std::to_string(num) + ": " + word;
+            job.args.push_back(val);
+        }
+        res.push_back(job);
+    }
+    return res;
+}
+
+std::vector<Batch::Job> Batch::read(const std::string &path)
+{
+    core::Image image;
+    image.open(path);
+    return parse(std::string((const char*)image.data(), image.size()));
+}
+
+Batch::Result Batch::run_job(const Job &job, const Loaded &loaded)
+{
+    Result res;
+    if (!loaded.error.empty()) {
+        res.error = loaded.error;
+        return res;
+    }
+
+    // Output first, VM flushes to it when lease ends
+    core::BufferOutput output;
+    {
+        VMPool::Lease vm = m_vms.acquire();
+        vm->load(loaded.program);
+        vm->set_output(&output);
+        for (uint8_t i = 0; i < job.args.size(); ++i)
+            vm->regs().put_int(i, job.args[i]);
+
+        try {
+            while (vm->step());
+            res.ok = true;
+        }
+        catch (std::string e) {
+            res.error = e;
+            uint64_t pc = vm->regs().pc();
+            std::string symbol = loaded.program.symbol(pc ? pc - 1 : 0);
+            if (!symbol.empty()) {
+                res.error += " at " + symbol;
+                uint32_t line = loaded.program.line(pc ? pc - 1 : 0);
+                if (line)
+                    res.error += ", line " + std::to_string(line);
+            }
+        }
+        res.ticks = vm->ticks();
+    }
+    res.output = output.data();
+    return res;
+}
+
+unsigned Batch::run(const std::vector<Job> &jobs, Callback func)
+{
+    // Every program once, jobs share it read only
+    std::map<std::string, std::unique_ptr<Loaded>> programs;
+    for (auto &job : jobs) {
+        std::unique_ptr<Loaded> &loaded = programs[job.path];
+        if (loaded)
+            continue;
+        loaded.reset(new Loaded());
+        try {
+            loaded->image.open(job.path, core::Image::WillNeed);
+            loaded->program.load(loaded->image);
+        }
+        catch (std::string e) {
+            loaded->error = e;
+        }
+    }
+
+    std::vector<Result> results(jobs.size());
+    std::vector<bool> done(jobs.size());
+    unsigned next = 0;
+    unsigned failed = 0;
+    std::mutex lock;
+
+    m_pool.parallel_for(jobs.size(), [&](unsigned idx) {
+        const Job &job = jobs[idx];
+        Result res = run_job(job, *programs.find(job.path)->second);
+
+        std::lock_guard<std::mutex> guard(lock);
+        results[idx] = std::move(res);
+        done[idx] = true;
+        // Pass on everything finished in order, free it meanwhile
+        while (next < jobs.size() && done[next]) {
+            if (!results[next].ok)
+                ++failed;
+            func(next, results[next]);
+            results[next] = Result();
+            ++next;
+        }
+    });
+    return failed;
+}
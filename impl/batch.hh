@@ -0,0 +1,86 @@
+#pragma once
+
+#include "vm.hh"
+#include "pool.hh"
+#include "vmpool.hh"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace impl
+{
+
+/* Runs many independent programs on a thread pool.
+ *
+ * Each program file is loaded once and shared by all jobs running it.
+ * Jobs take VMs from a pool, so handlers are registered once per
+ * thread and heap memory is reused. Output of each job is collected to
+ * memory and passed on in job order as soon as the jobs before it are
+ * done, so the result doesn't depend on scheduling.
+ *
+ * Array intrinsics use the shared thread pool, which is best kept at
+ * one thread while batch keeps all cores busy.
+ */
+class Batch
+{
+public:
+    /* Program path with integers put to R0, R1 and so on */
+    struct Job
+    {
+        std::string path;
+        std::vector<uint64_t> args;
+    };
+
+    struct Result
+    {
+        Result() : ok(false), ticks(0) {}
+
+        bool ok;
+        uint64_t ticks;
+        std::string output;
+        // Exception with location, if not ok
+        std::string error;
+    };
+
+    /* Called with job index, one call at a time */
+    typedef std::function<void (unsigned, const Result &)> Callback;
+
+    /* Zero threads means one per core */
+    explicit Batch(unsigned threads = 0);
+
+    inline unsigned threads() const
+    {
+        return m_pool.size();
+    }
+
+    /* Job per line: program path followed by arguments separated by
+     * white space, decimal or 0x hexadecimal, negative allowed. Empty
+     * lines and ones starting with # are skipped.
+     */
+    static std::vector<Job> parse(const std::string &text);
+    static std::vector<Job> read(const std::string &path);
+
+    /* Runs all jobs and returns how many of them failed. Program that
+     * can't be loaded fails its jobs.
+     */
+    unsigned run(const std::vector<Job> &jobs, Callback func);
+
+private:
+    struct Loaded
+    {
+        core::Image image;
+        core::Program program;
+        std::string error;
+    };
+
+    Result run_job(const Job &job, const Loaded &loaded);
+
+    ThreadPool m_pool;
+    VMPool m_vms;
+};
+
+}
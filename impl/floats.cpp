@@ -0,0 +1,226 @@
+#include "floats.hh"
+#include "opcodes.hh"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+
+using core::VM;
+using impl::Opcode;
+using impl::Floats;
+
+Floats::Floats(VM *vm)
+{
+    vm->opcode(Opcode::LOAD_FLOAT(), Floats::load_float);
+    vm->opcode(Opcode::LOAD_FLOAT32(), Floats::load_float32);
+
+    vm->opcode(Opcode::FADD(), Floats::alu_float<Floats::add>);
+    vm->opcode(Opcode::FSUB(), Floats::alu_float<Floats::sub>);
+    vm->opcode(Opcode::FMUL(), Floats::alu_float<Floats::mul>);
+    vm->opcode(Opcode::FDIV(), Floats::alu_float<Floats::div>);
+    vm->opcode(Opcode::FMIN(), Floats::alu_float<Floats::min>);
+    vm->opcode(Opcode::FMAX(), Floats::alu_float<Floats::max>);
+
+    vm->opcode(Opcode::FMA(), Floats::fma);
+    vm->opcode(Opcode::FSQRT(), Floats::fsqrt);
+    vm->opcode(Opcode::ITOF(), Floats::itof);
+    vm->opcode(Opcode::FTOI(), Floats::ftoi);
+
+    typedef std::equal_to<double> eq;
+    typedef std::not_equal_to<double> ne;
+    typedef std::less<double> lt;
+    typedef std::less_equal<double> le;
+
+    vm->opcode(Opcode::JFEQ8(), Floats::jump_cmp<eq, int8_t>);
+    vm->opcode(Opcode::JFNE8(), Floats::jump_cmp<ne, int8_t>);
+    vm->opcode(Opcode::JFLT8(), Floats::jump_cmp<lt, int8_t>);
+    vm->opcode(Opcode::JFLE8(), Floats::jump_cmp<le, int8_t>);
+
+    vm->opcode(Opcode::JFEQ32(), Floats::jump_cmp<eq, int32_t>);
+    vm->opcode(Opcode::JFNE32(), Floats::jump_cmp<ne, int32_t>);
+    vm->opcode(Opcode::JFLT32(), Floats::jump_cmp<lt, int32_t>);
+    vm->opcode(Opcode::JFLE32(), Floats::jump_cmp<le, int32_t>);
+
+    vm->opcode(Opcode::PRINT_FLOAT(), Floats::print_float);
+}
+
+std::string Floats::format(double val)
+{
+    char buf[32];
+    if (std::isnan(val))
+        return "nan";
+    if (std::isinf(val))
+        return val < 0 ? "-inf" : "inf";
+
+    // Most values round trip with 15 digits, try shortest first
+    for (int prec = 15; prec <= 17; ++prec) {
+        snprintf(buf, sizeof(buf), "%.*g", prec, val);
+        if (prec == 17 || strtod(buf, nullptr) == val)
+            break;
+    }
+    if (!strpbrk(buf, ".e"))
+        strcat(buf, ".0");
+    return buf;
+}
+
+double Floats::add(double val1, double val2)
+{
+    return val1 + val2;
+}
+
+double Floats::sub(double val1, double val2)
+{
+    return val1 - val2;
+}
+
+double Floats::mul(double val1, double val2)
+{
+    return val1 * val2;
+}
+
+double Floats::div(double val1, double val2)
+{
+    return val1 / val2;
+}
+
+double Floats::min(double val1, double val2)
+{
+    return std::fmin(val1, val2);
+}
+
+double Floats::max(double val1, double val2)
+{
+    return std::fmax(val1, val2);
+}
+
+uint64_t Floats::to_int(double val)
+{
+    if (!(val >= -9223372036854775808.0 && val < 9223372036854775808.0))
+        throw std::string("Float out of integer range");
+    return static_cast<uint64_t>(static_cast<int64_t>(val));
+}
+
+double Floats::get(core::VM *vm, uint8_t reg)
+{
+    if (reg > 0xf)
+        return reg >> 4;
+    return vm->regs().get_float(reg);
+}
+
+bool Floats::load_float(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "LOAD_FLOAT\n";
+    uint8_t reg = vm->fetch8();
+    uint64_t bits = vm->fetch_int(8);
+
+    double val;
+    memcpy(&val, &bits, sizeof(val));
+    vm->regs().put_float(reg, val);
+
+    return true;
+}
+
+bool Floats::load_float32(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "LOAD_FLOAT32\n";
+    uint8_t reg = vm->fetch8();
+    uint32_t bits = static_cast<uint32_t>(vm->fetch_int(4));
+
+    float val;
+    memcpy(&val, &bits, sizeof(val));
+    vm->regs().put_float(reg, val);
+
+    return true;
+}
+
+template<double (*Op)(double, double)>
+bool Floats::alu_float(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "ALU_FLOAT\n";
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+    uint8_t reg3 = vm->fetch8();
+
+    vm->regs().put_float(reg1, Op(get(vm, reg2), get(vm, reg3)));
+
+    return true;
+}
+
+bool Floats::fma(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "FMA\n";
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+    uint8_t reg3 = vm->fetch8();
+    uint8_t reg4 = vm->fetch8();
+
+    vm->regs().put_float(
+        reg1,
+        std::fma(get(vm, reg2), get(vm, reg3), get(vm, reg4)));
+
+    return true;
+}
+
+bool Floats::fsqrt(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "FSQRT\n";
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+
+    vm->regs().put_float(reg1, std::sqrt(get(vm, reg2)));
+
+    return true;
+}
+
+bool Floats::itof(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "ITOF\n";
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+    uint64_t val = (reg2>0xf)?(reg2>>4):vm->regs().get_int(reg2);
+
+    vm->regs().put_float(reg1, static_cast<int64_t>(val));
+
+    return true;
+}
+
+bool Floats::ftoi(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "FTOI\n";
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+
+    vm->regs().put_int(reg1, to_int(get(vm, reg2)));
+
+    return true;
+}
+
+template<typename Compare, typename Diff>
+bool Floats::jump_cmp(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "JUMP_FLOAT" << sizeof(Diff) * 8 << "\n";
+
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+    double val1 = get(vm, reg1);
+    double val2 = get(vm, reg2);
+
+    uint64_t pos = vm->regs().pc();
+    Diff diff = static_cast<Diff>(vm->fetch_int(sizeof(Diff)));
+
+    if (Compare()(val1, val2))
+        vm->regs().pc_update(pos + diff);
+
+    return true;
+}
+
+bool Floats::print_float(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "PRINT_FLOAT\n";
+    uint8_t reg = vm->fetch8();
+    std::string res = format(vm->regs().get_float(reg));
+    vm->output().write(res.data(), res.size());
+    return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "vm.hh"
+#include <string>
+
+namespace impl
+{
+
+class Floats
+{
+public:
+    Floats(core::VM *vm);
+
+    /* Shortest representation which reads back to the same value,
+     * always with decimal point or exponent: 42.0, 0.1, 1e+100
+     */
+    static std::string format(double val);
+
+    /* Truncates towards zero, throws on NaN and out of range values */
+    static uint64_t to_int(double val);
+
+private:
+    static bool load_float(core::VM *vm);
+    static bool load_float32(core::VM *vm);
+
+    static double add(double val1, double val2);
+    static double sub(double val1, double val2);
+    static double mul(double val1, double val2);
+    static double div(double val1, double val2);
+    static double min(double val1, double val2);
+    static double max(double val1, double val2);
+
+    template<double (*Op)(double, double)>
+    static bool alu_float(core::VM *vm);
+
+    static bool fma(core::VM *vm);
+    static bool fsqrt(core::VM *vm);
+    static bool itof(core::VM *vm);
+    static bool ftoi(core::VM *vm);
+
+    /* Unordered compare (NaN operand) is false for all but NE */
+    template<typename Compare, typename Diff>
+    static bool jump_cmp(core::VM *vm);
+
+    static double get(core::VM *vm, uint8_t reg);
+
+    static bool print_float(core::VM *vm);
+};
+
+}
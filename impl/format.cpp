@@ -0,0 +1,185 @@
+#include "format.hh"
+#include "floats.hh"
+#include "opcodes.hh"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+using core::VM;
+using impl::Opcode;
+using impl::Format;
+
+Format::Format(VM *vm)
+{
+    vm->opcode(Opcode::FORMAT(), [this](VM *vm) { return format(vm); });
+}
+
+static std::string invalid(const char *fmt, uint64_t size)
+{
+    return std::string("Invalid format: ") + std::string(fmt, size);
+}
+
+std::vector<Format::Piece> Format::parse(const char *fmt, uint64_t size)
+{
+    std::vector<Piece> res;
+    Piece piece;
+    piece.arg = false;
+
+    const char *end = fmt + size;
+    for (const char *pos = fmt; pos < end; ++pos) {
+        if (*pos == '}') {
+            if (pos + 1 >= end || pos[1] != '}')
+                throw invalid(fmt, size);
+            piece.text.push_back('}');
+            ++pos;
+            continue;
+        }
+        if (*pos != '{') {
+            piece.text.push_back(*pos);
+            continue;
+        }
+        if (pos + 1 < end && pos[1] == '{') {
+            piece.text.push_back('{');
+            ++pos;
+            continue;
+        }
+
+        Spec spec;
+        ++pos;
+        if (pos < end && *pos == '0') {
+            spec.zero = true;
+            ++pos;
+        }
+        while (pos < end && *pos >= '0' && *pos <= '9' && spec.width < 1000)
+            spec.width = spec.width * 10 + (*pos++ - '0');
+        if (pos < end && (*pos == 'd' || *pos == 'x')) {
+            spec.conv = *pos++;
+        } else if (pos < end && *pos == '.') {
+            ++pos;
+            spec.precision = 0;
+            while (pos < end && *pos >= '0' && *pos <= '9'
+                    && spec.precision < 100)
+                spec.precision = spec.precision * 10 + (*pos++ - '0');
+        }
+        if (pos >= end || *pos != '}')
+            throw invalid(fmt, size);
+
+        piece.arg = true;
+        piece.spec = spec;
+        res.push_back(piece);
+        piece = Piece();
+        piece.arg = false;
+    }
+    res.push_back(piece);
+
+    return res;
+}
+
+const Format::Cached &Format::get(uint64_t addr, core::StringRef fmt)
+{
+    auto it = m_cache.find(addr);
+    if (it != m_cache.end() && it->second.fmt.size() == fmt.size
+            && std::memcmp(it->second.fmt.data(), fmt.data, fmt.size) == 0)
+        return it->second;
+
+    Cached &res = m_cache[addr];
+    res.pieces = parse(fmt.data, fmt.size);
+    res.fmt.assign(fmt.data, fmt.size);
+    res.args = res.pieces.size() - 1;
+    return res;
+}
+
+/* Pads to width, zeros go after sign */
+static void append(std::string &res, const char *data, uint64_t size,
+    const Format::Spec &spec)
+{
+    if (spec.width > size) {
+        uint64_t fill = spec.width - size;
+        if (!spec.zero) {
+            res.append(fill, ' ');
+        } else {
+            if (size > 0 && data[0] == '-') {
+                res.push_back('-');
+                ++data;
+                --size;
+            }
+            res.append(fill, '0');
+        }
+    }
+    res.append(data, size);
+}
+
+void Format::render(VM *vm, std::string &res, const Spec &spec, uint8_t reg)
+{
+    char buf[64];
+    char *end = buf + sizeof(buf);
+    char *pos = end;
+
+    core::RegisterType type = vm->regs().type(reg);
+    if (spec.conv || (type == core::RegisterType::Integer
+            && spec.precision < 0)) {
+        uint64_t val = vm->regs().get_int(reg);
+        if (spec.conv == 'x') {
+            do {
+                *--pos = "0123456789abcdef"[val & 0xf];
+                val >>= 4;
+            } while (val);
+        } else {
+            bool neg = spec.conv == 'd' && (int64_t)val < 0;
+            if (neg)
+                val = -val;
+            do {
+                *--pos = '0' + val % 10;
+                val /= 10;
+            } while (val);
+            if (neg)
+                *--pos = '-';
+        }
+        append(res, pos, end - pos, spec);
+    } else if (spec.precision >= 0) {
+        // Large values and precisions don't fit fixed buffer
+        double val = vm->regs().get_float(reg);
+        int len = snprintf(nullptr, 0, "%.*f", spec.precision, val);
+        if (len < 0)
+            throw std::string("Invalid float format");
+        std::string text(len + 1, 0);
+        snprintf(&text[0], text.size(), "%.*f", spec.precision, val);
+        append(res, text.data(), len, spec);
+    } else if (type == core::RegisterType::Float) {
+        std::string val = Floats::format(vm->regs().get_float(reg));
+        append(res, val.data(), val.size(), spec);
+    } else {
+        core::StringRef val = vm->regs().get_string_ref(reg);
+        append(res, val.data, val.size, spec);
+    }
+}
+
+bool Format::format(VM *vm)
+{
+    if (vm->debug()) std::cerr << "FORMAT\n";
+    uint64_t addr = vm->regs().pc() - 1;
+    uint8_t reg = vm->fetch8();
+    uint8_t fmt = vm->fetch8();
+    uint8_t first = vm->fetch8();
+    uint8_t count = vm->fetch8();
+    // Argument registers are numbered from first without wrapping
+    if (first + count > core::num_registers)
+        throw std::string("Invalid register");
+
+    const Cached &cached = get(addr, vm->regs().get_string_ref(fmt));
+    if (cached.args != count)
+        throw std::string("Format expects ")
+            + std::to_string(cached.args) + " arguments, got "
+            + std::to_string((int)count);
+
+    std::string res;
+    for (size_t i = 0; i < cached.pieces.size(); ++i) {
+        const Piece &piece = cached.pieces[i];
+        res += piece.text;
+        if (piece.arg)
+            render(vm, res, piece.spec, first + i);
+    }
+    vm->regs().put_string(reg, std::move(res));
+
+    return true;
+}
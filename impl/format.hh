@@ -0,0 +1,68 @@
+#pragma once
+
+#include "vm.hh"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace impl
+{
+
+/* FORMAT renders consecutive registers to string register by format
+ * string. Each {} is replaced by next register, type decides how:
+ * integers as unsigned decimal, floats as PRINT does and strings as
+ * is. Inside braces optional width, with leading 0 for zero padding,
+ * is followed by optional conversion:
+ *   d   signed integer
+ *   x   hexadecimal integer
+ *   .N  float with N decimals
+ * Braces are doubled to get them literally: {{ and }}.
+ *
+ * Format is parsed once per instruction address, cache is kept as
+ * long as format string stays the same. Handler state belongs to
+ * this object, which has to live as long as the VM runs.
+ */
+class Format
+{
+public:
+    Format(core::VM *vm);
+
+    struct Spec
+    {
+        Spec() : zero(false), width(0), conv(0), precision(-1) {}
+
+        bool zero;
+        unsigned width;
+        char conv;
+        int precision;
+    };
+
+    /* Literal text followed by argument, last piece has no argument */
+    struct Piece
+    {
+        std::string text;
+        bool arg;
+        Spec spec;
+    };
+
+    /* Throws on invalid format */
+    static std::vector<Piece> parse(const char *fmt, uint64_t size);
+
+private:
+    struct Cached
+    {
+        std::string fmt;
+        std::vector<Piece> pieces;
+        uint64_t args;
+    };
+
+    bool format(core::VM *vm);
+    const Cached &get(uint64_t addr, core::StringRef fmt);
+
+    static void render(core::VM *vm, std::string &res, const Spec &spec,
+        uint8_t reg);
+
+    std::unordered_map<uint64_t, Cached> m_cache;
+};
+
+}
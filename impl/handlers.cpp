@@ -0,0 +1,11 @@
+#include "handlers.hh"
+
+using impl::Handlers;
+
+Handlers::Handlers(core::VM *vm, const std::string &snapshot) :
+    m_nopstop(vm), m_ints(vm), m_strs(vm), m_random(vm), m_jump(vm),
+    m_mov(vm), m_heap(vm), m_floats(vm), m_vectors(vm), m_arrays(vm),
+    m_sort(vm), m_hash(vm), m_maps(vm), m_format(vm),
+    m_snapshots(vm, snapshot)
+{
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "vm.hh"
+#include "nopstop.hh"
+#include "ints.hh"
+#include "strs.hh"
+#include "random.hh"
+#include "jump.hh"
+#include "mov.hh"
+#include "heap.hh"
+#include "floats.hh"
+#include "vectors.hh"
+#include "arrays.hh"
+#include "sort.hh"
+#include "hash.hh"
+#include "maps.hh"
+#include "format.hh"
+#include "snapshots.hh"
+#include <string>
+
+namespace impl
+{
+
+/* All instruction handlers registered to one VM. Some keep state, like
+ * FORMAT cache, so the object lives as long as the VM and goes with it
+ * from one run to the next.
+ */
+class Handlers
+{
+public:
+    Handlers(core::VM *vm, const std::string &snapshot = "");
+
+private:
+    NopStop m_nopstop;
+    Ints m_ints;
+    Strs m_strs;
+    Random m_random;
+    Jump m_jump;
+    Mov m_mov;
+    Heap m_heap;
+    Floats m_floats;
+    Vectors m_vectors;
+    Arrays m_arrays;
+    Sort m_sort;
+    Hash m_hash;
+    Maps m_maps;
+    Format m_format;
+    Snapshots m_snapshots;
+};
+
+}
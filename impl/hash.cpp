@@ -0,0 +1,205 @@
+#include "hash.hh"
+#include "crc.hh"
+#include "opcodes.hh"
+#include "simd.hh"
+#include <iostream>
+
+#ifdef MINVM_X86
+#include <immintrin.h>
+#endif
+
+using core::VM;
+using impl::Opcode;
+using impl::Hash;
+using impl::Simd;
+
+static uint32_t read32(const uint8_t *ptr)
+{
+    return (uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8)
+        | ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+static uint64_t read64(const uint8_t *ptr)
+{
+    return (uint64_t)read32(ptr) | ((uint64_t)read32(ptr + 4) << 32);
+}
+
+#ifdef MINVM_X86
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const uint8_t *data, uint64_t len)
+{
+    uint64_t acc = ~crc;
+    while (len >= 8) {
+        acc = _mm_crc32_u64(acc, read64(data));
+        data += 8;
+        len -= 8;
+    }
+    uint32_t res = acc;
+    while (len-- > 0)
+        res = _mm_crc32_u8(res, *data++);
+    return ~res;
+}
+#endif
+
+bool Hash::hardware_crc()
+{
+    return Simd::sse42();
+}
+
+uint32_t Hash::crc32c(uint32_t crc, const uint8_t *data, uint64_t len)
+{
+#ifdef MINVM_X86
+    if (hardware_crc())
+        return crc32c_sse42(crc, data, len);
+#endif
+    static const core::Crc tables(0x82f63b78);
+    return tables.update(crc, data, len);
+}
+
+uint32_t Hash::crc32(uint32_t crc, const uint8_t *data, uint64_t len)
+{
+    static const core::Crc tables(0xedb88320);
+    return tables.update(crc, data, len);
+}
+
+static const uint64_t prime1 = 0x9e3779b185ebca87ULL;
+static const uint64_t prime2 = 0xc2b2ae3d27d4eb4fULL;
+static const uint64_t prime3 = 0x165667b19e3779f9ULL;
+static const uint64_t prime4 = 0x85ebca77c2b2ae63ULL;
+static const uint64_t prime5 = 0x27d4eb2f165667c5ULL;
+
+static inline uint64_t rotl(uint64_t val, int bits)
+{
+    return (val << bits) | (val >> (64 - bits));
+}
+
+static inline uint64_t xx_round(uint64_t acc, uint64_t input)
+{
+    acc += input * prime2;
+    return rotl(acc, 31) * prime1;
+}
+
+static inline uint64_t xx_merge(uint64_t acc, uint64_t val)
+{
+    acc ^= xx_round(0, val);
+    return acc * prime1 + prime4;
+}
+
+uint64_t Hash::xxhash64(const uint8_t *data, uint64_t len, uint64_t seed)
+{
+    const uint8_t *end = data + len;
+    uint64_t res;
+
+    if (len >= 32) {
+        uint64_t v1 = seed + prime1 + prime2;
+        uint64_t v2 = seed + prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - prime1;
+        while (end - data >= 32) {
+            v1 = xx_round(v1, read64(data));
+            v2 = xx_round(v2, read64(data + 8));
+            v3 = xx_round(v3, read64(data + 16));
+            v4 = xx_round(v4, read64(data + 24));
+            data += 32;
+        }
+        res = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        res = xx_merge(res, v1);
+        res = xx_merge(res, v2);
+        res = xx_merge(res, v3);
+        res = xx_merge(res, v4);
+    } else {
+        res = seed + prime5;
+    }
+    res += len;
+
+    while (end - data >= 8) {
+        res ^= xx_round(0, read64(data));
+        res = rotl(res, 27) * prime1 + prime4;
+        data += 8;
+    }
+    if (end - data >= 4) {
+        res ^= (uint64_t)read32(data) * prime1;
+        res = rotl(res, 23) * prime2 + prime3;
+        data += 4;
+    }
+    while (data < end) {
+        res ^= *data++ * prime5;
+        res = rotl(res, 11) * prime1;
+    }
+
+    res ^= res >> 33;
+    res *= prime2;
+    res ^= res >> 29;
+    res *= prime3;
+    res ^= res >> 32;
+    return res;
+}
+
+static const uint8_t *get_range(VM *vm, uint8_t base, uint8_t len,
+    uint64_t &size)
+{
+    size = (len>0xf)?(len>>4):vm->regs().get_int(len);
+    if (size == 0)
+        return nullptr;
+    return vm->heap_read(vm->regs().get_int(base), size);
+}
+
+Hash::Hash(VM *vm)
+{
+    vm->opcode(Opcode::CRC(), Hash::crc);
+    vm->opcode(Opcode::HASH(), Hash::hash);
+}
+
+bool Hash::crc(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "CRC\n";
+    uint8_t reg = vm->fetch8();
+    uint8_t algo = vm->fetch8();
+    uint8_t base = vm->fetch8();
+    uint8_t len = vm->fetch8();
+
+    uint64_t size;
+    const uint8_t *data = get_range(vm, base, len, size);
+    uint32_t val = vm->regs().get_int(reg);
+    switch ((Crc)algo) {
+        case Crc::Crc32C:
+            val = crc32c(val, data, size);
+            break;
+        case Crc::Crc32:
+            val = crc32(val, data, size);
+            break;
+        default:
+            throw std::string("Invalid CRC algorithm: ")
+                + std::to_string((int)algo);
+    }
+    vm->regs().put_int(reg, val);
+
+    return true;
+}
+
+bool Hash::hash(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "HASH\n";
+    uint8_t reg = vm->fetch8();
+    uint8_t algo = vm->fetch8();
+    uint8_t base = vm->fetch8();
+    uint8_t len = vm->fetch8();
+
+    uint64_t size;
+    const uint8_t *data = get_range(vm, base, len, size);
+    uint64_t val;
+    switch ((Algo)algo) {
+        case Algo::XxHash64:
+            val = xxhash64(data, size, 0);
+            break;
+        case Algo::XxHash64Seed:
+            val = xxhash64(data, size, vm->regs().get_int(reg));
+            break;
+        default:
+            throw std::string("Invalid hash algorithm: ")
+                + std::to_string((int)algo);
+    }
+    vm->regs().put_int(reg, val);
+
+    return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "vm.hh"
+
+namespace impl
+{
+
+/* Checksums and hashes over heap byte ranges.
+ *
+ * Both opcodes take destination register, algorithm byte, base
+ * address and length registers. CRC is streaming: destination holds
+ * running value, zero to start, and same result comes from one call
+ * over whole range as from calls over consecutive parts of it.
+ * CRC32C uses SSE4.2 instruction when CPU has it and Simd isa is not
+ * forced to generic, other variants use slicing-by-8 tables.
+ */
+class Hash
+{
+public:
+    enum class Crc : uint8_t
+    {
+        Crc32C = 0,     // Castagnoli, as in iSCSI and ext4
+        Crc32           // IEEE, as in zlib and PNG
+    };
+
+    enum class Algo : uint8_t
+    {
+        XxHash64 = 0,   // Seed zero
+        XxHash64Seed    // Seed from destination register, for chaining
+    };
+
+    Hash(core::VM *vm);
+
+    static uint32_t crc32c(uint32_t crc, const uint8_t *data, uint64_t len);
+    static uint32_t crc32(uint32_t crc, const uint8_t *data, uint64_t len);
+    static uint64_t xxhash64(const uint8_t *data, uint64_t len, uint64_t seed);
+
+    /* True when crc32c() runs on SSE4.2 instruction */
+    static bool hardware_crc();
+
+private:
+    static bool crc(core::VM *vm);
+    static bool hash(core::VM *vm);
+};
+
+}
@@ -10,6 +10,7 @@ Ints::Ints(VM *vm)
 {
     vm->opcode(Opcode::LOAD_INT(), Ints::load_int);
     vm->opcode(Opcode::LOAD_INT_MEM(), Ints::load_int_mem);
+    vm->opcode(Opcode::STORE_INT(), Ints::store_int);
 
     vm->opcode(Opcode::LOAD_INT8(), Ints::load_int8);
     vm->opcode(Opcode::LOAD_INT16(), Ints::load_int16);
@@ -26,6 +27,44 @@ Ints::Ints(VM *vm)
     vm->opcode(Opcode::DIV_INT(), Ints::div_int);
     vm->opcode(Opcode::MOD_INT(), Ints::mod_int);
 
+    vm->opcode(Opcode::ADD_IMM(), Ints::add_imm);
+    vm->opcode(Opcode::SUB_IMM(), Ints::sub_imm);
+    vm->opcode(Opcode::MUL_IMM(), Ints::mul_imm);
+    vm->opcode(Opcode::DIV_IMM(), Ints::div_imm);
+    vm->opcode(Opcode::MOD_IMM(), Ints::mod_imm);
+
+    vm->opcode(Opcode::AND_INT(), Ints::alu_int<Ints::bit_and>);
+    vm->opcode(Opcode::OR_INT(), Ints::alu_int<Ints::bit_or>);
+    vm->opcode(Opcode::XOR_INT(), Ints::alu_int<Ints::bit_xor>);
+    vm->opcode(Opcode::SHL_INT(), Ints::alu_int<Ints::shl>);
+    vm->opcode(Opcode::SHR_INT(), Ints::alu_int<Ints::shr>);
+    vm->opcode(Opcode::SAR_INT(), Ints::alu_int<Ints::sar>);
+    vm->opcode(Opcode::ROL_INT(), Ints::alu_int<Ints::rol>);
+    vm->opcode(Opcode::ROR_INT(), Ints::alu_int<Ints::ror>);
+
+    vm->opcode(Opcode::AND_IMM(), Ints::alu_imm<Ints::bit_and>);
+    vm->opcode(Opcode::OR_IMM(), Ints::alu_imm<Ints::bit_or>);
+    vm->opcode(Opcode::XOR_IMM(), Ints::alu_imm<Ints::bit_xor>);
+    vm->opcode(Opcode::SHL_IMM(), Ints::alu_imm<Ints::shl>);
+    vm->opcode(Opcode::SHR_IMM(), Ints::alu_imm<Ints::shr>);
+    vm->opcode(Opcode::SAR_IMM(), Ints::alu_imm<Ints::sar>);
+    vm->opcode(Opcode::ROL_IMM(), Ints::alu_imm<Ints::rol>);
+    vm->opcode(Opcode::ROR_IMM(), Ints::alu_imm<Ints::ror>);
+
+    vm->opcode(Opcode::NOT_INT(), Ints::alu_unary<Ints::bit_not>);
+    vm->opcode(Opcode::POPCNT(), Ints::alu_unary<Ints::popcnt>);
+    vm->opcode(Opcode::CLZ(), Ints::alu_unary<Ints::clz>);
+    vm->opcode(Opcode::CTZ(), Ints::alu_unary<Ints::ctz>);
+
+    vm->opcode(Opcode::IDIV_INT(), Ints::alu_int<Ints::idiv>);
+    vm->opcode(Opcode::IMOD_INT(), Ints::alu_int<Ints::imod>);
+    vm->opcode(Opcode::IDIV_IMM(), Ints::alu_simm<Ints::idiv>);
+    vm->opcode(Opcode::IMOD_IMM(), Ints::alu_simm<Ints::imod>);
+
+    vm->opcode(Opcode::MULH_INT(), Ints::alu_int<Ints::mulh>);
+    vm->opcode(Opcode::UMULH_INT(), Ints::alu_int<Ints::umulh>);
+    vm->opcode(Opcode::DIV128(), Ints::div128);
+
     vm->opcode(Opcode::PRINT_INT(), Ints::print_int);
 }
 
@@ -78,6 +117,30 @@ bool Ints::load_int_mem(core::VM *vm)
     return true;
 }
 
+bool Ints::store_int(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "STORE_INT\n";
+
+    uint8_t reg1 = vm->fetch8();
+    uint8_t size = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+    if (size > 8)
+        throw std::string("Invalid size: ") + std::to_string((int)size);
+
+    uint64_t val = (reg1>0xf)?(reg1>>4):vm->regs().get_int(reg1);
+    uint64_t pos = vm->regs().get_int(reg2);
+    if (size == 0)
+        return true;
+
+    uint8_t *dst = vm->heap_range(pos, size);
+    for (uint8_t cnt = size; cnt > 0; --cnt) {
+        dst[cnt - 1] = val & 0xff;
+        val >>= 8;
+    }
+
+    return true;
+}
+
 bool Ints::load_int8(VM *vm)
 {
     if (vm->debug()) std::cerr << "LOAD_INT8\n";
@@ -235,10 +298,274 @@ bool Ints::mod_int(core::VM *vm)
     return true;
 }
 
+bool Ints::add_imm(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "ADD_IMM\n";
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+    uint8_t size = vm->fetch8();
+
+    uint64_t val1 = (reg2>0xf)?(reg2>>4):vm->regs().get_int(reg2);
+    uint64_t val2 = vm->fetch_int(size);
+
+    vm->regs().put_int(reg1, val1 + val2);
+
+    return true;
+}
+
+bool Ints::sub_imm(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "SUB_IMM\n";
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+    uint8_t size = vm->fetch8();
+
+    uint64_t val1 = (reg2>0xf)?(reg2>>4):vm->regs().get_int(reg2);
+    uint64_t val2 = vm->fetch_int(size);
+
+    vm->regs().put_int(reg1, val1 - val2);
+
+    return true;
+}
+
+bool Ints::mul_imm(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "MUL_IMM\n";
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+    uint8_t size = vm->fetch8();
+
+    uint64_t val1 = (reg2>0xf)?(reg2>>4):vm->regs().get_int(reg2);
+    uint64_t val2 = vm->fetch_int(size);
+
+    vm->regs().put_int(reg1, val1 * val2);
+
+    return true;
+}
+
+bool Ints::div_imm(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "DIV_IMM\n";
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+    uint8_t size = vm->fetch8();
+
+    uint64_t val1 = (reg2>0xf)?(reg2>>4):vm->regs().get_int(reg2);
+    uint64_t val2 = vm->fetch_int(size);
+
+    if (val2 == 0)
+        throw std::string("Divide by zero!");
+
+    vm->regs().put_int(reg1, val1 / val2);
+
+    return true;
+}
+
+bool Ints::mod_imm(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "MOD_IMM\n";
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+    uint8_t size = vm->fetch8();
+
+    uint64_t val1 = (reg2>0xf)?(reg2>>4):vm->regs().get_int(reg2);
+    uint64_t val2 = vm->fetch_int(size);
+
+    if (val2 == 0)
+        throw std::string("Divide by zero!");
+
+    vm->regs().put_int(reg1, val1 % val2);
+
+    return true;
+}
+
+uint64_t Ints::bit_and(uint64_t val1, uint64_t val2)
+{
+    return val1 & val2;
+}
+
+uint64_t Ints::bit_or(uint64_t val1, uint64_t val2)
+{
+    return val1 | val2;
+}
+
+uint64_t Ints::bit_xor(uint64_t val1, uint64_t val2)
+{
+    return val1 ^ val2;
+}
+
+uint64_t Ints::shl(uint64_t val1, uint64_t val2)
+{
+    return val1 << (val2 & 63);
+}
+
+uint64_t Ints::shr(uint64_t val1, uint64_t val2)
+{
+    return val1 >> (val2 & 63);
+}
+
+uint64_t Ints::sar(uint64_t val1, uint64_t val2)
+{
+    return static_cast<uint64_t>(static_cast<int64_t>(val1) >> (val2 & 63));
+}
+
+uint64_t Ints::rol(uint64_t val1, uint64_t val2)
+{
+    // Recognized by compilers as single rotate instruction
+    val2 &= 63;
+    return (val1 << val2) | (val1 >> ((64 - val2) & 63));
+}
+
+uint64_t Ints::ror(uint64_t val1, uint64_t val2)
+{
+    val2 &= 63;
+    return (val1 >> val2) | (val1 << ((64 - val2) & 63));
+}
+
+uint64_t Ints::bit_not(uint64_t val)
+{
+    return ~val;
+}
+
+uint64_t Ints::popcnt(uint64_t val)
+{
+    return __builtin_popcountll(val);
+}
+
+uint64_t Ints::clz(uint64_t val)
+{
+    return val ? __builtin_clzll(val) : 64;
+}
+
+uint64_t Ints::ctz(uint64_t val)
+{
+    return val ? __builtin_ctzll(val) : 64;
+}
+
+uint64_t Ints::idiv(uint64_t val1, uint64_t val2)
+{
+    if (val2 == 0)
+        throw std::string("Divide by zero!");
+    if (val2 == static_cast<uint64_t>(-1))
+        return -val1;
+    return static_cast<int64_t>(val1) / static_cast<int64_t>(val2);
+}
+
+uint64_t Ints::imod(uint64_t val1, uint64_t val2)
+{
+    if (val2 == 0)
+        throw std::string("Divide by zero!");
+    if (val2 == static_cast<uint64_t>(-1))
+        return 0;
+    return static_cast<int64_t>(val1) % static_cast<int64_t>(val2);
+}
+
+uint64_t Ints::mulh(uint64_t val1, uint64_t val2)
+{
+    __int128 res = static_cast<__int128>(static_cast<int64_t>(val1))
+        * static_cast<int64_t>(val2);
+    return static_cast<uint64_t>(res >> 64);
+}
+
+uint64_t Ints::umulh(uint64_t val1, uint64_t val2)
+{
+    unsigned __int128 res = static_cast<unsigned __int128>(val1) * val2;
+    return static_cast<uint64_t>(res >> 64);
+}
+
+template<uint64_t (*Op)(uint64_t, uint64_t)>
+bool Ints::alu_int(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "ALU_INT\n";
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+    uint8_t reg3 = vm->fetch8();
+
+    uint64_t val1 = (reg2>0xf)?(reg2>>4):vm->regs().get_int(reg2);
+    uint64_t val2 = (reg3>0xf)?(reg3>>4):vm->regs().get_int(reg3);
+
+    vm->regs().put_int(reg1, Op(val1, val2));
+
+    return true;
+}
+
+template<uint64_t (*Op)(uint64_t, uint64_t)>
+bool Ints::alu_imm(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "ALU_IMM\n";
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+    uint8_t size = vm->fetch8();
+
+    uint64_t val1 = (reg2>0xf)?(reg2>>4):vm->regs().get_int(reg2);
+    uint64_t val2 = vm->fetch_int(size);
+
+    vm->regs().put_int(reg1, Op(val1, val2));
+
+    return true;
+}
+
+template<uint64_t (*Op)(uint64_t, uint64_t)>
+bool Ints::alu_simm(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "ALU_SIMM\n";
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+    uint8_t size = vm->fetch8();
+
+    uint64_t val1 = (reg2>0xf)?(reg2>>4):vm->regs().get_int(reg2);
+    uint64_t val2 = vm->fetch_sint(size);
+
+    vm->regs().put_int(reg1, Op(val1, val2));
+
+    return true;
+}
+
+template<uint64_t (*Op)(uint64_t)>
+bool Ints::alu_unary(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "ALU_UNARY\n";
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+
+    uint64_t val = (reg2>0xf)?(reg2>>4):vm->regs().get_int(reg2);
+
+    vm->regs().put_int(reg1, Op(val));
+
+    return true;
+}
+
+bool Ints::div128(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "DIV128\n";
+    uint8_t quot = vm->fetch8();
+    uint8_t rem = vm->fetch8();
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+    uint8_t reg3 = vm->fetch8();
+
+    uint64_t high = (reg1>0xf)?(reg1>>4):vm->regs().get_int(reg1);
+    uint64_t low = (reg2>0xf)?(reg2>>4):vm->regs().get_int(reg2);
+    uint64_t div = (reg3>0xf)?(reg3>>4):vm->regs().get_int(reg3);
+
+    if (div == 0)
+        throw std::string("Divide by zero!");
+    // Quotient has to fit in 64 bits
+    if (high >= div)
+        throw std::string("Divide overflow!");
+
+    unsigned __int128 val = (static_cast<unsigned __int128>(high) << 64) | low;
+
+    vm->regs().put_int(quot, static_cast<uint64_t>(val / div));
+    vm->regs().put_int(rem, static_cast<uint64_t>(val % div));
+
+    return true;
+}
+
 bool Ints::print_int(VM *vm)
 {
     if (vm->debug()) std::cerr << "PRINT_INT\n";
     uint8_t reg = vm->fetch8();
-    std::cout << vm->regs().get_int(reg);
+    vm->output().write_int(vm->regs().get_int(reg));
     return true;
 }
@@ -10,6 +10,32 @@ class Ints
 public:
     Ints(core::VM *vm);
 
+    /* Bit operations, shared with constant folding. Shift and rotate
+     * counts are taken modulo 64, CLZ and CTZ of zero are 64.
+     */
+    static uint64_t bit_and(uint64_t val1, uint64_t val2);
+    static uint64_t bit_or(uint64_t val1, uint64_t val2);
+    static uint64_t bit_xor(uint64_t val1, uint64_t val2);
+    static uint64_t shl(uint64_t val1, uint64_t val2);
+    static uint64_t shr(uint64_t val1, uint64_t val2);
+    static uint64_t sar(uint64_t val1, uint64_t val2);
+    static uint64_t rol(uint64_t val1, uint64_t val2);
+    static uint64_t ror(uint64_t val1, uint64_t val2);
+
+    static uint64_t bit_not(uint64_t val);
+    static uint64_t popcnt(uint64_t val);
+    static uint64_t clz(uint64_t val);
+    static uint64_t ctz(uint64_t val);
+
+    /* Signed division rounds towards zero, and overflow of the most
+     * negative value divided by -1 wraps around. High half of 128-bit
+     * product is returned by MULH (signed) and UMULH (unsigned).
+     */
+    static uint64_t idiv(uint64_t val1, uint64_t val2);
+    static uint64_t imod(uint64_t val1, uint64_t val2);
+    static uint64_t mulh(uint64_t val1, uint64_t val2);
+    static uint64_t umulh(uint64_t val1, uint64_t val2);
+
 private:
     static bool load_int8(core::VM *vm);
     static bool load_int16(core::VM *vm);
@@ -18,6 +44,7 @@ private:
 
     static bool load_int(core::VM *vm);
     static bool load_int_mem(core::VM *vm);
+    static bool store_int(core::VM *vm);
 
     static bool inc_int(core::VM *vm);
     static bool dec_int(core::VM *vm);
@@ -28,6 +55,23 @@ private:
     static bool div_int(core::VM *vm);
     static bool mod_int(core::VM *vm);
 
+    static bool add_imm(core::VM *vm);
+    static bool sub_imm(core::VM *vm);
+    static bool mul_imm(core::VM *vm);
+    static bool div_imm(core::VM *vm);
+    static bool mod_imm(core::VM *vm);
+
+    template<uint64_t (*Op)(uint64_t, uint64_t)>
+    static bool alu_int(core::VM *vm);
+    template<uint64_t (*Op)(uint64_t, uint64_t)>
+    static bool alu_imm(core::VM *vm);
+    template<uint64_t (*Op)(uint64_t, uint64_t)>
+    static bool alu_simm(core::VM *vm);
+    template<uint64_t (*Op)(uint64_t)>
+    static bool alu_unary(core::VM *vm);
+
+    static bool div128(core::VM *vm);
+
     static bool print_int(core::VM *vm);
 };
 
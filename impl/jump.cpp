@@ -1,11 +1,26 @@
 #include "jump.hh"
 #include "opcodes.hh"
+#include <functional>
 #include <iostream>
 
 using core::VM;
 using core::Opcode;
 using impl::Jump;
 
+/* Compares operands as two's complement signed values
+ */
+template<typename Compare>
+class Signed
+{
+public:
+    bool operator()(uint64_t val1, uint64_t val2) const
+    {
+        return Compare()(
+            static_cast<int64_t>(val1),
+            static_cast<int64_t>(val2));
+    }
+};
+
 Jump::Jump(VM *vm)
 {
     vm->opcode(Opcode::JMP8(), Jump::jump8);
@@ -19,6 +34,84 @@ Jump::Jump(VM *vm)
     vm->opcode(Opcode::JMP_LE32(), Jump::jump_le32);
     vm->opcode(Opcode::JMP_LE64(), Jump::jump_le64);
     vm->opcode(Opcode::JMP_LE_INT(), Jump::jump_le_int);
+
+    vm->opcode(Opcode::JMP_LE_IMM8(), Jump::jump_le_imm8);
+    vm->opcode(Opcode::JMP_LE_IMM16(), Jump::jump_le_imm16);
+    vm->opcode(Opcode::JMP_LE_IMM32(), Jump::jump_le_imm32);
+
+    typedef std::equal_to<uint64_t> eq;
+    typedef std::not_equal_to<uint64_t> ne;
+    typedef std::less<uint64_t> lt;
+    typedef std::greater<uint64_t> gt;
+    typedef std::less_equal<uint64_t> le;
+    typedef std::greater_equal<uint64_t> ge;
+
+    vm->opcode(Opcode::JEQ8(), Jump::jump_cmp<eq, int8_t>);
+    vm->opcode(Opcode::JNE8(), Jump::jump_cmp<ne, int8_t>);
+    vm->opcode(Opcode::JLT8(), Jump::jump_cmp<lt, int8_t>);
+    vm->opcode(Opcode::JGT8(), Jump::jump_cmp<gt, int8_t>);
+    vm->opcode(Opcode::JLE8(), Jump::jump_cmp<le, int8_t>);
+    vm->opcode(Opcode::JGE8(), Jump::jump_cmp<ge, int8_t>);
+
+    vm->opcode(Opcode::JEQ32(), Jump::jump_cmp<eq, int32_t>);
+    vm->opcode(Opcode::JNE32(), Jump::jump_cmp<ne, int32_t>);
+    vm->opcode(Opcode::JLT32(), Jump::jump_cmp<lt, int32_t>);
+    vm->opcode(Opcode::JGT32(), Jump::jump_cmp<gt, int32_t>);
+    vm->opcode(Opcode::JLE32(), Jump::jump_cmp<le, int32_t>);
+    vm->opcode(Opcode::JGE32(), Jump::jump_cmp<ge, int32_t>);
+
+    vm->opcode(Opcode::JEQ_IMM8(), Jump::jump_cmp_imm<eq, int8_t>);
+    vm->opcode(Opcode::JNE_IMM8(), Jump::jump_cmp_imm<ne, int8_t>);
+    vm->opcode(Opcode::JLT_IMM8(), Jump::jump_cmp_imm<lt, int8_t>);
+    vm->opcode(Opcode::JGT_IMM8(), Jump::jump_cmp_imm<gt, int8_t>);
+    vm->opcode(Opcode::JLE_IMM8(), Jump::jump_cmp_imm<le, int8_t>);
+    vm->opcode(Opcode::JGE_IMM8(), Jump::jump_cmp_imm<ge, int8_t>);
+
+    vm->opcode(Opcode::JEQ_IMM32(), Jump::jump_cmp_imm<eq, int32_t>);
+    vm->opcode(Opcode::JNE_IMM32(), Jump::jump_cmp_imm<ne, int32_t>);
+    vm->opcode(Opcode::JLT_IMM32(), Jump::jump_cmp_imm<lt, int32_t>);
+    vm->opcode(Opcode::JGT_IMM32(), Jump::jump_cmp_imm<gt, int32_t>);
+    vm->opcode(Opcode::JLE_IMM32(), Jump::jump_cmp_imm<le, int32_t>);
+    vm->opcode(Opcode::JGE_IMM32(), Jump::jump_cmp_imm<ge, int32_t>);
+
+    typedef Signed<std::less<int64_t>> slt;
+    typedef Signed<std::greater<int64_t>> sgt;
+    typedef Signed<std::less_equal<int64_t>> sle;
+    typedef Signed<std::greater_equal<int64_t>> sge;
+
+    vm->opcode(Opcode::JSLT8(), Jump::jump_cmp<slt, int8_t>);
+    vm->opcode(Opcode::JSGT8(), Jump::jump_cmp<sgt, int8_t>);
+    vm->opcode(Opcode::JSLE8(), Jump::jump_cmp<sle, int8_t>);
+    vm->opcode(Opcode::JSGE8(), Jump::jump_cmp<sge, int8_t>);
+
+    vm->opcode(Opcode::JSLT32(), Jump::jump_cmp<slt, int32_t>);
+    vm->opcode(Opcode::JSGT32(), Jump::jump_cmp<sgt, int32_t>);
+    vm->opcode(Opcode::JSLE32(), Jump::jump_cmp<sle, int32_t>);
+    vm->opcode(Opcode::JSGE32(), Jump::jump_cmp<sge, int32_t>);
+
+    vm->opcode(Opcode::JSLT_IMM8(), Jump::jump_cmp_imm<slt, int8_t, true>);
+    vm->opcode(Opcode::JSGT_IMM8(), Jump::jump_cmp_imm<sgt, int8_t, true>);
+    vm->opcode(Opcode::JSLE_IMM8(), Jump::jump_cmp_imm<sle, int8_t, true>);
+    vm->opcode(Opcode::JSGE_IMM8(), Jump::jump_cmp_imm<sge, int8_t, true>);
+
+    vm->opcode(Opcode::JSLT_IMM32(), Jump::jump_cmp_imm<slt, int32_t, true>);
+    vm->opcode(Opcode::JSGT_IMM32(), Jump::jump_cmp_imm<sgt, int32_t, true>);
+    vm->opcode(Opcode::JSLE_IMM32(), Jump::jump_cmp_imm<sle, int32_t, true>);
+    vm->opcode(Opcode::JSGE_IMM32(), Jump::jump_cmp_imm<sge, int32_t, true>);
+
+    vm->opcode(Opcode::LOOP_INC8(), Jump::loop<true, int8_t>);
+    vm->opcode(Opcode::LOOP_INC16(), Jump::loop<true, int16_t>);
+    vm->opcode(Opcode::LOOP_INC32(), Jump::loop<true, int32_t>);
+    vm->opcode(Opcode::LOOP_DEC8(), Jump::loop<false, int8_t>);
+    vm->opcode(Opcode::LOOP_DEC16(), Jump::loop<false, int16_t>);
+    vm->opcode(Opcode::LOOP_DEC32(), Jump::loop<false, int32_t>);
+
+    vm->opcode(Opcode::LOOP_INC_IMM8(), Jump::loop_imm<true, int8_t>);
+    vm->opcode(Opcode::LOOP_INC_IMM16(), Jump::loop_imm<true, int16_t>);
+    vm->opcode(Opcode::LOOP_INC_IMM32(), Jump::loop_imm<true, int32_t>);
+    vm->opcode(Opcode::LOOP_DEC_IMM8(), Jump::loop_imm<false, int8_t>);
+    vm->opcode(Opcode::LOOP_DEC_IMM16(), Jump::loop_imm<false, int16_t>);
+    vm->opcode(Opcode::LOOP_DEC_IMM32(), Jump::loop_imm<false, int32_t>);
 }
 
 bool Jump::conditional(
@@ -27,6 +120,11 @@ bool Jump::conditional(
     uint64_t val1 = (reg1>0xf)?(reg1>>4):vm->regs().get_int(reg1);
     uint64_t val2 = (reg2>0xf)?(reg2>>4):vm->regs().get_int(reg2);
 
+    return compare(algo, val1, val2);
+}
+
+bool Jump::compare(uint8_t algo, uint64_t val1, uint64_t val2)
+{
     switch (algo) {
         case 0: return val1 == val2;
         case 1: return val1 < val2;
@@ -44,11 +142,27 @@ bool Jump::conditional(
         case 13: return ~val1 && val2;
         case 14: return val1 ^ val2;
         case 15: return val1 % val2;
+        case 16: return Signed<std::less<int64_t>>()(val1, val2);
+        case 17: return Signed<std::greater<int64_t>>()(val1, val2);
+        case 18: return Signed<std::less_equal<int64_t>>()(val1, val2);
+        case 19: return Signed<std::greater_equal<int64_t>>()(val1, val2);
         default:
             throw std::string("Invalid comparison in jump");
     }
 }
 
+bool Jump::conditional_imm(core::VM *vm)
+{
+    uint8_t algo = vm->fetch8();
+    uint8_t reg1 = vm->fetch8();
+    uint8_t size = vm->fetch8();
+
+    uint64_t val1 = (reg1>0xf)?(reg1>>4):vm->regs().get_int(reg1);
+    uint64_t val2 = vm->fetch_int(size);
+
+    return compare(algo, val1, val2);
+}
+
 void Jump::jump_conditional(
     core::VM *vm, uint64_t addr, bool cond)
 {
@@ -264,3 +378,151 @@ bool Jump::jump_le_int(core::VM *vm)
 
     return true;
 }
+
+bool Jump::jump_le_imm8(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "JUMP_LE_IMM8\n";
+
+    bool cond = conditional_imm(vm);
+
+    uint64_t pos = vm->regs().pc();
+    int8_t diff = vm->fetch8();
+
+    jump_conditional(
+        vm,
+        pos + diff,
+        cond);
+
+    return true;
+}
+
+bool Jump::jump_le_imm16(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "JUMP_LE_IMM16\n";
+
+    bool cond = conditional_imm(vm);
+
+    uint64_t pos = vm->regs().pc();
+    int16_t diff = static_cast<int16_t>(vm->fetch_int(2));
+
+    jump_conditional(
+        vm,
+        pos + diff,
+        cond);
+
+    return true;
+}
+
+bool Jump::jump_le_imm32(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "JUMP_LE_IMM32\n";
+
+    bool cond = conditional_imm(vm);
+
+    uint64_t pos = vm->regs().pc();
+    int32_t diff = static_cast<int32_t>(vm->fetch_int(4));
+
+    jump_conditional(
+        vm,
+        pos + diff,
+        cond);
+
+    return true;
+}
+
+template<typename Compare, typename Diff>
+bool Jump::jump_cmp(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "JUMP_CMP" << sizeof(Diff) * 8 << "\n";
+
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+    uint64_t val1 = (reg1>0xf)?(reg1>>4):vm->regs().get_int(reg1);
+    uint64_t val2 = (reg2>0xf)?(reg2>>4):vm->regs().get_int(reg2);
+
+    uint64_t pos = vm->regs().pc();
+    Diff diff = static_cast<Diff>(vm->fetch_int(sizeof(Diff)));
+
+    jump_conditional(
+        vm,
+        pos + diff,
+        Compare()(val1, val2));
+
+    return true;
+}
+
+template<typename Compare, typename Diff, bool Sign>
+bool Jump::jump_cmp_imm(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "JUMP_CMP_IMM" << sizeof(Diff) * 8 << "\n";
+
+    uint8_t reg1 = vm->fetch8();
+    uint8_t size = vm->fetch8();
+    uint64_t val1 = (reg1>0xf)?(reg1>>4):vm->regs().get_int(reg1);
+    uint64_t val2 = Sign ? vm->fetch_sint(size) : vm->fetch_int(size);
+
+    uint64_t pos = vm->regs().pc();
+    Diff diff = static_cast<Diff>(vm->fetch_int(sizeof(Diff)));
+
+    jump_conditional(
+        vm,
+        pos + diff,
+        Compare()(val1, val2));
+
+    return true;
+}
+
+template<bool Inc>
+uint64_t Jump::loop_step(core::VM *vm, uint8_t reg)
+{
+    uint64_t val = vm->regs().get_int(reg);
+    val = Inc ? val + 1 : val - 1;
+    vm->regs().put_int(reg, val);
+    return val;
+}
+
+template<bool Inc, typename Diff>
+bool Jump::loop(core::VM *vm)
+{
+    if (vm->debug())
+        std::cerr << (Inc ? "LOOP_INC" : "LOOP_DEC") << sizeof(Diff) * 8 << "\n";
+
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+
+    uint64_t val = loop_step<Inc>(vm, reg1);
+    uint64_t bound = (reg2>0xf)?(reg2>>4):vm->regs().get_int(reg2);
+
+    uint64_t pos = vm->regs().pc();
+    Diff diff = static_cast<Diff>(vm->fetch_int(sizeof(Diff)));
+
+    jump_conditional(
+        vm,
+        pos + diff,
+        Inc ? val < bound : val > bound);
+
+    return true;
+}
+
+template<bool Inc, typename Diff>
+bool Jump::loop_imm(core::VM *vm)
+{
+    if (vm->debug())
+        std::cerr << (Inc ? "LOOP_INC_IMM" : "LOOP_DEC_IMM") << sizeof(Diff) * 8 << "\n";
+
+    uint8_t reg1 = vm->fetch8();
+    uint8_t size = vm->fetch8();
+
+    uint64_t bound = vm->fetch_int(size);
+    uint64_t val = loop_step<Inc>(vm, reg1);
+
+    uint64_t pos = vm->regs().pc();
+    Diff diff = static_cast<Diff>(vm->fetch_int(sizeof(Diff)));
+
+    jump_conditional(
+        vm,
+        pos + diff,
+        Inc ? val < bound : val > bound);
+
+    return true;
+}
@@ -10,6 +10,8 @@ class Jump
 public:
     Jump(core::VM *vm);
 
+    static bool compare(uint8_t algo, uint64_t val1, uint64_t val2);
+
 private:
     static bool jump8(core::VM *vm);
     static bool jump16(core::VM *vm);
@@ -23,6 +25,30 @@ private:
     static bool jump_le64(core::VM *vm);
     static bool jump_le_int(core::VM *vm);
 
+    static bool jump_le_imm8(core::VM *vm);
+    static bool jump_le_imm16(core::VM *vm);
+    static bool jump_le_imm32(core::VM *vm);
+
+    static bool conditional_imm(core::VM *vm);
+
+    /* Comparison is part of the opcode, no operator byte.
+     * Immediate of signed comparison is sign extended.
+     */
+    template<typename Compare, typename Diff>
+    static bool jump_cmp(core::VM *vm);
+    template<typename Compare, typename Diff, bool Sign = false>
+    static bool jump_cmp_imm(core::VM *vm);
+
+    /* Counted loop: increments (decrements) counter and jumps
+     * while it's below (above) the bound
+     */
+    template<bool Inc, typename Diff>
+    static bool loop(core::VM *vm);
+    template<bool Inc, typename Diff>
+    static bool loop_imm(core::VM *vm);
+    template<bool Inc>
+    static uint64_t loop_step(core::VM *vm, uint8_t reg);
+
     static bool conditional(
         core::VM *vm, uint8_t algo, uint8_t val1, uint8_t val2);
 
@@ -0,0 +1,93 @@
+#include "maps.hh"
+#include "opcodes.hh"
+#include <iostream>
+
+using core::VM;
+using core::HashMap;
+using core::RegisterData;
+using impl::Opcode;
+using impl::Maps;
+
+Maps::Maps(VM *vm)
+{
+    vm->opcode(Opcode::MAP_NEW(), Maps::map_new);
+    vm->opcode(Opcode::MAP_PUT(), Maps::map_put);
+    vm->opcode(Opcode::MAP_GET8(), Maps::map_get<int8_t>);
+    vm->opcode(Opcode::MAP_GET32(), Maps::map_get<int32_t>);
+    vm->opcode(Opcode::MAP_DEL(), Maps::map_del);
+    vm->opcode(Opcode::MAP_SIZE(), Maps::map_size);
+}
+
+HashMap &Maps::get_map(VM *vm, uint8_t reg)
+{
+    return vm->maps().get(vm->regs().get_int(reg));
+}
+
+RegisterData Maps::get(VM *vm, uint8_t reg)
+{
+    if (reg > 0xf) {
+        RegisterData res;
+        res.m_int = reg >> 4;
+        return res;
+    }
+    return vm->regs().get(reg);
+}
+
+bool Maps::map_new(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "MAP_NEW\n";
+    uint8_t reg = vm->fetch8();
+    vm->regs().put_int(reg, vm->maps().create());
+    return true;
+}
+
+bool Maps::map_put(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "MAP_PUT\n";
+    uint8_t map = vm->fetch8();
+    uint8_t key = vm->fetch8();
+    uint8_t val = vm->fetch8();
+
+    get_map(vm, map).put(get(vm, key), get(vm, val));
+    return true;
+}
+
+template<typename Diff>
+bool Maps::map_get(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "MAP_GET" << sizeof(Diff) * 8 << "\n";
+    uint8_t reg = vm->fetch8();
+    uint8_t map = vm->fetch8();
+    uint8_t key = vm->fetch8();
+
+    uint64_t pos = vm->regs().pc();
+    Diff diff = static_cast<Diff>(vm->fetch_int(sizeof(Diff)));
+
+    const RegisterData *val = get_map(vm, map).find(get(vm, key));
+    if (val)
+        vm->regs().put(reg, *val);
+    else
+        vm->regs().pc_update(pos + diff);
+
+    return true;
+}
+
+bool Maps::map_del(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "MAP_DEL\n";
+    uint8_t map = vm->fetch8();
+    uint8_t key = vm->fetch8();
+
+    get_map(vm, map).erase(get(vm, key));
+    return true;
+}
+
+bool Maps::map_size(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "MAP_SIZE\n";
+    uint8_t reg = vm->fetch8();
+    uint8_t map = vm->fetch8();
+
+    vm->regs().put_int(reg, get_map(vm, map).size());
+    return true;
+}
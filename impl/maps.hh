@@ -0,0 +1,31 @@
+#pragma once
+
+#include "vm.hh"
+
+namespace impl
+{
+
+/* Opcodes for VM hash maps. Map is addressed by handle in integer
+ * register, keys are integer or string registers and values any
+ * register. Inline immediate key or value is an integer.
+ */
+class Maps
+{
+public:
+    Maps(core::VM *vm);
+
+private:
+    static bool map_new(core::VM *vm);
+    static bool map_put(core::VM *vm);
+
+    /* Value to destination, or jump when key is missing */
+    template<typename Diff> static bool map_get(core::VM *vm);
+
+    static bool map_del(core::VM *vm);
+    static bool map_size(core::VM *vm);
+
+    static core::HashMap &get_map(core::VM *vm, uint8_t reg);
+    static core::RegisterData get(core::VM *vm, uint8_t reg);
+};
+
+}
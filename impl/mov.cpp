@@ -1,5 +1,6 @@
 #include "mov.hh"
 #include "opcodes.hh"
+#include <functional>
 #include <iostream>
 
 using core::VM;
@@ -9,6 +10,14 @@ using impl::Mov;
 Mov::Mov(VM *vm)
 {
     vm->opcode(Opcode::MOV(), Mov::mov);
+    vm->opcode(Opcode::SELECT(), Mov::select);
+
+    vm->opcode(Opcode::SETEQ(), Mov::set_cmp<std::equal_to<uint64_t>>);
+    vm->opcode(Opcode::SETNE(), Mov::set_cmp<std::not_equal_to<uint64_t>>);
+    vm->opcode(Opcode::SETLT(), Mov::set_cmp<std::less<uint64_t>>);
+    vm->opcode(Opcode::SETGT(), Mov::set_cmp<std::greater<uint64_t>>);
+    vm->opcode(Opcode::SETLE(), Mov::set_cmp<std::less_equal<uint64_t>>);
+    vm->opcode(Opcode::SETGE(), Mov::set_cmp<std::greater_equal<uint64_t>>);
 }
 
 bool Mov::mov(core::VM *vm)
@@ -22,3 +31,40 @@ bool Mov::mov(core::VM *vm)
 
     return true;
 }
+
+bool Mov::select(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "SELECT\n";
+
+    uint8_t dst = vm->fetch8();
+    uint8_t cond = vm->fetch8();
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+
+    uint64_t val = (cond>0xf)?(cond>>4):vm->regs().get_int(cond);
+    uint8_t src = val ? reg1 : reg2;
+
+    if (src > 0xf)
+        vm->regs().put_int(dst, src >> 4);
+    else
+        vm->regs().copy(dst, src);
+
+    return true;
+}
+
+template<typename Compare>
+bool Mov::set_cmp(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "SET_CMP\n";
+
+    uint8_t dst = vm->fetch8();
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+
+    uint64_t val1 = (reg1>0xf)?(reg1>>4):vm->regs().get_int(reg1);
+    uint64_t val2 = (reg2>0xf)?(reg2>>4):vm->regs().get_int(reg2);
+
+    vm->regs().put_int(dst, Compare()(val1, val2));
+
+    return true;
+}
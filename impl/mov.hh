@@ -13,6 +13,15 @@ public:
 
 private:
     static bool mov(core::VM *vm);
+
+    /* Conditional move, no branch on the condition
+     */
+    static bool select(core::VM *vm);
+
+    /* Sets destination to 1 if comparison holds, otherwise 0
+     */
+    template<typename Compare>
+    static bool set_cmp(core::VM *vm);
 };
 
 }
@@ -54,6 +54,177 @@ public:
     static core::Opcode HEAP()           { return core::Opcode(0x23); }
     static core::Opcode INFO()           { return core::Opcode(0x24); }
 
+    static core::Opcode ADD_IMM()        { return core::Opcode(0x25); }
+    static core::Opcode SUB_IMM()        { return core::Opcode(0x26); }
+    static core::Opcode MUL_IMM()        { return core::Opcode(0x27); }
+    static core::Opcode DIV_IMM()        { return core::Opcode(0x28); }
+    static core::Opcode MOD_IMM()        { return core::Opcode(0x29); }
+
+    static core::Opcode JMP_LE_IMM8()    { return core::Opcode(0x2a); }
+    static core::Opcode JMP_LE_IMM16()   { return core::Opcode(0x2b); }
+    static core::Opcode JMP_LE_IMM32()   { return core::Opcode(0x2c); }
+
+    static core::Opcode JEQ8()           { return core::Opcode(0x2d); }
+    static core::Opcode JNE8()           { return core::Opcode(0x2e); }
+    static core::Opcode JLT8()           { return core::Opcode(0x2f); }
+    static core::Opcode JGT8()           { return core::Opcode(0x30); }
+    static core::Opcode JLE8()           { return core::Opcode(0x31); }
+    static core::Opcode JGE8()           { return core::Opcode(0x32); }
+
+    static core::Opcode JEQ32()          { return core::Opcode(0x33); }
+    static core::Opcode JNE32()          { return core::Opcode(0x34); }
+    static core::Opcode JLT32()          { return core::Opcode(0x35); }
+    static core::Opcode JGT32()          { return core::Opcode(0x36); }
+    static core::Opcode JLE32()          { return core::Opcode(0x37); }
+    static core::Opcode JGE32()          { return core::Opcode(0x38); }
+
+    static core::Opcode JEQ_IMM8()       { return core::Opcode(0x39); }
+    static core::Opcode JNE_IMM8()       { return core::Opcode(0x3a); }
+    static core::Opcode JLT_IMM8()       { return core::Opcode(0x3b); }
+    static core::Opcode JGT_IMM8()       { return core::Opcode(0x3c); }
+    static core::Opcode JLE_IMM8()       { return core::Opcode(0x3d); }
+    static core::Opcode JGE_IMM8()       { return core::Opcode(0x3e); }
+
+    static core::Opcode JEQ_IMM32()      { return core::Opcode(0x3f); }
+    static core::Opcode JNE_IMM32()      { return core::Opcode(0x40); }
+    static core::Opcode JLT_IMM32()      { return core::Opcode(0x41); }
+    static core::Opcode JGT_IMM32()      { return core::Opcode(0x42); }
+    static core::Opcode JLE_IMM32()      { return core::Opcode(0x43); }
+    static core::Opcode JGE_IMM32()      { return core::Opcode(0x44); }
+
+    static core::Opcode LOOP_INC8()      { return core::Opcode(0x45); }
+    static core::Opcode LOOP_INC16()     { return core::Opcode(0x46); }
+    static core::Opcode LOOP_INC32()     { return core::Opcode(0x47); }
+
+    static core::Opcode LOOP_DEC8()      { return core::Opcode(0x48); }
+    static core::Opcode LOOP_DEC16()     { return core::Opcode(0x49); }
+    static core::Opcode LOOP_DEC32()     { return core::Opcode(0x4a); }
+
+    static core::Opcode LOOP_INC_IMM8()  { return core::Opcode(0x4b); }
+    static core::Opcode LOOP_INC_IMM16() { return core::Opcode(0x4c); }
+    static core::Opcode LOOP_INC_IMM32() { return core::Opcode(0x4d); }
+
+    static core::Opcode LOOP_DEC_IMM8()  { return core::Opcode(0x4e); }
+    static core::Opcode LOOP_DEC_IMM16() { return core::Opcode(0x4f); }
+    static core::Opcode LOOP_DEC_IMM32() { return core::Opcode(0x50); }
+
+    static core::Opcode SELECT()         { return core::Opcode(0x51); }
+    static core::Opcode SETEQ()          { return core::Opcode(0x52); }
+    static core::Opcode SETNE()          { return core::Opcode(0x53); }
+    static core::Opcode SETLT()          { return core::Opcode(0x54); }
+    static core::Opcode SETGT()          { return core::Opcode(0x55); }
+    static core::Opcode SETLE()          { return core::Opcode(0x56); }
+    static core::Opcode SETGE()          { return core::Opcode(0x57); }
+
+    static core::Opcode AND_INT()        { return core::Opcode(0x58); }
+    static core::Opcode OR_INT()         { return core::Opcode(0x59); }
+    static core::Opcode XOR_INT()        { return core::Opcode(0x5a); }
+    static core::Opcode SHL_INT()        { return core::Opcode(0x5b); }
+    static core::Opcode SHR_INT()        { return core::Opcode(0x5c); }
+    static core::Opcode SAR_INT()        { return core::Opcode(0x5d); }
+    static core::Opcode ROL_INT()        { return core::Opcode(0x5e); }
+    static core::Opcode ROR_INT()        { return core::Opcode(0x5f); }
+
+    static core::Opcode AND_IMM()        { return core::Opcode(0x60); }
+    static core::Opcode OR_IMM()         { return core::Opcode(0x61); }
+    static core::Opcode XOR_IMM()        { return core::Opcode(0x62); }
+    static core::Opcode SHL_IMM()        { return core::Opcode(0x63); }
+    static core::Opcode SHR_IMM()        { return core::Opcode(0x64); }
+    static core::Opcode SAR_IMM()        { return core::Opcode(0x65); }
+    static core::Opcode ROL_IMM()        { return core::Opcode(0x66); }
+    static core::Opcode ROR_IMM()        { return core::Opcode(0x67); }
+
+    static core::Opcode NOT_INT()        { return core::Opcode(0x68); }
+    static core::Opcode POPCNT()         { return core::Opcode(0x69); }
+    static core::Opcode CLZ()            { return core::Opcode(0x6a); }
+    static core::Opcode CTZ()            { return core::Opcode(0x6b); }
+
+    static core::Opcode IDIV_INT()       { return core::Opcode(0x6c); }
+    static core::Opcode IMOD_INT()       { return core::Opcode(0x6d); }
+    static core::Opcode IDIV_IMM()       { return core::Opcode(0x6e); }
+    static core::Opcode IMOD_IMM()       { return core::Opcode(0x6f); }
+
+    static core::Opcode MULH_INT()       { return core::Opcode(0x70); }
+    static core::Opcode UMULH_INT()      { return core::Opcode(0x71); }
+    static core::Opcode DIV128()         { return core::Opcode(0x72); }
+
+    static core::Opcode JSLT8()          { return core::Opcode(0x73); }
+    static core::Opcode JSGT8()          { return core::Opcode(0x74); }
+    static core::Opcode JSLE8()          { return core::Opcode(0x75); }
+    static core::Opcode JSGE8()          { return core::Opcode(0x76); }
+
+    static core::Opcode JSLT32()         { return core::Opcode(0x77); }
+    static core::Opcode JSGT32()         { return core::Opcode(0x78); }
+    static core::Opcode JSLE32()         { return core::Opcode(0x79); }
+    static core::Opcode JSGE32()         { return core::Opcode(0x7a); }
+
+    static core::Opcode JSLT_IMM8()      { return core::Opcode(0x7b); }
+    static core::Opcode JSGT_IMM8()      { return core::Opcode(0x7c); }
+    static core::Opcode JSLE_IMM8()      { return core::Opcode(0x7d); }
+    static core::Opcode JSGE_IMM8()      { return core::Opcode(0x7e); }
+
+    static core::Opcode JSLT_IMM32()     { return core::Opcode(0x7f); }
+    static core::Opcode JSGT_IMM32()     { return core::Opcode(0x80); }
+    static core::Opcode JSLE_IMM32()     { return core::Opcode(0x81); }
+    static core::Opcode JSGE_IMM32()     { return core::Opcode(0x82); }
+
+    static core::Opcode LOAD_FLOAT()     { return core::Opcode(0x83); }
+    static core::Opcode LOAD_FLOAT32()   { return core::Opcode(0x84); }
+
+    static core::Opcode FADD()           { return core::Opcode(0x85); }
+    static core::Opcode FSUB()           { return core::Opcode(0x86); }
+    static core::Opcode FMUL()           { return core::Opcode(0x87); }
+    static core::Opcode FDIV()           { return core::Opcode(0x88); }
+    static core::Opcode FMIN()           { return core::Opcode(0x89); }
+    static core::Opcode FMAX()           { return core::Opcode(0x8a); }
+
+    static core::Opcode FMA()            { return core::Opcode(0x8b); }
+    static core::Opcode FSQRT()          { return core::Opcode(0x8c); }
+    static core::Opcode ITOF()           { return core::Opcode(0x8d); }
+    static core::Opcode FTOI()           { return core::Opcode(0x8e); }
+
+    static core::Opcode JFEQ8()          { return core::Opcode(0x8f); }
+    static core::Opcode JFNE8()          { return core::Opcode(0x90); }
+    static core::Opcode JFLT8()          { return core::Opcode(0x91); }
+    static core::Opcode JFLE8()          { return core::Opcode(0x92); }
+
+    static core::Opcode JFEQ32()         { return core::Opcode(0x93); }
+    static core::Opcode JFNE32()         { return core::Opcode(0x94); }
+    static core::Opcode JFLT32()         { return core::Opcode(0x95); }
+    static core::Opcode JFLE32()         { return core::Opcode(0x96); }
+
+    static core::Opcode VLOAD()          { return core::Opcode(0x97); }
+    static core::Opcode VSTORE()         { return core::Opcode(0x98); }
+    static core::Opcode VSPLAT()         { return core::Opcode(0x99); }
+    static core::Opcode VOP()            { return core::Opcode(0x9a); }
+    static core::Opcode VREDUCE()        { return core::Opcode(0x9b); }
+
+    static core::Opcode AREDUCE()        { return core::Opcode(0x9c); }
+    static core::Opcode ACOUNT()         { return core::Opcode(0x9d); }
+    static core::Opcode ASCAN()          { return core::Opcode(0x9e); }
+    static core::Opcode SORT()           { return core::Opcode(0x9f); }
+    static core::Opcode BSEARCH()        { return core::Opcode(0xa0); }
+    static core::Opcode CRC()            { return core::Opcode(0xa1); }
+    static core::Opcode HASH()           { return core::Opcode(0xa2); }
+    static core::Opcode MAP_NEW()        { return core::Opcode(0xa3); }
+    static core::Opcode MAP_PUT()        { return core::Opcode(0xa4); }
+    static core::Opcode MAP_GET8()       { return core::Opcode(0xa5); }
+    static core::Opcode MAP_GET32()      { return core::Opcode(0xa6); }
+    static core::Opcode MAP_DEL()        { return core::Opcode(0xa7); }
+    static core::Opcode MAP_SIZE()       { return core::Opcode(0xa8); }
+    static core::Opcode STR_POOL()       { return core::Opcode(0xa9); }
+    static core::Opcode LOAD_STR_CONST() { return core::Opcode(0xaa); }
+    static core::Opcode CONCAT()         { return core::Opcode(0xab); }
+    static core::Opcode SUBSTR()         { return core::Opcode(0xac); }
+    static core::Opcode FIND()           { return core::Opcode(0xad); }
+    static core::Opcode LEN()            { return core::Opcode(0xae); }
+    static core::Opcode JSTR8()          { return core::Opcode(0xaf); }
+    static core::Opcode JSTR32()         { return core::Opcode(0xb0); }
+    static core::Opcode TO_INT()         { return core::Opcode(0xb1); }
+    static core::Opcode FROM_INT()       { return core::Opcode(0xb2); }
+    static core::Opcode FORMAT()         { return core::Opcode(0xb3); }
+    static core::Opcode SNAPSHOT()       { return core::Opcode(0xb4); }
+
     static core::Opcode STOP()           { return core::Opcode(0xff); }
 };
 
@@ -0,0 +1,116 @@
+#include "pool.hh"
+#include <memory>
+
+using impl::ThreadPool;
+
+static unsigned s_shared_threads = 0;
+static std::unique_ptr<ThreadPool> s_shared;
+static std::mutex s_shared_lock;
+
+ThreadPool::ThreadPool(unsigned threads) :
+    m_func(nullptr), m_count(0), m_next(0), m_active(0),
+    m_generation(0), m_stop(false), m_failed(false)
+{
+    for (unsigned i = 1; i < threads; ++i)
+        m_workers.emplace_back(&ThreadPool::worker, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto &thread : m_workers)
+        thread.join();
+}
+
+ThreadPool &ThreadPool::shared()
+{
+    std::lock_guard<std::mutex> guard(s_shared_lock);
+    if (!s_shared) {
+        unsigned threads = s_shared_threads;
+        if (threads == 0)
+            threads = std::thread::hardware_concurrency();
+        s_shared.reset(new ThreadPool(threads ? threads : 1));
+    }
+    return *s_shared;
+}
+
+void ThreadPool::set_shared_threads(unsigned threads)
+{
+    std::lock_guard<std::mutex> guard(s_shared_lock);
+    s_shared_threads = threads;
+    s_shared.reset();
+}
+
+void ThreadPool::run_items()
+{
+    std::unique_lock<std::mutex> guard(m_lock);
+    while (m_next < m_count) {
+        unsigned item = m_next++;
+        guard.unlock();
+        try {
+            (*m_func)(item);
+        }
+        catch (std::string e) {
+            guard.lock();
+            if (!m_failed) {
+                m_failed = true;
+                m_error = e;
+            }
+            guard.unlock();
+        }
+        guard.lock();
+    }
+}
+
+void ThreadPool::worker()
+{
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> guard(m_lock);
+    while (true) {
+        m_wake.wait(guard, [&] { return m_stop || m_generation != seen; });
+        if (m_stop)
+            return;
+        seen = m_generation;
+
+        guard.unlock();
+        run_items();
+        guard.lock();
+
+        if (--m_active == 0)
+            m_done.notify_all();
+    }
+}
+
+void ThreadPool::parallel_for(unsigned count,
+    const std::function<void(unsigned)> &func)
+{
+    if (m_workers.empty() || count <= 1) {
+        for (unsigned i = 0; i < count; ++i)
+            func(i);
+        return;
+    }
+
+    std::lock_guard<std::mutex> busy(m_busy);
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_func = &func;
+        m_count = count;
+        m_next = 0;
+        m_active = m_workers.size();
+        m_failed = false;
+        ++m_generation;
+    }
+    m_wake.notify_all();
+
+    run_items();
+
+    std::unique_lock<std::mutex> guard(m_lock);
+    m_done.wait(guard, [&] { return m_active == 0; });
+    m_func = nullptr;
+    if (m_failed)
+        throw m_error;
+}
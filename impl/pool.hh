@@ -0,0 +1,62 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace impl
+{
+
+/* Fixed set of worker threads running indexed parallel loops.
+ *
+ * Calling thread takes part in the work, so pool of size one
+ * has no workers and runs everything inline.
+ */
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned threads);
+    ~ThreadPool();
+
+    inline unsigned size() const
+    {
+        return m_workers.size() + 1;
+    }
+
+    /* Calls func(0) .. func(count - 1) and waits for all of them.
+     * First thrown error is rethrown in calling thread. Concurrent
+     * callers are served one at a time.
+     */
+    void parallel_for(unsigned count, const std::function<void(unsigned)> &func);
+
+    /* Pool shared by intrinsics, one thread per core by default
+     */
+    static ThreadPool &shared();
+    static void set_shared_threads(unsigned threads);
+
+private:
+    void worker();
+    void run_items();
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_busy;
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+
+    const std::function<void(unsigned)> *m_func;
+    unsigned m_count;
+    unsigned m_next;
+    unsigned m_active;
+    uint64_t m_generation;
+    bool m_stop;
+
+    bool m_failed;
+    std::string m_error;
+};
+
+}
@@ -0,0 +1,438 @@
+#include "simd.hh"
+#include <cstring>
+
+#ifdef MINVM_X86
+#include <immintrin.h>
+#endif
+
+using core::Lane;
+using impl::Simd;
+
+static Simd::Isa detect()
+{
+#ifdef MINVM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return Simd::Isa::Avx2;
+    return Simd::Isa::Sse2;
+#else
+    return Simd::Isa::Generic;
+#endif
+}
+
+static bool detect_sse42()
+{
+#ifdef MINVM_X86
+    // CPU info is set up by detect() before
+    return __builtin_cpu_supports("sse4.2");
+#else
+    return false;
+#endif
+}
+
+static Simd::Isa s_isa = detect();
+static bool s_sse42 = detect_sse42();
+
+Simd::Isa Simd::isa()
+{
+    return s_isa;
+}
+
+const char *Simd::isa_name()
+{
+    switch (s_isa) {
+        case Isa::Avx2:
+            return "avx2";
+        case Isa::Sse2:
+            return "sse2";
+        default:
+            return "generic";
+    }
+}
+
+void Simd::set_isa(Isa isa)
+{
+    // Can't go above what CPU supports
+    if (isa > detect())
+        isa = detect();
+    s_isa = isa;
+}
+
+bool Simd::sse42()
+{
+    return s_sse42 && s_isa != Isa::Generic;
+}
+
+unsigned Simd::lane_size(Lane lane)
+{
+    switch (lane) {
+        case Lane::U8:
+        case Lane::I8:
+            return 1;
+        case Lane::U16:
+        case Lane::I16:
+            return 2;
+        case Lane::U32:
+        case Lane::I32:
+        case Lane::F32:
+            return 4;
+        default:
+            return 8;
+    }
+}
+
+template<typename T>
+static void set_mask(T &res, bool cond)
+{
+    std::memset(&res, cond ? 0xff : 0, sizeof(T));
+}
+
+/* Signed lanes do add, sub and mul unsigned to wrap around
+ */
+template<typename T, typename Arith>
+static void generic_binary(Simd::Op op,
+    uint8_t *dst, const uint8_t *a, const uint8_t *b, unsigned bytes)
+{
+    for (unsigned i = 0; i < bytes; i += sizeof(T)) {
+        T x, y, res;
+        std::memcpy(&x, a + i, sizeof(T));
+        std::memcpy(&y, b + i, sizeof(T));
+        switch (op) {
+            case Simd::Op::Add:
+                res = (T)((Arith)x + (Arith)y);
+                break;
+            case Simd::Op::Sub:
+                res = (T)((Arith)x - (Arith)y);
+                break;
+            case Simd::Op::Mul:
+                res = (T)((Arith)x * (Arith)y);
+                break;
+            case Simd::Op::Min:
+                res = x < y ? x : y;
+                break;
+            case Simd::Op::Max:
+                res = x > y ? x : y;
+                break;
+            case Simd::Op::CmpEq:
+                set_mask(res, x == y);
+                break;
+            case Simd::Op::CmpGt:
+                set_mask(res, x > y);
+                break;
+            default:
+                throw std::string("Invalid vector operation");
+        }
+        std::memcpy(dst + i, &res, sizeof(T));
+    }
+}
+
+static void generic_bits(Simd::Op op,
+    uint8_t *dst, const uint8_t *a, const uint8_t *b, unsigned bytes)
+{
+    for (unsigned i = 0; i < bytes; ++i) {
+        if (op == Simd::Op::And)
+            dst[i] = a[i] & b[i];
+        else if (op == Simd::Op::Or)
+            dst[i] = a[i] | b[i];
+        else
+            dst[i] = a[i] ^ b[i];
+    }
+}
+
+static void generic(Simd::Op op, Lane lane,
+    uint8_t *dst, const uint8_t *a, const uint8_t *b, unsigned bytes)
+{
+    if (op >= Simd::Op::And) {
+        generic_bits(op, dst, a, b, bytes);
+        return;
+    }
+    switch (lane) {
+        case Lane::U8:
+            generic_binary<uint8_t, uint32_t>(op, dst, a, b, bytes);
+            break;
+        case Lane::U16:
+            generic_binary<uint16_t, uint32_t>(op, dst, a, b, bytes);
+            break;
+        case Lane::U32:
+            generic_binary<uint32_t, uint32_t>(op, dst, a, b, bytes);
+            break;
+        case Lane::U64:
+            generic_binary<uint64_t, uint64_t>(op, dst, a, b, bytes);
+            break;
+        case Lane::I8:
+            generic_binary<int8_t, uint32_t>(op, dst, a, b, bytes);
+            break;
+        case Lane::I16:
+            generic_binary<int16_t, uint32_t>(op, dst, a, b, bytes);
+            break;
+        case Lane::I32:
+            generic_binary<int32_t, uint32_t>(op, dst, a, b, bytes);
+            break;
+        case Lane::I64:
+            generic_binary<int64_t, uint64_t>(op, dst, a, b, bytes);
+            break;
+        case Lane::F32:
+            generic_binary<float, float>(op, dst, a, b, bytes);
+            break;
+        case Lane::F64:
+            generic_binary<double, double>(op, dst, a, b, bytes);
+            break;
+    }
+}
+
+#ifdef MINVM_X86
+
+/* SSE2 is part of x86-64 baseline, 16 bytes at a time */
+static bool sse2(Simd::Op op, Lane lane,
+    uint8_t *dst, const uint8_t *a, const uint8_t *b)
+{
+    unsigned size = Simd::lane_size(lane);
+    bool is_int = lane < Lane::F32;
+    bool is_signed = lane >= Lane::I8 && lane <= Lane::I64;
+    __m128i x = _mm_loadu_si128((const __m128i*)a);
+    __m128i y = _mm_loadu_si128((const __m128i*)b);
+    __m128i res;
+
+    if (lane == Lane::F32 && op < Simd::Op::And) {
+        __m128 fx = _mm_castsi128_ps(x);
+        __m128 fy = _mm_castsi128_ps(y);
+        __m128 fres;
+        switch (op) {
+            case Simd::Op::Add: fres = _mm_add_ps(fx, fy); break;
+            case Simd::Op::Sub: fres = _mm_sub_ps(fx, fy); break;
+            case Simd::Op::Mul: fres = _mm_mul_ps(fx, fy); break;
+            case Simd::Op::Min: fres = _mm_min_ps(fx, fy); break;
+            case Simd::Op::Max: fres = _mm_max_ps(fx, fy); break;
+            case Simd::Op::CmpEq: fres = _mm_cmpeq_ps(fx, fy); break;
+            default: fres = _mm_cmpgt_ps(fx, fy); break;
+        }
+        res = _mm_castps_si128(fres);
+    } else if (lane == Lane::F64 && op < Simd::Op::And) {
+        __m128d fx = _mm_castsi128_pd(x);
+        __m128d fy = _mm_castsi128_pd(y);
+        __m128d fres;
+        switch (op) {
+            case Simd::Op::Add: fres = _mm_add_pd(fx, fy); break;
+            case Simd::Op::Sub: fres = _mm_sub_pd(fx, fy); break;
+            case Simd::Op::Mul: fres = _mm_mul_pd(fx, fy); break;
+            case Simd::Op::Min: fres = _mm_min_pd(fx, fy); break;
+            case Simd::Op::Max: fres = _mm_max_pd(fx, fy); break;
+            case Simd::Op::CmpEq: fres = _mm_cmpeq_pd(fx, fy); break;
+            default: fres = _mm_cmpgt_pd(fx, fy); break;
+        }
+        res = _mm_castpd_si128(fres);
+    } else if (op == Simd::Op::And) {
+        res = _mm_and_si128(x, y);
+    } else if (op == Simd::Op::Or) {
+        res = _mm_or_si128(x, y);
+    } else if (op == Simd::Op::Xor) {
+        res = _mm_xor_si128(x, y);
+    } else if (!is_int) {
+        return false;
+    } else if (op == Simd::Op::Add) {
+        if (size == 1) res = _mm_add_epi8(x, y);
+        else if (size == 2) res = _mm_add_epi16(x, y);
+        else if (size == 4) res = _mm_add_epi32(x, y);
+        else res = _mm_add_epi64(x, y);
+    } else if (op == Simd::Op::Sub) {
+        if (size == 1) res = _mm_sub_epi8(x, y);
+        else if (size == 2) res = _mm_sub_epi16(x, y);
+        else if (size == 4) res = _mm_sub_epi32(x, y);
+        else res = _mm_sub_epi64(x, y);
+    } else if (op == Simd::Op::Mul && size == 2) {
+        res = _mm_mullo_epi16(x, y);
+    } else if (op == Simd::Op::Min && lane == Lane::U8) {
+        res = _mm_min_epu8(x, y);
+    } else if (op == Simd::Op::Min && lane == Lane::I16) {
+        res = _mm_min_epi16(x, y);
+    } else if (op == Simd::Op::Max && lane == Lane::U8) {
+        res = _mm_max_epu8(x, y);
+    } else if (op == Simd::Op::Max && lane == Lane::I16) {
+        res = _mm_max_epi16(x, y);
+    } else if (op == Simd::Op::CmpEq && size < 8) {
+        if (size == 1) res = _mm_cmpeq_epi8(x, y);
+        else if (size == 2) res = _mm_cmpeq_epi16(x, y);
+        else res = _mm_cmpeq_epi32(x, y);
+    } else if (op == Simd::Op::CmpGt && is_signed && size < 8) {
+        if (size == 1) res = _mm_cmpgt_epi8(x, y);
+        else if (size == 2) res = _mm_cmpgt_epi16(x, y);
+        else res = _mm_cmpgt_epi32(x, y);
+    } else {
+        return false;
+    }
+
+    _mm_storeu_si128((__m128i*)dst, res);
+    return true;
+}
+
+__attribute__((target("avx2")))
+static bool avx2(Simd::Op op, Lane lane,
+    uint8_t *dst, const uint8_t *a, const uint8_t *b)
+{
+    unsigned size = Simd::lane_size(lane);
+    bool is_int = lane < Lane::F32;
+    bool is_signed = lane >= Lane::I8 && lane <= Lane::I64;
+    __m256i x = _mm256_loadu_si256((const __m256i*)a);
+    __m256i y = _mm256_loadu_si256((const __m256i*)b);
+    __m256i res;
+
+    if (lane == Lane::F32 && op < Simd::Op::And) {
+        __m256 fx = _mm256_castsi256_ps(x);
+        __m256 fy = _mm256_castsi256_ps(y);
+        __m256 fres;
+        switch (op) {
+            case Simd::Op::Add: fres = _mm256_add_ps(fx, fy); break;
+            case Simd::Op::Sub: fres = _mm256_sub_ps(fx, fy); break;
+            case Simd::Op::Mul: fres = _mm256_mul_ps(fx, fy); break;
+            case Simd::Op::Min: fres = _mm256_min_ps(fx, fy); break;
+            case Simd::Op::Max: fres = _mm256_max_ps(fx, fy); break;
+            case Simd::Op::CmpEq:
+                fres = _mm256_cmp_ps(fx, fy, _CMP_EQ_OQ);
+                break;
+            default:
+                fres = _mm256_cmp_ps(fx, fy, _CMP_GT_OQ);
+                break;
+        }
+        res = _mm256_castps_si256(fres);
+    } else if (lane == Lane::F64 && op < Simd::Op::And) {
+        __m256d fx = _mm256_castsi256_pd(x);
+        __m256d fy = _mm256_castsi256_pd(y);
+        __m256d fres;
+        switch (op) {
+            case Simd::Op::Add: fres = _mm256_add_pd(fx, fy); break;
+            case Simd::Op::Sub: fres = _mm256_sub_pd(fx, fy); break;
+            case Simd::Op::Mul: fres = _mm256_mul_pd(fx, fy); break;
+            case Simd::Op::Min: fres = _mm256_min_pd(fx, fy); break;
+            case Simd::Op::Max: fres = _mm256_max_pd(fx, fy); break;
+            case Simd::Op::CmpEq:
+                fres = _mm256_cmp_pd(fx, fy, _CMP_EQ_OQ);
+                break;
+            default:
+                fres = _mm256_cmp_pd(fx, fy, _CMP_GT_OQ);
+                break;
+        }
+        res = _mm256_castpd_si256(fres);
+    } else if (op == Simd::Op::And) {
+        res = _mm256_and_si256(x, y);
+    } else if (op == Simd::Op::Or) {
+        res = _mm256_or_si256(x, y);
+    } else if (op == Simd::Op::Xor) {
+        res = _mm256_xor_si256(x, y);
+    } else if (!is_int) {
+        return false;
+    } else if (op == Simd::Op::Add) {
+        if (size == 1) res = _mm256_add_epi8(x, y);
+        else if (size == 2) res = _mm256_add_epi16(x, y);
+        else if (size == 4) res = _mm256_add_epi32(x, y);
+        else res = _mm256_add_epi64(x, y);
+    } else if (op == Simd::Op::Sub) {
+        if (size == 1) res = _mm256_sub_epi8(x, y);
+        else if (size == 2) res = _mm256_sub_epi16(x, y);
+        else if (size == 4) res = _mm256_sub_epi32(x, y);
+        else res = _mm256_sub_epi64(x, y);
+    } else if (op == Simd::Op::Mul && (size == 2 || size == 4)) {
+        if (size == 2) res = _mm256_mullo_epi16(x, y);
+        else res = _mm256_mullo_epi32(x, y);
+    } else if ((op == Simd::Op::Min || op == Simd::Op::Max) && size < 8) {
+        bool min = op == Simd::Op::Min;
+        switch (lane) {
+            case Lane::U8:
+                res = min ? _mm256_min_epu8(x, y) : _mm256_max_epu8(x, y);
+                break;
+            case Lane::U16:
+                res = min ? _mm256_min_epu16(x, y) : _mm256_max_epu16(x, y);
+                break;
+            case Lane::U32:
+                res = min ? _mm256_min_epu32(x, y) : _mm256_max_epu32(x, y);
+                break;
+            case Lane::I8:
+                res = min ? _mm256_min_epi8(x, y) : _mm256_max_epi8(x, y);
+                break;
+            case Lane::I16:
+                res = min ? _mm256_min_epi16(x, y) : _mm256_max_epi16(x, y);
+                break;
+            default:
+                res = min ? _mm256_min_epi32(x, y) : _mm256_max_epi32(x, y);
+                break;
+        }
+    } else if (op == Simd::Op::CmpEq) {
+        if (size == 1) res = _mm256_cmpeq_epi8(x, y);
+        else if (size == 2) res = _mm256_cmpeq_epi16(x, y);
+        else if (size == 4) res = _mm256_cmpeq_epi32(x, y);
+        else res = _mm256_cmpeq_epi64(x, y);
+    } else if (op == Simd::Op::CmpGt && is_signed) {
+        if (size == 1) res = _mm256_cmpgt_epi8(x, y);
+        else if (size == 2) res = _mm256_cmpgt_epi16(x, y);
+        else if (size == 4) res = _mm256_cmpgt_epi32(x, y);
+        else res = _mm256_cmpgt_epi64(x, y);
+    } else {
+        return false;
+    }
+
+    _mm256_storeu_si256((__m256i*)dst, res);
+    return true;
+}
+
+/* Byte shuffle reversing each lane, stays within 128-bit halves */
+__attribute__((target("avx2")))
+static bool avx2_swap(unsigned size,
+    uint8_t *dst, const uint8_t *src, unsigned bytes)
+{
+    alignas(32) uint8_t mask[32];
+    for (unsigned i = 0; i < 32; ++i)
+        mask[i] = (i % 16) - (i % size) + (size - 1 - i % size);
+    __m256i shuf = _mm256_load_si256((const __m256i*)mask);
+
+    if (bytes == 32) {
+        __m256i val = _mm256_loadu_si256((const __m256i*)src);
+        _mm256_storeu_si256((__m256i*)dst, _mm256_shuffle_epi8(val, shuf));
+    } else if (bytes == 16) {
+        __m128i val = _mm_loadu_si128((const __m128i*)src);
+        _mm_storeu_si128((__m128i*)dst,
+            _mm_shuffle_epi8(val, _mm256_castsi256_si128(shuf)));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+#endif
+
+void Simd::binary(Op op, Lane lane,
+    uint8_t *dst, const uint8_t *a, const uint8_t *b, unsigned bytes)
+{
+    if (op > Op::Xor)
+        throw std::string("Invalid vector operation");
+#ifdef MINVM_X86
+    if (s_isa == Isa::Avx2 && bytes == 32 && avx2(op, lane, dst, a, b))
+        return;
+    if (s_isa != Isa::Generic && (bytes == 16 || bytes == 32)
+        && sse2(op, lane, dst, a, b)) {
+        if (bytes == 16 || sse2(op, lane, dst + 16, a + 16, b + 16))
+            return;
+    }
+#endif
+    generic(op, lane, dst, a, b, bytes);
+}
+
+void Simd::swap(Lane lane, uint8_t *dst, const uint8_t *src, unsigned bytes)
+{
+    unsigned size = lane_size(lane);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    size = 1;
+#endif
+    if (size == 1) {
+        std::memmove(dst, src, bytes);
+        return;
+    }
+#ifdef MINVM_X86
+    if (s_isa == Isa::Avx2 && avx2_swap(size, dst, src, bytes))
+        return;
+#endif
+    uint8_t tmp[8];
+    for (unsigned i = 0; i < bytes; i += size) {
+        for (unsigned j = 0; j < size; ++j)
+            tmp[j] = src[i + size - 1 - j];
+        std::memcpy(dst + i, tmp, size);
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "vregs.hh"
+
+#if defined(__x86_64__)
+#define MINVM_X86 1
+#endif
+
+/* For per lane helpers of kernels that have to stay one loop */
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
+namespace impl
+{
+
+/* Lane-wise vector kernels. Implementation is selected at startup
+ * by CPUID: AVX2, SSE2 or portable C++. Operations an instruction set
+ * lacks, like 64-bit multiply, fall back to portable code.
+ */
+class Simd
+{
+public:
+    enum class Op : uint8_t
+    {
+        Add = 0,
+        Sub,
+        Mul,
+        Min,
+        Max,
+        CmpEq,
+        CmpGt,
+        And,
+        Or,
+        Xor
+    };
+
+    enum class Isa : uint8_t
+    {
+        Generic,
+        Sse2,
+        Avx2
+    };
+
+    static Isa isa();
+    static const char *isa_name();
+    static void set_isa(Isa isa);
+
+    /* True when CPU has SSE4.2 and isa is not lowered to Generic */
+    static bool sse42();
+
+    /* Compare sets lane to all ones when true, otherwise zero.
+     * Integer add, sub and mul wrap around in lane width.
+     */
+    static void binary(Op op, core::Lane lane,
+        uint8_t *dst, const uint8_t *a, const uint8_t *b, unsigned bytes);
+
+    /* Converts lanes between big endian memory and host order
+     */
+    static void swap(core::Lane lane,
+        uint8_t *dst, const uint8_t *src, unsigned bytes);
+
+    static unsigned lane_size(core::Lane lane);
+};
+
+}
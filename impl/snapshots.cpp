@@ -0,0 +1,20 @@
+#include "snapshots.hh"
+#include "opcodes.hh"
+#include <iostream>
+
+using core::VM;
+using impl::Opcode;
+using impl::Snapshots;
+
+Snapshots::Snapshots(VM *vm, const std::string &path) : m_path(path)
+{
+    vm->opcode(Opcode::SNAPSHOT(), [this](VM *vm) { return snapshot(vm); });
+}
+
+bool Snapshots::snapshot(VM *vm)
+{
+    if (vm->debug()) std::cerr << "SNAPSHOT\n";
+    if (!m_path.empty())
+        vm->snapshot(m_path);
+    return true;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "vm.hh"
+#include <string>
+
+namespace impl
+{
+
+/* SNAPSHOT saves VM state to file set here, so later run can restore
+ * it and continue from the next instruction. Without file it does
+ * nothing.
+ */
+class Snapshots
+{
+public:
+    Snapshots(core::VM *vm, const std::string &path = "");
+
+private:
+    bool snapshot(core::VM *vm);
+
+    std::string m_path;
+};
+
+}
@@ -0,0 +1,295 @@
+#include "sort.hh"
+#include "arrays.hh"
+#include "opcodes.hh"
+#include "pool.hh"
+#include "simd.hh"
+#include "vectors.hh"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using core::VM;
+using core::Lane;
+using impl::Opcode;
+using impl::Arrays;
+using impl::Simd;
+using impl::Sort;
+using impl::ThreadPool;
+
+namespace
+{
+
+typedef std::array<uint64_t, 256> Histogram;
+
+struct Records
+{
+    Lane lane;
+    unsigned width;
+    uint64_t stride;
+    uint64_t count;
+    uint8_t *data;
+};
+
+/* Range of records handled by one thread
+ */
+struct Part
+{
+    uint64_t begin;
+    uint64_t end;
+};
+
+}
+
+static bool is_float(Lane lane)
+{
+    return lane == Lane::F32 || lane == Lane::F64;
+}
+
+/* Byte of key mapped so that comparing mapped bytes from first to
+ * last as unsigned gives the element order
+ */
+ALWAYS_INLINE uint8_t digit(Lane lane, const uint8_t *key, unsigned pos)
+{
+    uint8_t byte = key[pos];
+    if (is_float(lane) && (key[0] & 0x80))
+        return ~byte;
+    if (pos == 0 && lane >= Lane::I8)
+        return byte ^ 0x80;
+    return byte;
+}
+
+/* Same mapping for whole key read as big endian number
+ */
+static uint64_t ordered(Lane lane, unsigned width, uint64_t bits)
+{
+    uint64_t mask = width == 8 ? UINT64_MAX : (1ULL << (width * 8)) - 1;
+    uint64_t sign = 1ULL << (width * 8 - 1);
+    bits &= mask;
+    if (is_float(lane) && (bits & sign))
+        return ~bits & mask;
+    if (lane >= Lane::I8)
+        return bits ^ sign;
+    return bits;
+}
+
+static uint64_t load_key(const uint8_t *ptr, unsigned width)
+{
+    uint64_t res = 0;
+    for (unsigned i = 0; i < width; ++i)
+        res = (res << 8) | ptr[i];
+    return res;
+}
+
+static std::vector<Part> split(const Records &recs)
+{
+    unsigned parts = 1;
+    if (recs.count * recs.stride >= Arrays::parallel_threshold())
+        parts = ThreadPool::shared().size();
+    if (parts > recs.count)
+        parts = recs.count;
+
+    std::vector<Part> res;
+    uint64_t per_part = (recs.count + parts - 1) / parts;
+    for (uint64_t pos = 0; pos < recs.count; pos += per_part)
+        res.push_back(Part{pos, std::min(recs.count, pos + per_part)});
+    return res;
+}
+
+static void run_parts(const std::vector<Part> &parts,
+    const std::function<void(unsigned)> &func)
+{
+    if (parts.size() == 1) {
+        func(0);
+        return;
+    }
+    ThreadPool::shared().parallel_for(parts.size(), func);
+}
+
+/* Histograms of every key byte in one read over the records
+ */
+static void count_all(const Records &recs, const uint8_t *src,
+    const Part &part, std::vector<Histogram> &hist)
+{
+    for (auto &h : hist)
+        h.fill(0);
+    for (uint64_t i = part.begin; i < part.end; ++i) {
+        const uint8_t *key = src + i * recs.stride;
+        for (unsigned pos = 0; pos < recs.width; ++pos)
+            ++hist[pos][digit(recs.lane, key, pos)];
+    }
+}
+
+static void count_pos(const Records &recs, const uint8_t *src,
+    const Part &part, unsigned pos, Histogram &hist)
+{
+    hist.fill(0);
+    for (uint64_t i = part.begin; i < part.end; ++i)
+        ++hist[digit(recs.lane, src + i * recs.stride, pos)];
+}
+
+template<unsigned Stride>
+ALWAYS_INLINE void scatter_records(const Records &recs, const uint8_t *src,
+    uint8_t *dst, const Part &part, unsigned pos, Histogram &offsets)
+{
+    uint64_t stride = Stride ? Stride : recs.stride;
+    for (uint64_t i = part.begin; i < part.end; ++i) {
+        const uint8_t *rec = src + i * stride;
+        uint64_t &off = offsets[digit(recs.lane, rec, pos)];
+        std::memcpy(dst + off * stride, rec, stride);
+        ++off;
+    }
+}
+
+static void scatter(const Records &recs, const uint8_t *src, uint8_t *dst,
+    const Part &part, unsigned pos, Histogram &offsets)
+{
+    switch (recs.stride) {
+        case 1: scatter_records<1>(recs, src, dst, part, pos, offsets); break;
+        case 2: scatter_records<2>(recs, src, dst, part, pos, offsets); break;
+        case 4: scatter_records<4>(recs, src, dst, part, pos, offsets); break;
+        case 8: scatter_records<8>(recs, src, dst, part, pos, offsets); break;
+        default: scatter_records<0>(recs, src, dst, part, pos, offsets); break;
+    }
+}
+
+static void radix_sort(const Records &recs)
+{
+    std::vector<Part> parts = split(recs);
+    std::vector<std::vector<Histogram>> all(parts.size(),
+        std::vector<Histogram>(recs.width));
+    run_parts(parts, [&](unsigned idx) {
+        count_all(recs, recs.data, parts[idx], all[idx]);
+    });
+
+    std::vector<uint8_t> buffer(recs.count * recs.stride);
+    uint8_t *src = recs.data;
+    uint8_t *dst = buffer.data();
+    std::vector<Histogram> offsets(parts.size());
+    bool moved = false;
+
+    for (unsigned pos = recs.width; pos > 0; --pos) {
+        Histogram total;
+        total.fill(0);
+        for (const auto &hist : all)
+            for (unsigned d = 0; d < 256; ++d)
+                total[d] += hist[pos - 1][d];
+        if (std::find(total.begin(), total.end(), recs.count) != total.end())
+            continue;
+
+        // Order of records changes after each pass, so per thread counts
+        // have to be taken again except for the first pass
+        std::vector<Histogram> current(parts.size());
+        if (!moved) {
+            for (size_t p = 0; p < parts.size(); ++p)
+                current[p] = all[p][pos - 1];
+        } else {
+            run_parts(parts, [&](unsigned idx) {
+                count_pos(recs, src, parts[idx], pos - 1, current[idx]);
+            });
+        }
+
+        uint64_t base = 0;
+        for (unsigned d = 0; d < 256; ++d) {
+            for (size_t p = 0; p < parts.size(); ++p) {
+                offsets[p][d] = base;
+                base += current[p][d];
+            }
+        }
+        run_parts(parts, [&](unsigned idx) {
+            scatter(recs, src, dst, parts[idx], pos - 1, offsets[idx]);
+        });
+        std::swap(src, dst);
+        moved = true;
+    }
+
+    if (src != recs.data)
+        std::memcpy(recs.data, src, recs.count * recs.stride);
+}
+
+static Records get_records(VM *vm, uint8_t shape, uint8_t base,
+    uint8_t count, uint8_t stride, bool write)
+{
+    Records res;
+    res.lane = impl::Vectors::lane(shape);
+    res.width = Simd::lane_size(res.lane);
+    res.count = (count>0xf)?(count>>4):vm->regs().get_int(count);
+    res.stride = (stride>0xf)?(stride>>4):vm->regs().get_int(stride);
+    res.data = nullptr;
+
+    if (res.stride < res.width)
+        throw std::string("Invalid array stride: ")
+            + std::to_string(res.stride);
+    if (res.count > UINT64_MAX / res.stride)
+        throw std::string("Heap memory access out of bounds");
+    // Searching only reads, pages stay clean
+    if (res.count > 0 && write)
+        res.data = vm->heap_range(
+            vm->regs().get_int(base), res.count * res.stride);
+    else if (res.count > 0)
+        res.data = (uint8_t*)vm->heap_read(
+            vm->regs().get_int(base), res.count * res.stride);
+    return res;
+}
+
+Sort::Sort(VM *vm)
+{
+    vm->opcode(Opcode::SORT(), Sort::sort);
+    vm->opcode(Opcode::BSEARCH(), Sort::bsearch);
+}
+
+bool Sort::sort(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "SORT\n";
+    uint8_t shape = vm->fetch8();
+    uint8_t base = vm->fetch8();
+    uint8_t count = vm->fetch8();
+    uint8_t stride = vm->fetch8();
+
+    Records recs = get_records(vm, shape, base, count, stride, true);
+    if (recs.count > 1)
+        radix_sort(recs);
+
+    return true;
+}
+
+bool Sort::bsearch(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "BSEARCH\n";
+    uint8_t reg = vm->fetch8();
+    uint8_t shape = vm->fetch8();
+    uint8_t base = vm->fetch8();
+    uint8_t count = vm->fetch8();
+    uint8_t value = vm->fetch8();
+    uint8_t stride = vm->fetch8();
+
+    Records recs = get_records(vm, shape, base, count, stride, false);
+    uint64_t bits;
+    if (recs.lane == Lane::F32) {
+        float val = (value>0xf)?(value>>4):vm->regs().get_float(value);
+        uint32_t tmp;
+        std::memcpy(&tmp, &val, sizeof(tmp));
+        bits = tmp;
+    } else if (recs.lane == Lane::F64) {
+        double val = (value>0xf)?(value>>4):vm->regs().get_float(value);
+        std::memcpy(&bits, &val, sizeof(bits));
+    } else {
+        bits = (value>0xf)?(value>>4):vm->regs().get_int(value);
+    }
+    uint64_t key = ordered(recs.lane, recs.width, bits);
+
+    uint64_t low = 0;
+    uint64_t high = recs.count;
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        uint64_t val = load_key(recs.data + mid * recs.stride, recs.width);
+        if (ordered(recs.lane, recs.width, val) < key)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    vm->regs().put_int(reg, low);
+
+    return true;
+}
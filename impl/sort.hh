@@ -0,0 +1,37 @@
+#pragma once
+
+#include "vm.hh"
+
+namespace impl
+{
+
+/* Sorting and searching of heap arrays in place.
+ *
+ * Array is given like for Arrays intrinsics with lane byte, base
+ * address and element count, and in addition record stride in bytes.
+ * Key is the big endian element in beginning of each record, rest of
+ * the record moves along with it. Signed and unsigned lanes compare
+ * as integers of element width, float lanes in IEEE total order, so
+ * -0.0 comes before 0.0.
+ *
+ * Sort is stable LSD radix sort reading key bytes directly from heap,
+ * passes where all keys share the byte are skipped. Arrays of at least
+ * Arrays::parallel_threshold() bytes are sorted with shared thread
+ * pool, which gives the same result.
+ */
+class Sort
+{
+public:
+    Sort(core::VM *vm);
+
+private:
+    /* Sorts records in ascending key order */
+    static bool sort(core::VM *vm);
+
+    /* Index of first record with key not less than value, or count
+     * if there's none. Array has to be sorted.
+     */
+    static bool bsearch(core::VM *vm);
+};
+
+}
@@ -1,5 +1,7 @@
 #include "strs.hh"
 #include "opcodes.hh"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 
 using core::VM;
@@ -9,21 +11,284 @@ using impl::Strs;
 Strs::Strs(VM *vm)
 {
     vm->opcode(Opcode::LOAD_STR(), Strs::load_str);
+    vm->opcode(Opcode::LOAD_STR_MEM(), Strs::load_str_mem);
+    vm->opcode(Opcode::STORE_STR(), Strs::store_str);
+    vm->opcode(Opcode::STORE_STR_MEM(), Strs::store_str_mem);
+    vm->opcode(Opcode::STR_POOL(), Strs::str_pool);
+    vm->opcode(Opcode::LOAD_STR_CONST(), Strs::load_str_const);
+    vm->opcode(Opcode::CONCAT(), Strs::concat);
+    vm->opcode(Opcode::SUBSTR(), Strs::substr);
+    vm->opcode(Opcode::FIND(), Strs::find);
+    vm->opcode(Opcode::LEN(), Strs::len);
+    vm->opcode(Opcode::JSTR8(), Strs::jump_str<int8_t>);
+    vm->opcode(Opcode::JSTR32(), Strs::jump_str<int32_t>);
+    vm->opcode(Opcode::TO_INT(), Strs::to_int);
+    vm->opcode(Opcode::FROM_INT(), Strs::from_int);
     vm->opcode(Opcode::PRINT_STR(), Strs::print_str);
 }
 
+void Strs::load(core::VM *vm, uint8_t reg, uint64_t pos)
+{
+    if (pos < vm->size()) {
+        const uint8_t *data = vm->code_range(pos);
+        const void *end = std::memchr(data, 0, vm->size() - pos);
+        if (end == nullptr)
+            throw std::string("Memory access out of bounds");
+        vm->regs().put_string_ref(reg, (const char*)data,
+            (const uint8_t*)end - data);
+        return;
+    }
+
+    uint64_t index = pos - vm->size();
+    const core::Heap &heap = vm->heap(index);
+    uint64_t avail = heap.pos() + heap.size() - index;
+    const uint8_t *data = heap.data(index, avail);
+    const void *end = std::memchr(data, 0, avail);
+    if (end == nullptr)
+        throw std::string("Heap memory access out of bounds");
+    vm->regs().put_string(reg, std::string((const char*)data,
+        (const uint8_t*)end - data));
+}
+
+void Strs::store(core::VM *vm, uint8_t reg, uint64_t pos)
+{
+    core::StringRef ref = vm->regs().get_string_ref(reg);
+    uint8_t *dst = vm->heap_range(pos, ref.size + 1);
+    std::memcpy(dst, ref.data, ref.size);
+    dst[ref.size] = 0;
+}
+
 bool Strs::load_str(core::VM *vm)
 {
     if (vm->debug()) std::cerr << "LOAD_STR\n";
-    std::string res = "";
     uint8_t reg = vm->fetch8();
 
-    uint8_t val = vm->fetch8();
-    while (val != 0) {
-        res.push_back(val);
-        val = vm->fetch8();
+    uint64_t pos = vm->regs().pc();
+    load(vm, reg, pos);
+    vm->regs().pc_update(pos + vm->regs().get_string_ref(reg).size + 1);
+
+    return true;
+}
+
+bool Strs::load_str_mem(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "LOAD_STR_MEM\n";
+    uint8_t reg = vm->fetch8();
+    uint64_t pos = vm->fetch_int(8);
+
+    load(vm, reg, pos);
+
+    return true;
+}
+
+bool Strs::store_str(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "STORE_STR\n";
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+
+    store(vm, reg1, vm->regs().get_int(reg2));
+
+    return true;
+}
+
+bool Strs::store_str_mem(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "STORE_STR_MEM\n";
+    uint8_t reg = vm->fetch8();
+    uint64_t pos = vm->fetch_int(8);
+
+    store(vm, reg, pos);
+
+    return true;
+}
+
+bool Strs::str_pool(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "STR_POOL\n";
+    uint64_t size = vm->fetch_int(4);
+
+    uint64_t pos = vm->regs().pc();
+    vm->intern_strings(pos, size);
+    vm->regs().pc_update(pos + size);
+
+    return true;
+}
+
+bool Strs::load_str_const(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "LOAD_STR_CONST\n";
+    uint8_t reg = vm->fetch8();
+    uint64_t idx = vm->fetch_int(2);
+
+    core::StringRef ref = vm->string_const(idx);
+    vm->regs().put_string_ref(reg, ref.data, ref.size);
+
+    return true;
+}
+
+bool Strs::concat(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "CONCAT\n";
+    uint8_t reg = vm->fetch8();
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+
+    core::StringRef ref2 = vm->regs().get_string_ref(reg2);
+    if (reg == reg1) {
+        vm->regs().append_string(reg, ref2.data, ref2.size);
+        return true;
+    }
+
+    core::StringRef ref1 = vm->regs().get_string_ref(reg1);
+    std::string res;
+    res.reserve(ref1.size + ref2.size);
+    res.append(ref1.data, ref1.size);
+    res.append(ref2.data, ref2.size);
+    vm->regs().put_string(reg, std::move(res));
+
+    return true;
+}
+
+bool Strs::substr(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "SUBSTR\n";
+    uint8_t reg = vm->fetch8();
+    uint8_t src = vm->fetch8();
+    uint8_t start = vm->fetch8();
+    uint8_t count = vm->fetch8();
+
+    uint64_t pos = (start>0xf)?(start>>4):vm->regs().get_int(start);
+    uint64_t size = (count>0xf)?(count>>4):vm->regs().get_int(count);
+    core::StringRef ref = vm->regs().get_string_ref(src);
+    if (pos > ref.size)
+        throw std::string("String index out of bounds");
+    size = std::min(size, ref.size - pos);
+
+    if (vm->regs().get(src).m_view)
+        vm->regs().put_string_ref(reg, ref.data + pos, size);
+    else
+        vm->regs().put_string(reg, std::string(ref.data + pos, size));
+
+    return true;
+}
+
+bool Strs::find(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "FIND\n";
+    uint8_t reg = vm->fetch8();
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+
+    core::StringRef ref1 = vm->regs().get_string_ref(reg1);
+    core::StringRef ref2 = vm->regs().get_string_ref(reg2);
+    const char *end = ref1.data + ref1.size;
+    const char *pos = std::search(ref1.data, end,
+        ref2.data, ref2.data + ref2.size);
+    vm->regs().put_int(reg, pos - ref1.data);
+
+    return true;
+}
+
+bool Strs::len(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "LEN\n";
+    uint8_t reg = vm->fetch8();
+    uint8_t src = vm->fetch8();
+
+    vm->regs().put_int(reg, vm->regs().get_string_ref(src).size);
+
+    return true;
+}
+
+int Strs::compare(core::StringRef a, core::StringRef b)
+{
+    int res = std::memcmp(a.data, b.data, std::min(a.size, b.size));
+    if (res != 0)
+        return res;
+    return (a.size > b.size) - (a.size < b.size);
+}
+
+template<typename Diff>
+bool Strs::jump_str(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "JSTR" << sizeof(Diff) * 8 << "\n";
+    uint8_t algo = vm->fetch8();
+    uint8_t reg1 = vm->fetch8();
+    uint8_t reg2 = vm->fetch8();
+
+    uint64_t pos = vm->regs().pc();
+    Diff diff = static_cast<Diff>(vm->fetch_int(sizeof(Diff)));
+
+    int res = compare(vm->regs().get_string_ref(reg1),
+        vm->regs().get_string_ref(reg2));
+    bool jump;
+    switch (algo) {
+        case 0: jump = res == 0; break;
+        case 1: jump = res < 0; break;
+        case 2: jump = res > 0; break;
+        case 3: jump = res <= 0; break;
+        case 4: jump = res >= 0; break;
+        case 5: jump = res != 0; break;
+        default:
+            throw std::string("Invalid string comparison: ")
+                + std::to_string((int)algo);
+    }
+    if (jump)
+        vm->regs().pc_update(pos + diff);
+
+    return true;
+}
+
+bool Strs::to_int(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "TO_INT\n";
+    uint8_t reg = vm->fetch8();
+    uint8_t src = vm->fetch8();
+
+    core::StringRef ref = vm->regs().get_string_ref(src);
+    const char *pos = ref.data;
+    const char *end = ref.data + ref.size;
+    bool neg = pos < end && *pos == '-';
+    if (neg)
+        ++pos;
+    if (pos == end)
+        throw std::string("Invalid integer: ") + std::string(ref.data, ref.size);
+
+    // Signed 64 bit range, so FROM_INT gives the same string back
+    uint64_t limit = neg ? (1ULL << 63) : (1ULL << 63) - 1;
+    uint64_t res = 0;
+    for (; pos < end; ++pos) {
+        if (*pos < '0' || *pos > '9'
+                || res > (limit - (*pos - '0')) / 10)
+            throw std::string("Invalid integer: ")
+                + std::string(ref.data, ref.size);
+        res = res * 10 + (*pos - '0');
     }
-    vm->regs().put_string(reg, res);
+    vm->regs().put_int(reg, neg ? -res : res);
+
+    return true;
+}
+
+bool Strs::from_int(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "FROM_INT\n";
+    uint8_t reg = vm->fetch8();
+    uint8_t src = vm->fetch8();
+
+    uint64_t val = (src>0xf)?(src>>4):vm->regs().get_int(src);
+    bool neg = (int64_t)val < 0;
+    if (neg)
+        val = -val;
+    char buf[21];
+    char *pos = buf + sizeof(buf);
+    do {
+        *--pos = '0' + val % 10;
+        val /= 10;
+    } while (val);
+    if (neg)
+        *--pos = '-';
+    vm->regs().put_string(reg, std::string(pos, buf + sizeof(buf) - pos));
 
     return true;
 }
@@ -31,7 +296,8 @@ bool Strs::load_str(core::VM *vm)
 bool Strs::print_str(core::VM *vm)
 {
     if (vm->debug()) std::cerr << "PRINT_STR\n";
-    std::cout << vm->regs().get_string(vm->fetch8());
+    core::StringRef ref = vm->regs().get_string_ref(vm->fetch8());
+    vm->output().write(ref.data, ref.size);
 
     return true;
 }
@@ -5,6 +5,18 @@
 namespace impl
 {
 
+/* String literals and strings in program memory are loaded as
+ * references to it without copying, program memory can't change.
+ * Strings in heap are copied, since heap can be written later.
+ * Strings in memory are NUL terminated.
+ *
+ * STR_POOL interns following block of strings once, after which
+ * LOAD_STR_CONST assigns them by index in constant time.
+ *
+ * Concatenation to its first source appends in place, so building
+ * string in loop is amortized linear. Substring of referred string
+ * refers to the same memory.
+ */
 class Strs
 {
 public:
@@ -12,7 +24,27 @@ public:
 
 private:
     static bool load_str(core::VM *vm);
+    static bool load_str_mem(core::VM *vm);
+    static bool store_str(core::VM *vm);
+    static bool store_str_mem(core::VM *vm);
+    static bool str_pool(core::VM *vm);
+    static bool load_str_const(core::VM *vm);
+
+    static bool concat(core::VM *vm);
+    static bool substr(core::VM *vm);
+    /* Index of the first occurrence, or length when there's none */
+    static bool find(core::VM *vm);
+    static bool len(core::VM *vm);
+    /* Jump on lexicographic comparison with JMP_LE operator */
+    template<typename Diff> static bool jump_str(core::VM *vm);
+    static bool to_int(core::VM *vm);
+    static bool from_int(core::VM *vm);
+
+    static int compare(core::StringRef a, core::StringRef b);
     static bool print_str(core::VM *vm);
+
+    static void load(core::VM *vm, uint8_t reg, uint64_t pos);
+    static void store(core::VM *vm, uint8_t reg, uint64_t pos);
 };
 
 }
@@ -0,0 +1,169 @@
+#include "vectors.hh"
+#include "opcodes.hh"
+#include <cstring>
+#include <iostream>
+
+using core::VM;
+using core::Lane;
+using impl::Opcode;
+using impl::Simd;
+using impl::Vectors;
+
+Vectors::Vectors(VM *vm)
+{
+    vm->opcode(Opcode::VLOAD(), Vectors::vload);
+    vm->opcode(Opcode::VSTORE(), Vectors::vstore);
+    vm->opcode(Opcode::VSPLAT(), Vectors::vsplat);
+    vm->opcode(Opcode::VOP(), Vectors::vop);
+    vm->opcode(Opcode::VREDUCE(), Vectors::vreduce);
+}
+
+Lane Vectors::lane(uint8_t shape)
+{
+    uint8_t val = shape & ~core::vector_wide;
+    if (val > (uint8_t)Lane::F64)
+        throw std::string("Invalid vector shape: ")
+            + std::to_string((int)shape);
+    return (Lane)val;
+}
+
+unsigned Vectors::bytes(uint8_t shape)
+{
+    return (shape & core::vector_wide) ? core::vector_bytes : 16;
+}
+
+static void clear_upper(uint8_t *vreg, unsigned bytes)
+{
+    if (bytes < core::vector_bytes)
+        std::memset(vreg + bytes, 0, core::vector_bytes - bytes);
+}
+
+bool Vectors::vload(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "VLOAD\n";
+    uint8_t vreg = vm->fetch8();
+    uint8_t shape = vm->fetch8();
+    uint8_t reg = vm->fetch8();
+
+    unsigned size = bytes(shape);
+    uint8_t *dst = vm->vregs().get(vreg);
+    const uint8_t *src = vm->heap_read(vm->regs().get_int(reg), size);
+
+    Simd::swap(lane(shape), dst, src, size);
+    clear_upper(dst, size);
+
+    return true;
+}
+
+bool Vectors::vstore(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "VSTORE\n";
+    uint8_t vreg = vm->fetch8();
+    uint8_t shape = vm->fetch8();
+    uint8_t reg = vm->fetch8();
+
+    unsigned size = bytes(shape);
+    const uint8_t *src = vm->vregs().get(vreg);
+    uint8_t *dst = vm->heap_range(vm->regs().get_int(reg), size);
+
+    Simd::swap(lane(shape), dst, src, size);
+
+    return true;
+}
+
+bool Vectors::vsplat(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "VSPLAT\n";
+    uint8_t vreg = vm->fetch8();
+    uint8_t shape = vm->fetch8();
+    uint8_t reg = vm->fetch8();
+
+    Lane type = lane(shape);
+    unsigned size = bytes(shape);
+    unsigned width = Simd::lane_size(type);
+    uint8_t *dst = vm->vregs().get(vreg);
+
+    uint8_t val[8];
+    if (type == Lane::F32) {
+        float fval = vm->regs().get_float(reg);
+        std::memcpy(val, &fval, width);
+    } else if (type == Lane::F64) {
+        double fval = vm->regs().get_float(reg);
+        std::memcpy(val, &fval, width);
+    } else {
+        uint64_t ival = (reg>0xf)?(reg>>4):vm->regs().get_int(reg);
+        for (unsigned i = 0; i < width; ++i) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            val[width - 1 - i] = ival >> (i * 8);
+#else
+            val[i] = ival >> (i * 8);
+#endif
+        }
+    }
+
+    for (unsigned i = 0; i < size; i += width)
+        std::memcpy(dst + i, val, width);
+    clear_upper(dst, size);
+
+    return true;
+}
+
+bool Vectors::vop(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "VOP\n";
+    uint8_t vreg1 = vm->fetch8();
+    uint8_t op = vm->fetch8();
+    uint8_t shape = vm->fetch8();
+    uint8_t vreg2 = vm->fetch8();
+    uint8_t vreg3 = vm->fetch8();
+
+    unsigned size = bytes(shape);
+    uint8_t *dst = vm->vregs().get(vreg1);
+
+    Simd::binary((Simd::Op)op, lane(shape), dst,
+        vm->vregs().get(vreg2), vm->vregs().get(vreg3), size);
+    clear_upper(dst, size);
+
+    return true;
+}
+
+bool Vectors::vreduce(core::VM *vm)
+{
+    if (vm->debug()) std::cerr << "VREDUCE\n";
+    uint8_t reg = vm->fetch8();
+    uint8_t op = vm->fetch8();
+    uint8_t shape = vm->fetch8();
+    uint8_t vreg = vm->fetch8();
+
+    Simd::Op oper = (Simd::Op)op;
+    if (oper == Simd::Op::Sub || oper == Simd::Op::CmpEq
+        || oper == Simd::Op::CmpGt || oper > Simd::Op::Xor)
+        throw std::string("Invalid vector reduction: ")
+            + std::to_string((int)op);
+
+    Lane type = lane(shape);
+    unsigned size = bytes(shape);
+    unsigned width = Simd::lane_size(type);
+
+    alignas(32) uint8_t tmp[core::vector_bytes];
+    std::memcpy(tmp, vm->vregs().get(vreg), size);
+    while (size > width) {
+        size /= 2;
+        Simd::binary(oper, type, tmp, tmp, tmp + size, size);
+    }
+
+    switch (type) {
+        case Lane::U8: vm->regs().put_int(reg, *(uint8_t*)tmp); break;
+        case Lane::U16: vm->regs().put_int(reg, *(uint16_t*)tmp); break;
+        case Lane::U32: vm->regs().put_int(reg, *(uint32_t*)tmp); break;
+        case Lane::U64: vm->regs().put_int(reg, *(uint64_t*)tmp); break;
+        case Lane::I8: vm->regs().put_int(reg, *(int8_t*)tmp); break;
+        case Lane::I16: vm->regs().put_int(reg, *(int16_t*)tmp); break;
+        case Lane::I32: vm->regs().put_int(reg, *(int32_t*)tmp); break;
+        case Lane::I64: vm->regs().put_int(reg, *(int64_t*)tmp); break;
+        case Lane::F32: vm->regs().put_float(reg, *(float*)tmp); break;
+        case Lane::F64: vm->regs().put_float(reg, *(double*)tmp); break;
+    }
+
+    return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "vm.hh"
+#include "simd.hh"
+
+namespace impl
+{
+
+/* Vector instructions operating on vector register bank.
+ *
+ * Shape byte selects lane type and width, see core::Lane. Lanes are
+ * stored big endian in memory like integers, and kept in host order
+ * in registers.
+ */
+class Vectors
+{
+public:
+    Vectors(core::VM *vm);
+
+    /* Lane type of valid shape byte, throws on invalid one */
+    static core::Lane lane(uint8_t shape);
+    static unsigned bytes(uint8_t shape);
+
+private:
+    static bool vload(core::VM *vm);
+    static bool vstore(core::VM *vm);
+    static bool vsplat(core::VM *vm);
+    static bool vop(core::VM *vm);
+
+    /* Horizontal reduction to scalar register, folds halves together
+     * with lane-wise operation. Integer result is extended from lane.
+     */
+    static bool vreduce(core::VM *vm);
+};
+
+}
@@ -0,0 +1,76 @@
+#include "vmpool.hh"
+#include <cstdlib>
+#include <new>
+
+using impl::VMPool;
+
+void *VMPool::Entry::operator new(size_t size)
+{
+    void *res = nullptr;
+    size_t align = alignof(Entry) < sizeof(void*) ?
+        sizeof(void*) : alignof(Entry);
+    if (posix_memalign(&res, align, size) != 0)
+        throw std::bad_alloc();
+    return res;
+}
+
+void VMPool::Entry::operator delete(void *ptr)
+{
+    free(ptr);
+}
+
+VMPool::Lease::Lease(VMPool *pool, std::unique_ptr<Entry> entry) :
+    m_pool(pool), m_entry(std::move(entry))
+{
+}
+
+VMPool::Lease::Lease(Lease &&other) noexcept :
+    m_pool(other.m_pool), m_entry(std::move(other.m_entry))
+{
+    other.m_pool = nullptr;
+}
+
+VMPool::Lease::~Lease()
+{
+    if (m_pool && m_entry)
+        m_pool->release(std::move(m_entry));
+}
+
+VMPool::VMPool(unsigned max_idle) : m_max_idle(max_idle)
+{
+}
+
+VMPool::Lease VMPool::acquire()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        if (!m_idle.empty()) {
+            std::unique_ptr<Entry> entry = std::move(m_idle.back());
+            m_idle.pop_back();
+            return Lease(this, std::move(entry));
+        }
+    }
+    // Registering handlers takes a while, not under lock
+    return Lease(this, std::unique_ptr<Entry>(new Entry()));
+}
+
+unsigned VMPool::idle()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    return m_idle.size();
+}
+
+void VMPool::release(std::unique_ptr<Entry> entry)
+{
+    try {
+        // Flushes what's left to the old output
+        entry->vm.set_output(nullptr);
+    }
+    catch (std::string) {
+    }
+    entry->vm.reset();
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (m_max_idle == 0 || m_idle.size() < m_max_idle)
+        m_idle.push_back(std::move(entry));
+}
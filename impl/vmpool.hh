@@ -0,0 +1,80 @@
+#pragma once
+
+#include "vm.hh"
+#include "handlers.hh"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace impl
+{
+
+/* VMs with all handlers registered, ready for running short programs
+ * back to back. VM goes back to the pool when its lease ends, reset
+ * but keeping heap memory, so after warm-up a run doesn't allocate VM,
+ * handlers or heap. Pool is thread safe, leased VM is for one thread
+ * at a time.
+ */
+class VMPool
+{
+private:
+    struct Entry
+    {
+        Entry() : handlers(&vm) {}
+
+        /* VM holds over-aligned vector registers, which plain new
+         * doesn't align for before C++17
+         */
+        static void *operator new(size_t size);
+        static void operator delete(void *ptr);
+
+        core::VM vm;
+        Handlers handlers;
+    };
+
+public:
+    /* Leased VM, output set to it has to outlive the lease */
+    class Lease
+    {
+    public:
+        Lease(Lease &&other) noexcept;
+        ~Lease();
+
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+
+        inline core::VM &operator*() const
+        {
+            return m_entry->vm;
+        }
+        inline core::VM *operator->() const
+        {
+            return &m_entry->vm;
+        }
+
+    private:
+        friend class VMPool;
+        Lease(VMPool *pool, std::unique_ptr<Entry> entry);
+
+        VMPool *m_pool;
+        std::unique_ptr<Entry> m_entry;
+    };
+
+    /* Keeps at most max_idle VMs, zero for no limit */
+    explicit VMPool(unsigned max_idle = 0);
+
+    /* Idle VM, or new one if there is none */
+    Lease acquire();
+
+    unsigned idle();
+
+private:
+    void release(std::unique_ptr<Entry> entry);
+
+    std::mutex m_lock;
+    std::vector<std::unique_ptr<Entry>> m_idle;
+    unsigned m_max_idle;
+};
+
+}
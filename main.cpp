@@ -1,16 +1,20 @@
 #include <iostream>
-#include <fstream>
 #include <cstdint>
+#include <chrono>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <memory>
+#include <unistd.h>
 
 #include "opcodes.hh"
 #include "vm.hh"
-#include "impl/nopstop.hh"
-#include "impl/ints.hh"
-#include "impl/strs.hh"
-#include "impl/random.hh"
-#include "impl/jump.hh"
-#include "impl/mov.hh"
-#include "impl/heap.hh"
+#include "checkpoint.hh"
+#include "impl/handlers.hh"
+#include "impl/batch.hh"
+#include "impl/pool.hh"
+#include "impl/simd.hh"
+#include "opt/optimizer.hh"
 
 using namespace core;
 
@@ -22,6 +26,42 @@ void usage(std::string app)
     std::cout << "Usage: " << app << " application\n";
     std::cout << "  -h|--help      This help\n";
     std::cout << "  -d|--debug     Set debug\n";
+    std::cout << "  -O|--optimize  Optimize bytecode before running\n";
+    std::cout << "  -s|--stats     Print executed instructions and time\n";
+    std::cout << "  -j|--threads N Threads for intrinsics or batch jobs\n";
+    std::cout << "  --async-output Write output in background thread\n";
+    std::cout << "  --populate     Read whole program in before running\n";
+    std::cout << "  --snapshot F   Save state to F at SNAPSHOT instruction\n";
+    std::cout << "  --restore F    Continue from state saved to F\n";
+    std::cout << "  --batch F      Run jobs listed in F, one per line:\n";
+    std::cout << "                 program and integers for R0, R1...\n";
+    std::cout << "  --checkpoint F Keep checkpoint log in F, resume from it\n";
+    std::cout << "  --checkpoint-interval S\n";
+    std::cout << "                 Seconds between checkpoints, default 5\n";
+}
+
+static const unsigned long max_threads = 1024;
+static const unsigned long max_interval = 24 * 60 * 60;
+
+/* Whole string as decimal number not above max */
+static bool parseNumber(const char *str, unsigned long max,
+    unsigned long &res)
+{
+    // strtoul would take sign and leading space
+    if (!isdigit(str[0]))
+        return false;
+    char *end = nullptr;
+    errno = 0;
+    res = std::strtoul(str, &end, 10);
+    return *end == 0 && errno == 0 && res <= max;
+}
+
+/* Value checked by parseArgs, or def if not given */
+static unsigned long numberArg(const std::map<std::string, std::string> &args,
+    const std::string &name, unsigned long def)
+{
+    auto arg = args.find(name);
+    return arg != args.end() ? std::stoul(arg->second) : def;
 }
 
 std::map<std::string, std::string> parseArgs(int argc, char **argv)
@@ -33,6 +73,67 @@ std::map<std::string, std::string> parseArgs(int argc, char **argv)
         if (val == "-d" ||
             val == "--debug") {
             res["debug"] = "true";
+        } else if (val == "-O" ||
+            val == "--optimize") {
+            res["optimize"] = "true";
+        } else if (val == "-s" ||
+            val == "--stats") {
+            res["stats"] = "true";
+        } else if (val == "--populate") {
+            res["populate"] = "true";
+        } else if (val == "--async-output") {
+            res["async-output"] = "true";
+        } else if (val == "-j" ||
+            val == "--threads") {
+            if (i + 1 >= argc) {
+                std::cout << "\nERROR: Missing thread count\n\n";
+                usage(argv[0]);
+                exit(1);
+            }
+            unsigned long threads;
+            if (!parseNumber(argv[++i], max_threads, threads)) {
+                std::cout << "\nERROR: Invalid thread count: " << argv[i]
+                    << ", at most " << max_threads << "\n\n";
+                usage(argv[0]);
+                exit(1);
+            }
+            res["threads"] = std::to_string(threads);
+        } else if (val == "--snapshot" ||
+            val == "--restore") {
+            if (i + 1 >= argc) {
+                std::cout << "\nERROR: Missing snapshot file\n\n";
+                usage(argv[0]);
+                exit(1);
+            }
+            res[val.substr(2)] = argv[++i];
+        } else if (val == "--batch") {
+            if (i + 1 >= argc) {
+                std::cout << "\nERROR: Missing batch file\n\n";
+                usage(argv[0]);
+                exit(1);
+            }
+            res["batch"] = argv[++i];
+        } else if (val == "--checkpoint") {
+            if (i + 1 >= argc) {
+                std::cout << "\nERROR: Missing checkpoint file\n\n";
+                usage(argv[0]);
+                exit(1);
+            }
+            res["checkpoint"] = argv[++i];
+        } else if (val == "--checkpoint-interval") {
+            if (i + 1 >= argc) {
+                std::cout << "\nERROR: Missing checkpoint interval\n\n";
+                usage(argv[0]);
+                exit(1);
+            }
+            unsigned long interval;
+            if (!parseNumber(argv[++i], max_interval, interval)) {
+                std::cout << "\nERROR: Invalid checkpoint interval: "
+                    << argv[i] << ", at most " << max_interval << "\n\n";
+                usage(argv[0]);
+                exit(1);
+            }
+            res["checkpoint-interval"] = std::to_string(interval);
         } else if (val == "-h" ||
             val == "--help") {
             usage(argv[0]);
@@ -55,9 +156,76 @@ std::map<std::string, std::string> parseArgs(int argc, char **argv)
     return res;
 }
 
+int runBatch(std::map<std::string, std::string> &args)
+{
+    for (auto name : {"fname", "optimize", "snapshot", "restore",
+            "checkpoint"}) {
+        if (args.find(name) != args.end()) {
+            std::cerr << "ERROR: --batch doesn't go with "
+                << (std::string(name) == "fname" ? "application" : name)
+                << "\n";
+            return 1;
+        }
+    }
+
+    std::vector<impl::Batch::Job> jobs;
+    try {
+        jobs = impl::Batch::read(args["batch"]);
+    }
+    catch (std::string e) {
+        std::cerr << "ERROR: " << e << "\n";
+        return 1;
+    }
+
+    // Jobs take the cores, intrinsics run inline
+    impl::ThreadPool::set_shared_threads(1);
+    impl::Batch batch(numberArg(args, "threads", 0));
+
+    std::unique_ptr<Output> output;
+    if (args.find("async-output") != args.end())
+        output.reset(new AsyncOutput(STDOUT_FILENO));
+    else
+        output.reset(new FdOutput(STDOUT_FILENO));
+
+    uint64_t ticks = 0;
+    auto start = std::chrono::steady_clock::now();
+    unsigned failed;
+    try {
+        failed = batch.run(jobs, [&](unsigned idx,
+                const impl::Batch::Result &res) {
+            output->write(res.output.data(), res.output.size());
+            ticks += res.ticks;
+            if (!res.ok) {
+                // Job output is written before its error
+                output->drain();
+                std::cerr << "*** EXCEPTION in job " << idx + 1
+                    << " (" << jobs[idx].path << "): " << res.error << "\n";
+            }
+        });
+        output->drain();
+    }
+    catch (std::string e) {
+        std::cerr << "ERROR: " << e << "\n";
+        return 1;
+    }
+
+    if (args.find("stats") != args.end()) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        std::cerr << "Jobs:         " << jobs.size() << ", "
+            << failed << " failed\n";
+        std::cerr << "Threads:      " << batch.threads() << "\n";
+        std::cerr << "Instructions: " << ticks << "\n";
+        std::cerr << "Time:         " << elapsed / 1000 << " us\n";
+    }
+    return failed ? 1 : 0;
+}
+
 int main(int argc, char **argv)
 {
     std::map<std::string, std::string> args = parseArgs(argc, argv);
+    if (args.find("batch") != args.end())
+        return runBatch(args);
     auto fname = args.find("fname");
     if (fname == args.end()) {
         std::cout << "\nERROR: Missing application!\n\n";
@@ -65,32 +233,133 @@ int main(int argc, char **argv)
         return 1;
     }
 
-    std::ifstream input(fname->second, std::ios::in | std::ios::binary);
-    std::string code(
-        (std::istreambuf_iterator<char>(input)),
-        std::istreambuf_iterator<char>());
-    input.close();
+    Image image;
+    Program program;
+    try {
+        unsigned flags = Image::WillNeed;
+        if (args.find("populate") != args.end())
+            flags |= Image::Populate;
+        image.open(fname->second, flags);
+        program.load(image);
+    }
+    catch (std::string e) {
+        std::cerr << "ERROR: " << e << "\n";
+        return 1;
+    }
+
+    // Optimizer starts from address 0, other entry points run as is
+    std::string optimized;
+    if (args.find("optimize") != args.end() && program.entry() == 0) {
+        opt::Optimizer optimizer(program.memory(), program.memory_size());
+        if (optimizer.optimize()) {
+            optimized = optimizer.code();
+            program.set_memory((const uint8_t*)optimized.data(),
+                optimized.size());
+        }
+    }
+
+    impl::ThreadPool::set_shared_threads(numberArg(args, "threads", 0));
 
-    VM vm((uint8_t*)code.data(), code.length());
+    std::unique_ptr<Output> output;
+    if (args.find("async-output") != args.end())
+        output.reset(new AsyncOutput(STDOUT_FILENO));
+    else
+        output.reset(new FdOutput(STDOUT_FILENO));
+    VM vm;
+    vm.load(program);
+    vm.set_output(output.get());
     auto debug = args.find("debug");
     if (debug != args.end())
         vm.set_debug();
 
-    impl::NopStop nopstop(&vm);
-    impl::Ints ints(&vm);
-    impl::Strs strs(&vm);
-    impl::Random rand(&vm);
-    impl::Jump jump(&vm);
-    impl::Mov mov(&vm);
-    impl::Heap heap(&vm);
+    auto snapshot = args.find("snapshot");
+    impl::Handlers handlers(&vm,
+        snapshot != args.end() ? snapshot->second : "");
+
+    auto restore = args.find("restore");
+    if (restore != args.end()) {
+        try {
+            vm.restore(restore->second);
+        }
+        catch (std::string e) {
+            std::cerr << "ERROR: " << e << "\n";
+            return 1;
+        }
+    }
+
+    std::unique_ptr<Checkpoint> checkpoint;
+    auto log = args.find("checkpoint");
+    if (log != args.end()) {
+        try {
+            checkpoint.reset(new Checkpoint(vm, log->second));
+            checkpoint->restore();
+        }
+        catch (std::string e) {
+            std::cerr << "ERROR: " << e << "\n";
+            return 1;
+        }
+    }
+    auto interval = std::chrono::seconds(
+        numberArg(args, "checkpoint-interval", 5));
 
+    auto start = std::chrono::steady_clock::now();
     try {
-        while (vm.step());
+        if (checkpoint) {
+            auto next = std::chrono::steady_clock::now() + interval;
+            for (uint64_t count = 1; vm.step(); ++count) {
+                // Clock is checked only now and then, it's not free
+                if ((count & 0xffff) != 0
+                        || std::chrono::steady_clock::now() < next)
+                    continue;
+                // Output up to checkpoint is not repeated on resume
+                output->drain();
+                checkpoint->write();
+                if (checkpoint->size() > 2 * checkpoint->base_size()
+                        + (64 << 20))
+                    checkpoint->compact();
+                next = std::chrono::steady_clock::now() + interval;
+            }
+        } else {
+            while (vm.step());
+        }
+        output->drain();
+        if (checkpoint) {
+            checkpoint.reset();
+            unlink(log->second.c_str());
+        }
     }
     catch (std::string e) {
+        // Program output is written before the error
+        try {
+            output->drain();
+        }
+        catch (std::string) {
+        }
         std::cerr << "\n*** EXCEPTION: " << e << "\n";
+        uint64_t pc = vm.regs().pc();
+        std::string symbol = program.symbol(pc ? pc - 1 : 0);
+        if (!symbol.empty()) {
+            std::cerr << "At: " << symbol;
+            uint32_t line = program.line(pc ? pc - 1 : 0);
+            if (line)
+                std::cerr << ", line " << line;
+            std::cerr << "\n";
+        }
         std::cerr << "\n" << vm.regs().dump();
+        if (vm.debug())
+            std::cerr << vm.vregs().dump();
         return 1;
     }
+
+    if (args.find("stats") != args.end()) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        std::cerr << "Instructions: " << vm.ticks() << "\n";
+        std::cerr << "Time:         " << elapsed / 1000 << " us\n";
+        if (vm.ticks())
+            std::cerr << "Per insn:     "
+                << (double)elapsed / vm.ticks() << " ns\n";
+        std::cerr << "SIMD:         " << impl::Simd::isa_name() << "\n";
+    }
     return 0;
 }
@@ -0,0 +1,539 @@
+#include "decoder.hh"
+#include "impl/opcodes.hh"
+
+using impl::Opcode;
+using opt::Flow;
+using opt::Format;
+using opt::Instruction;
+using opt::Operand;
+
+/* Dedicated compare-branch and SETcc opcodes come in groups of six,
+ * in JMP_LE comparison order ==, !=, <, >, <=, >=
+ */
+static const uint8_t cmp_algos[] = {0, 5, 1, 2, 3, 4};
+
+/* Signed ones in groups of four, <, >, <=, >=
+ */
+static const uint8_t scmp_algos[] = {16, 17, 18, 19};
+
+static std::vector<uint8_t> cmp_forms(uint8_t first, uint8_t count = 6)
+{
+    std::vector<uint8_t> res;
+    for (uint8_t i = 0; i < count; ++i)
+        res.push_back(first + i);
+    return res;
+}
+
+static std::vector<Format> build_formats()
+{
+    std::vector<Format> res(256);
+
+    res[*Opcode::NOP()] = Format(Flow::Next, {});
+    res[*Opcode::SNAPSHOT()] = Format(Flow::Next, {});
+    res[*Opcode::STOP()] = Format(Flow::Stop, {});
+
+    res[*Opcode::LOAD_INT()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Byte, Operand::Src});
+    res[*Opcode::LOAD_INT_MEM()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Byte, Operand::Addr64});
+    res[*Opcode::LOAD_INT8()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Imm8});
+    res[*Opcode::LOAD_INT16()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Imm16});
+    res[*Opcode::LOAD_INT32()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Imm32});
+    res[*Opcode::LOAD_INT64()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Imm64});
+    res[*Opcode::STORE_INT()] = Format(Flow::Next,
+        {Operand::Src, Operand::Byte, Operand::Src});
+    res[*Opcode::LOAD_STR()] = Format(Flow::Next,
+        {Operand::Dst, Operand::String});
+    res[*Opcode::LOAD_STR_MEM()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Addr64});
+    res[*Opcode::STORE_STR()] = Format(Flow::Next,
+        {Operand::Src, Operand::Src});
+    res[*Opcode::STORE_STR_MEM()] = Format(Flow::Next,
+        {Operand::Src, Operand::Addr64});
+    res[*Opcode::STR_POOL()] = Format(Flow::Next, {Operand::Blob});
+    res[*Opcode::LOAD_STR_CONST()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Imm16});
+    res[*Opcode::CONCAT()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Src, Operand::Src});
+    res[*Opcode::SUBSTR()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Src, Operand::Src, Operand::Src});
+    res[*Opcode::FIND()] = res[*Opcode::CONCAT()];
+    res[*Opcode::LEN()] = Format(Flow::Next, {Operand::Dst, Operand::Src});
+    res[*Opcode::JSTR8()] = Format(Flow::Branch,
+        {Operand::Byte, Operand::Src, Operand::Src, Operand::Rel8});
+    res[*Opcode::JSTR32()] = Format(Flow::Branch,
+        {Operand::Byte, Operand::Src, Operand::Src, Operand::Rel32});
+    res[*Opcode::TO_INT()] = res[*Opcode::LEN()];
+    res[*Opcode::FROM_INT()] = res[*Opcode::LEN()];
+    // Arguments are count registers from the first one
+    res[*Opcode::FORMAT()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Src, Operand::Byte, Operand::Byte});
+
+    res[*Opcode::INC_INT()] = Format(Flow::Next, {Operand::Dst});
+    res[*Opcode::DEC_INT()] = Format(Flow::Next, {Operand::Dst});
+    res[*Opcode::ADD_INT()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Src, Operand::Src});
+    res[*Opcode::SUB_INT()] = res[*Opcode::ADD_INT()];
+    res[*Opcode::MUL_INT()] = res[*Opcode::ADD_INT()];
+    res[*Opcode::DIV_INT()] = res[*Opcode::ADD_INT()];
+    res[*Opcode::MOD_INT()] = res[*Opcode::ADD_INT()];
+
+    res[*Opcode::ADD_IMM()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Src, Operand::SizedImm});
+    res[*Opcode::SUB_IMM()] = res[*Opcode::ADD_IMM()];
+    res[*Opcode::MUL_IMM()] = res[*Opcode::ADD_IMM()];
+    res[*Opcode::DIV_IMM()] = res[*Opcode::ADD_IMM()];
+    res[*Opcode::MOD_IMM()] = res[*Opcode::ADD_IMM()];
+
+    for (uint8_t op = *Opcode::AND_INT(); op <= *Opcode::ROR_INT(); ++op)
+        res[op] = res[*Opcode::ADD_INT()];
+    for (uint8_t op = *Opcode::AND_IMM(); op <= *Opcode::ROR_IMM(); ++op)
+        res[op] = res[*Opcode::ADD_IMM()];
+    for (uint8_t op = *Opcode::NOT_INT(); op <= *Opcode::CTZ(); ++op)
+        res[op] = Format(Flow::Next, {Operand::Dst, Operand::Src});
+
+    res[*Opcode::IDIV_INT()] = res[*Opcode::ADD_INT()];
+    res[*Opcode::IMOD_INT()] = res[*Opcode::ADD_INT()];
+    res[*Opcode::IDIV_IMM()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Src, Operand::SignedImm});
+    res[*Opcode::IMOD_IMM()] = res[*Opcode::IDIV_IMM()];
+    res[*Opcode::MULH_INT()] = res[*Opcode::ADD_INT()];
+    res[*Opcode::UMULH_INT()] = res[*Opcode::ADD_INT()];
+    res[*Opcode::DIV128()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Dst, Operand::Src, Operand::Src, Operand::Src});
+
+    res[*Opcode::LOAD_FLOAT()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Imm64});
+    res[*Opcode::LOAD_FLOAT32()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Imm32});
+    for (uint8_t op = *Opcode::FADD(); op <= *Opcode::FMAX(); ++op)
+        res[op] = res[*Opcode::ADD_INT()];
+    res[*Opcode::FMA()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Src, Operand::Src, Operand::Src});
+    for (uint8_t op = *Opcode::FSQRT(); op <= *Opcode::FTOI(); ++op)
+        res[op] = Format(Flow::Next, {Operand::Dst, Operand::Src});
+
+    // Vector registers are not tracked, they are plain bytes
+    res[*Opcode::VLOAD()] = Format(Flow::Next,
+        {Operand::Byte, Operand::Byte, Operand::Src});
+    res[*Opcode::VSTORE()] = res[*Opcode::VLOAD()];
+    res[*Opcode::VSPLAT()] = res[*Opcode::VLOAD()];
+    res[*Opcode::VOP()] = Format(Flow::Next,
+        {Operand::Byte, Operand::Byte, Operand::Byte, Operand::Byte,
+         Operand::Byte});
+    res[*Opcode::VREDUCE()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Byte, Operand::Byte, Operand::Byte});
+
+    res[*Opcode::AREDUCE()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Byte, Operand::Byte, Operand::Src,
+         Operand::Src});
+    res[*Opcode::ACOUNT()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Byte, Operand::Src, Operand::Src,
+         Operand::Src});
+    res[*Opcode::ASCAN()] = Format(Flow::Next,
+        {Operand::Byte, Operand::Src, Operand::Src});
+    res[*Opcode::SORT()] = Format(Flow::Next,
+        {Operand::Byte, Operand::Src, Operand::Src, Operand::Src});
+    res[*Opcode::BSEARCH()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Byte, Operand::Src, Operand::Src,
+         Operand::Src, Operand::Src});
+
+    res[*Opcode::CRC()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Byte, Operand::Src, Operand::Src});
+    res[*Opcode::HASH()] = res[*Opcode::CRC()];
+
+    res[*Opcode::MAP_NEW()] = Format(Flow::Next, {Operand::Dst});
+    res[*Opcode::MAP_PUT()] = Format(Flow::Next,
+        {Operand::Src, Operand::Src, Operand::Src});
+    res[*Opcode::MAP_GET8()] = Format(Flow::Branch,
+        {Operand::Dst, Operand::Src, Operand::Src, Operand::Rel8});
+    res[*Opcode::MAP_GET32()] = Format(Flow::Branch,
+        {Operand::Dst, Operand::Src, Operand::Src, Operand::Rel32});
+    res[*Opcode::MAP_DEL()] = Format(Flow::Next, {Operand::Src, Operand::Src});
+    res[*Opcode::MAP_SIZE()] = Format(Flow::Next, {Operand::Dst, Operand::Src});
+
+    res[*Opcode::PRINT_INT()] = Format(Flow::Next, {Operand::Src});
+    res[*Opcode::PRINT_FLOAT()] = Format(Flow::Next, {Operand::Src});
+    res[*Opcode::PRINT_STR()] = Format(Flow::Next, {Operand::Src});
+    res[*Opcode::RANDOM()] = Format(Flow::Next, {Operand::Dst});
+
+    res[*Opcode::JMP8()] = Format(Flow::Jump, {Operand::Rel8});
+    res[*Opcode::JMP16()] = Format(Flow::Jump, {Operand::Rel16});
+    res[*Opcode::JMP32()] = Format(Flow::Jump, {Operand::Rel32});
+    res[*Opcode::JMP64()] = Format(Flow::Jump, {Operand::Abs64});
+    res[*Opcode::JMP_INT()] = Format(Flow::Indirect, {Operand::Src});
+
+    res[*Opcode::JMP_LE8()] = Format(Flow::Branch,
+        {Operand::Byte, Operand::Src, Operand::Src, Operand::Rel8});
+    res[*Opcode::JMP_LE16()] = Format(Flow::Branch,
+        {Operand::Byte, Operand::Src, Operand::Src, Operand::Rel16});
+    res[*Opcode::JMP_LE32()] = Format(Flow::Branch,
+        {Operand::Byte, Operand::Src, Operand::Src, Operand::Rel32});
+    res[*Opcode::JMP_LE64()] = Format(Flow::Branch,
+        {Operand::Byte, Operand::Src, Operand::Src, Operand::Abs64});
+    res[*Opcode::JMP_LE_INT()] = Format(Flow::Indirect,
+        {Operand::Byte, Operand::Src, Operand::Src, Operand::Src});
+
+    res[*Opcode::JMP_LE_IMM8()] = Format(Flow::Branch,
+        {Operand::Byte, Operand::Src, Operand::SizedImm, Operand::Rel8});
+    res[*Opcode::JMP_LE_IMM16()] = Format(Flow::Branch,
+        {Operand::Byte, Operand::Src, Operand::SizedImm, Operand::Rel16});
+    res[*Opcode::JMP_LE_IMM32()] = Format(Flow::Branch,
+        {Operand::Byte, Operand::Src, Operand::SizedImm, Operand::Rel32});
+
+    for (auto op : cmp_forms(*Opcode::JEQ8())) {
+        res[op] = Format(Flow::Branch,
+            {Operand::Src, Operand::Src, Operand::Rel8});
+        res[op + 6] = Format(Flow::Branch,
+            {Operand::Src, Operand::Src, Operand::Rel32});
+        res[op + 12] = Format(Flow::Branch,
+            {Operand::Src, Operand::SizedImm, Operand::Rel8});
+        res[op + 18] = Format(Flow::Branch,
+            {Operand::Src, Operand::SizedImm, Operand::Rel32});
+    }
+
+    for (auto op : cmp_forms(*Opcode::JSLT8(), 4)) {
+        res[op] = Format(Flow::Branch,
+            {Operand::Src, Operand::Src, Operand::Rel8});
+        res[op + 4] = Format(Flow::Branch,
+            {Operand::Src, Operand::Src, Operand::Rel32});
+        res[op + 8] = Format(Flow::Branch,
+            {Operand::Src, Operand::SignedImm, Operand::Rel8});
+        res[op + 12] = Format(Flow::Branch,
+            {Operand::Src, Operand::SignedImm, Operand::Rel32});
+    }
+
+    for (auto op : cmp_forms(*Opcode::JFEQ8(), 4)) {
+        res[op] = Format(Flow::Branch,
+            {Operand::Src, Operand::Src, Operand::Rel8});
+        res[op + 4] = Format(Flow::Branch,
+            {Operand::Src, Operand::Src, Operand::Rel32});
+    }
+
+    Operand rels[] = {Operand::Rel8, Operand::Rel16, Operand::Rel32};
+    for (uint8_t i = 0; i < 3; ++i) {
+        res[*Opcode::LOOP_INC8() + i] = Format(Flow::Branch,
+            {Operand::Dst, Operand::Src, rels[i]});
+        res[*Opcode::LOOP_DEC8() + i] = res[*Opcode::LOOP_INC8() + i];
+        res[*Opcode::LOOP_INC_IMM8() + i] = Format(Flow::Branch,
+            {Operand::Dst, Operand::SizedImm, rels[i]});
+        res[*Opcode::LOOP_DEC_IMM8() + i] = res[*Opcode::LOOP_INC_IMM8() + i];
+    }
+
+    res[*Opcode::MOV()] = Format(Flow::Next, {Operand::Dst, Operand::Src});
+    res[*Opcode::SELECT()] = Format(Flow::Next,
+        {Operand::Dst, Operand::Src, Operand::Src, Operand::Src});
+    for (auto op : cmp_forms(*Opcode::SETEQ()))
+        res[op] = Format(Flow::Next,
+            {Operand::Dst, Operand::Src, Operand::Src});
+    res[*Opcode::HEAP()] = Format(Flow::Next, {Operand::Src});
+    res[*Opcode::INFO()] = Format(Flow::Next, {Operand::Dst, Operand::Byte});
+
+    return res;
+}
+
+const Format &opt::format(uint8_t opcode)
+{
+    static std::vector<Format> formats = build_formats();
+    return formats[opcode];
+}
+
+static std::vector<std::vector<uint8_t>> build_families()
+{
+    std::vector<std::vector<uint8_t>> res = {
+        {*Opcode::JMP8(), *Opcode::JMP16(),
+         *Opcode::JMP32(), *Opcode::JMP64()},
+        {*Opcode::JMP_LE8(), *Opcode::JMP_LE16(),
+         *Opcode::JMP_LE32(), *Opcode::JMP_LE64()},
+        {*Opcode::JMP_LE_IMM8(), *Opcode::JMP_LE_IMM16(),
+         *Opcode::JMP_LE_IMM32()},
+    };
+
+    for (auto op : cmp_forms(*Opcode::JEQ8())) {
+        res.push_back({op, (uint8_t)(op + 6)});
+        res.push_back({(uint8_t)(op + 12), (uint8_t)(op + 18)});
+    }
+
+    for (auto op : cmp_forms(*Opcode::JSLT8(), 4)) {
+        res.push_back({op, (uint8_t)(op + 4)});
+        res.push_back({(uint8_t)(op + 8), (uint8_t)(op + 12)});
+    }
+
+    for (auto op : cmp_forms(*Opcode::JFEQ8(), 4))
+        res.push_back({op, (uint8_t)(op + 4)});
+
+    res.push_back({*Opcode::MAP_GET8(), *Opcode::MAP_GET32()});
+    res.push_back({*Opcode::JSTR8(), *Opcode::JSTR32()});
+
+    for (auto op : {*Opcode::LOOP_INC8(), *Opcode::LOOP_DEC8(),
+            *Opcode::LOOP_INC_IMM8(), *Opcode::LOOP_DEC_IMM8()})
+        res.push_back({op, (uint8_t)(op + 1), (uint8_t)(op + 2)});
+
+    return res;
+}
+
+std::vector<uint8_t> opt::jump_forms(uint8_t opcode)
+{
+    static std::vector<std::vector<uint8_t>> families = build_families();
+
+    for (auto &family : families) {
+        for (auto op : family) {
+            if (op == opcode)
+                return family;
+        }
+    }
+    return std::vector<uint8_t>();
+}
+
+int opt::branch_compare(uint8_t opcode)
+{
+    if (opcode >= *Opcode::JSLT8() && opcode <= *Opcode::JSGE_IMM32())
+        return scmp_algos[(opcode - *Opcode::JSLT8()) % 4];
+    if (opcode < *Opcode::JEQ8() || opcode > *Opcode::JGE_IMM32())
+        return -1;
+    return cmp_algos[(opcode - *Opcode::JEQ8()) % 6];
+}
+
+int opt::set_compare(uint8_t opcode)
+{
+    if (opcode < *Opcode::SETEQ() || opcode > *Opcode::SETGE())
+        return -1;
+    return cmp_algos[opcode - *Opcode::SETEQ()];
+}
+
+uint8_t opt::branch_opcode(uint8_t algo, bool imm)
+{
+    for (uint8_t i = 0; i < 6; ++i) {
+        if (cmp_algos[i] == algo)
+            return (imm ? *Opcode::JEQ_IMM8() : *Opcode::JEQ8()) + i;
+    }
+    for (uint8_t i = 0; i < 4; ++i) {
+        if (scmp_algos[i] == algo)
+            return (imm ? *Opcode::JSLT_IMM8() : *Opcode::JSLT8()) + i;
+    }
+    return 0;
+}
+
+uint64_t opt::operand_size(Operand op)
+{
+    switch (op) {
+        case Operand::Dst:
+        case Operand::Src:
+        case Operand::Byte:
+        case Operand::Imm8:
+        case Operand::Rel8:
+        case Operand::SizedImm:
+        case Operand::SignedImm:
+            return 1;
+        case Operand::Imm16:
+        case Operand::Rel16:
+            return 2;
+        case Operand::Imm32:
+        case Operand::Rel32:
+            return 4;
+        case Operand::Imm64:
+        case Operand::Addr64:
+        case Operand::Abs64:
+            return 8;
+        case Operand::String:
+            return 0;
+        case Operand::Blob:
+            return 4;
+    }
+    return 0;
+}
+
+uint8_t opt::imm_size(uint64_t val)
+{
+    uint8_t res = 0;
+    while (val != 0) {
+        ++res;
+        val >>= 8;
+    }
+    return res;
+}
+
+uint8_t opt::simm_size(uint64_t val)
+{
+    if (val == 0)
+        return 0;
+
+    int64_t sval = static_cast<int64_t>(val);
+    for (uint8_t res = 1; res < 8; ++res) {
+        int shift = 64 - res * 8;
+        if (static_cast<int64_t>(val << shift) >> shift == sval)
+            return res;
+    }
+    return 8;
+}
+
+static bool is_target(Operand op)
+{
+    return op == Operand::Rel8
+        || op == Operand::Rel16
+        || op == Operand::Rel32
+        || op == Operand::Abs64;
+}
+
+const Format &Instruction::fmt() const
+{
+    return opt::format(opcode);
+}
+
+Flow Instruction::flow() const
+{
+    return fmt().flow;
+}
+
+int Instruction::target_operand() const
+{
+    const Format &f = fmt();
+    for (size_t i = 0; i < f.operands.size(); ++i) {
+        if (is_target(f.operands[i]))
+            return i;
+    }
+    return -1;
+}
+
+uint64_t Instruction::size() const
+{
+    uint64_t res = 1;
+    const Format &f = fmt();
+    for (size_t i = 0; i < f.operands.size(); ++i) {
+        if (f.operands[i] == Operand::String)
+            res += str.length() + 1;
+        else if (f.operands[i] == Operand::Blob)
+            res += 4 + str.length();
+        else if (f.operands[i] == Operand::SizedImm)
+            res += 1 + imm_size(args[i]);
+        else if (f.operands[i] == Operand::SignedImm)
+            res += 1 + simm_size(args[i]);
+        else
+            res += operand_size(f.operands[i]);
+    }
+    return res;
+}
+
+std::string Instruction::encode() const
+{
+    std::string res;
+    res.push_back(opcode);
+
+    const Format &f = fmt();
+    for (size_t i = 0; i < f.operands.size(); ++i) {
+        if (f.operands[i] == Operand::String) {
+            res += str;
+            res.push_back(0);
+            continue;
+        }
+        if (f.operands[i] == Operand::Blob) {
+            for (uint64_t b = 4; b > 0; --b)
+                res.push_back((str.length() >> ((b - 1) * 8)) & 0xff);
+            res += str;
+            continue;
+        }
+        uint64_t bytes = operand_size(f.operands[i]);
+        if (f.operands[i] == Operand::SizedImm) {
+            bytes = imm_size(args[i]);
+            res.push_back(bytes);
+        } else if (f.operands[i] == Operand::SignedImm) {
+            bytes = simm_size(args[i]);
+            res.push_back(bytes);
+        }
+        for (uint64_t b = bytes; b > 0; --b)
+            res.push_back((args[i] >> ((b - 1) * 8)) & 0xff);
+    }
+    return res;
+}
+
+Instruction opt::decode(const uint8_t *mem, uint64_t size, uint64_t addr)
+{
+    if (addr >= size)
+        throw std::string("Decode out of bounds at ")
+            + std::to_string(addr);
+
+    Instruction res;
+    res.addr = addr;
+    res.opcode = mem[addr];
+
+    const Format &f = res.fmt();
+    if (!f.known)
+        throw std::string("Unknown opcode ")
+            + std::to_string((int)res.opcode)
+            + " at " + std::to_string(addr);
+
+    uint64_t pos = addr + 1;
+    for (auto op : f.operands) {
+        if (op == Operand::String) {
+            while (pos < size && mem[pos] != 0)
+                res.str.push_back(mem[pos++]);
+            if (pos >= size)
+                throw std::string("Unterminated string at ")
+                    + std::to_string(addr);
+            ++pos;
+            res.args.push_back(0);
+            continue;
+        }
+
+        uint64_t bytes = operand_size(op);
+        if (pos + bytes > size)
+            throw std::string("Truncated instruction at ")
+                + std::to_string(addr);
+
+        if (op == Operand::SizedImm || op == Operand::SignedImm) {
+            bytes = mem[pos++];
+            if (bytes > 8)
+                throw std::string("Invalid immediate size at ")
+                    + std::to_string(addr);
+            if (pos + bytes > size)
+                throw std::string("Truncated instruction at ")
+                    + std::to_string(addr);
+        }
+
+        uint64_t val = 0;
+        for (uint64_t b = 0; b < bytes; ++b) {
+            val <<= 8;
+            val |= mem[pos + b];
+        }
+
+        switch (op) {
+            case Operand::Rel8:
+                res.target = pos + static_cast<int8_t>(val);
+                break;
+            case Operand::Rel16:
+                res.target = pos + static_cast<int16_t>(val);
+                break;
+            case Operand::Rel32:
+                res.target = pos + static_cast<int32_t>(val);
+                break;
+            case Operand::Abs64:
+                res.target = val;
+                break;
+            case Operand::Blob:
+                if (pos + bytes + val > size)
+                    throw std::string("Truncated instruction at ")
+                        + std::to_string(addr);
+                res.str.assign((const char*)mem + pos + bytes, val);
+                pos += val;
+                break;
+            case Operand::SignedImm:
+                if (bytes > 0 && bytes < 8) {
+                    uint64_t sign = 1ULL << (bytes * 8 - 1);
+                    val = (val ^ sign) - sign;
+                }
+                break;
+            default:
+                break;
+        }
+
+        res.args.push_back(val);
+        pos += bytes;
+    }
+    res.orig_size = pos - addr;
+
+    return res;
+}
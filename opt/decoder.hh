@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace opt
+{
+
+/* Operand kinds in the encoded instruction stream.
+ * Multi byte values are big endian, like the VM reads them.
+ */
+enum class Operand : uint8_t
+{
+    Dst,        // Register written by the instruction
+    Src,        // Register, or inline immediate (reg >> 4) when above 0xf
+    Byte,       // Raw byte, like size or comparison operator
+    Imm8,
+    Imm16,
+    Imm32,
+    Imm64,
+    Addr64,     // Absolute memory address
+    Rel8,       // Jump displacement, relative to the displacement itself
+    Rel16,
+    Rel32,
+    Abs64,      // Absolute jump target
+    SizedImm,   // Size byte followed by that many bytes of immediate
+    SignedImm,  // Like SizedImm, but sign extended
+    String,     // NUL terminated string
+    Blob        // 32 bit byte count followed by that many bytes
+};
+
+enum class Flow : uint8_t
+{
+    Next,       // Continues to the next instruction
+    Jump,       // Unconditional jump
+    Branch,     // Conditional jump
+    Stop,       // Stops execution
+    Indirect    // Target is not known statically
+};
+
+class Format
+{
+public:
+    Format() : known(false), flow(Flow::Next) {}
+    Format(Flow f, std::vector<Operand> ops) :
+        known(true), flow(f), operands(ops) {}
+
+    bool known;
+    Flow flow;
+    std::vector<Operand> operands;
+};
+
+const Format &format(uint8_t opcode);
+
+/* Jump encodings of the same instruction, from the shortest to the longest.
+ * Empty if opcode is not a relaxable jump.
+ */
+std::vector<uint8_t> jump_forms(uint8_t opcode);
+
+/* JMP_LE comparison operator of dedicated compare-branch opcode,
+ * -1 for other opcodes.
+ */
+int branch_compare(uint8_t opcode);
+
+/* JMP_LE comparison operator of SETcc opcode, -1 for other opcodes.
+ */
+int set_compare(uint8_t opcode);
+
+/* Shortest dedicated compare-branch opcode for JMP_LE comparison operator,
+ * 0 if there is none.
+ */
+uint8_t branch_opcode(uint8_t algo, bool imm);
+
+class Instruction
+{
+public:
+    Instruction() : addr(0), opcode(0), target(0), orig_size(0) {}
+
+    const Format &fmt() const;
+    Flow flow() const;
+
+    /* Index of the jump target operand, -1 if none
+     */
+    int target_operand() const;
+
+    uint64_t size() const;
+    std::string encode() const;
+
+    uint64_t addr;
+    uint8_t opcode;
+    std::vector<uint64_t> args;
+    std::string str;
+    uint64_t target;
+    uint64_t orig_size;
+};
+
+Instruction decode(const uint8_t *mem, uint64_t size, uint64_t addr);
+
+uint64_t operand_size(Operand op);
+
+/* Shortest byte count able to hold value, as used by SizedImm
+ */
+uint8_t imm_size(uint64_t val);
+
+/* Shortest byte count able to hold value, as used by SignedImm
+ */
+uint8_t simm_size(uint64_t val);
+
+}
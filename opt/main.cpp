@@ -0,0 +1,86 @@
+#include <iostream>
+#include <fstream>
+#include <cstdint>
+
+#include "optimizer.hh"
+
+#include <map>
+#include <string>
+
+void usage(std::string app)
+{
+    std::cout << "Usage: " << app << " input output\n";
+    std::cout << "  -h|--help      This help\n";
+    std::cout << "  -v|--verbose   Print statistics\n";
+}
+
+std::map<std::string, std::string> parseArgs(int argc, char **argv)
+{
+    std::map<std::string, std::string> res;
+    for (int i = 1; i < argc; ++i) {
+        std::string val = argv[i];
+        if (val == "-v" ||
+            val == "--verbose") {
+            res["verbose"] = "true";
+        } else if (val == "-h" ||
+            val == "--help") {
+            usage(argv[0]);
+            exit(0);
+        } else if (val[0] != '-') {
+            if (res.find("input") == res.end()) {
+                res["input"] = val;
+            } else if (res.find("output") == res.end()) {
+                res["output"] = val;
+            } else {
+                std::cout << "\nERROR: Too many arguments: " << val << "\n\n";
+                usage(argv[0]);
+                exit(1);
+            }
+        } else {
+            std::cout << "\nERROR: Invalid arugment: " << val << "\n\n";
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+    return res;
+}
+
+int main(int argc, char **argv)
+{
+    std::map<std::string, std::string> args = parseArgs(argc, argv);
+    if (args.find("output") == args.end()) {
+        std::cout << "\nERROR: Missing input or output!\n\n";
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::ifstream input(args["input"], std::ios::in | std::ios::binary);
+    if (!input) {
+        std::cerr << "ERROR: Can't open " << args["input"] << "\n";
+        return 1;
+    }
+    std::string code(
+        (std::istreambuf_iterator<char>(input)),
+        std::istreambuf_iterator<char>());
+    input.close();
+
+    opt::Optimizer optimizer((const uint8_t*)code.data(), code.length());
+    if (!optimizer.optimize())
+        std::cerr << "WARNING: Not optimized: " << optimizer.reason() << "\n";
+
+    if (args.find("verbose") != args.end()) {
+        std::cout << "Instructions: " << optimizer.instructions_before()
+                  << " -> " << optimizer.instructions_after() << "\n";
+        std::cout << "Bytes:        " << code.length()
+                  << " -> " << optimizer.code().length() << "\n";
+    }
+
+    std::ofstream output(args["output"], std::ios::out | std::ios::binary);
+    output << optimizer.code();
+    if (!output) {
+        std::cerr << "ERROR: Can't write " << args["output"] << "\n";
+        return 1;
+    }
+
+    return 0;
+}
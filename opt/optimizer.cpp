@@ -0,0 +1,966 @@
+#include "optimizer.hh"
+#include "impl/opcodes.hh"
+#include "impl/ints.hh"
+#include "impl/jump.hh"
+#include "regs.hh"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <set>
+
+using impl::Opcode;
+using opt::Flow;
+using opt::Format;
+using opt::Instruction;
+using opt::Operand;
+using opt::Optimizer;
+
+class Optimizer::Value
+{
+public:
+    enum Kind : uint8_t
+    {
+        Unknown,
+        Int,
+        Const,
+        Str
+    };
+
+    Value() : kind(Unknown), val(0) {}
+    Value(Kind k, uint64_t v = 0) : kind(k), val(v) {}
+
+    inline bool is_int() const
+    {
+        return kind == Int || kind == Const;
+    }
+    inline bool is_const(uint64_t v) const
+    {
+        return kind == Const && val == v;
+    }
+
+    bool operator==(const Value &other) const
+    {
+        return kind == other.kind
+            && (kind != Const || val == other.val);
+    }
+    bool operator!=(const Value &other) const
+    {
+        return !(*this == other);
+    }
+
+    Kind kind;
+    uint64_t val;
+};
+
+/* Register form of immediate arithmetic, other opcodes as is
+ */
+static uint8_t reg_form(uint8_t op)
+{
+    if (op == *Opcode::ADD_IMM())
+        return *Opcode::ADD_INT();
+    if (op == *Opcode::SUB_IMM())
+        return *Opcode::SUB_INT();
+    if (op == *Opcode::MUL_IMM())
+        return *Opcode::MUL_INT();
+    if (op == *Opcode::DIV_IMM())
+        return *Opcode::DIV_INT();
+    if (op == *Opcode::MOD_IMM())
+        return *Opcode::MOD_INT();
+    if (op == *Opcode::IDIV_IMM())
+        return *Opcode::IDIV_INT();
+    if (op == *Opcode::IMOD_IMM())
+        return *Opcode::IMOD_INT();
+    if (op >= *Opcode::AND_IMM() && op <= *Opcode::ROR_IMM())
+        return op - *Opcode::AND_IMM() + *Opcode::AND_INT();
+    return op;
+}
+
+static bool is_arith(uint8_t op)
+{
+    op = reg_form(op);
+    return op == *Opcode::ADD_INT()
+        || op == *Opcode::SUB_INT()
+        || op == *Opcode::MUL_INT()
+        || op == *Opcode::DIV_INT()
+        || op == *Opcode::MOD_INT()
+        || op == *Opcode::IDIV_INT()
+        || op == *Opcode::IMOD_INT()
+        || op == *Opcode::MULH_INT()
+        || op == *Opcode::UMULH_INT()
+        || (op >= *Opcode::AND_INT() && op <= *Opcode::ROR_INT());
+}
+
+static bool is_unary(uint8_t op)
+{
+    return op >= *Opcode::NOT_INT() && op <= *Opcode::CTZ();
+}
+
+static bool is_load_imm(uint8_t op)
+{
+    return op == *Opcode::LOAD_INT8()
+        || op == *Opcode::LOAD_INT16()
+        || op == *Opcode::LOAD_INT32()
+        || op == *Opcode::LOAD_INT64();
+}
+
+static bool fold(uint8_t op, uint64_t val1, uint64_t val2, uint64_t &res)
+{
+    op = reg_form(op);
+    if (op == *Opcode::ADD_INT())
+        res = val1 + val2;
+    else if (op == *Opcode::SUB_INT())
+        res = val1 - val2;
+    else if (op == *Opcode::MUL_INT())
+        res = val1 * val2;
+    else if (op == *Opcode::DIV_INT() && val2 != 0)
+        res = val1 / val2;
+    else if (op == *Opcode::MOD_INT() && val2 != 0)
+        res = val1 % val2;
+    else if (op == *Opcode::IDIV_INT() && val2 != 0)
+        res = impl::Ints::idiv(val1, val2);
+    else if (op == *Opcode::IMOD_INT() && val2 != 0)
+        res = impl::Ints::imod(val1, val2);
+    else if (op == *Opcode::MULH_INT())
+        res = impl::Ints::mulh(val1, val2);
+    else if (op == *Opcode::UMULH_INT())
+        res = impl::Ints::umulh(val1, val2);
+    else if (op == *Opcode::AND_INT())
+        res = impl::Ints::bit_and(val1, val2);
+    else if (op == *Opcode::OR_INT())
+        res = impl::Ints::bit_or(val1, val2);
+    else if (op == *Opcode::XOR_INT())
+        res = impl::Ints::bit_xor(val1, val2);
+    else if (op == *Opcode::SHL_INT())
+        res = impl::Ints::shl(val1, val2);
+    else if (op == *Opcode::SHR_INT())
+        res = impl::Ints::shr(val1, val2);
+    else if (op == *Opcode::SAR_INT())
+        res = impl::Ints::sar(val1, val2);
+    else if (op == *Opcode::ROL_INT())
+        res = impl::Ints::rol(val1, val2);
+    else if (op == *Opcode::ROR_INT())
+        res = impl::Ints::ror(val1, val2);
+    else
+        return false;
+    return true;
+}
+
+static uint64_t fold_unary(uint8_t op, uint64_t val)
+{
+    if (op == *Opcode::NOT_INT())
+        return impl::Ints::bit_not(val);
+    if (op == *Opcode::POPCNT())
+        return impl::Ints::popcnt(val);
+    if (op == *Opcode::CLZ())
+        return impl::Ints::clz(val);
+    return impl::Ints::ctz(val);
+}
+
+/* Shift count of power of two, -1 for other values
+ */
+static int log2_exact(uint64_t val)
+{
+    if (val == 0 || (val & (val - 1)) != 0)
+        return -1;
+    return impl::Ints::ctz(val);
+}
+
+static bool is_loop(uint8_t op)
+{
+    return op >= *Opcode::LOOP_INC8() && op <= *Opcode::LOOP_DEC_IMM32();
+}
+
+static bool is_float_branch(uint8_t op)
+{
+    return op >= *Opcode::JFEQ8() && op <= *Opcode::JFLE32();
+}
+
+static bool is_map_branch(uint8_t op)
+{
+    return op == *Opcode::MAP_GET8() || op == *Opcode::MAP_GET32();
+}
+
+static bool is_str_branch(uint8_t op)
+{
+    return op == *Opcode::JSTR8() || op == *Opcode::JSTR32();
+}
+
+static Instruction make(const Instruction &orig, uint8_t opcode,
+    std::vector<uint64_t> args)
+{
+    Instruction res;
+    res.addr = orig.addr;
+    res.orig_size = orig.orig_size;
+    res.opcode = opcode;
+    res.args = args;
+    return res;
+}
+
+static Instruction make_load(const Instruction &orig, uint8_t reg, uint64_t val)
+{
+    uint8_t op = *Opcode::LOAD_INT64();
+    if (val <= 0xff)
+        op = *Opcode::LOAD_INT8();
+    else if (val <= 0xffff)
+        op = *Opcode::LOAD_INT16();
+    else if (val <= 0xffffffff)
+        op = *Opcode::LOAD_INT32();
+
+    return make(orig, op, {reg, val});
+}
+
+static Instruction make_mov(const Instruction &orig, uint8_t dst, uint8_t src)
+{
+    if (dst == src)
+        return make(orig, *Opcode::NOP(), {});
+    return make(orig, *Opcode::MOV(), {dst, src});
+}
+
+static bool fits(Operand op, int64_t diff)
+{
+    switch (op) {
+        case Operand::Rel8:
+            return diff >= INT8_MIN && diff <= INT8_MAX;
+        case Operand::Rel16:
+            return diff >= INT16_MIN && diff <= INT16_MAX;
+        case Operand::Rel32:
+            return diff >= INT32_MIN && diff <= INT32_MAX;
+        case Operand::Abs64:
+            return true;
+        default:
+            return false;
+    }
+}
+
+Optimizer::Optimizer(const uint8_t *mem, uint64_t size) :
+    m_mem(mem), m_size(size),
+    m_new_size(0),
+    m_before(0), m_after(0)
+{
+}
+
+bool Optimizer::optimize()
+{
+    try {
+        decode_all();
+        find_data();
+        propagate();
+        fuse_loops();
+        thread_jumps();
+        remove_unreachable();
+        layout();
+    }
+    catch (std::string e) {
+        m_reason = e;
+        m_code = std::string((const char*)m_mem, m_size);
+        m_after = m_before;
+        return false;
+    }
+    return true;
+}
+
+void Optimizer::decode_all()
+{
+    if (m_mem == nullptr || m_size == 0)
+        throw std::string("Empty program");
+
+    std::vector<uint64_t> work = {0};
+    while (!work.empty()) {
+        uint64_t addr = work.back();
+        work.pop_back();
+
+        if (addr == m_size || m_insts.find(addr) != m_insts.end())
+            continue;
+        if (addr > m_size)
+            throw std::string("Jump out of bounds to ")
+                + std::to_string(addr);
+
+        Instruction inst = decode(m_mem, m_size, addr);
+        if (inst.flow() == Flow::Indirect)
+            throw std::string("Indirect jump at ")
+                + std::to_string(addr);
+
+        const Format &f = inst.fmt();
+        for (size_t i = 0; i < f.operands.size(); ++i) {
+            if (f.operands[i] == Operand::Dst && inst.args[i] == 0xff)
+                throw std::string("Program counter write at ")
+                    + std::to_string(addr);
+        }
+
+        if (inst.flow() == Flow::Next || inst.flow() == Flow::Branch)
+            work.push_back(addr + inst.orig_size);
+        if (inst.flow() == Flow::Jump || inst.flow() == Flow::Branch)
+            work.push_back(inst.target);
+
+        m_insts[addr] = inst;
+    }
+
+    uint64_t end = 0;
+    for (auto &it : m_insts) {
+        if (it.first < end)
+            throw std::string("Overlapping instructions at ")
+                + std::to_string(it.first);
+        end = it.first + it.second.orig_size;
+    }
+
+    m_before = m_insts.size();
+}
+
+void Optimizer::find_data()
+{
+    for (auto &it : m_insts) {
+        const Instruction &inst = it.second;
+        uint64_t addr;
+        uint64_t end;
+        if (inst.opcode == *Opcode::LOAD_INT_MEM() && inst.args[1] != 0) {
+            addr = inst.args[2];
+            if (addr >= m_size)
+                continue;
+            end = std::min(addr + inst.args[1], m_size);
+        } else if (inst.opcode == *Opcode::LOAD_STR_MEM()) {
+            addr = inst.args[1];
+            if (addr >= m_size)
+                continue;
+            // String with its terminating NUL
+            const void *nul = std::memchr(m_mem + addr, 0, m_size - addr);
+            end = nul ? (const uint8_t*)nul - m_mem + 1 : m_size;
+        } else {
+            continue;
+        }
+
+        auto next = m_insts.lower_bound(addr);
+        if (next != m_insts.end() && next->first < end)
+            throw std::string("Program reads its own code at ")
+                + std::to_string(it.first);
+        if (next != m_insts.begin()) {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second.orig_size > addr)
+                throw std::string("Program reads its own code at ")
+                    + std::to_string(it.first);
+        }
+        m_refs.push_back(std::make_pair(addr, end));
+    }
+
+    uint64_t pos = 0;
+    auto it = m_insts.begin();
+    while (pos < m_size) {
+        if (it != m_insts.end() && it->first == pos) {
+            pos += it->second.orig_size;
+            ++it;
+            continue;
+        }
+
+        // Keep only referenced part of the gap
+        uint64_t end = (it == m_insts.end()) ? m_size : it->first;
+        uint64_t first = end;
+        uint64_t last = pos;
+        for (auto &ref : m_refs) {
+            if (ref.first < end && ref.second > pos) {
+                first = std::min(first, std::max(ref.first, pos));
+                last = std::max(last, std::min(ref.second, end));
+            }
+        }
+        if (first < last)
+            m_data[first] = std::string((const char*)m_mem + first,
+                last - first);
+        pos = end;
+    }
+}
+
+std::vector<uint64_t> Optimizer::successors(const Instruction &inst) const
+{
+    std::vector<uint64_t> res;
+    if (inst.flow() == Flow::Next || inst.flow() == Flow::Branch)
+        res.push_back(inst.addr + inst.orig_size);
+    if (inst.flow() == Flow::Jump || inst.flow() == Flow::Branch)
+        res.push_back(inst.target);
+    return res;
+}
+
+void Optimizer::transfer(const Instruction &inst, State &state) const
+{
+    uint8_t op = inst.opcode;
+    const std::vector<uint64_t> &args = inst.args;
+
+    auto src = [&](uint64_t reg) -> Value {
+        if (reg > 0xf)
+            return Value(Value::Const, reg >> 4);
+        return state[reg];
+    };
+    auto arg = [&](size_t idx) -> Value {
+        if (inst.fmt().operands[idx] == Operand::SizedImm
+            || inst.fmt().operands[idx] == Operand::SignedImm)
+            return Value(Value::Const, args[idx]);
+        return src(args[idx]);
+    };
+    auto set = [&](uint64_t reg, Value val) {
+        if (reg < core::num_registers)
+            state[reg] = val;
+    };
+
+    if (is_load_imm(op)) {
+        set(args[0], Value(Value::Const, args[1]));
+    } else if (op == *Opcode::LOAD_STR()
+        || op == *Opcode::LOAD_STR_CONST()
+        || op == *Opcode::CONCAT()
+        || op == *Opcode::SUBSTR()
+        || op == *Opcode::FROM_INT()
+        || op == *Opcode::FORMAT()) {
+        set(args[0], Value(Value::Str));
+    } else if (op == *Opcode::INC_INT() || op == *Opcode::DEC_INT()) {
+        Value val = src(args[0]);
+        if (val.kind == Value::Const)
+            val.val += (op == *Opcode::INC_INT()) ? 1 : -1;
+        else
+            val = Value(Value::Int);
+        set(args[0], val);
+    } else if (is_arith(op)) {
+        Value val1 = arg(1);
+        Value val2 = arg(2);
+        uint64_t res = 0;
+        if (val1.kind == Value::Const && val2.kind == Value::Const
+            && fold(op, val1.val, val2.val, res))
+            set(args[0], Value(Value::Const, res));
+        else
+            set(args[0], Value(Value::Int));
+    } else if (is_unary(op)) {
+        Value val = src(args[1]);
+        if (val.kind == Value::Const)
+            set(args[0], Value(Value::Const, fold_unary(op, val.val)));
+        else
+            set(args[0], Value(Value::Int));
+    } else if (op == *Opcode::MOV()) {
+        if (args[1] < core::num_registers)
+            set(args[0], state[args[1]]);
+        else
+            set(args[0], Value());
+    } else if (op == *Opcode::SELECT()) {
+        Value cond = src(args[1]);
+        Value val1 = src(args[2]);
+        Value val2 = src(args[3]);
+        if (cond.kind == Value::Const)
+            set(args[0], cond.val ? val1 : val2);
+        else if (val1 == val2)
+            set(args[0], val1);
+        else if (val1.is_int() && val2.is_int())
+            set(args[0], Value(Value::Int));
+        else
+            set(args[0], Value());
+    } else if (set_compare(op) >= 0) {
+        Value val1 = src(args[1]);
+        Value val2 = src(args[2]);
+        if (val1.kind == Value::Const && val2.kind == Value::Const)
+            set(args[0], Value(Value::Const,
+                impl::Jump::compare(set_compare(op), val1.val, val2.val)));
+        else
+            set(args[0], Value(Value::Int));
+    } else if (is_loop(op)) {
+        set(args[0], Value(Value::Int));
+    } else if (op == *Opcode::LOAD_INT()
+        || op == *Opcode::LOAD_INT_MEM()
+        || op == *Opcode::INFO()
+        || op == *Opcode::RANDOM()
+        || op == *Opcode::FTOI()
+        || op == *Opcode::ACOUNT()
+        || op == *Opcode::BSEARCH()
+        || op == *Opcode::CRC()
+        || op == *Opcode::HASH()
+        || op == *Opcode::MAP_NEW()
+        || op == *Opcode::MAP_SIZE()
+        || op == *Opcode::FIND()
+        || op == *Opcode::LEN()
+        || op == *Opcode::TO_INT()) {
+        set(args[0], Value(Value::Int));
+    } else {
+        const Format &f = inst.fmt();
+        for (size_t i = 0; i < f.operands.size(); ++i) {
+            if (f.operands[i] == Operand::Dst)
+                set(args[i], Value());
+        }
+    }
+}
+
+bool Optimizer::merge(State &dst, const State &src) const
+{
+    bool changed = false;
+    for (size_t i = 0; i < dst.size(); ++i) {
+        if (dst[i] == src[i] || dst[i].kind == Value::Unknown)
+            continue;
+        if (dst[i].is_int() && src[i].is_int())
+            dst[i] = Value(Value::Int);
+        else
+            dst[i] = Value();
+        changed = true;
+    }
+    return changed;
+}
+
+void Optimizer::rewrite(Instruction &inst, const State &state)
+{
+    uint8_t op = inst.opcode;
+    const std::vector<uint64_t> &args = inst.args;
+
+    auto src = [&](uint64_t reg) -> Value {
+        if (reg > 0xf)
+            return Value(Value::Const, reg >> 4);
+        return state[reg];
+    };
+    auto arg = [&](size_t idx) -> Value {
+        if (inst.fmt().operands[idx] == Operand::SizedImm
+            || inst.fmt().operands[idx] == Operand::SignedImm)
+            return Value(Value::Const, args[idx]);
+        return src(args[idx]);
+    };
+
+    if (op == *Opcode::INC_INT() || op == *Opcode::DEC_INT()) {
+        Value val = src(args[0]);
+        if (args[0] < core::num_registers && val.kind == Value::Const)
+            inst = make_load(inst, args[0],
+                val.val + ((op == *Opcode::INC_INT()) ? 1 : -1));
+    } else if (is_arith(op) && args[0] < core::num_registers) {
+        uint8_t dst = args[0];
+        Value val1 = arg(1);
+        Value val2 = arg(2);
+        uint64_t res = 0;
+
+        if (val1.kind == Value::Const && val2.kind == Value::Const) {
+            if (fold(op, val1.val, val2.val, res))
+                inst = make_load(inst, dst, res);
+            return;
+        }
+
+        // Strength reduction, other operand is known integer register
+        op = reg_form(op);
+        if (op == *Opcode::ADD_INT()) {
+            if (val2.is_const(0) && val1.is_int())
+                inst = make_mov(inst, dst, args[1]);
+            else if (val1.is_const(0) && val2.is_int())
+                inst = make_mov(inst, dst, args[2]);
+        } else if (op == *Opcode::SUB_INT()) {
+            if (val2.is_const(0) && val1.is_int())
+                inst = make_mov(inst, dst, args[1]);
+        } else if (op == *Opcode::MUL_INT()) {
+            if (val2.is_const(1) && val1.is_int())
+                inst = make_mov(inst, dst, args[1]);
+            else if (val1.is_const(1) && val2.is_int())
+                inst = make_mov(inst, dst, args[2]);
+            else if ((val2.is_const(0) && val1.is_int())
+                || (val1.is_const(0) && val2.is_int()))
+                inst = make_load(inst, dst, 0);
+            else if (val2.is_const(2) && val1.is_int())
+                inst = make(inst, *Opcode::ADD_INT(),
+                    {dst, args[1], args[1]});
+            else if (val1.is_const(2) && val2.is_int())
+                inst = make(inst, *Opcode::ADD_INT(),
+                    {dst, args[2], args[2]});
+            else if (log2_exact(val2.val) > 0 && val2.kind == Value::Const
+                && val1.is_int())
+                inst = make(inst, *Opcode::SHL_IMM(),
+                    {dst, args[1], (uint64_t)log2_exact(val2.val)});
+            else if (log2_exact(val1.val) > 0 && val1.kind == Value::Const
+                && val2.is_int())
+                inst = make(inst, *Opcode::SHL_IMM(),
+                    {dst, args[2], (uint64_t)log2_exact(val1.val)});
+        } else if (op == *Opcode::DIV_INT()) {
+            if (val2.is_const(1) && val1.is_int())
+                inst = make_mov(inst, dst, args[1]);
+            else if (log2_exact(val2.val) > 0 && val2.kind == Value::Const
+                && val1.is_int())
+                inst = make(inst, *Opcode::SHR_IMM(),
+                    {dst, args[1], (uint64_t)log2_exact(val2.val)});
+        } else if (op == *Opcode::MOD_INT()) {
+            if (val2.is_const(1) && val1.is_int())
+                inst = make_load(inst, dst, 0);
+            else if (log2_exact(val2.val) > 0 && val2.kind == Value::Const
+                && val1.is_int())
+                inst = make(inst, *Opcode::AND_IMM(),
+                    {dst, args[1], val2.val - 1});
+        } else if (op == *Opcode::IDIV_INT()) {
+            if (val2.is_const(1) && val1.is_int())
+                inst = make_mov(inst, dst, args[1]);
+        } else if (op == *Opcode::IMOD_INT()) {
+            if (val2.is_const(1) && val1.is_int())
+                inst = make_load(inst, dst, 0);
+        } else if (op == *Opcode::AND_INT()) {
+            if ((val2.is_const(0) && val1.is_int())
+                || (val1.is_const(0) && val2.is_int()))
+                inst = make_load(inst, dst, 0);
+        } else if (op >= *Opcode::OR_INT() && op <= *Opcode::ROR_INT()) {
+            if (val2.is_const(0) && val1.is_int())
+                inst = make_mov(inst, dst, args[1]);
+        }
+    } else if (is_unary(op) && args[0] < core::num_registers) {
+        Value val = src(args[1]);
+        if (val.kind == Value::Const)
+            inst = make_load(inst, args[0], fold_unary(op, val.val));
+    } else if (op == *Opcode::MOV()) {
+        if (args[0] < core::num_registers
+            && args[1] < core::num_registers
+            && state[args[1]].kind == Value::Const) {
+            // Only when it doesn't grow the code
+            Instruction load = make_load(inst, args[0], state[args[1]].val);
+            if (load.size() <= inst.size())
+                inst = load;
+        }
+    } else if (op == *Opcode::SELECT() && args[0] < core::num_registers) {
+        // Known condition, or both choices the same
+        Value cond = src(args[1]);
+        if (cond.kind != Value::Const && args[2] != args[3])
+            return;
+        uint64_t reg = (cond.kind != Value::Const || cond.val)
+            ? args[2] : args[3];
+        if (reg > 0xf)
+            inst = make_load(inst, args[0], reg >> 4);
+        else
+            inst = make_mov(inst, args[0], reg);
+    } else if (set_compare(op) >= 0 && args[0] < core::num_registers) {
+        Value val1 = src(args[1]);
+        Value val2 = src(args[2]);
+        if (val1.kind == Value::Const && val2.kind == Value::Const)
+            inst = make_load(inst, args[0],
+                impl::Jump::compare(set_compare(op), val1.val, val2.val));
+    } else if (inst.flow() == Flow::Branch && !jump_forms(op).empty()
+        && !is_loop(op) && !is_float_branch(op) && !is_map_branch(op)
+        && !is_str_branch(op)) {
+        int algo = branch_compare(op);
+        size_t first = 0;
+        if (algo < 0) {
+            algo = args[0];
+            first = 1;
+        }
+
+        Value val1 = arg(first);
+        Value val2 = arg(first + 1);
+        if (val1.kind != Value::Const || val2.kind != Value::Const) {
+            // Comparison in opcode is not decoded on every execution
+            uint8_t cmp = 0;
+            if (first == 1)
+                cmp = branch_opcode(algo,
+                    inst.fmt().operands[2] == Operand::SizedImm);
+            if (cmp != 0) {
+                uint64_t target = inst.target;
+                inst = make(inst, cmp, {args[1], args[2], 0});
+                inst.target = target;
+            }
+            return;
+        }
+        if (algo > 19 || (algo == 15 && val2.val == 0))
+            return;
+
+        if (impl::Jump::compare(algo, val1.val, val2.val)) {
+            uint64_t target = inst.target;
+            inst = make(inst, *Opcode::JMP32(), {0});
+            inst.target = target;
+        } else {
+            inst = make(inst, *Opcode::NOP(), {});
+        }
+    }
+}
+
+void Optimizer::propagate()
+{
+    std::set<uint64_t> leaders = {0};
+    for (auto &it : m_insts) {
+        const Instruction &inst = it.second;
+        if (inst.flow() == Flow::Jump || inst.flow() == Flow::Branch)
+            leaders.insert(inst.target);
+        if (inst.flow() != Flow::Next)
+            leaders.insert(inst.addr + inst.orig_size);
+    }
+
+    auto block = [&](uint64_t leader) {
+        std::vector<uint64_t> res;
+        uint64_t addr = leader;
+        while (true) {
+            const Instruction &inst = m_insts.at(addr);
+            res.push_back(addr);
+            addr += inst.orig_size;
+            if (inst.flow() != Flow::Next
+                || leaders.count(addr)
+                || m_insts.find(addr) == m_insts.end())
+                break;
+        }
+        return res;
+    };
+
+    std::map<uint64_t, State> in;
+    in[0] = State(core::num_registers);
+
+    std::vector<uint64_t> work = {0};
+    while (!work.empty()) {
+        uint64_t leader = work.back();
+        work.pop_back();
+
+        State state = in[leader];
+        std::vector<uint64_t> addrs = block(leader);
+        for (auto addr : addrs)
+            transfer(m_insts.at(addr), state);
+
+        for (auto succ : successors(m_insts.at(addrs.back()))) {
+            if (m_insts.find(succ) == m_insts.end())
+                continue;
+            auto dst = in.find(succ);
+            if (dst == in.end()) {
+                in[succ] = state;
+                work.push_back(succ);
+            } else if (merge(dst->second, state)) {
+                work.push_back(succ);
+            }
+        }
+    }
+
+    for (auto &entry : in) {
+        State state = entry.second;
+        for (auto addr : block(entry.first)) {
+            Instruction &inst = m_insts.at(addr);
+            rewrite(inst, state);
+            transfer(inst, state);
+        }
+    }
+
+    for (auto it = m_insts.begin(); it != m_insts.end();) {
+        if (it->second.opcode == *Opcode::NOP()) {
+            m_removed[it->first] = it->second.orig_size;
+            it = m_insts.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void Optimizer::fuse_loops()
+{
+    std::set<uint64_t> targets;
+    for (auto &it : m_insts) {
+        const Instruction &inst = it.second;
+        if (inst.flow() == Flow::Jump || inst.flow() == Flow::Branch)
+            targets.insert(forward(inst.target));
+    }
+
+    // INC/DEC of counter followed by compare-branch on it.
+    // Jumps to the INC end up to the loop instruction, which includes it.
+    for (auto it = m_insts.begin(); it != m_insts.end();) {
+        const Instruction &step = it->second;
+        auto next = m_insts.find(forward(step.addr + step.orig_size));
+        if ((step.opcode != *Opcode::INC_INT()
+                && step.opcode != *Opcode::DEC_INT())
+            || step.args[0] >= core::num_registers
+            || next == m_insts.end()
+            || targets.count(next->first)) {
+            ++it;
+            continue;
+        }
+
+        Instruction &branch = next->second;
+        bool inc = step.opcode == *Opcode::INC_INT();
+        bool imm = branch.fmt().operands.size() == 3
+            && branch.fmt().operands[1] == Operand::SizedImm;
+        int algo = branch_compare(branch.opcode);
+        if (branch.args.empty() || branch.args[0] != step.args[0]
+            || !(algo == (inc ? 1 : 2)
+                || (!inc && algo == 5 && imm && branch.args[1] == 0))) {
+            ++it;
+            continue;
+        }
+
+        uint8_t op = inc
+            ? (imm ? *Opcode::LOOP_INC_IMM8() : *Opcode::LOOP_INC8())
+            : (imm ? *Opcode::LOOP_DEC_IMM8() : *Opcode::LOOP_DEC8());
+        uint64_t target = branch.target;
+        branch = make(branch, op, {step.args[0], branch.args[1], 0});
+        branch.target = target;
+
+        m_removed[it->first] = step.orig_size;
+        it = m_insts.erase(it);
+    }
+}
+
+uint64_t Optimizer::forward(uint64_t addr) const
+{
+    auto it = m_removed.find(addr);
+    while (it != m_removed.end()) {
+        addr += it->second;
+        it = m_removed.find(addr);
+    }
+    return addr;
+}
+
+void Optimizer::thread_jumps()
+{
+    for (auto &it : m_insts) {
+        Instruction &inst = it.second;
+        if (inst.flow() != Flow::Jump && inst.flow() != Flow::Branch)
+            continue;
+
+        std::set<uint64_t> seen;
+        uint64_t target = forward(inst.target);
+        while (seen.find(target) == seen.end()) {
+            auto next = m_insts.find(target);
+            if (next == m_insts.end() || next->second.flow() != Flow::Jump)
+                break;
+            seen.insert(target);
+            target = forward(next->second.target);
+        }
+        inst.target = target;
+    }
+}
+
+void Optimizer::remove_unreachable()
+{
+    std::set<uint64_t> reached;
+    std::vector<uint64_t> work = {forward(0)};
+    while (!work.empty()) {
+        uint64_t addr = work.back();
+        work.pop_back();
+
+        auto it = m_insts.find(addr);
+        if (it == m_insts.end() || reached.count(addr))
+            continue;
+        reached.insert(addr);
+        for (auto succ : successors(it->second))
+            work.push_back(forward(succ));
+    }
+
+    for (auto it = m_insts.begin(); it != m_insts.end();) {
+        if (!reached.count(it->first)) {
+            m_removed[it->first] = it->second.orig_size;
+            it = m_insts.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+uint64_t Optimizer::relocate(uint64_t addr) const
+{
+    if (addr >= m_size)
+        return addr - m_size + m_new_size;
+
+    auto it = m_data.upper_bound(addr);
+    if (it != m_data.begin()) {
+        --it;
+        if (addr < it->first + it->second.length())
+            return m_new_addr.at(it->first) + (addr - it->first);
+    }
+    throw std::string("Can't relocate address ") + std::to_string(addr);
+}
+
+void Optimizer::layout()
+{
+    // Items in original order, true for instructions
+    std::map<uint64_t, bool> items;
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        items.clear();
+        for (auto &it : m_insts)
+            items[it.first] = true;
+        for (auto &it : m_data)
+            items[it.first] = false;
+
+        // Unconditional jumps to next item are not needed
+        for (auto it = items.begin(); it != items.end(); ++it) {
+            if (!it->second)
+                continue;
+            const Instruction &inst = m_insts.at(it->first);
+            if (inst.flow() != Flow::Jump)
+                continue;
+            auto next = std::next(it);
+            uint64_t target = forward(inst.target);
+            if ((next == items.end() && target == m_size)
+                || (next != items.end() && next->second
+                    && next->first == target)) {
+                m_removed[inst.addr] = inst.orig_size;
+                m_insts.erase(inst.addr);
+                changed = true;
+                break;
+            }
+        }
+    }
+
+    for (auto &it : m_insts) {
+        std::vector<uint8_t> forms = jump_forms(it.second.opcode);
+        if (!forms.empty())
+            it.second.opcode = forms[0];
+    }
+
+    auto new_target = [&](const Instruction &inst) -> uint64_t {
+        uint64_t target = forward(inst.target);
+        if (target == m_size)
+            return m_new_size;
+        auto it = m_new_addr.find(target);
+        if (it == m_new_addr.end() || !items[target])
+            throw std::string("Invalid jump target ")
+                + std::to_string(target);
+        return it->second;
+    };
+
+    changed = true;
+    while (changed) {
+        changed = false;
+
+        uint64_t pos = 0;
+        for (auto &item : items) {
+            m_new_addr[item.first] = pos;
+            if (item.second)
+                pos += m_insts.at(item.first).size();
+            else
+                pos += m_data.at(item.first).length();
+        }
+        m_new_size = pos;
+
+        for (auto &it : m_insts) {
+            Instruction &inst = it.second;
+            int idx = inst.target_operand();
+            if (idx < 0)
+                continue;
+
+            Operand kind = inst.fmt().operands[idx];
+            uint64_t field = m_new_addr[inst.addr]
+                + inst.size() - operand_size(kind);
+            int64_t diff = new_target(inst) - field;
+            if (fits(kind, diff))
+                continue;
+
+            std::vector<uint8_t> forms = jump_forms(inst.opcode);
+            for (size_t i = 0; i + 1 < forms.size(); ++i) {
+                if (forms[i] == inst.opcode) {
+                    inst.opcode = forms[i + 1];
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    m_code.clear();
+    for (auto &item : items) {
+        if (!item.second) {
+            m_code += m_data.at(item.first);
+            continue;
+        }
+
+        Instruction inst = m_insts.at(item.first);
+        int idx = inst.target_operand();
+        if (idx >= 0) {
+            Operand kind = inst.fmt().operands[idx];
+            uint64_t target = new_target(inst);
+            if (kind == Operand::Abs64)
+                inst.args[idx] = target;
+            else
+                inst.args[idx] = target
+                    - (m_new_addr[inst.addr] + inst.size()
+                        - operand_size(kind));
+        }
+        if (inst.opcode == *Opcode::LOAD_INT_MEM() && inst.args[1] != 0)
+            inst.args[2] = relocate(inst.args[2]);
+        if (inst.opcode == *Opcode::LOAD_STR_MEM()
+            || inst.opcode == *Opcode::STORE_STR_MEM())
+            inst.args[1] = relocate(inst.args[1]);
+
+        m_code += inst.encode();
+    }
+
+    m_after = m_insts.size();
+}
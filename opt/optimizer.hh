@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "decoder.hh"
+
+namespace opt
+{
+
+/* Bytecode level optimizer.
+ *
+ * Decodes code reachable from entry point, and builds control flow graph
+ * from it. Performs constant propagation and folding, strength reduction,
+ * fuses counter updates with compare-branches into loop instructions,
+ * jump threading, dead code removal and finally lays out the code again
+ * with shortest possible jump encodings.
+ *
+ * Bytes not reached as code are considered data. Data referenced by
+ * LOAD_INT_MEM and LOAD_STR_MEM is kept and relocated, other unreachable
+ * bytes are dropped.
+ * Register addressed memory accesses are assumed to target heap, which
+ * programs locate with INFO.
+ *
+ * If program can't be analyzed, for example because of indirect jumps,
+ * it's left untouched.
+ */
+class Optimizer
+{
+public:
+    Optimizer(const uint8_t *mem, uint64_t size);
+
+    bool optimize();
+
+    inline const std::string &code() const
+    {
+        return m_code;
+    }
+    inline const std::string &reason() const
+    {
+        return m_reason;
+    }
+    inline uint64_t instructions_before() const
+    {
+        return m_before;
+    }
+    inline uint64_t instructions_after() const
+    {
+        return m_after;
+    }
+
+private:
+    class Value;
+    typedef std::vector<Value> State;
+
+    void decode_all();
+    void find_data();
+    void propagate();
+    void rewrite(Instruction &inst, const State &state);
+    void fuse_loops();
+    void thread_jumps();
+    void remove_unreachable();
+    void layout();
+
+    void transfer(const Instruction &inst, State &state) const;
+    bool merge(State &dst, const State &src) const;
+    std::vector<uint64_t> successors(const Instruction &inst) const;
+
+    uint64_t forward(uint64_t addr) const;
+    uint64_t relocate(uint64_t addr) const;
+
+    const uint8_t *m_mem;
+    uint64_t m_size;
+
+    std::map<uint64_t, Instruction> m_insts;
+    std::map<uint64_t, uint64_t> m_removed;
+    std::map<uint64_t, std::string> m_data;
+    std::vector<std::pair<uint64_t, uint64_t>> m_refs;
+
+    std::map<uint64_t, uint64_t> m_new_addr;
+    uint64_t m_new_size;
+
+    std::string m_code;
+    std::string m_reason;
+    uint64_t m_before;
+    uint64_t m_after;
+};
+
+}
@@ -0,0 +1,177 @@
+#include "framework.hh"
+#include <vm.hh>
+#include <impl/opcodes.hh>
+#include <arrays.hh>
+#include <pool.hh>
+#include <simd.hh>
+#include <atomic>
+
+static void test_arrays_reduce()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::AREDUCE(), 2, (uint8_t)impl::Simd::Op::Add,
+            (uint8_t)core::Lane::I16, 0, 1,
+        *impl::Opcode::AREDUCE(), 3, (uint8_t)impl::Simd::Op::Min,
+            (uint8_t)core::Lane::I16, 0, 1,
+        *impl::Opcode::AREDUCE(), 4, (uint8_t)impl::Simd::Op::Max,
+            (uint8_t)core::Lane::U16, 0, 1,
+        *impl::Opcode::ACOUNT(), 5, (uint8_t)core::Lane::U16, 0, 1, 0x60,
+        *impl::Opcode::AREDUCE(), 6, (uint8_t)impl::Simd::Op::Min,
+            (uint8_t)core::Lane::I16, 0, 0x00,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Arrays arrays(&vm);
+    vm.add_heap(200);
+    uint8_t *heap = vm.heap_range(sizeof(mem), 200);
+    for (int i = 0; i < 100; ++i)
+        put_be(heap + i * 2, (i % 10) - 3, 2);
+    vm.regs().put_int(0, sizeof(mem));
+    vm.regs().put_int(1, 100);
+
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(2), 150);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(3), (uint64_t)-3);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(4), 0xffff);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(5), 10);
+
+    vm.regs().put_int(0, 0);
+    assertThrows(std::string, "Empty array", vm.step());
+}
+
+static void test_arrays_float()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::AREDUCE(), 2, (uint8_t)impl::Simd::Op::Add,
+            (uint8_t)core::Lane::F64, 0, 1,
+        *impl::Opcode::AREDUCE(), 3, (uint8_t)impl::Simd::Op::Max,
+            (uint8_t)core::Lane::F64, 0, 1,
+        *impl::Opcode::ACOUNT(), 4, (uint8_t)core::Lane::F64, 0, 1, 3,
+        *impl::Opcode::ASCAN(), (uint8_t)core::Lane::F64, 0, 1,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Arrays arrays(&vm);
+    vm.add_heap(80);
+    uint8_t *heap = vm.heap_range(sizeof(mem), 80);
+    for (int i = 0; i < 10; ++i) {
+        double val = i * 0.5;
+        uint64_t bits;
+        memcpy(&bits, &val, sizeof(bits));
+        put_be(heap + i * 8, bits, 8);
+    }
+    vm.regs().put_int(0, sizeof(mem));
+    vm.regs().put_int(1, 10);
+    vm.regs().put_float(3, 2.0);
+
+    assert(vm.step());
+    assertEquals(vm.regs().get_float(2), 22.5);
+    assert(vm.step());
+    assertEquals(vm.regs().get_float(3), 4.5);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(4), 1);
+    assert(vm.step());
+    uint64_t bits = get_be(heap + 9 * 8, 8);
+    double last;
+    memcpy(&last, &bits, sizeof(last));
+    assertEquals(last, 22.5);
+}
+
+/* Parallel split gives same results as single thread
+ */
+static void test_arrays_parallel()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::AREDUCE(), 2, (uint8_t)impl::Simd::Op::Add,
+            (uint8_t)core::Lane::U32, 0, 1,
+        *impl::Opcode::AREDUCE(), 3, (uint8_t)impl::Simd::Op::Max,
+            (uint8_t)core::Lane::I32, 0, 1,
+        *impl::Opcode::ACOUNT(), 4, (uint8_t)core::Lane::U32, 0, 1, 0x70,
+        *impl::Opcode::ASCAN(), (uint8_t)core::Lane::U32, 0, 1,
+    };
+    const unsigned count = 1001;
+    uint64_t threshold = impl::Arrays::parallel_threshold();
+
+    uint64_t res[2][3];
+    uint8_t scanned[2][count * 4];
+    for (int run = 0; run < 2; ++run) {
+        impl::ThreadPool::set_shared_threads(run ? 4 : 1);
+        impl::Arrays::set_parallel_threshold(run ? 64 : threshold);
+
+        core::VM vm((uint8_t*)mem, sizeof(mem));
+        impl::Arrays arrays(&vm);
+        vm.add_heap(count * 4);
+        uint8_t *heap = vm.heap_range(sizeof(mem), count * 4);
+        for (unsigned i = 0; i < count; ++i)
+            put_be(heap + i * 4, (i * 2654435761u) % 1000 + 0x7ffffc00, 4);
+        put_be(heap + 500 * 4, 7, 4);
+        vm.regs().put_int(0, sizeof(mem));
+        vm.regs().put_int(1, count);
+
+        for (int i = 0; i < 4; ++i)
+            assert(vm.step());
+        res[run][0] = vm.regs().get_int(2);
+        res[run][1] = vm.regs().get_int(3);
+        res[run][2] = vm.regs().get_int(4);
+        memcpy(scanned[run], heap, count * 4);
+    }
+    impl::ThreadPool::set_shared_threads(0);
+    impl::Arrays::set_parallel_threshold(threshold);
+
+    assertEquals(res[0][0], res[1][0]);
+    assertEquals(res[0][1], res[1][1]);
+    assertEquals(res[0][2], 1);
+    assertEquals(res[1][2], 1);
+    assertEquals(memcmp(scanned[0], scanned[1], count * 4), 0);
+    uint64_t total = res[0][0] & 0xffffffff;
+    assertEquals(get_be(scanned[0] + (count - 1) * 4, 4), total);
+}
+
+static void test_arrays_pool()
+{
+    impl::ThreadPool pool(3);
+    assertEquals(pool.size(), 3);
+
+    std::atomic<unsigned> sum(0);
+    pool.parallel_for(100, [&](unsigned idx) { sum += idx; });
+    assertEquals(sum.load(), 4950);
+
+    assertThrows(std::string, "fail",
+        pool.parallel_for(10, [](unsigned idx) {
+            if (idx == 7)
+                throw std::string("fail");
+        }));
+}
+
+static void test_arrays_bounds()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::ASCAN(), (uint8_t)core::Lane::U64, 0, 1,
+        *impl::Opcode::AREDUCE(), 2, (uint8_t)impl::Simd::Op::Mul,
+            (uint8_t)core::Lane::U64, 0, 0x10,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Arrays arrays(&vm);
+    vm.add_heap(16);
+    vm.regs().put_int(0, sizeof(mem));
+    vm.regs().put_int(1, 3);
+
+    assertThrows(std::string, "Heap memory access out of bounds", vm.step());
+    vm.regs().put_int(1, 0x2000000000000001);
+    vm.regs().pc_update(0);
+    assertThrows(std::string, "Heap memory access out of bounds", vm.step());
+    vm.regs().put_int(1, 2);
+    vm.regs().pc_update(0);
+    assert(vm.step());
+    assertThrows(std::string, "Invalid array reduction: 2", vm.step());
+}
+
+void test_arrays()
+{
+    TEST_CASE(test_arrays_reduce);
+    TEST_CASE(test_arrays_float);
+    TEST_CASE(test_arrays_parallel);
+    TEST_CASE(test_arrays_pool);
+    TEST_CASE(test_arrays_bounds);
+}
@@ -0,0 +1,104 @@
+#include "framework.hh"
+#include <batch.hh>
+#include <impl/opcodes.hh>
+#include <unistd.h>
+
+static const uint8_t add_code[] = {
+    *impl::Opcode::ADD_INT(), 2, 0, 1,
+    *impl::Opcode::PRINT_INT(), 2,
+    *impl::Opcode::STOP()
+};
+
+static const uint8_t fail_code[] = {
+    *impl::Opcode::PRINT_INT(), 0,
+    0xfe,
+    *impl::Opcode::STOP()
+};
+
+static void test_batch_parse()
+{
+    auto jobs = impl::Batch::parse(
+        "# comment\n"
+        "a.bin\n"
+        "\n"
+        "  b.bin 1 0x10\t-1  \n"
+        "a.bin");
+    assertEquals(jobs.size(), 3);
+    assertEquals(jobs[0].path, "a.bin");
+    assertEquals(jobs[0].args.size(), 0);
+    assertEquals(jobs[1].path, "b.bin");
+    assertEquals(jobs[1].args.size(), 3);
+    assertEquals(jobs[1].args[0], 1);
+    assertEquals(jobs[1].args[1], 16);
+    assertEquals(jobs[1].args[2], (uint64_t)-1);
+    assertEquals(jobs[2].path, "a.bin");
+
+    assertThrows(std::string, "Invalid argument at line 2: 1x",
+        impl::Batch::parse("a.bin\na.bin 1x"));
+    assertThrows(std::string, "Too many arguments at line 1",
+        impl::Batch::parse("a.bin 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17"));
+}
+
+static void test_batch_run()
+{
+    std::string add = temp_file(std::string((const char*)add_code,
+        sizeof(add_code)));
+    std::string broken = temp_file(std::string((const char*)fail_code,
+        sizeof(fail_code)));
+
+    std::string text;
+    for (unsigned i = 0; i < 200; ++i) {
+        if (i == 50)
+            text += broken + " 7\n";
+        else if (i == 60)
+            text += "/nonexistent/x\n";
+        else
+            text += add + " " + std::to_string(i) + " 1000\n";
+    }
+    auto jobs = impl::Batch::parse(text);
+
+    impl::Batch batch(4);
+    assertEquals(batch.threads(), 4);
+    std::vector<unsigned> order;
+    std::vector<impl::Batch::Result> results;
+    unsigned failed = batch.run(jobs, [&](unsigned idx,
+            const impl::Batch::Result &res) {
+        order.push_back(idx);
+        results.push_back(res);
+    });
+    assertEquals(failed, 2);
+    assertEquals(order.size(), 200);
+    for (unsigned i = 0; i < 200; ++i)
+        assertEquals(order[i], i);
+
+    assert(results[0].ok);
+    assertEquals(results[0].output, "1000");
+    assertEquals(results[0].ticks, 3);
+    assertEquals(results[199].output, "1199");
+
+    // Output before the error is kept
+    assert(!results[50].ok);
+    assertEquals(results[50].output, "7");
+    assertEquals(results[50].error, "Invalid opcode: 254");
+    assert(!results[60].ok);
+    assertEquals(results[60].output, "");
+    assertEquals(results[60].error, "Can't open file: /nonexistent/x");
+
+    // Workers are reused by the next run
+    results.clear();
+    assertEquals(batch.run(impl::Batch::parse(add + " 1 2"),
+        [&](unsigned, const impl::Batch::Result &res) {
+            results.push_back(res);
+        }), 0);
+    assertEquals(results.size(), 1);
+    assertEquals(results[0].output, "3");
+
+    unlink(add.c_str());
+    unlink(broken.c_str());
+}
+
+void test_batch()
+{
+    TEST_CASE(test_batch_parse);
+    TEST_CASE(test_batch_run);
+}
@@ -0,0 +1,214 @@
+#include "framework.hh"
+#include <vm.hh>
+#include <checkpoint.hh>
+#include <impl/opcodes.hh>
+#include <nopstop.hh>
+#include <ints.hh>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static uint8_t code[] = {
+    *impl::Opcode::LOAD_INT8(), 1, 7,
+    *impl::Opcode::INC_INT(), 1,
+    *impl::Opcode::INC_INT(), 1,
+    *impl::Opcode::STOP()
+};
+
+static uint64_t file_size(const std::string &path)
+{
+    struct stat st;
+    assert(stat(path.c_str(), &st) == 0);
+    return st.st_size;
+}
+
+static void test_checkpoint_dirty()
+{
+    core::Heap heap(100, 3 * core::Heap::page_size);
+    assertEquals(heap.pages(), 3);
+    assert(!heap.dirty(0));
+
+    // Reading doesn't mark, writing does
+    const core::Heap &view = heap;
+    assertEquals(view[100 + core::Heap::page_size], 0);
+    view.data(100, 10);
+    assert(!heap.dirty(0));
+    assert(!heap.dirty(1));
+    heap[100 + core::Heap::page_size] = 1;
+    assert(!heap.dirty(0));
+    assert(heap.dirty(1));
+    heap.data(100 + core::Heap::page_size - 1, 2);
+    assert(heap.dirty(0));
+    assert(!heap.dirty(2));
+
+    core::Heap copy(heap);
+    assert(copy.dirty(1));
+    heap.clear_dirty();
+    assert(!heap.dirty(0));
+    assert(!heap.dirty(1));
+}
+
+static void test_checkpoint_resume()
+{
+    std::string path = temp_file();
+    uint64_t heap_start = sizeof(code);
+    {
+        core::VM vm(code, sizeof(code));
+        impl::NopStop nopstop(&vm);
+        impl::Ints ints(&vm);
+        vm.add_heap(20000);
+        vm.add_heap(10);
+        assert(vm.step());
+        vm.set_mem(heap_start + 5, 0x11);
+        vm.set_mem(heap_start + 20003, 0x33);
+
+        core::Checkpoint checkpoint(vm, path);
+        assertEquals(checkpoint.records(), 0);
+        checkpoint.write();
+        uint64_t full = checkpoint.size();
+
+        assert(vm.step());
+        vm.set_mem(heap_start + 10000, 0x22);
+        vm.regs().put_string(2, "owned");
+        checkpoint.write();
+        assertEquals(checkpoint.records(), 2);
+        // Only the page written since
+        uint64_t delta = checkpoint.size() - full;
+        assert(delta > core::Heap::page_size);
+        assert(delta < 2 * core::Heap::page_size);
+        assert(!vm.heap(heap_start).dirty(2));
+
+        // Not in any checkpoint
+        assert(vm.step());
+        vm.set_mem(heap_start + 6, 0x44);
+    }
+
+    core::VM vm(code, sizeof(code));
+    impl::NopStop nopstop(&vm);
+    impl::Ints ints(&vm);
+    core::Checkpoint checkpoint(vm, path);
+    assertEquals(checkpoint.records(), 2);
+    assert(checkpoint.restore());
+    assertEquals(vm.regs().pc(), 5);
+    assertEquals(vm.ticks(), 2);
+    assertEquals(vm.regs().get_int(1), 8);
+    assertEquals(vm.regs().get_string(2), "owned");
+    assertEquals(vm.heap_size(), 20010);
+    assertEquals(vm.mem(heap_start + 5), 0x11);
+    assertEquals(vm.mem(heap_start + 6), 0);
+    assertEquals(vm.mem(heap_start + 10000), 0x22);
+    assertEquals(vm.mem(heap_start + 20003), 0x33);
+    assert(!vm.heap(heap_start).dirty(0));
+
+    // Restored from log, next record has just the changes
+    uint64_t size = checkpoint.size();
+    vm.set_mem(heap_start + 7, 0x55);
+    checkpoint.write();
+    assert(checkpoint.size() - size < 2 * core::Heap::page_size);
+    while (vm.step());
+    assertEquals(vm.regs().get_int(1), 9);
+
+    core::VM vm2(code, sizeof(code));
+    core::Checkpoint checkpoint2(vm2, path);
+    assert(checkpoint2.restore());
+    assertEquals(vm2.mem(heap_start + 5), 0x11);
+    assertEquals(vm2.mem(heap_start + 7), 0x55);
+    assertEquals(vm2.mem(heap_start + 10000), 0x22);
+    unlink(path.c_str());
+}
+
+static void test_checkpoint_torn()
+{
+    std::string path = temp_file();
+    core::VM vm(code, sizeof(code));
+    vm.add_heap(10000);
+    uint64_t first;
+    {
+        core::Checkpoint checkpoint(vm, path);
+        assertEquals(checkpoint.restore(), false);
+        vm.regs().put_int(1, 1);
+        checkpoint.write();
+        first = checkpoint.size();
+        vm.regs().put_int(1, 2);
+        vm.set_mem(sizeof(code) + 1, 1);
+        checkpoint.write();
+    }
+
+    // Crash in the middle of second record
+    assert(truncate(path.c_str(), file_size(path) - 100) == 0);
+    core::VM vm2(code, sizeof(code));
+    core::Checkpoint checkpoint(vm2, path);
+    assertEquals(checkpoint.records(), 1);
+    assertEquals(checkpoint.size(), first);
+    assertEquals(file_size(path), first);
+    assert(checkpoint.restore());
+    assertEquals(vm2.regs().get_int(1), 1);
+    assertEquals(vm2.mem(sizeof(code) + 1), 0);
+    unlink(path.c_str());
+}
+
+static void test_checkpoint_compact()
+{
+    std::string path = temp_file();
+    core::VM vm(code, sizeof(code));
+    vm.add_heap(50000);
+    core::Checkpoint checkpoint(vm, path);
+    for (int i = 0; i < 10; ++i) {
+        vm.set_mem(sizeof(code) + i * 4096, i + 1);
+        vm.regs().put_int(1, i);
+        checkpoint.write();
+    }
+    assertEquals(checkpoint.records(), 10);
+    uint64_t size = checkpoint.size();
+    checkpoint.compact();
+    assertEquals(checkpoint.records(), 1);
+    assert(checkpoint.size() < size);
+    assertEquals(checkpoint.base_size(), checkpoint.size());
+    assertEquals(file_size(path), checkpoint.size());
+    vm.set_mem(sizeof(code) + 1, 0x77);
+    checkpoint.write();
+
+    core::VM vm2(code, sizeof(code));
+    core::Checkpoint checkpoint2(vm2, path);
+    assertEquals(checkpoint2.records(), 2);
+    assert(checkpoint2.restore());
+    assertEquals(vm2.regs().get_int(1), 9);
+    for (int i = 0; i < 10; ++i)
+        assertEquals(vm2.mem(sizeof(code) + i * 4096), i + 1);
+    assertEquals(vm2.mem(sizeof(code) + 1), 0x77);
+    unlink(path.c_str());
+}
+
+static void test_checkpoint_invalid()
+{
+    std::string path = temp_file();
+    core::VM vm(code, sizeof(code));
+    {
+        core::Checkpoint checkpoint(vm, path);
+        checkpoint.write();
+    }
+
+    uint8_t other[sizeof(code)];
+    std::memcpy(other, code, sizeof(code));
+    other[2] = 8;
+    core::VM vm2(other, sizeof(other));
+    assertThrows(std::string, "Checkpoint log doesn't match loaded program",
+        core::Checkpoint(vm2, path));
+
+    assert(truncate(path.c_str(), 10) == 0);
+    assertThrows(std::string, "Invalid checkpoint log: " + path,
+        core::Checkpoint(vm, path));
+    unlink(path.c_str());
+
+    assertThrows(std::string, "Can't open checkpoint log: /nonexistent/x",
+        core::Checkpoint(vm, "/nonexistent/x"));
+}
+
+void test_checkpoint()
+{
+    TEST_CASE(test_checkpoint_dirty);
+    TEST_CASE(test_checkpoint_resume);
+    TEST_CASE(test_checkpoint_torn);
+    TEST_CASE(test_checkpoint_compact);
+    TEST_CASE(test_checkpoint_invalid);
+}
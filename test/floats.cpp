@@ -0,0 +1,119 @@
+#include "framework.hh"
+#include <vm.hh>
+#include <impl/opcodes.hh>
+#include <floats.hh>
+#include <cmath>
+
+static void test_floats_load()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_FLOAT(), 1, 0x3f, 0xf8, 0, 0, 0, 0, 0, 0,
+        *impl::Opcode::LOAD_FLOAT32(), 2, 0xc0, 0x20, 0, 0,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Floats floats(&vm);
+
+    assert(vm.step());
+    assertEquals(vm.regs().get_float(1), 1.5);
+    assert(vm.step());
+    assertEquals(vm.regs().get_float(2), -2.5);
+}
+
+static void test_floats_alu()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::FADD(), 2, 0, 1,
+        *impl::Opcode::FSUB(), 3, 0, 1,
+        *impl::Opcode::FMUL(), 4, 0, 0x20,
+        *impl::Opcode::FDIV(), 5, 0, 1,
+        *impl::Opcode::FMIN(), 6, 0, 1,
+        *impl::Opcode::FMAX(), 7, 0, 1,
+        *impl::Opcode::FMA(), 8, 0, 1, 0x30,
+        *impl::Opcode::FSQRT(), 9, 1,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Floats floats(&vm);
+    vm.regs().put_float(0, 1.5);
+    vm.regs().put_float(1, 4.0);
+
+    for (int i = 0; i < 8; ++i)
+        assert(vm.step());
+    assertEquals(vm.regs().get_float(2), 5.5);
+    assertEquals(vm.regs().get_float(3), -2.5);
+    assertEquals(vm.regs().get_float(4), 3.0);
+    assertEquals(vm.regs().get_float(5), 0.375);
+    assertEquals(vm.regs().get_float(6), 1.5);
+    assertEquals(vm.regs().get_float(7), 4.0);
+    assertEquals(vm.regs().get_float(8), 9.0);
+    assertEquals(vm.regs().get_float(9), 2.0);
+}
+
+static void test_floats_convert()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::ITOF(), 2, 0,
+        *impl::Opcode::FTOI(), 3, 1,
+        *impl::Opcode::FTOI(), 4, 5,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Floats floats(&vm);
+    vm.regs().put_int(0, -7);
+    vm.regs().put_float(1, -3.75);
+    vm.regs().put_float(5, NAN);
+
+    assert(vm.step());
+    assertEquals(vm.regs().get_float(2), -7.0);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(3), (uint64_t)-3);
+    assertThrows(std::string, "Float out of integer range", vm.step());
+    assertThrows(std::string, "Float out of integer range",
+        impl::Floats::to_int(9223372036854775808.0));
+}
+
+static void test_floats_jump()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::JFLT8(), 0, 1, 2,
+        *impl::Opcode::NOP(),
+        *impl::Opcode::JFEQ32(), 0, 2, 0, 0, 0, 5,
+        *impl::Opcode::JFNE8(), 0, 2, 2,
+        *impl::Opcode::NOP(),
+        *impl::Opcode::JFLE8(), 2, 0, 2,
+        *impl::Opcode::NOP(),
+        *impl::Opcode::STOP(),
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Floats floats(&vm);
+    vm.regs().put_float(0, 1.0);
+    vm.regs().put_float(1, 2.5);
+    vm.regs().put_float(2, NAN);
+
+    assert(vm.step());
+    assertEquals(vm.regs().pc(), 5);
+    assert(vm.step());
+    assertEquals(vm.regs().pc(), 12);
+    assert(vm.step());
+    assertEquals(vm.regs().pc(), 17);
+    assert(vm.step());
+    assertEquals(vm.regs().pc(), 21);
+}
+
+static void test_floats_format()
+{
+    assertEquals(impl::Floats::format(42.0), "42.0");
+    assertEquals(impl::Floats::format(0.1), "0.1");
+    assertEquals(impl::Floats::format(-2.5), "-2.5");
+    assertEquals(impl::Floats::format(1.0 / 3), "0.3333333333333333");
+    assertEquals(impl::Floats::format(std::sqrt(2.0)), "1.4142135623730951");
+    assertEquals(impl::Floats::format(1e100), "1e+100");
+    assertEquals(impl::Floats::format(-INFINITY), "-inf");
+}
+
+void test_floats()
+{
+    TEST_CASE(test_floats_load);
+    TEST_CASE(test_floats_alu);
+    TEST_CASE(test_floats_convert);
+    TEST_CASE(test_floats_jump);
+    TEST_CASE(test_floats_format);
+}
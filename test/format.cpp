@@ -0,0 +1,86 @@
+#include "framework.hh"
+#include <vm.hh>
+#include <impl/opcodes.hh>
+#include <format.hh>
+
+static std::string run_format(core::VM &vm, const std::string &fmt,
+    uint8_t first, uint8_t count)
+{
+    uint8_t mem[] = {
+        *impl::Opcode::FORMAT(), 0, 1, first, count,
+    };
+    vm.load(mem, sizeof(mem));
+    vm.regs().put_string(1, fmt);
+    vm.step();
+    return vm.regs().get_string(0);
+}
+
+static void test_format_parse()
+{
+    std::vector<impl::Format::Piece> res = impl::Format::parse(
+        "id={08x} {{v}}={.2}", 19);
+    assertEquals(res.size(), 3);
+    assertEquals(res[0].text, "id=");
+    assert(res[0].arg);
+    assert(res[0].spec.zero);
+    assertEquals(res[0].spec.width, 8);
+    assertEquals(res[0].spec.conv, 'x');
+    assertEquals(res[1].text, " {v}=");
+    assertEquals(res[1].spec.precision, 2);
+    assertEquals(res[2].text, "");
+    assert(!res[2].arg);
+
+    assertThrows(std::string, "Invalid format: a{", impl::Format::parse("a{", 2));
+    assertThrows(std::string, "Invalid format: {q}", impl::Format::parse("{q}", 3));
+    assertThrows(std::string, "Invalid format: }", impl::Format::parse("}", 1));
+}
+
+static void test_format_render()
+{
+    core::VM vm;
+    impl::Format format(&vm);
+    vm.regs().put_int(2, 123);
+    vm.regs().put_float(3, 45.6);
+    vm.regs().put_string(4, "abc");
+
+    assertEquals(run_format(vm, "id={} value={} name={}", 2, 3),
+        "id=123 value=45.6 name=abc");
+    assertEquals(run_format(vm, "{{{}}}", 4, 1), "{abc}");
+
+    vm.regs().put_int(6, 255);
+    vm.regs().put_int(7, -5);
+    vm.regs().put_int(8, -5);
+    vm.regs().put_float(9, 1.5);
+    vm.regs().put_string(10, "ab");
+    assertEquals(run_format(vm, "[{5}|{x}|{05d}|{.3}|{4}]", 6, 5),
+        "[  255|fffffffffffffffb|-0005|1.500|  ab]");
+    assertEquals(run_format(vm, "{} {d}", 7, 2), "18446744073709551611 -5");
+
+    // Longer than any fixed buffer
+    vm.regs().put_float(11, 1e70);
+    std::string big = run_format(vm, "v={.2}", 11, 1);
+    assertEquals(big.size(), 2 + 71 + 3);
+    assertEquals(big.substr(0, 3), "v=1");
+    assertEquals(big.substr(big.size() - 3), ".00");
+    std::string precise = run_format(vm, "{.70}", 9, 1);
+    assertEquals(precise.size(), 72);
+    assertEquals(precise, "1." + std::string("5") + std::string(69, '0'));
+
+    assertThrows(std::string, "Format expects 2 arguments, got 1",
+        run_format(vm, "{}{}", 2, 1));
+    assertThrows(std::string, "Invalid register type, expected integer",
+        run_format(vm, "{x}", 4, 1));
+    assertThrows(std::string, "Invalid register",
+        run_format(vm, "{}{}", 15, 2));
+    // Range past the last register doesn't wrap to R0
+    vm.regs().put_string(0, "kept");
+    assertThrows(std::string, "Invalid register",
+        run_format(vm, "{}{}", 255, 2));
+    assertEquals(vm.regs().get_string(0), "kept");
+}
+
+void test_format()
+{
+    TEST_CASE(test_format_parse);
+    TEST_CASE(test_format_render);
+}
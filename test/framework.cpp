@@ -2,6 +2,7 @@
 #include <vector>
 #include <atomic>
 #include <map>
+#include <cstdlib>
 #include <unistd.h>
 
 static std::map<std::string, std::function<void(void)>> _test_cases;
@@ -135,6 +136,32 @@ std::string test_stats()
     return res;
 }
 
+std::string temp_file(const std::string &data)
+{
+    char name[] = "/tmp/minvm_testXXXXXX";
+    int fd = mkstemp(name);
+    assert(fd >= 0);
+    assertEquals(write(fd, data.data(), data.size()), (ssize_t)data.size());
+    close(fd);
+    return name;
+}
+
+void put_be(uint8_t *ptr, uint64_t val, unsigned size)
+{
+    for (unsigned i = size; i > 0; --i) {
+        ptr[i - 1] = val & 0xff;
+        val >>= 8;
+    }
+}
+
+uint64_t get_be(const uint8_t *ptr, unsigned size)
+{
+    uint64_t res = 0;
+    for (unsigned i = 0; i < size; ++i)
+        res = (res << 8) | ptr[i];
+    return res;
+}
+
 void StdoutCatcher::start(bool do_reset)
 {
     m_buf = std::cout.rdbuf();
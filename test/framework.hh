@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <iostream>
 #include <sstream>
@@ -72,6 +73,13 @@ catch (EXPTYPE e)\
     }\
 }
 
+/* New file in /tmp holding data, caller unlinks it */
+std::string temp_file(const std::string &data = "");
+
+/* Big endian numbers in VM memory */
+void put_be(uint8_t *ptr, uint64_t val, unsigned size);
+uint64_t get_be(const uint8_t *ptr, unsigned size);
+
 class StdoutCatcher
 {
 public:
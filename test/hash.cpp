@@ -0,0 +1,110 @@
+#include "framework.hh"
+#include <vm.hh>
+#include <impl/opcodes.hh>
+#include <hash.hh>
+#include <simd.hh>
+#include <cstring>
+
+static void test_hash_known()
+{
+    const uint8_t *check = (const uint8_t*)"123456789";
+    assertEquals(impl::Hash::crc32(0, check, 9), 0xcbf43926);
+    assertEquals(impl::Hash::crc32c(0, check, 9), 0xe3069283);
+    assertEquals(impl::Hash::crc32c(0, check, 0), 0);
+
+    assertEquals(impl::Hash::xxhash64(check, 0, 0), 0xef46db3751d8e999);
+    assertEquals(impl::Hash::xxhash64((const uint8_t*)"abc", 3, 0),
+        0x44bc2cf5ad770999);
+    const char *text = "Nobody inspects the spammish repetition";
+    assertEquals(impl::Hash::xxhash64((const uint8_t*)text, strlen(text), 0),
+        0xfbcea83c8a378bf1);
+}
+
+static void test_hash_hardware()
+{
+    static uint8_t data[1027];
+    for (unsigned i = 0; i < sizeof(data); ++i)
+        data[i] = i * 31 + 7;
+
+    impl::Simd::Isa isa = impl::Simd::isa();
+    uint32_t hw[4];
+    uint32_t sw[4];
+    for (int run = 0; run < 2; ++run) {
+        impl::Simd::set_isa(run ? impl::Simd::Isa::Generic : isa);
+        uint32_t *res = run ? sw : hw;
+        res[0] = impl::Hash::crc32c(0, data, sizeof(data));
+        res[1] = impl::Hash::crc32c(0, data + 1, 13);
+        res[2] = impl::Hash::crc32c(0x12345678, data + 3, 1000);
+        res[3] = impl::Hash::crc32c(0, data, 7);
+    }
+    assert(!impl::Hash::hardware_crc());
+    impl::Simd::set_isa(isa);
+
+    for (int i = 0; i < 4; ++i)
+        assertEquals(hw[i], sw[i]);
+}
+
+static void test_hash_opcodes()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::CRC(), 2, (uint8_t)impl::Hash::Crc::Crc32, 0, 1,
+        *impl::Opcode::CRC(), 3, (uint8_t)impl::Hash::Crc::Crc32, 0, 0x40,
+        *impl::Opcode::CRC(), 3, (uint8_t)impl::Hash::Crc::Crc32, 4, 0x50,
+        *impl::Opcode::HASH(), 5, (uint8_t)impl::Hash::Algo::XxHash64, 0, 1,
+        *impl::Opcode::HASH(), 6, (uint8_t)impl::Hash::Algo::XxHash64Seed, 0, 1,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Hash hash(&vm);
+    vm.add_heap(9);
+    uint8_t *heap = vm.heap_range(sizeof(mem), 9);
+    memcpy(heap, "123456789", 9);
+    vm.regs().put_int(0, sizeof(mem));
+    vm.regs().put_int(1, 9);
+    vm.regs().put_int(2, 0);
+    vm.regs().put_int(3, 0);
+    vm.regs().put_int(4, sizeof(mem) + 4);
+    vm.regs().put_int(6, 1);
+
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(2), 0xcbf43926);
+
+    // Streaming over two parts gives the same
+    assert(vm.step());
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(3), 0xcbf43926);
+
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(5), impl::Hash::xxhash64(heap, 9, 0));
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(6), impl::Hash::xxhash64(heap, 9, 1));
+    assert(vm.regs().get_int(5) != vm.regs().get_int(6));
+}
+
+static void test_hash_invalid()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::HASH(), 2, 9, 0, 1,
+        *impl::Opcode::CRC(), 2, 2, 0, 1,
+        *impl::Opcode::CRC(), 2, 0, 0, 1,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Hash hash(&vm);
+    vm.add_heap(8);
+    vm.regs().put_int(0, sizeof(mem));
+    vm.regs().put_int(1, 8);
+
+    assertThrows(std::string, "Invalid hash algorithm: 9", vm.step());
+    vm.regs().pc_update(5);
+    assertThrows(std::string, "Invalid CRC algorithm: 2", vm.step());
+    vm.regs().pc_update(10);
+    vm.regs().put_int(1, 9);
+    assertThrows(std::string, "Heap memory access out of bounds", vm.step());
+}
+
+void test_hash()
+{
+    TEST_CASE(test_hash_known);
+    TEST_CASE(test_hash_hardware);
+    TEST_CASE(test_hash_opcodes);
+    TEST_CASE(test_hash_invalid);
+}
@@ -87,6 +87,35 @@ static void test_heap_add()
     assert(vm.heap_size() == 12 * 2);
 }
 
+static void test_heap_range()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::NOP(), *impl::Opcode::NOP()
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    vm.add_heap(8);
+    vm.add_heap(8);
+
+    uint8_t *data = vm.heap_range(2, 8);
+    data[7] = 0x42;
+    assert(vm.mem(9) == 0x42);
+    assert(vm.heap_range(10, 8) != data);
+
+    // Ranges can't span heap blocks or code
+    assertThrows(
+        std::string,
+        "Heap memory access out of bounds",
+        vm.heap_range(3, 8));
+    assertThrows(
+        std::string,
+        "Heap memory access out of bounds",
+        vm.heap_range(1, 2));
+    assertThrows(
+        std::string,
+        "Heap memory access out of bounds",
+        vm.heap_range(10, 0));
+}
+
 static void test_heap_info()
 {
     static uint8_t mem[] = {
@@ -142,5 +171,6 @@ void test_heap()
     TEST_CASE(test_heap_access_exception);
 
     TEST_CASE(test_heap_add);
+    TEST_CASE(test_heap_range);
     TEST_CASE(test_heap_info);
 }
@@ -0,0 +1,96 @@
+#include "framework.hh"
+#include <vm.hh>
+#include <image.hh>
+#include <impl/opcodes.hh>
+#include <nopstop.hh>
+#include <ints.hh>
+#include <cstdio>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static void test_image_map()
+{
+    std::string name = temp_file("program");
+    core::Image image;
+    image.open(name, core::Image::Populate | core::Image::WillNeed);
+    assert(image.mapped());
+    assertEquals(image.size(), 7);
+    assertEquals(std::string((const char*)image.data(), image.size()),
+        "program");
+
+    // Forced read and empty file can't be mapped
+    image.open(name, core::Image::NoMap);
+    assert(!image.mapped());
+    assertEquals(std::string((const char*)image.data(), image.size()),
+        "program");
+    unlink(name.c_str());
+
+    name = temp_file("");
+    image.open(name);
+    assert(!image.mapped());
+    assertEquals(image.size(), 0);
+    unlink(name.c_str());
+
+    assertThrows(std::string, "Can't open file: /nonexistent/minvm",
+        image.open("/nonexistent/minvm"));
+
+    image.assign("abc");
+    assert(!image.mapped());
+    assertEquals(image.size(), 3);
+}
+
+static void test_image_pipe()
+{
+    int fds[2];
+    assertEquals(pipe(fds), 0);
+    // Larger than read chunk
+    std::string data(100000, 'x');
+    data[99999] = 'y';
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        ssize_t res = write(fds[1], data.data(), data.size());
+        _exit(res == (ssize_t)data.size() ? 0 : 1);
+    }
+    close(fds[1]);
+
+    core::Image image;
+    image.open(fds[0]);
+    close(fds[0]);
+    int status;
+    waitpid(pid, &status, 0);
+    assertEquals(status, 0);
+    assert(!image.mapped());
+    assertEquals(image.size(), data.size());
+    assertEquals(std::string((const char*)image.data(), image.size()), data);
+}
+
+static void test_image_vm()
+{
+    uint8_t code[] = {
+        *impl::Opcode::LOAD_INT8(), 1, 42,
+        *impl::Opcode::STOP()
+    };
+    std::string name = temp_file(std::string((char*)code, sizeof(code)));
+    core::Image image;
+    image.open(name);
+    unlink(name.c_str());
+
+    core::VM vm;
+    vm.load(image);
+    impl::NopStop nopstop(&vm);
+    impl::Ints ints(&vm);
+    while (vm.step());
+    assertEquals(vm.regs().get_int(1), 42);
+
+    // Mapped code is never written
+    assertThrows(std::string, "Write attempt to read only memory",
+        vm.set_mem(0, 1));
+}
+
+void test_image()
+{
+    TEST_CASE(test_image_map);
+    TEST_CASE(test_image_pipe);
+    TEST_CASE(test_image_vm);
+}
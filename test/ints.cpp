@@ -4,6 +4,32 @@
 #include <ints.hh>
 #include <iomanip>
 
+static void test_ints_store_int()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::STORE_INT(), 0, 4, 1,
+        *impl::Opcode::LOAD_INT(), 2, 2, 1,
+        *impl::Opcode::STORE_INT(), 0x50, 1, 3,
+        *impl::Opcode::STORE_INT(), 0, 2, 4,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Ints ints(&vm);
+    vm.add_heap(8);
+    vm.regs().put_int(0, 0x11223344);
+    vm.regs().put_int(1, sizeof(mem));
+    vm.regs().put_int(3, sizeof(mem) + 7);
+    vm.regs().put_int(4, 0);
+
+    assert(vm.step());
+    assertEquals(vm.mem(sizeof(mem)), 0x11);
+    assertEquals(vm.mem(sizeof(mem) + 3), 0x44);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(2), 0x1122);
+    assert(vm.step());
+    assertEquals(vm.mem(sizeof(mem) + 7), 5);
+    assertThrows(std::string, "Heap memory access out of bounds", vm.step());
+}
+
 static void test_ints_load_int8()
 {
     static uint8_t mem[] = {
@@ -386,6 +412,210 @@ static void test_ints_mod()
     assert(vm.regs().get_int(5) == 2);
 }
 
+static void test_ints_bitops()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT16(), 1, 0xf0, 0x0f,
+        *impl::Opcode::LOAD_INT64(), 2,
+            0x80, 0, 0, 0, 0, 0, 0, 0x01,
+        *impl::Opcode::AND_INT(), 3, 1, 0xf0,
+        *impl::Opcode::OR_INT(), 4, 1, 0x30,
+        *impl::Opcode::XOR_INT(), 5, 1, 1,
+        *impl::Opcode::SHL_INT(), 6, 1, 0x40,
+        *impl::Opcode::SHR_INT(), 7, 2, 0xf0,
+        *impl::Opcode::SAR_INT(), 8, 2, 0xf0,
+        *impl::Opcode::ROL_INT(), 9, 2, 0x10,
+        *impl::Opcode::ROR_INT(), 10, 2, 0x10,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Ints ints(&vm);
+
+    assert(vm.step());
+    assert(vm.step());
+
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(3), 0x0f);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(4), 0xf00f);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(5), 0);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(6), 0xf00f0);
+
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(7), 0x0001000000000000);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(8), 0xffff000000000000);
+
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(9), 3);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(10), 0xc000000000000000);
+    assert(vm.regs().pc() == sizeof(mem));
+}
+
+static void test_ints_bit_imm()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT8(), 1, 0x81,
+        *impl::Opcode::AND_IMM(), 2, 1, 1, 0x80,
+        *impl::Opcode::XOR_IMM(), 3, 1, 2, 0x01, 0x00,
+        *impl::Opcode::SHL_IMM(), 4, 1, 1, 60,
+        *impl::Opcode::ROR_IMM(), 5, 1, 1, 64 + 4,
+        *impl::Opcode::OR_IMM(), 6, 1, 0,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Ints ints(&vm);
+
+    assert(vm.step());
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(2), 0x80);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(3), 0x181);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(4), 0x1000000000000000);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(5), 0x1000000000000008);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(6), 0x81);
+    assert(vm.regs().pc() == sizeof(mem));
+}
+
+static void test_ints_bit_unary()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT16(), 1, 0x0f, 0x00,
+        *impl::Opcode::NOT_INT(), 2, 1,
+        *impl::Opcode::POPCNT(), 3, 2,
+        *impl::Opcode::CLZ(), 4, 1,
+        *impl::Opcode::CTZ(), 5, 1,
+        *impl::Opcode::CLZ(), 6, 0,
+        *impl::Opcode::CTZ(), 7, 0,
+        *impl::Opcode::POPCNT(), 8, 0x70,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Ints ints(&vm);
+
+    assert(vm.step());
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(2), 0xfffffffffffff0ff);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(3), 60);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(4), 52);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(5), 8);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(6), 64);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(7), 64);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(8), 3);
+}
+
+static void test_ints_idiv()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::IDIV_INT(), 2, 0, 1,
+        *impl::Opcode::IMOD_INT(), 3, 0, 1,
+        *impl::Opcode::IDIV_IMM(), 4, 0, 1, 0xfd,
+        *impl::Opcode::IMOD_IMM(), 5, 0, 1, 0x05,
+        *impl::Opcode::IDIV_INT(), 6, 1, 0x70,
+        *impl::Opcode::IDIV_INT(), 7, 0, 0,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Ints ints(&vm);
+    vm.regs().put_int(0, -17);
+    vm.regs().put_int(1, 0x8000000000000000);
+
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(2), 0);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(3), (uint64_t)-17);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(4), 5);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(5), (uint64_t)-2);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(6), 0xedb6db6db6db6db7);
+
+    vm.regs().put_int(0, 0);
+    assertThrows(
+        std::string,
+        "Divide by zero!",
+        vm.step());
+}
+
+static void test_ints_idiv_overflow()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::IDIV_IMM(), 2, 0, 1, 0xff,
+        *impl::Opcode::IMOD_IMM(), 3, 0, 1, 0xff,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Ints ints(&vm);
+    vm.regs().put_int(0, 0x8000000000000000);
+
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(2), 0x8000000000000000);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(3), 0);
+}
+
+static void test_ints_mulh()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::UMULH_INT(), 2, 0, 1,
+        *impl::Opcode::MULH_INT(), 3, 0, 1,
+        *impl::Opcode::MULH_INT(), 4, 0, 0x20,
+        *impl::Opcode::UMULH_INT(), 5, 0, 0x20,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Ints ints(&vm);
+    vm.regs().put_int(0, -1);
+    vm.regs().put_int(1, 0x100000000);
+
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(2), 0xffffffff);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(3), (uint64_t)-1);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(4), (uint64_t)-1);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(5), 1);
+}
+
+static void test_ints_div128()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::DIV128(), 3, 4, 0, 1, 2,
+        *impl::Opcode::DIV128(), 5, 6, 2, 1, 0x30,
+        *impl::Opcode::DIV128(), 5, 6, 0, 1, 0,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Ints ints(&vm);
+    vm.regs().put_int(0, 1);
+    vm.regs().put_int(1, 5);
+    vm.regs().put_int(2, 3);
+
+    // 2^64 + 5 = 3 * 6148914691236517207
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(3), 6148914691236517207);
+    assertEquals(vm.regs().get_int(4), 0);
+
+    assertThrows(
+        std::string,
+        "Divide overflow!",
+        vm.step());
+
+    vm.regs().pc_update(12);
+    vm.regs().put_int(0, 0);
+    assertThrows(
+        std::string,
+        "Divide by zero!",
+        vm.step());
+}
+
 static void test_ints_print()
 {
     static uint8_t mem[] = {
@@ -406,6 +636,7 @@ static void test_ints_print()
     StdoutCatcher catcher;
     catcher.start();
     bool res = vm.step();
+    vm.output().flush();
     catcher.stop();
     assert(res);
 
@@ -413,6 +644,7 @@ static void test_ints_print()
 
     catcher.start(true);
     res = vm.step();
+    vm.output().flush();
     catcher.stop();
     assert(res);
 
@@ -463,8 +695,127 @@ static void test_ints_mod_by_zero()
         vm.step());
 }
 
+static void test_ints_add_imm()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT8(), 1, 0x0a,
+        *impl::Opcode::ADD_IMM(), 0, 1, 1, 0x20,
+        *impl::Opcode::ADD_IMM(), 2, 0, 3, 0x01, 0x86, 0xa0,
+        *impl::Opcode::ADD_IMM(), 3, 0x50, 0,
+        *impl::Opcode::ADD_IMM(), 4, 1,
+            8, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Ints ints(&vm);
+
+    assert(vm.step());
+    assert(vm.step());
+    assert(vm.regs().get_int(0) == 0x0a + 0x20);
+
+    assert(vm.step());
+    assert(vm.regs().get_int(2) == 0x0a + 0x20 + 100000);
+
+    assert(vm.step());
+    assert(vm.regs().get_int(3) == 5);
+
+    assert(vm.step());
+    assert(vm.regs().get_int(4) == 0x0a - 1);
+    assert(vm.regs().pc() == sizeof(mem));
+}
+
+static void test_ints_sub_imm()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT8(), 1, 0x0a,
+        *impl::Opcode::SUB_IMM(), 0, 1, 1, 0x02,
+        *impl::Opcode::SUB_IMM(), 2, 1, 2, 0x01, 0x00,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Ints ints(&vm);
+
+    assert(vm.step());
+    assert(vm.step());
+    assert(vm.regs().get_int(0) == 0x0a - 0x02);
+
+    assert(vm.step());
+    assert(vm.regs().get_int(2) == static_cast<uint64_t>(0x0a - 0x100));
+}
+
+static void test_ints_mul_imm()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT8(), 1, 0x0a,
+        *impl::Opcode::MUL_IMM(), 0, 1, 2, 0x16, 0x2e,
+        *impl::Opcode::MUL_IMM(), 2, 0, 4, 0x00, 0x01, 0x00, 0x00,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Ints ints(&vm);
+
+    assert(vm.step());
+    assert(vm.step());
+    assert(vm.regs().get_int(0) == 0x0a * 5678);
+
+    assert(vm.step());
+    assert(vm.regs().get_int(2) == 0x0aULL * 5678 * 0x10000);
+}
+
+static void test_ints_div_imm()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT32(), 1, 0x00, 0x01, 0x86, 0xa0,
+        *impl::Opcode::DIV_IMM(), 0, 1, 2, 0x03, 0xe8,
+        *impl::Opcode::DIV_IMM(), 2, 1, 1, 0x00,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Ints ints(&vm);
+
+    assert(vm.step());
+    assert(vm.step());
+    assert(vm.regs().get_int(0) == 100);
+
+    assertThrows(
+        std::string,
+        "Divide by zero!",
+        vm.step());
+}
+
+static void test_ints_mod_imm()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT32(), 1, 0x00, 0x01, 0x86, 0xa3,
+        *impl::Opcode::MOD_IMM(), 0, 1, 2, 0x03, 0xe8,
+        *impl::Opcode::MOD_IMM(), 2, 1, 0,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Ints ints(&vm);
+
+    assert(vm.step());
+    assert(vm.step());
+    assert(vm.regs().get_int(0) == 3);
+
+    assertThrows(
+        std::string,
+        "Divide by zero!",
+        vm.step());
+}
+
+static void test_ints_imm_invalid_size()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::ADD_IMM(), 0, 1, 9, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Ints ints(&vm);
+
+    assertThrows(
+        std::string,
+        "Invalid size: 9",
+        vm.step());
+}
+
 void test_ints()
 {
+    TEST_CASE(test_ints_store_int);
     TEST_CASE(test_ints_load_int8);
     TEST_CASE(test_ints_load_int16);
     TEST_CASE(test_ints_load_int32);
@@ -494,5 +845,21 @@ void test_ints()
     TEST_CASE(test_ints_mod);
     TEST_CASE(test_ints_mod_by_zero);
 
+    TEST_CASE(test_ints_add_imm);
+    TEST_CASE(test_ints_sub_imm);
+    TEST_CASE(test_ints_mul_imm);
+    TEST_CASE(test_ints_div_imm);
+    TEST_CASE(test_ints_mod_imm);
+    TEST_CASE(test_ints_imm_invalid_size);
+
+    TEST_CASE(test_ints_bitops);
+    TEST_CASE(test_ints_bit_imm);
+    TEST_CASE(test_ints_bit_unary);
+
+    TEST_CASE(test_ints_idiv);
+    TEST_CASE(test_ints_idiv_overflow);
+    TEST_CASE(test_ints_mulh);
+    TEST_CASE(test_ints_div128);
+
     TEST_CASE(test_ints_print);
 }
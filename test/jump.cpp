@@ -363,6 +363,250 @@ static void test_jump_jmp_le_int()
     assert(!vm.step());
 }
 
+static void test_jump_jmp_le_imm8()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT8(), 0, 0,
+        *impl::Opcode::INC_INT(), 0,
+        *impl::Opcode::JMP_LE_IMM8(), 1, 0, 2, 0x01, 0x2c, (uint8_t)-8,
+        *impl::Opcode::STOP()
+    };
+
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::NopStop nopstop(&vm);
+    impl::Ints ints(&vm);
+    impl::Jump jmps(&vm);
+
+    assert(vm.step());
+    assert(vm.step());
+    assert(vm.step());
+    assert(vm.regs().pc() == 3);
+    assert(vm.regs().get_int(0) == 1);
+
+    while (vm.step());
+    assert(vm.regs().get_int(0) == 300);
+    assert(vm.regs().pc() == sizeof(mem));
+}
+
+static void test_jump_jmp_le_imm16()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT8(), 0, 0,
+        *impl::Opcode::INC_INT(), 0,
+        *impl::Opcode::JMP_LE_IMM16(), 5, 0, 1, 0x20, 0xff, 0xf9,
+        *impl::Opcode::STOP()
+    };
+
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::NopStop nopstop(&vm);
+    impl::Ints ints(&vm);
+    impl::Jump jmps(&vm);
+
+    while (vm.step());
+    assert(vm.regs().get_int(0) == 0x20);
+    assert(vm.regs().pc() == sizeof(mem));
+}
+
+static void test_jump_jmp_le_imm32()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT8(), 0, 0,
+        *impl::Opcode::INC_INT(), 0,
+        *impl::Opcode::JMP_LE_IMM32(), 0, 0, 0, 0xff, 0xff, 0xff, 0xf9,
+        *impl::Opcode::STOP()
+    };
+
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::NopStop nopstop(&vm);
+    impl::Ints ints(&vm);
+    impl::Jump jmps(&vm);
+
+    assert(vm.step());
+    assert(vm.step());
+    assert(vm.step());
+    assert(vm.regs().get_int(0) == 1);
+    assert(vm.regs().pc() == 13);
+    assert(!vm.step());
+}
+
+static bool jump_cmp_taken(
+    std::vector<uint8_t> code, uint64_t val1, uint64_t val2)
+{
+    core::VM vm(code.data(), code.size());
+    impl::Jump jmps(&vm);
+
+    vm.regs().put_int(0, val1);
+    vm.regs().put_int(1, val2);
+    assert(vm.step());
+
+    return vm.regs().pc() != code.size();
+}
+
+static void test_jump_cmp8()
+{
+    uint8_t ops[] = {
+        *impl::Opcode::JEQ8(), *impl::Opcode::JNE8(),
+        *impl::Opcode::JLT8(), *impl::Opcode::JGT8(),
+        *impl::Opcode::JLE8(), *impl::Opcode::JGE8()
+    };
+    // Expected results for 1 ? 2, 2 ? 2 and 3 ? 2
+    bool expect[][3] = {
+        {false, true, false},
+        {true, false, true},
+        {true, false, false},
+        {false, false, true},
+        {true, true, false},
+        {false, true, true}
+    };
+
+    for (int i = 0; i < 6; ++i) {
+        std::vector<uint8_t> code = {ops[i], 0, 1, 5};
+        for (int j = 0; j < 3; ++j)
+            assertEquals(jump_cmp_taken(code, j + 1, 2), expect[i][j]);
+    }
+}
+
+static void test_jump_cmp32()
+{
+    std::vector<uint8_t> code = {
+        *impl::Opcode::JLT32(), 0, 1, 0xff, 0xff, 0xff, 0xf0
+    };
+    assert(jump_cmp_taken(code, 1, 2));
+    assert(!jump_cmp_taken(code, 2, 2));
+
+    core::VM vm(code.data(), code.size());
+    impl::Jump jmps(&vm);
+    vm.regs().put_int(1, 1);
+    assert(vm.step());
+    // Offset -16 counts from after registers, PC wraps below zero
+    assertEquals(vm.regs().pc(), (uint64_t)-13);
+}
+
+static void test_jump_cmp_imm()
+{
+    std::vector<uint8_t> code = {
+        *impl::Opcode::JGE_IMM8(), 0, 3, 0x01, 0x86, 0xa0, 2
+    };
+    assert(jump_cmp_taken(code, 100000, 0));
+    assert(jump_cmp_taken(code, 100001, 0));
+    assert(!jump_cmp_taken(code, 99999, 0));
+
+    code = {
+        *impl::Opcode::JNE_IMM32(), 0x50, 0, 0, 0, 0, 2
+    };
+    assert(jump_cmp_taken(code, 0, 0));
+
+    code = {
+        *impl::Opcode::JEQ_IMM32(), 0x50, 0, 0, 0, 0, 2
+    };
+    assert(!jump_cmp_taken(code, 0, 0));
+}
+
+static void test_jump_signed()
+{
+    std::vector<uint8_t> code = {
+        *impl::Opcode::JSLT8(), 0, 1, 2
+    };
+    assert(jump_cmp_taken(code, -1, 1));
+    assert(!jump_cmp_taken(code, 1, -1));
+    assert(jump_cmp_taken(code, 0x8000000000000000, 0x7fffffffffffffff));
+
+    code = {
+        *impl::Opcode::JSGE32(), 0, 1, 0, 0, 0, 2
+    };
+    assert(jump_cmp_taken(code, 0, -5));
+    assert(!jump_cmp_taken(code, -6, -5));
+
+    code = {
+        *impl::Opcode::JSGT_IMM8(), 0, 1, 0xfb, 2
+    };
+    assert(jump_cmp_taken(code, -4, 0));
+    assert(!jump_cmp_taken(code, -5, 0));
+    assert(jump_cmp_taken(code, 0xfb, 0));
+
+    code = {
+        *impl::Opcode::JSLE_IMM32(), 0, 2, 0xff, 0x00, 0, 0, 0, 2
+    };
+    assert(jump_cmp_taken(code, -256, 0));
+    assert(!jump_cmp_taken(code, -255, 0));
+
+    code = {
+        *impl::Opcode::JMP_LE8(), 16, 0, 1, 2
+    };
+    assert(jump_cmp_taken(code, -1, 0));
+}
+
+static void test_jump_loop_inc8()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT8(), 0, 0,
+        *impl::Opcode::LOAD_INT8(), 1, 10,
+        *impl::Opcode::NOP(),
+        *impl::Opcode::LOOP_INC8(), 0, 1, (uint8_t)-4,
+        *impl::Opcode::STOP()
+    };
+
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::NopStop nopstop(&vm);
+    impl::Ints ints(&vm);
+    impl::Jump jmps(&vm);
+
+    assert(vm.step());
+    assert(vm.step());
+    assert(vm.step());
+    assert(vm.step());
+    assert(vm.regs().get_int(0) == 1);
+    assert(vm.regs().pc() == 6);
+
+    while (vm.step());
+    assert(vm.regs().get_int(0) == 10);
+    assert(vm.regs().pc() == sizeof(mem));
+    assert(vm.ticks() == 2 + 10 * 2 + 1);
+}
+
+static void test_jump_loop_dec16()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT8(), 0, 10,
+        *impl::Opcode::NOP(),
+        *impl::Opcode::LOOP_DEC16(), 0, 0x30, 0xff, 0xfc,
+        *impl::Opcode::STOP()
+    };
+
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::NopStop nopstop(&vm);
+    impl::Ints ints(&vm);
+    impl::Jump jmps(&vm);
+
+    while (vm.step());
+    assert(vm.regs().get_int(0) == 3);
+    assert(vm.regs().pc() == sizeof(mem));
+}
+
+static void test_jump_loop_imm()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT8(), 0, 0,
+        *impl::Opcode::NOP(),
+        *impl::Opcode::LOOP_INC_IMM32(), 0, 2, 0x01, 0x2c,
+            0xff, 0xff, 0xff, 0xfa,
+        *impl::Opcode::LOOP_DEC_IMM8(), 0, 0, (uint8_t)-3,
+        *impl::Opcode::STOP()
+    };
+
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::NopStop nopstop(&vm);
+    impl::Ints ints(&vm);
+    impl::Jump jmps(&vm);
+
+    while (vm.regs().pc() < 13)
+        assert(vm.step());
+    assert(vm.regs().get_int(0) == 300);
+
+    while (vm.step());
+    assert(vm.regs().get_int(0) == 0);
+    assert(vm.regs().pc() == sizeof(mem));
+}
 
 void test_jump()
 {
@@ -378,4 +622,17 @@ void test_jump()
     TEST_CASE(test_jump_jmp_le32);
     TEST_CASE(test_jump_jmp_le64);
     TEST_CASE(test_jump_jmp_le_int);
+
+    TEST_CASE(test_jump_jmp_le_imm8);
+    TEST_CASE(test_jump_jmp_le_imm16);
+    TEST_CASE(test_jump_jmp_le_imm32);
+
+    TEST_CASE(test_jump_cmp8);
+    TEST_CASE(test_jump_cmp32);
+    TEST_CASE(test_jump_cmp_imm);
+
+    TEST_CASE(test_jump_signed);
+    TEST_CASE(test_jump_loop_inc8);
+    TEST_CASE(test_jump_loop_dec16);
+    TEST_CASE(test_jump_loop_imm);
 }
@@ -0,0 +1,127 @@
+#include "framework.hh"
+#include <vm.hh>
+#include <maps.hh>
+#include <impl/opcodes.hh>
+#include <impl/maps.hh>
+#include <map>
+
+static core::RegisterData int_key(uint64_t val)
+{
+    core::RegisterData res;
+    res.m_int = val;
+    return res;
+}
+
+static core::RegisterData str_key(std::string val)
+{
+    core::RegisterData res;
+    res.m_type = core::RegisterType::String;
+    res.m_str = val;
+    return res;
+}
+
+static void test_maps_table()
+{
+    core::HashMap map;
+    std::map<uint64_t, uint64_t> ref;
+
+    assert(map.find(int_key(1)) == nullptr);
+    assert(!map.erase(int_key(1)));
+
+    // Inserts, overwrites and deletes with growth and tombstones
+    bool same = true;
+    for (uint64_t i = 0; i < 20000; ++i) {
+        uint64_t key = (i * 7919) % 3000;
+        if (i % 3 == 2) {
+            same = same && map.erase(int_key(key)) == (ref.erase(key) > 0);
+        } else {
+            map.put(int_key(key), int_key(i));
+            ref[key] = i;
+        }
+    }
+    assertEquals(map.size(), ref.size());
+    for (uint64_t key = 0; key < 3000; ++key) {
+        const core::RegisterData *val = map.find(int_key(key));
+        if (ref.count(key))
+            same = same && val && val->m_int == ref[key];
+        else
+            same = same && val == nullptr;
+    }
+    assert(same);
+}
+
+static void test_maps_keys()
+{
+    core::HashMap map;
+    core::RegisterData val = str_key("value");
+
+    map.put(str_key("1"), val);
+    map.put(int_key(1), int_key(2));
+    assertEquals(map.size(), 2);
+    assertEquals(map.find(str_key("1"))->m_str, "value");
+    assertEquals(map.find(int_key(1))->m_int, 2);
+    assert(map.find(str_key("2")) == nullptr);
+
+    core::RegisterData fkey;
+    fkey.m_type = core::RegisterType::Float;
+    fkey.m_float = 1.0;
+    assertThrows(std::string, "Invalid map key type", map.put(fkey, val));
+
+    core::Maps maps;
+    assertEquals(maps.create(), 1);
+    assertEquals(maps.create(), 2);
+    maps.get(2).put(int_key(5), int_key(6));
+    assertEquals(maps.get(1).size(), 0);
+    assertEquals(maps.get(2).size(), 1);
+    assertThrows(std::string, "Invalid map handle", maps.get(0));
+    assertThrows(std::string, "Invalid map handle", maps.get(3));
+}
+
+static void test_maps_opcodes()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::MAP_NEW(), 0,
+        *impl::Opcode::MAP_PUT(), 0, 1, 2,
+        *impl::Opcode::MAP_PUT(), 0, 0x30, 0x70,
+        *impl::Opcode::MAP_GET8(), 3, 0, 1, 0x10,
+        *impl::Opcode::MAP_GET32(), 4, 0, 0x30, 0, 0, 0, 0x20,
+        *impl::Opcode::MAP_SIZE(), 5, 0,
+        *impl::Opcode::MAP_DEL(), 0, 1,
+        *impl::Opcode::MAP_GET8(), 3, 0, 1, 0x10,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Maps maps(&vm);
+    vm.regs().put_string(1, "key");
+    vm.regs().put_float(2, 1.5);
+
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(0), 1);
+    assert(vm.step());
+    assert(vm.step());
+
+    assert(vm.step());
+    assertEquals(vm.regs().get_float(3), 1.5);
+    assertEquals(vm.regs().pc(), 15);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(4), 7);
+    assertEquals(vm.regs().pc(), 23);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(5), 2);
+    assert(vm.step());
+
+    // Miss jumps and leaves destination alone
+    assert(vm.step());
+    assertEquals(vm.regs().get_float(3), 1.5);
+    assertEquals(vm.regs().pc(), 33 + 0x10);
+
+    vm.regs().pc_update(10);
+    vm.regs().put_int(0, 2);
+    assertThrows(std::string, "Invalid map handle", vm.step());
+}
+
+void test_maps()
+{
+    TEST_CASE(test_maps_table);
+    TEST_CASE(test_maps_keys);
+    TEST_CASE(test_maps_opcodes);
+}
@@ -36,7 +36,64 @@ static void test_basic_mov()
     assert(vm.regs().get_string(10) == "ab");
 }
 
+static void test_select()
+{
+    static uint8_t code[] = {
+        *impl::Opcode::LOAD_INT8(), 0, 42,
+        *impl::Opcode::LOAD_STR(), 5, 'a', 'b', 0,
+        *impl::Opcode::SELECT(), 1, 0x10, 0, 5,
+        *impl::Opcode::SELECT(), 2, 3, 0, 5,
+        *impl::Opcode::SELECT(), 3, 0, 0x70, 0x80,
+    };
+    core::VM vm((uint8_t*)code, sizeof(code));
+
+    impl::Ints ints(&vm);
+    impl::Strs strs(&vm);
+    impl::Mov mov(&vm);
+
+    for (int i = 0; i < 5; ++i)
+        assert(vm.step());
+
+    assertEquals(vm.regs().get_int(1), 42);
+    assert(vm.regs().get_string(2) == "ab");
+    assertEquals(vm.regs().get_int(3), 7);
+}
+
+static uint64_t set_cmp(core::Opcode op, uint8_t reg1, uint8_t reg2)
+{
+    uint8_t code[] = {
+        *impl::Opcode::LOAD_INT8(), 1, 5,
+        *impl::Opcode::LOAD_INT8(), 2, 10,
+        *op, 0, reg1, reg2
+    };
+    core::VM vm(code, sizeof(code));
+
+    impl::Ints ints(&vm);
+    impl::Mov mov(&vm);
+
+    for (int i = 0; i < 3; ++i)
+        vm.step();
+
+    return vm.regs().get_int(0);
+}
+
+static void test_set_cmp()
+{
+    assertEquals(set_cmp(impl::Opcode::SETEQ(), 1, 0x50), 1);
+    assertEquals(set_cmp(impl::Opcode::SETEQ(), 1, 2), 0);
+    assertEquals(set_cmp(impl::Opcode::SETNE(), 1, 2), 1);
+    assertEquals(set_cmp(impl::Opcode::SETLT(), 1, 2), 1);
+    assertEquals(set_cmp(impl::Opcode::SETLT(), 2, 1), 0);
+    assertEquals(set_cmp(impl::Opcode::SETGT(), 2, 1), 1);
+    assertEquals(set_cmp(impl::Opcode::SETLE(), 1, 0x50), 1);
+    assertEquals(set_cmp(impl::Opcode::SETLE(), 2, 0x50), 0);
+    assertEquals(set_cmp(impl::Opcode::SETGE(), 0xf0, 2), 1);
+    assertEquals(set_cmp(impl::Opcode::SETGE(), 1, 2), 0);
+}
+
 void test_mov()
 {
     TEST_CASE(test_basic_mov);
+    TEST_CASE(test_select);
+    TEST_CASE(test_set_cmp);
 }
@@ -0,0 +1,538 @@
+#include "framework.hh"
+#include <vm.hh>
+#include <impl/opcodes.hh>
+#include <nopstop.hh>
+#include <ints.hh>
+#include <jump.hh>
+#include <mov.hh>
+#include <random.hh>
+#include <floats.hh>
+#include <strs.hh>
+#include <impl/maps.hh>
+#include <opt/optimizer.hh>
+
+static uint64_t run(core::VM &vm, const std::string &code)
+{
+    vm.load((uint8_t*)code.data(), code.length());
+    impl::NopStop nopstop(&vm);
+    impl::Ints ints(&vm);
+    impl::Jump jmps(&vm);
+    impl::Mov mov(&vm);
+    impl::Random rand(&vm);
+    impl::Floats floats(&vm);
+    impl::Maps maps(&vm);
+    impl::Strs strs(&vm);
+
+    while (vm.step());
+
+    return vm.ticks();
+}
+
+static void test_opt_fold()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT8(), 0, 2,
+        *impl::Opcode::LOAD_INT8(), 1, 3,
+        *impl::Opcode::ADD_INT(), 2, 0, 1,
+        *impl::Opcode::MUL_INT(), 3, 2, 0x20,
+        *impl::Opcode::INC_INT(), 3,
+        *impl::Opcode::MOV(), 4, 3,
+        *impl::Opcode::STOP()
+    };
+
+    opt::Optimizer optimizer(mem, sizeof(mem));
+    assert(optimizer.optimize());
+
+    std::string res = optimizer.code();
+    assertEquals(res.length(), 6 * 3 + 1);
+    assert(res[6] == *impl::Opcode::LOAD_INT8());
+    assert(res[7] == 2);
+    assert(res[8] == 5);
+
+    core::VM vm;
+    run(vm, res);
+    assertEquals(vm.regs().get_int(2), 5);
+    assertEquals(vm.regs().get_int(3), 11);
+    assertEquals(vm.regs().get_int(4), 11);
+}
+
+static void test_opt_strength()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::RANDOM(), 0,
+        *impl::Opcode::LOAD_INT8(), 5, 0,
+        *impl::Opcode::MUL_INT(), 1, 0, 0x20,
+        *impl::Opcode::MUL_INT(), 2, 0, 0x10,
+        *impl::Opcode::ADD_INT(), 0, 0, 5,
+        *impl::Opcode::DIV_INT(), 3, 0, 0x10,
+        *impl::Opcode::STOP()
+    };
+
+    opt::Optimizer optimizer(mem, sizeof(mem));
+    assert(optimizer.optimize());
+
+    std::string res = optimizer.code();
+    assertEquals(optimizer.instructions_before(), 7);
+    assertEquals(optimizer.instructions_after(), 6);
+    assert(res[5] == *impl::Opcode::ADD_INT());
+    assert(res[6] == 1);
+    assert(res[7] == 0);
+    assert(res[8] == 0);
+    assert(res[9] == *impl::Opcode::MOV());
+    assert(res[12] == *impl::Opcode::MOV());
+    assert((uint8_t)res[15] == *impl::Opcode::STOP());
+}
+
+static void test_opt_dead_code()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT8(), 0, 1,
+        *impl::Opcode::NOP(),
+        *impl::Opcode::STOP(),
+        *impl::Opcode::INC_INT(), 0,
+        *impl::Opcode::STOP()
+    };
+
+    opt::Optimizer optimizer(mem, sizeof(mem));
+    assert(optimizer.optimize());
+
+    std::string res = optimizer.code();
+    assertEquals(res.length(), 4);
+    assert((uint8_t)res[3] == *impl::Opcode::STOP());
+}
+
+static void test_opt_branch_shrink()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT8(), 0, 0,
+        *impl::Opcode::LOAD_INT8(), 1, 20,
+        *impl::Opcode::INC_INT(), 0,
+        *impl::Opcode::JMP_LE32(), 1, 0, 1, 0xff, 0xff, 0xff, 0xfa,
+        *impl::Opcode::STOP()
+    };
+
+    opt::Optimizer optimizer(mem, sizeof(mem));
+    assert(optimizer.optimize());
+
+    std::string res = optimizer.code();
+    assertEquals(res.length(), sizeof(mem) - 6);
+    assert(res[6] == *impl::Opcode::LOOP_INC8());
+    assert((uint8_t)res[9] == (uint8_t)-3);
+
+    core::VM vm;
+    run(vm, res);
+    assertEquals(vm.regs().get_int(0), 20);
+}
+
+static void test_opt_thread_jumps()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::RANDOM(), 0,
+        *impl::Opcode::JMP_LE8(), 0, 0, 0x10, 4,
+        *impl::Opcode::INC_INT(), 0,
+        *impl::Opcode::STOP(),
+        *impl::Opcode::JMP8(), (uint8_t)-2,
+    };
+
+    opt::Optimizer optimizer(mem, sizeof(mem));
+    assert(optimizer.optimize());
+
+    std::string res = optimizer.code();
+    assertEquals(res.length(), sizeof(mem) - 3);
+    assert(res[2] == *impl::Opcode::JEQ8());
+    assert(res[5] == 3);
+}
+
+static void test_opt_const_branch()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT8(), 0, 5,
+        *impl::Opcode::JMP_LE8(), 1, 0, 0x30, 4,
+        *impl::Opcode::INC_INT(), 0,
+        *impl::Opcode::STOP(),
+        *impl::Opcode::DEC_INT(), 0,
+        *impl::Opcode::STOP(),
+    };
+
+    opt::Optimizer optimizer(mem, sizeof(mem));
+    assert(optimizer.optimize());
+
+    std::string res = optimizer.code();
+    assertEquals(res.length(), 7);
+    assert(res[0] == *impl::Opcode::LOAD_INT8());
+    assert(res[3] == *impl::Opcode::LOAD_INT8());
+    assert(res[5] == 6);
+    assert((uint8_t)res[6] == *impl::Opcode::STOP());
+}
+
+static void test_opt_loop()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT8(), 0, 0,
+        *impl::Opcode::LOAD_INT8(), 1, 0,
+        *impl::Opcode::LOAD_INT16(), 4, 0x01, 0x00,
+        *impl::Opcode::NOP(),
+        *impl::Opcode::ADD_INT(), 1, 1, 0,
+        *impl::Opcode::MUL_INT(), 2, 0, 0x10,
+        *impl::Opcode::INC_INT(), 0,
+        *impl::Opcode::JMP_LE16(), 1, 0, 4, 0xff, 0xf1,
+        *impl::Opcode::STOP()
+    };
+
+    core::VM vm1;
+    uint64_t ticks = run(vm1, std::string((char*)mem, sizeof(mem)));
+
+    opt::Optimizer optimizer(mem, sizeof(mem));
+    assert(optimizer.optimize());
+
+    core::VM vm2;
+    uint64_t opt_ticks = run(vm2, optimizer.code());
+
+    assert(opt_ticks < ticks);
+    for (uint8_t i = 0; i < core::num_registers; ++i)
+        assertEquals(vm1.regs().get_int(i), vm2.regs().get_int(i));
+}
+
+static void test_opt_data()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::NOP(),
+        *impl::Opcode::LOAD_INT_MEM(), 0, 2, 0, 0, 0, 0, 0, 0, 0, 16,
+        *impl::Opcode::STOP(),
+        *impl::Opcode::INC_INT(), 0,
+        *impl::Opcode::STOP(),
+        0x12, 0x34
+    };
+
+    opt::Optimizer optimizer(mem, sizeof(mem));
+    assert(optimizer.optimize());
+
+    std::string res = optimizer.code();
+    assertEquals(res.length(), 14);
+    assert(res[10] == 12);
+
+    core::VM vm;
+    run(vm, res);
+    assertEquals(vm.regs().get_int(0), 0x1234);
+}
+
+static void test_opt_data_str()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::NOP(),
+        *impl::Opcode::LOAD_STR_MEM(), 0, 0, 0, 0, 0, 0, 0, 0, 15,
+        *impl::Opcode::STOP(),
+        *impl::Opcode::INC_INT(), 0,
+        *impl::Opcode::STOP(),
+        'H', 'i', 0
+    };
+
+    opt::Optimizer optimizer(mem, sizeof(mem));
+    assert(optimizer.optimize());
+
+    std::string res = optimizer.code();
+    assert(res.length() < sizeof(mem));
+
+    core::VM vm;
+    run(vm, res);
+    assertEquals(vm.regs().get_string(0), "Hi");
+}
+
+static void test_opt_str_pool()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::STR_POOL(), 0, 0, 0, 5,
+        'a', 0, 'b', 'c', 0,
+        *impl::Opcode::NOP(),
+        *impl::Opcode::LOAD_STR_CONST(), 0, 0, 1,
+        *impl::Opcode::STOP()
+    };
+
+    opt::Optimizer optimizer(mem, sizeof(mem));
+    assert(optimizer.optimize());
+
+    std::string res = optimizer.code();
+    assertEquals(res.length(), sizeof(mem) - 1);
+    assertEquals(res.substr(0, 10), std::string((char*)mem, 10));
+
+    core::VM vm;
+    run(vm, res);
+    assertEquals(vm.regs().get_string(0), "bc");
+}
+
+static void test_opt_indirect()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT8(), 0, 5,
+        *impl::Opcode::NOP(),
+        *impl::Opcode::JMP_INT(), 0,
+        *impl::Opcode::STOP()
+    };
+
+    opt::Optimizer optimizer(mem, sizeof(mem));
+    assert(!optimizer.optimize());
+    assert(optimizer.reason() == "Indirect jump at 4");
+    assert(optimizer.code() == std::string((char*)mem, sizeof(mem)));
+}
+
+static void test_opt_imm()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::RANDOM(), 0,
+        *impl::Opcode::LOAD_INT8(), 1, 7,
+        *impl::Opcode::ADD_IMM(), 2, 1, 8, 0, 0, 0, 0, 0, 0, 0, 0x10,
+        *impl::Opcode::MUL_IMM(), 3, 0, 1, 1,
+        *impl::Opcode::JMP_LE_IMM32(), 1, 0, 2, 0x01, 0x00, 0, 0, 0, 6,
+        *impl::Opcode::INC_INT(), 3,
+        *impl::Opcode::STOP()
+    };
+
+    opt::Optimizer optimizer(mem, sizeof(mem));
+    assert(optimizer.optimize());
+
+    std::string res = optimizer.code();
+    assertEquals(res.length(), 20);
+    assert(res[5] == *impl::Opcode::LOAD_INT8());
+    assert(res[6] == 2);
+    assert(res[7] == 0x17);
+    assert(res[8] == *impl::Opcode::MOV());
+    assert(res[11] == *impl::Opcode::JLT_IMM8());
+    assert(res[13] == 2);
+    assert(res[16] == 3);
+
+    core::VM vm;
+    run(vm, res);
+    uint64_t val = vm.regs().get_int(0);
+    if (val >= 0x100)
+        ++val;
+    assertEquals(vm.regs().get_int(2), 0x17);
+    assertEquals(vm.regs().get_int(3), val);
+}
+
+static void test_opt_imm_branch()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT8(), 0, 5,
+        *impl::Opcode::JMP_LE_IMM8(), 0, 0, 1, 5, 4,
+        *impl::Opcode::INC_INT(), 0,
+        *impl::Opcode::STOP(),
+        *impl::Opcode::DEC_INT(), 0,
+        *impl::Opcode::STOP(),
+    };
+
+    opt::Optimizer optimizer(mem, sizeof(mem));
+    assert(optimizer.optimize());
+
+    std::string res = optimizer.code();
+    assertEquals(res.length(), 7);
+    assert(res[3] == *impl::Opcode::LOAD_INT8());
+    assert(res[5] == 4);
+}
+
+static void test_opt_loop_fuse()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT8(), 0, 0,
+        *impl::Opcode::INC_INT(), 0,
+        *impl::Opcode::JMP_LE_IMM8(), 1, 0, 2, 0x01, 0x00, (uint8_t)-8,
+        *impl::Opcode::LOAD_INT8(), 2, 5,
+        *impl::Opcode::DEC_INT(), 2,
+        *impl::Opcode::JNE_IMM8(), 2, 0, (uint8_t)-5,
+        *impl::Opcode::STOP()
+    };
+
+    opt::Optimizer optimizer(mem, sizeof(mem));
+    assert(optimizer.optimize());
+
+    std::string res = optimizer.code();
+    assertEquals(res.length(), 17);
+    assert(res[3] == *impl::Opcode::LOOP_INC_IMM8());
+    assert(res[4] == 0);
+    assert(res[5] == 2);
+    assert((uint8_t)res[8] == (uint8_t)-5);
+    assert(res[12] == *impl::Opcode::LOOP_DEC_IMM8());
+    assert((uint8_t)res[15] == (uint8_t)-3);
+
+    core::VM vm;
+    run(vm, res);
+    assertEquals(vm.regs().get_int(0), 0x100);
+    assertEquals(vm.regs().get_int(2), 0);
+}
+
+static void test_opt_select()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::RANDOM(), 0,
+        *impl::Opcode::LOAD_INT8(), 1, 20,
+        *impl::Opcode::SETLT(), 2, 0x30, 0x50,
+        *impl::Opcode::SELECT(), 3, 2, 1, 0,
+        *impl::Opcode::SETGT(), 4, 0, 1,
+        *impl::Opcode::SELECT(), 5, 4, 0, 1,
+        *impl::Opcode::STOP()
+    };
+
+    opt::Optimizer optimizer(mem, sizeof(mem));
+    assert(optimizer.optimize());
+
+    std::string res = optimizer.code();
+    assertEquals(res.length(), sizeof(mem) - 3);
+    assert(res[5] == *impl::Opcode::LOAD_INT8());
+    assert(res[7] == 1);
+    assert(res[8] == *impl::Opcode::MOV());
+    assert(res[9] == 3);
+    assert(res[10] == 1);
+    assert(res[11] == *impl::Opcode::SETGT());
+    assert(res[15] == *impl::Opcode::SELECT());
+
+    core::VM vm;
+    run(vm, res);
+    uint64_t val = vm.regs().get_int(0);
+    uint64_t max = val > 20 ? val : 20;
+    assertEquals(vm.regs().get_int(3), 20);
+    assertEquals(vm.regs().get_int(5), max);
+}
+
+static void test_opt_bitops()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::RANDOM(), 0,
+        *impl::Opcode::LOAD_INT8(), 1, 0xf0,
+        *impl::Opcode::SHR_IMM(), 2, 1, 1, 4,
+        *impl::Opcode::POPCNT(), 3, 2,
+        *impl::Opcode::MUL_IMM(), 4, 0, 1, 64,
+        *impl::Opcode::DIV_INT(), 5, 0, 0x80,
+        *impl::Opcode::MOD_IMM(), 6, 0, 2, 0x10, 0x00,
+        *impl::Opcode::STOP()
+    };
+
+    opt::Optimizer optimizer(mem, sizeof(mem));
+    assert(optimizer.optimize());
+
+    std::string res = optimizer.code();
+    assert(res[5] == *impl::Opcode::LOAD_INT8());
+    assert(res[7] == 0x0f);
+    assert(res[8] == *impl::Opcode::LOAD_INT8());
+    assert(res[10] == 4);
+    assert(res[11] == *impl::Opcode::SHL_IMM());
+    assert(res[15] == 6);
+    assert(res[16] == *impl::Opcode::SHR_IMM());
+    assert(res[20] == 3);
+    assert(res[21] == *impl::Opcode::AND_IMM());
+    assert(res[25] == 0x0f);
+    assert((uint8_t)res[26] == 0xff);
+    assertEquals(res.length(), 28);
+
+    core::VM vm;
+    run(vm, res);
+    uint64_t val = vm.regs().get_int(0);
+    assertEquals(vm.regs().get_int(3), 4);
+    assertEquals(vm.regs().get_int(4), val * 64);
+    assertEquals(vm.regs().get_int(5), val / 8);
+    assertEquals(vm.regs().get_int(6), val % 0x1000);
+}
+
+static void test_opt_signed()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::RANDOM(), 0,
+        *impl::Opcode::LOAD_INT64(), 1,
+            0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xec,
+        *impl::Opcode::IDIV_IMM(), 2, 1, 1, 0xfb,
+        *impl::Opcode::JMP_LE_IMM8(), 16, 0, 8,
+            0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 3,
+        *impl::Opcode::INC_INT(), 3,
+        *impl::Opcode::STOP()
+    };
+
+    opt::Optimizer optimizer(mem, sizeof(mem));
+    assert(optimizer.optimize());
+
+    std::string res = optimizer.code();
+    assert(res[12] == *impl::Opcode::LOAD_INT8());
+    assert(res[14] == 4);
+    assert(res[15] == *impl::Opcode::JSLT_IMM8());
+    assert(res[17] == 1);
+    assert((uint8_t)res[18] == 0xff);
+    assertEquals(res.length(), 23);
+
+    core::VM vm;
+    run(vm, res);
+    int64_t val = vm.regs().get_int(0);
+    uint64_t inc = val < -1 ? 0 : 1;
+    assertEquals(vm.regs().get_int(3), inc);
+}
+
+static void test_opt_floats()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_FLOAT32(), 0, 0x3f, 0x80, 0, 0,
+        *impl::Opcode::LOAD_FLOAT32(), 1, 0x41, 0x20, 0, 0,
+        *impl::Opcode::FADD(), 0, 0, 0x10,
+        *impl::Opcode::JFLT32(), 0, 1, 0xff, 0xff, 0xff, 0xf9,
+        *impl::Opcode::FTOI(), 2, 0,
+        *impl::Opcode::STOP()
+    };
+
+    opt::Optimizer optimizer(mem, sizeof(mem));
+    assert(optimizer.optimize());
+
+    // Float compare is kept, only displacement shrinks
+    std::string res = optimizer.code();
+    assert((uint8_t)res[16] == *impl::Opcode::JFLT8());
+    assert((uint8_t)res[19] == 0xf9);
+    assertEquals(res.length(), sizeof(mem) - 3);
+
+    core::VM vm;
+    run(vm, res);
+    assertEquals(vm.regs().get_int(2), 10);
+}
+
+static void test_opt_maps()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::MAP_NEW(), 0,
+        *impl::Opcode::LOAD_INT8(), 1, 5,
+        *impl::Opcode::MAP_PUT(), 0, 0x30, 1,
+        *impl::Opcode::MAP_GET32(), 2, 0, 0x30, 0, 0, 0, 8,
+        *impl::Opcode::LOAD_INT8(), 3, 1,
+        *impl::Opcode::STOP(),
+        *impl::Opcode::LOAD_INT8(), 3, 2,
+        *impl::Opcode::STOP()
+    };
+
+    opt::Optimizer optimizer(mem, sizeof(mem));
+    assert(optimizer.optimize());
+
+    // Lookup is not mistaken for compare-branch
+    std::string res = optimizer.code();
+    assert((uint8_t)res[9] == *impl::Opcode::MAP_GET8());
+    assertEquals(res.length(), sizeof(mem) - 3);
+
+    core::VM vm;
+    run(vm, res);
+    assertEquals(vm.regs().get_int(2), 5);
+    assertEquals(vm.regs().get_int(3), 1);
+}
+
+void test_opt()
+{
+    TEST_CASE(test_opt_fold);
+    TEST_CASE(test_opt_strength);
+    TEST_CASE(test_opt_dead_code);
+    TEST_CASE(test_opt_branch_shrink);
+    TEST_CASE(test_opt_thread_jumps);
+    TEST_CASE(test_opt_const_branch);
+    TEST_CASE(test_opt_loop);
+    TEST_CASE(test_opt_data);
+    TEST_CASE(test_opt_data_str);
+    TEST_CASE(test_opt_str_pool);
+    TEST_CASE(test_opt_indirect);
+    TEST_CASE(test_opt_imm);
+    TEST_CASE(test_opt_imm_branch);
+    TEST_CASE(test_opt_loop_fuse);
+    TEST_CASE(test_opt_select);
+    TEST_CASE(test_opt_bitops);
+    TEST_CASE(test_opt_signed);
+    TEST_CASE(test_opt_floats);
+    TEST_CASE(test_opt_maps);
+}
@@ -0,0 +1,126 @@
+#include "framework.hh"
+#include <vm.hh>
+#include <output.hh>
+#include <impl/opcodes.hh>
+#include <nopstop.hh>
+#include <ints.hh>
+#include <strs.hh>
+#include <vector>
+#include <unistd.h>
+
+static void test_output_buffer()
+{
+    core::BufferOutput out;
+    out.write("a", 1);
+    out.write_int(0);
+    out.write_int(7);
+    out.write_int(42);
+    out.write_int(1234567890);
+    out.write_int(-1);
+    assertEquals(out.data(), "a07421234567890" "18446744073709551615");
+
+    out.clear();
+    assertEquals(out.data(), "");
+}
+
+static void test_output_threshold()
+{
+    std::vector<std::string> chunks;
+    core::CallbackOutput out([&](const char *data, uint64_t size) {
+        chunks.push_back(std::string(data, size));
+    }, 4);
+
+    out.write("ab", 2);
+    out.write("cd", 2);
+    assertEquals(chunks.size(), 0);
+    // Full buffer goes out first
+    out.write("e", 1);
+    assertEquals(chunks.size(), 1);
+    assertEquals(chunks[0], "abcd");
+    // Too big to buffer is passed on directly
+    out.write("fghij", 5);
+    assertEquals(chunks.size(), 3);
+    assertEquals(chunks[1], "e");
+    assertEquals(chunks[2], "fghij");
+
+    out.write("k", 1);
+    out.flush();
+    out.flush();
+    assertEquals(chunks.size(), 4);
+    assertEquals(chunks[3], "k");
+}
+
+static void test_output_async()
+{
+    int fds[2];
+    assertEquals(pipe(fds), 0);
+
+    // Tiny ring wraps around and fills up many times
+    std::string expect;
+    {
+        core::AsyncOutput out(fds[1], 7, 3);
+        for (uint64_t i = 0; i < 2000; ++i) {
+            out.write_int(i);
+            out.write(",", 1);
+            expect += std::to_string(i) + ",";
+        }
+        out.drain();
+        out.write("end", 3);
+        expect += "end";
+    }
+    close(fds[1]);
+
+    std::string res;
+    char buf[4096];
+    ssize_t got;
+    while ((got = read(fds[0], buf, sizeof(buf))) > 0)
+        res.append(buf, got);
+    close(fds[0]);
+    assertEquals(res.size(), expect.size());
+    assert(res == expect);
+
+    core::AsyncOutput bad(-1);
+    bad.write("a", 1);
+    assertThrows(std::string, "Output write failed", bad.drain());
+}
+
+static void test_output_vm()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::LOAD_INT8(), 0, 42,
+        *impl::Opcode::PRINT_INT(), 0,
+        *impl::Opcode::LOAD_STR(), 1, 'a', 'b', 0,
+        *impl::Opcode::PRINT_STR(), 1,
+        *impl::Opcode::STOP(),
+        *impl::Opcode::PRINT_INT(), 0,
+        *impl::Opcode::PRINT_STR(), 0,
+    };
+    core::BufferOutput out;
+    core::VM vm(mem, sizeof(mem));
+    impl::NopStop nopstop(&vm);
+    impl::Ints ints(&vm);
+    impl::Strs strs(&vm);
+    vm.set_output(&out);
+
+    // Flushed at STOP
+    while (vm.step());
+    assertEquals(out.data(), "42ab");
+
+    // and when instruction fails
+    out.clear();
+    assert(vm.step());
+    assertThrows(std::string, "Invalid register type, expected string",
+        vm.step());
+    assertEquals(out.data(), "42");
+
+    vm.set_output(nullptr);
+    assert(&vm.output() != &out);
+}
+
+void test_output()
+{
+    TEST_CASE(test_output_buffer);
+    TEST_CASE(test_output_threshold);
+    TEST_CASE(test_output_async);
+    TEST_CASE(test_output_vm);
+}
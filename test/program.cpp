@@ -0,0 +1,156 @@
+#include "framework.hh"
+#include <vm.hh>
+#include <program.hh>
+#include <impl/opcodes.hh>
+#include <nopstop.hh>
+#include <ints.hh>
+#include <strs.hh>
+#include <heap.hh>
+
+static std::string be(uint64_t val, unsigned size)
+{
+    std::string res(size, 0);
+    for (unsigned i = size; i > 0; --i) {
+        res[i - 1] = val & 0xff;
+        val >>= 8;
+    }
+    return res;
+}
+
+static std::string container(const std::string &code,
+    const std::string &rodata, uint64_t bss, uint64_t heap,
+    const std::string &strings, const std::string &symbols,
+    const std::string &lines, uint64_t entry = 0)
+{
+    std::string res = std::string("\x7fMVM", 4) + be(1, 2) + be(0, 2)
+        + be(entry, 8) + be(code.size(), 8) + be(rodata.size(), 8)
+        + be(bss, 8) + be(heap, 8) + be(strings.size(), 8)
+        + be(symbols.size(), 8) + be(lines.size(), 8)
+        + be(0, 4) + be(0, 4)
+        + code + rodata + strings + symbols + lines;
+    uint32_t crc = core::Program::checksum((const uint8_t*)res.data(),
+        res.size());
+    return res.replace(72, 4, be(crc, 4));
+}
+
+static void test_program_raw()
+{
+    uint8_t code[] = { *impl::Opcode::STOP() };
+    core::Program program;
+    program.load(code, sizeof(code));
+    assert(!program.container());
+    assertEquals(program.memory(), code);
+    assertEquals(program.memory_size(), 1);
+    assertEquals(program.entry(), 0);
+    assertEquals(program.bss_size() + program.heap_size(), 0);
+    assertEquals(program.symbol(0), "");
+    assertEquals(program.line(0), 0);
+}
+
+static void test_program_sections()
+{
+    std::string code = {
+        (char)*impl::Opcode::STOP(),
+        (char)*impl::Opcode::LOAD_INT8(), 1, 42,
+        (char)*impl::Opcode::STOP()
+    };
+    std::string symbols = be(0, 8) + std::string("first", 6)
+        + be(5, 8) + std::string("data", 5)
+        + be(1, 8) + std::string("main", 5);
+    std::string lines = be(0, 8) + be(3, 4) + be(1, 8) + be(7, 4)
+        + be(4, 8) + be(8, 4);
+    std::string data = container(code, "xyz", 8, 24,
+        std::string("ab\0c\0", 5), symbols, lines, 1);
+
+    core::Program program;
+    program.load((const uint8_t*)data.data(), data.size());
+    assert(program.container());
+    assertEquals(program.code_size(), 5);
+    assertEquals(program.rodata_size(), 3);
+    assertEquals(program.memory_size(), 8);
+    assertEquals(std::string((const char*)program.memory(), 8),
+        code + "xyz");
+    assertEquals(program.entry(), 1);
+    assertEquals(program.bss_size(), 8);
+    assertEquals(program.heap_size(), 24);
+    assertEquals(program.strings_size(), 5);
+
+    assertEquals(program.symbol(0), "first");
+    assertEquals(program.symbol(3), "main+2");
+    assertEquals(program.symbol(6), "data+1");
+    assertEquals(program.line(0), 3);
+    assertEquals(program.line(2), 7);
+    assertEquals(program.line(4), 8);
+
+    // Starts from entry with strings and heap ready
+    core::VM vm;
+    vm.load(program);
+    impl::NopStop nopstop(&vm);
+    impl::Ints ints(&vm);
+    while (vm.step());
+    assertEquals(vm.regs().get_int(1), 42);
+    assertEquals(vm.string_count(), 2);
+    assertEquals(vm.string_const(1).size, 1);
+    assertEquals(vm.size(), 8);
+    assertEquals(vm.heap_size(), 32);
+    assertEquals(vm.mem(8), 0);
+    vm.set_mem(8 + 31, 5);
+    assertEquals(vm.mem(8 + 31), 5);
+    assertThrows(std::string, "Write attempt to read only memory",
+        vm.set_mem(7, 1));
+
+    // Optimized code replaces both sections
+    program.set_memory((const uint8_t*)code.data(), 2);
+    assertEquals(program.memory_size(), 2);
+    assertEquals(program.rodata_size(), 0);
+    assertEquals(program.symbol(3), "");
+    assertEquals(program.line(3), 0);
+}
+
+static void test_program_invalid()
+{
+    core::Program program;
+    std::string data = container(std::string(1, (char)*impl::Opcode::STOP()),
+        "", 0, 0, "", "", "");
+    program.load((const uint8_t*)data.data(), data.size());
+
+    assertThrows(std::string, "Truncated program header",
+        program.load((const uint8_t*)data.data(), 10));
+
+    std::string bad = data;
+    bad[5] = 2;
+    assertThrows(std::string, "Unsupported program version: 2",
+        program.load((const uint8_t*)bad.data(), bad.size()));
+
+    bad = data;
+    bad[80] = 0;
+    assertThrows(std::string, "Program checksum mismatch",
+        program.load((const uint8_t*)bad.data(), bad.size()));
+
+    assertThrows(std::string, "Program size mismatch",
+        program.load((const uint8_t*)(data + "x").data(), data.size() + 1));
+
+    bad = container("", "", 0, 0, "", "", "");
+    bad.replace(16, 8, be(2, 8));
+    assertThrows(std::string, "Program section out of bounds",
+        program.load((const uint8_t*)bad.data(), bad.size()));
+
+    bad = container(std::string(2, 0), "", 0, 0, "", "", "", 2);
+    assertThrows(std::string, "Invalid entry point: 2",
+        program.load((const uint8_t*)bad.data(), bad.size()));
+
+    bad = container("", "", 0, 0, "", be(0, 8) + "a", "");
+    assertThrows(std::string, "Invalid symbol table",
+        program.load((const uint8_t*)bad.data(), bad.size()));
+
+    bad = container("", "", 0, 0, "", "", be(0, 8));
+    assertThrows(std::string, "Invalid line table",
+        program.load((const uint8_t*)bad.data(), bad.size()));
+}
+
+void test_program()
+{
+    TEST_CASE(test_program_raw);
+    TEST_CASE(test_program_sections);
+    TEST_CASE(test_program_invalid);
+}
@@ -12,6 +12,21 @@ int main(int argc, char **argv)
     REGISTER_TEST(strs);
     REGISTER_TEST(jump);
     REGISTER_TEST(heap);
+    REGISTER_TEST(floats);
+    REGISTER_TEST(vectors);
+    REGISTER_TEST(arrays);
+    REGISTER_TEST(sort);
+    REGISTER_TEST(hash);
+    REGISTER_TEST(maps);
+    REGISTER_TEST(output);
+    REGISTER_TEST(image);
+    REGISTER_TEST(program);
+    REGISTER_TEST(snapshot);
+    REGISTER_TEST(checkpoint);
+    REGISTER_TEST(batch);
+    REGISTER_TEST(vmpool);
+    REGISTER_TEST(format);
+    REGISTER_TEST(opt);
 
     unsigned int res = 0;
     try {
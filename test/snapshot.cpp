@@ -0,0 +1,141 @@
+#include "framework.hh"
+#include <vm.hh>
+#include <impl/opcodes.hh>
+#include <nopstop.hh>
+#include <ints.hh>
+#include <strs.hh>
+#include <snapshots.hh>
+#include <cstring>
+#include <unistd.h>
+
+static uint8_t code[] = {
+    *impl::Opcode::STR_POOL(), 0, 0, 0, 3,
+    'a', 'b', 0,
+    *impl::Opcode::LOAD_INT8(), 1, 7,
+    *impl::Opcode::LOAD_STR_CONST(), 2, 0, 0,
+    *impl::Opcode::SNAPSHOT(),
+    *impl::Opcode::INC_INT(), 1,
+    *impl::Opcode::STOP()
+};
+
+static core::RegisterData str_data(std::string val)
+{
+    core::RegisterData res;
+    res.m_type = core::RegisterType::String;
+    res.m_str = val;
+    return res;
+}
+
+static void test_snapshot_state()
+{
+    std::string path = temp_file();
+    core::VM vm(code, sizeof(code));
+    impl::NopStop nopstop(&vm);
+    impl::Ints ints(&vm);
+    impl::Strs strs(&vm);
+    impl::Snapshots snapshots(&vm);
+    for (int i = 0; i < 4; ++i)
+        assert(vm.step());
+
+    vm.regs().put_float(3, 1.5);
+    vm.regs().put_string(4, "owned");
+    vm.vregs().get(5)[31] = 0x42;
+    vm.add_heap(10);
+    vm.add_heap(0);
+    vm.add_heap(5000);
+    vm.set_mem(sizeof(code) + 3, 0x11);
+    vm.set_mem(sizeof(code) + 5009, 0x22);
+    core::HashMap &map = vm.maps().get(vm.maps().create());
+    map.put(str_data("key"), str_data("val"));
+    vm.maps().create();
+    vm.snapshot(path);
+
+    core::VM vm2(code, sizeof(code));
+    impl::NopStop nopstop2(&vm2);
+    impl::Ints ints2(&vm2);
+    impl::Strs strs2(&vm2);
+    vm2.restore(path);
+    assertEquals(vm2.regs().pc(), 16);
+    assertEquals(vm2.ticks(), 4);
+    assertEquals(vm2.string_count(), 1);
+    assertEquals(vm2.regs().get_int(1), 7);
+    assertEquals(vm2.regs().get_string(2), "ab");
+    assertEquals(vm2.regs().get_float(3), 1.5);
+    assertEquals(vm2.regs().get_string(4), "owned");
+    assertEquals(vm2.vregs().get(5)[31], 0x42);
+    assertEquals(vm2.heap_size(), 5010);
+    assertEquals(vm2.mem(sizeof(code) + 3), 0x11);
+    assertEquals(vm2.mem(sizeof(code) + 5009), 0x22);
+    assert(vm2.heap(5009).mapped());
+    assertEquals(vm2.maps().count(), 2);
+    assertEquals(vm2.maps().get(1).find(str_data("key"))->str().size, 3);
+    assertEquals(vm2.maps().get(2).size(), 0);
+
+    // Pages are private, file stays as it was
+    vm2.set_mem(sizeof(code) + 3, 0x33);
+    core::VM vm3(code, sizeof(code));
+    vm3.restore(path);
+    assertEquals(vm3.mem(sizeof(code) + 3), 0x11);
+
+    while (vm2.step());
+    assertEquals(vm2.regs().get_int(1), 8);
+    assertEquals(vm2.ticks(), 6);
+    unlink(path.c_str());
+}
+
+static void test_snapshot_opcode()
+{
+    std::string path = temp_file();
+    core::VM vm(code, sizeof(code));
+    impl::NopStop nopstop(&vm);
+    impl::Ints ints(&vm);
+    impl::Strs strs(&vm);
+    impl::Snapshots snapshots(&vm, path);
+    while (vm.step());
+    assertEquals(vm.regs().get_int(1), 8);
+
+    // Continues after SNAPSHOT
+    core::VM vm2(code, sizeof(code));
+    impl::NopStop nopstop2(&vm2);
+    impl::Ints ints2(&vm2);
+    vm2.restore(path);
+    assertEquals(vm2.regs().get_int(1), 7);
+    while (vm2.step());
+    assertEquals(vm2.regs().get_int(1), 8);
+    unlink(path.c_str());
+}
+
+static void test_snapshot_invalid()
+{
+    std::string path = temp_file();
+    core::VM vm(code, sizeof(code));
+    vm.regs().put_int(1, 3);
+    assertThrows(std::string, "Invalid snapshot: " + path, vm.restore(path));
+    vm.snapshot(path);
+
+    uint8_t other[sizeof(code)];
+    std::memcpy(other, code, sizeof(code));
+    other[10] = 8;
+    core::VM vm2(other, sizeof(other));
+    assertThrows(std::string, "Snapshot doesn't match loaded program",
+        vm2.restore(path));
+    // Failed restore leaves VM as it was
+    assertEquals(vm2.regs().get_int(1), 0);
+
+    truncate(path.c_str(), 100);
+    core::VM vm3(code, sizeof(code));
+    assertThrows(std::string, "Truncated snapshot", vm3.restore(path));
+    unlink(path.c_str());
+
+    assertThrows(std::string, "Can't open snapshot: " + path,
+        vm3.restore(path));
+    assertThrows(std::string, "Can't write snapshot: /nonexistent/x",
+        vm3.snapshot("/nonexistent/x"));
+}
+
+void test_snapshot()
+{
+    TEST_CASE(test_snapshot_state);
+    TEST_CASE(test_snapshot_opcode);
+    TEST_CASE(test_snapshot_invalid);
+}
@@ -0,0 +1,167 @@
+#include "framework.hh"
+#include <vm.hh>
+#include <impl/opcodes.hh>
+#include <arrays.hh>
+#include <pool.hh>
+#include <sort.hh>
+#include <cstring>
+
+static void test_sort_signed()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::SORT(), (uint8_t)core::Lane::I32, 0, 1, 0x40,
+        *impl::Opcode::BSEARCH(), 2, (uint8_t)core::Lane::I32, 0, 1, 3, 0x40,
+        *impl::Opcode::BSEARCH(), 4, (uint8_t)core::Lane::I32, 0, 1, 5, 0x40,
+        *impl::Opcode::SORT(), (uint8_t)core::Lane::U32, 0, 1, 0x40,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Sort sort(&vm);
+    vm.add_heap(400);
+    uint8_t *heap = vm.heap_range(sizeof(mem), 400);
+    for (int i = 0; i < 100; ++i)
+        put_be(heap + i * 4, ((i * 37) % 100) - 50, 4);
+    vm.regs().put_int(0, sizeof(mem));
+    vm.regs().put_int(1, 100);
+    vm.regs().put_int(3, -20);
+    vm.regs().put_int(5, 1000);
+
+    assert(vm.step());
+    for (int i = 0; i < 100; ++i)
+        assertEquals((int32_t)get_be(heap + i * 4, 4), i - 50);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(2), 30);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(4), 100);
+
+    // Same bytes as unsigned put negative ones last
+    assert(vm.step());
+    assertEquals(get_be(heap, 4), 0);
+    assertEquals(get_be(heap + 99 * 4, 4), 0xffffffff);
+}
+
+static void test_sort_records()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::SORT(), (uint8_t)core::Lane::U16, 0, 1, 2,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Sort sort(&vm);
+    vm.add_heap(64 * 6);
+    uint8_t *heap = vm.heap_range(sizeof(mem), 64 * 6);
+    for (int i = 0; i < 64; ++i) {
+        put_be(heap + i * 6, (i % 4) * 0x101, 2);
+        put_be(heap + i * 6 + 2, i, 4);
+    }
+    vm.regs().put_int(0, sizeof(mem));
+    vm.regs().put_int(1, 64);
+    vm.regs().put_int(2, 6);
+
+    assert(vm.step());
+    // Payload follows key and equal keys keep their order
+    for (uint64_t i = 0; i < 64; ++i) {
+        assertEquals(get_be(heap + i * 6, 2), (i / 16) * 0x101);
+        assertEquals(get_be(heap + i * 6 + 2, 4), (i % 16) * 4 + i / 16);
+    }
+}
+
+static void test_sort_float()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::SORT(), (uint8_t)core::Lane::F64, 0, 1, 0x80,
+        *impl::Opcode::BSEARCH(), 2, (uint8_t)core::Lane::F64, 0, 1, 3, 0x80,
+        *impl::Opcode::BSEARCH(), 4, (uint8_t)core::Lane::F64, 0, 1, 0x10, 0x80,
+    };
+    static const double values[] = {2.5, -0.0, -7.25, 1e300, 0.0, -1e-300, 3.0};
+    static const double sorted[] = {-7.25, -1e-300, -0.0, 0.0, 2.5, 3.0, 1e300};
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Sort sort(&vm);
+    vm.add_heap(7 * 8);
+    uint8_t *heap = vm.heap_range(sizeof(mem), 7 * 8);
+    for (int i = 0; i < 7; ++i) {
+        uint64_t bits;
+        memcpy(&bits, &values[i], 8);
+        put_be(heap + i * 8, bits, 8);
+    }
+    vm.regs().put_int(0, sizeof(mem));
+    vm.regs().put_int(1, 7);
+    vm.regs().put_float(3, -1.0);
+
+    assert(vm.step());
+    for (int i = 0; i < 7; ++i) {
+        uint64_t bits = get_be(heap + i * 8, 8);
+        uint64_t expect;
+        memcpy(&expect, &sorted[i], 8);
+        assertEquals(bits, expect);
+    }
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(2), 1);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(4), 4);
+}
+
+static void test_sort_parallel()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::SORT(), (uint8_t)core::Lane::I64, 0, 1, 0x80,
+    };
+    const unsigned count = 20000;
+    uint64_t threshold = impl::Arrays::parallel_threshold();
+    static uint8_t sorted[2][count * 8];
+
+    for (int run = 0; run < 2; ++run) {
+        impl::ThreadPool::set_shared_threads(run ? 4 : 1);
+        impl::Arrays::set_parallel_threshold(run ? 64 : threshold);
+
+        core::VM vm((uint8_t*)mem, sizeof(mem));
+        impl::Sort sort(&vm);
+        vm.add_heap(count * 8);
+        uint8_t *heap = vm.heap_range(sizeof(mem), count * 8);
+        for (unsigned i = 0; i < count; ++i)
+            put_be(heap + i * 8, (int32_t)(i * 2654435761u), 8);
+        vm.regs().put_int(0, sizeof(mem));
+        vm.regs().put_int(1, count);
+
+        assert(vm.step());
+        memcpy(sorted[run], heap, count * 8);
+    }
+    impl::ThreadPool::set_shared_threads(0);
+    impl::Arrays::set_parallel_threshold(threshold);
+
+    assertEquals(memcmp(sorted[0], sorted[1], count * 8), 0);
+    bool ordered = true;
+    for (unsigned i = 1; i < count; ++i)
+        ordered = ordered && (int64_t)get_be(sorted[0] + (i - 1) * 8, 8)
+            <= (int64_t)get_be(sorted[0] + i * 8, 8);
+    assert(ordered);
+}
+
+static void test_sort_invalid()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::SORT(), (uint8_t)core::Lane::U32, 0, 1, 0x20,
+        *impl::Opcode::SORT(), (uint8_t)core::Lane::U32, 0, 1, 0x40,
+        *impl::Opcode::BSEARCH(), 2, (uint8_t)core::Lane::U32, 0, 0x00, 3, 0x40,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Sort sort(&vm);
+    vm.add_heap(16);
+    vm.regs().put_int(0, sizeof(mem));
+    vm.regs().put_int(1, 5);
+
+    assertThrows(std::string, "Invalid array stride: 2", vm.step());
+    vm.regs().pc_update(5);
+    assertThrows(std::string, "Heap memory access out of bounds", vm.step());
+    vm.regs().pc_update(10);
+    vm.regs().put_int(0, 0);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(2), 0);
+}
+
+void test_sort()
+{
+    TEST_CASE(test_sort_signed);
+    TEST_CASE(test_sort_records);
+    TEST_CASE(test_sort_float);
+    TEST_CASE(test_sort_parallel);
+    TEST_CASE(test_sort_invalid);
+}
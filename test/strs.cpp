@@ -2,6 +2,7 @@
 #include <vm.hh>
 #include <impl/opcodes.hh>
 #include <strs.hh>
+#include <cstring>
 
 static uint8_t mem[] = {
     *impl::Opcode::LOAD_STR(), 0, 'A', 'b', 'E', 0x9, 0,
@@ -39,6 +40,7 @@ static void test_strs_print()
     StdoutCatcher catcher;
     catcher.start();
     bool res = vm.step();
+    vm.output().flush();
     catcher.stop();
     assert(res);
 
@@ -46,15 +48,232 @@ static void test_strs_print()
 
     catcher.start(true);
     res = vm.step();
+    vm.output().flush();
     catcher.stop();
     assert(res);
 
     assert(catcher.get() == "Dummy");
 }
 
+static void test_strs_ref()
+{
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Strs strs(&vm);
+
+    // Literal is used in place
+    assert(vm.step());
+    core::StringRef ref = vm.regs().get_string_ref(0);
+    assert(ref.data == (const char*)mem + 2);
+    assertEquals(ref.size, 4);
+    assertEquals(vm.regs().pc(), 7);
+
+    vm.regs().copy(3, 0);
+    assert(vm.regs().get_string_ref(3).data == ref.data);
+    vm.regs().put_string(0, "new");
+    assert(vm.regs().get_string(0) == "new");
+    assert(vm.regs().get_string(3) == "AbE\x09");
+}
+
+static void test_strs_mem()
+{
+    static uint8_t code[] = {
+        *impl::Opcode::LOAD_STR_MEM(), 0, 0, 0, 0, 0, 0, 0, 0, 33,
+        *impl::Opcode::STORE_STR(), 0, 1,
+        *impl::Opcode::STORE_STR_MEM(), 0, 0, 0, 0, 0, 0, 0, 0, 53,
+        *impl::Opcode::LOAD_STR_MEM(), 2, 0, 0, 0, 0, 0, 0, 0, 53,
+        'D', 'a', 't', 'a', 0,
+        *impl::Opcode::LOAD_STR_MEM(), 3, 0, 0, 0, 0, 0, 0, 0, 47,
+    };
+    core::VM vm(code, sizeof(code));
+    impl::Strs strs(&vm);
+    vm.add_heap(10);
+    vm.regs().put_int(1, sizeof(code));
+
+    assert(vm.step());
+    assert(vm.regs().get_string(0) == "Data");
+    assert(vm.regs().get_string_ref(0).data == (const char*)code + 33);
+
+    assert(vm.step());
+    uint8_t *heap = vm.heap_range(sizeof(code), 10);
+    assertEquals(memcmp(heap, "Data", 5), 0);
+    assert(vm.step());
+    assertEquals(memcmp(heap + 5, "Data", 5), 0);
+
+    // Heap strings are copies
+    assert(vm.step());
+    heap[5] = 'd';
+    assert(vm.regs().get_string(2) == "Data");
+
+    // No terminating NUL in code or heap
+    vm.regs().pc_update(38);
+    assertThrows(std::string, "Memory access out of bounds", vm.step());
+    heap[9] = 'x';
+    vm.regs().pc_update(23);
+    assertThrows(std::string, "Heap memory access out of bounds", vm.step());
+    vm.regs().pc_update(10);
+    vm.regs().put_int(1, sizeof(code) + 6);
+    assertThrows(std::string, "Heap memory access out of bounds", vm.step());
+}
+
+static void test_strs_pool()
+{
+    static uint8_t code[] = {
+        *impl::Opcode::STR_POOL(), 0, 0, 0, 7,
+        'a', 'b', 0, 0, 'c', 'd', 0,
+        *impl::Opcode::LOAD_STR_CONST(), 0, 0, 2,
+        *impl::Opcode::LOAD_STR_CONST(), 1, 0, 1,
+        *impl::Opcode::LOAD_STR_CONST(), 2, 0, 3,
+        *impl::Opcode::STR_POOL(), 0, 0, 0, 2,
+        'x', 'y',
+    };
+    core::VM vm(code, sizeof(code));
+    impl::Strs strs(&vm);
+
+    assert(vm.step());
+    assertEquals(vm.string_count(), 3);
+    assertEquals(vm.regs().pc(), 12);
+
+    assert(vm.step());
+    assert(vm.regs().get_string(0) == "cd");
+    assert(vm.regs().get_string_ref(0).data == (const char*)code + 9);
+    assert(vm.step());
+    assert(vm.regs().get_string(1) == "");
+
+    assertThrows(std::string, "Invalid string constant: 3", vm.step());
+    vm.regs().pc_update(24);
+    assertThrows(std::string, "Unterminated string pool", vm.step());
+    assertEquals(vm.string_count(), 3);
+}
+
+static void test_strs_ops()
+{
+    static uint8_t code[] = {
+        *impl::Opcode::LOAD_STR(), 0, 'a', 'b', 'c', 'a', 'b', 0,
+        *impl::Opcode::CONCAT(), 1, 0, 0,
+        *impl::Opcode::CONCAT(), 1, 1, 0,
+        *impl::Opcode::SUBSTR(), 2, 0, 0x10, 0x30,
+        *impl::Opcode::SUBSTR(), 3, 1, 0x40, 0xf0,
+        *impl::Opcode::FIND(), 4, 1, 2,
+        *impl::Opcode::FIND(), 5, 0, 1,
+        *impl::Opcode::LEN(), 6, 1,
+        *impl::Opcode::SUBSTR(), 2, 0, 0x60, 0x10,
+    };
+    core::VM vm(code, sizeof(code));
+    impl::Strs strs(&vm);
+
+    assert(vm.step());
+    assert(vm.step());
+    assert(vm.regs().get_string(1) == "abcababcab");
+    // Appends in place after the first copy
+    assert(vm.step());
+    assert(vm.regs().get_string(1) == "abcababcababcab");
+
+    // Substring of literal refers to it
+    assert(vm.step());
+    assert(vm.regs().get_string(2) == "bca");
+    assert(vm.regs().get_string_ref(2).data == (const char*)code + 3);
+    assert(vm.step());
+    assert(vm.regs().get_string(3) == "babcababcab");
+
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(4), 1);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(5), 5);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(6), 15);
+
+    assertThrows(std::string, "String index out of bounds", vm.step());
+    vm.regs().pc_update(8);
+    vm.regs().put_int(0, 1);
+    assertThrows(std::string, "Invalid register type, expected string",
+        vm.step());
+}
+
+static void test_strs_jump()
+{
+    static uint8_t code[] = {
+        *impl::Opcode::JSTR8(), 1, 0, 1, 0x10,
+        *impl::Opcode::JSTR32(), 0, 0, 2, 0, 0, 0, 0x20,
+        *impl::Opcode::JSTR8(), 4, 1, 0, 0x10,
+        *impl::Opcode::JSTR8(), 9, 1, 0, 0x10,
+    };
+    core::VM vm(code, sizeof(code));
+    impl::Strs strs(&vm);
+    vm.regs().put_string(0, "ab");
+    vm.regs().put_string(1, "abc");
+    vm.regs().put_string(2, "ab");
+
+    // Prefix is less
+    assert(vm.step());
+    assertEquals(vm.regs().pc(), 4 + 0x10);
+    vm.regs().pc_update(5);
+    assert(vm.step());
+    assertEquals(vm.regs().pc(), 9 + 0x20);
+    vm.regs().pc_update(13);
+    assert(vm.step());
+    assertEquals(vm.regs().pc(), 17 + 0x10);
+
+    vm.regs().put_string(1, "aa");
+    vm.regs().pc_update(13);
+    assert(vm.step());
+    assertEquals(vm.regs().pc(), 18);
+    assertThrows(std::string, "Invalid string comparison: 9", vm.step());
+}
+
+static void test_strs_conv()
+{
+    static uint8_t code[] = {
+        *impl::Opcode::TO_INT(), 1, 0,
+        *impl::Opcode::FROM_INT(), 2, 1,
+        *impl::Opcode::FROM_INT(), 3, 0x00,
+        *impl::Opcode::TO_INT(), 1, 2,
+    };
+    core::VM vm(code, sizeof(code));
+    impl::Strs strs(&vm);
+    vm.regs().put_string(0, "-42");
+
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(1), (uint64_t)-42);
+    assert(vm.step());
+    assert(vm.regs().get_string(2) == "-42");
+    vm.regs().put_int(0, 0);
+    assert(vm.step());
+    assert(vm.regs().get_string(3) == "0");
+
+    vm.regs().put_string(2, "12a");
+    assertThrows(std::string, "Invalid integer: 12a", vm.step());
+    vm.regs().pc_update(9);
+    vm.regs().put_string(2, "-");
+    assertThrows(std::string, "Invalid integer: -", vm.step());
+
+    // Whole signed range goes back and forth, beyond it is an error
+    const char *limits[] = {"9223372036854775807", "-9223372036854775808"};
+    for (auto limit : limits) {
+        vm.regs().put_string(0, limit);
+        vm.regs().pc_update(0);
+        assert(vm.step());
+        assert(vm.step());
+        assertEquals(vm.regs().get_string(2), limit);
+    }
+    const char *over[] = {"9223372036854775808", "-9223372036854775809",
+        "123456789012345678901"};
+    for (auto val : over) {
+        vm.regs().put_string(0, val);
+        vm.regs().pc_update(0);
+        assertThrows(std::string, std::string("Invalid integer: ") + val,
+            vm.step());
+    }
+}
+
 void test_strs()
 {
     TEST_CASE(test_strs_load_str);
+    TEST_CASE(test_strs_ref);
+    TEST_CASE(test_strs_mem);
+    TEST_CASE(test_strs_pool);
+    TEST_CASE(test_strs_ops);
+    TEST_CASE(test_strs_jump);
+    TEST_CASE(test_strs_conv);
 
     TEST_CASE(test_strs_print);
 }
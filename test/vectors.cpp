@@ -0,0 +1,180 @@
+#include "framework.hh"
+#include <vm.hh>
+#include <impl/opcodes.hh>
+#include <vectors.hh>
+#include <cstring>
+
+static const uint8_t i32x8 = (uint8_t)core::Lane::I32 | core::vector_wide;
+
+static void test_vectors_load_store()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::VLOAD(), 0, i32x8, 0,
+        *impl::Opcode::VSTORE(), 0, i32x8, 1,
+        *impl::Opcode::VLOAD(), 1, (uint8_t)core::Lane::U16, 0,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Vectors vectors(&vm);
+    vm.add_heap(64);
+    uint8_t *heap = vm.heap_range(sizeof(mem), 64);
+    for (int i = 0; i < 8; ++i)
+        heap[i * 4 + 3] = i + 1;
+    heap[1] = 0x80;
+    vm.regs().put_int(0, sizeof(mem));
+    vm.regs().put_int(1, sizeof(mem) + 32);
+
+    assert(vm.step());
+    int32_t lanes[8];
+    std::memcpy(lanes, vm.vregs().get(0), sizeof(lanes));
+    assertEquals(lanes[0], 0x00800001);
+    assertEquals(lanes[7], 8);
+
+    assert(vm.step());
+    assert(std::memcmp(heap, heap + 32, 32) == 0);
+
+    // 128-bit load clears upper half
+    std::memset(vm.vregs().get(1), 0xff, core::vector_bytes);
+    assert(vm.step());
+    uint16_t half[16];
+    std::memcpy(half, vm.vregs().get(1), sizeof(half));
+    assertEquals(half[0], 0x0080);
+    assertEquals(half[1], 0x0001);
+    assertEquals(half[8], 0);
+    assertEquals(half[15], 0);
+
+    vm.regs().put_int(0, sizeof(mem) + 40);
+    vm.regs().pc_update(0);
+    assertThrows(std::string, "Heap memory access out of bounds", vm.step());
+}
+
+static void test_vectors_arith()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::VSPLAT(), 0, i32x8, 0,
+        *impl::Opcode::VSPLAT(), 1, i32x8, 0x30,
+        *impl::Opcode::VOP(), 2, (uint8_t)impl::Simd::Op::Sub, i32x8, 1, 0,
+        *impl::Opcode::VREDUCE(), 3, (uint8_t)impl::Simd::Op::Add, i32x8, 2,
+        *impl::Opcode::VREDUCE(), 4, (uint8_t)impl::Simd::Op::Min,
+            (uint8_t)core::Lane::U32 | core::vector_wide, 2,
+        *impl::Opcode::VOP(), 5, (uint8_t)impl::Simd::Op::CmpGt, i32x8, 1, 0,
+        *impl::Opcode::VREDUCE(), 5, (uint8_t)impl::Simd::Op::Add, i32x8, 5,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Vectors vectors(&vm);
+    vm.regs().put_int(0, 5);
+
+    for (int i = 0; i < 4; ++i)
+        assert(vm.step());
+    assertEquals(vm.regs().get_int(3), (uint64_t)-16);
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(4), 0xfffffffe);
+    assert(vm.step());
+    assert(vm.step());
+    assertEquals(vm.regs().get_int(5), 0);
+}
+
+static void test_vectors_float()
+{
+    static const uint8_t f64x4 = (uint8_t)core::Lane::F64 | core::vector_wide;
+    static uint8_t mem[] = {
+        *impl::Opcode::VSPLAT(), 0, f64x4, 0,
+        *impl::Opcode::VOP(), 1, (uint8_t)impl::Simd::Op::Mul, f64x4, 0, 0,
+        *impl::Opcode::VREDUCE(), 2, (uint8_t)impl::Simd::Op::Add, f64x4, 1,
+        *impl::Opcode::VREDUCE(), 3, (uint8_t)impl::Simd::Op::Max,
+            (uint8_t)core::Lane::F32, 1,
+        *impl::Opcode::VSPLAT(), 0, (uint8_t)core::Lane::F32, 1,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Vectors vectors(&vm);
+    vm.regs().put_float(0, 1.5);
+
+    for (int i = 0; i < 3; ++i)
+        assert(vm.step());
+    assertEquals(vm.regs().get_float(2), 9.0);
+    assert(vm.step());
+    assertThrows(std::string, "Invalid register type, expected float",
+        vm.step());
+}
+
+/* Every operation and lane type gives same result with all
+ * implementations
+ */
+static void test_vectors_isa()
+{
+    impl::Simd::Isa orig = impl::Simd::isa();
+    alignas(32) uint8_t a[32], b[32], res[32], ref[32];
+    uint64_t seed = 0x9e3779b97f4a7c15;
+
+    for (uint8_t lane = 0; lane <= (uint8_t)core::Lane::F64; ++lane) {
+        for (int i = 0; i < 32; ++i) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            a[i] = seed >> 56;
+            b[i] = (i % 3) ? (uint8_t)(seed >> 48) : a[i];
+        }
+        if (lane == (uint8_t)core::Lane::F32) {
+            float fa[8], fb[8];
+            for (int i = 0; i < 8; ++i) {
+                fa[i] = a[i] - 100.0f;
+                fb[i] = (i % 3) ? b[i] * 0.5f : fa[i];
+            }
+            std::memcpy(a, fa, 32);
+            std::memcpy(b, fb, 32);
+        } else if (lane == (uint8_t)core::Lane::F64) {
+            double fa[4], fb[4];
+            for (int i = 0; i < 4; ++i) {
+                fa[i] = a[i] - 100.0;
+                fb[i] = (i % 3) ? b[i] * 0.5 : fa[i];
+            }
+            std::memcpy(a, fa, 32);
+            std::memcpy(b, fb, 32);
+        }
+
+        for (uint8_t op = 0; op <= (uint8_t)impl::Simd::Op::Xor; ++op) {
+            for (unsigned bytes = 16; bytes <= 32; bytes += 16) {
+                impl::Simd::set_isa(impl::Simd::Isa::Generic);
+                impl::Simd::binary((impl::Simd::Op)op, (core::Lane)lane,
+                    ref, a, b, bytes);
+                for (uint8_t isa = 1; isa <= 2; ++isa) {
+                    impl::Simd::set_isa((impl::Simd::Isa)isa);
+                    std::memset(res, 0, sizeof(res));
+                    impl::Simd::binary((impl::Simd::Op)op, (core::Lane)lane,
+                        res, a, b, bytes);
+                    assertEquals(std::memcmp(res, ref, bytes), 0);
+                }
+            }
+        }
+
+        impl::Simd::set_isa(impl::Simd::Isa::Generic);
+        impl::Simd::swap((core::Lane)lane, ref, a, 32);
+        impl::Simd::set_isa(orig);
+        impl::Simd::swap((core::Lane)lane, res, a, 32);
+        assertEquals(std::memcmp(res, ref, 32), 0);
+    }
+    impl::Simd::set_isa(orig);
+}
+
+static void test_vectors_invalid()
+{
+    static uint8_t mem[] = {
+        *impl::Opcode::VSPLAT(), 0, 0x0a, 0,
+        *impl::Opcode::VREDUCE(), 0, (uint8_t)impl::Simd::Op::CmpEq, i32x8, 0,
+        *impl::Opcode::VOP(), 0, 10, i32x8, 0, 0,
+        *impl::Opcode::VOP(), 16, 0, i32x8, 0, 0,
+    };
+    core::VM vm((uint8_t*)mem, sizeof(mem));
+    impl::Vectors vectors(&vm);
+
+    assertThrows(std::string, "Invalid vector shape: 10", vm.step());
+    assertThrows(std::string, "Invalid vector reduction: 5", vm.step());
+    assertThrows(std::string, "Invalid vector operation", vm.step());
+    assertThrows(std::string, "Invalid vector register", vm.step());
+}
+
+void test_vectors()
+{
+    TEST_CASE(test_vectors_load_store);
+    TEST_CASE(test_vectors_arith);
+    TEST_CASE(test_vectors_float);
+    TEST_CASE(test_vectors_isa);
+    TEST_CASE(test_vectors_invalid);
+}
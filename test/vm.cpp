@@ -231,6 +231,52 @@ static void test_memory_access()
         vm.set_mem(30, 0x77));
 }
 
+static void test_vm_reset()
+{
+    core::VM vm(mem2, sizeof(mem2));
+    impl::NopStop nopstop(&vm);
+    impl::Ints ints(&vm);
+    impl::Strs strs(&vm);
+    vm.add_heap(100);
+    vm.add_heap(5000);
+    vm.set_mem(sizeof(mem2) + 150, 0x42);
+    vm.vregs().get(2)[0] = 1;
+    vm.maps().create();
+    while (vm.step());
+    const uint8_t *small = vm.heap_read(sizeof(mem2), 100);
+    const uint8_t *large = vm.heap_read(sizeof(mem2) + 100, 5000);
+
+    vm.reset();
+    assertEquals(vm.regs().pc(), 0);
+    assertEquals(vm.regs().get_int(0), 0);
+    assertEquals(vm.regs().get_int(8), 0);
+    assertEquals(vm.vregs().get(2)[0], 0);
+    assertEquals(vm.ticks(), 0);
+    assertEquals(vm.heap_size(), 0);
+    assertEquals(vm.size(), 0);
+    assertEquals(vm.maps().count(), 0);
+    assertEquals(vm.string_count(), 0);
+
+    // Blocks come back zeroed, smallest that fits first
+    vm.load(mem2, sizeof(mem2));
+    vm.add_heap(50);
+    vm.add_heap(200);
+    vm.add_heap(10);
+    assertEquals(vm.heap_read(sizeof(mem2), 50), small);
+    assertEquals(vm.heap_read(sizeof(mem2) + 50, 200), large);
+    assertEquals(vm.heap(50).capacity(), 5000);
+    assertEquals(vm.heap(50).size(), 200);
+    assertEquals(vm.mem(sizeof(mem2) + 100), 0);
+    assertThrows(std::string, "Heap memory access out of bounds",
+        vm.heap_read(sizeof(mem2) + 50, 201));
+    assertEquals(vm.heap_size(), 260);
+
+    // Handlers stay
+    while (vm.step());
+    assertEquals(vm.regs().get_int(0), 123);
+    assertEquals(vm.regs().get_string(8), "abc");
+}
+
 void test_vm()
 {
     TEST_CASE(test_basic_opcodes);
@@ -243,4 +289,5 @@ void test_vm()
     TEST_CASE(test_heap_add_double);
     TEST_CASE(test_heap_access);
     TEST_CASE(test_memory_access);
+    TEST_CASE(test_vm_reset);
 }
@@ -0,0 +1,123 @@
+#include "framework.hh"
+#include <vmpool.hh>
+#include <impl/opcodes.hh>
+#include <thread>
+
+static uint8_t code[] = {
+    *impl::Opcode::ADD_INT(), 2, 0, 1,
+    *impl::Opcode::PRINT_INT(), 2,
+    *impl::Opcode::STOP()
+};
+
+static void test_vmpool_reuse()
+{
+    impl::VMPool pool;
+    assertEquals(pool.idle(), 0);
+    core::VM *first;
+    {
+        core::BufferOutput out;
+        impl::VMPool::Lease vm = pool.acquire();
+        first = &*vm;
+        vm->load(code, sizeof(code));
+        vm->add_heap(1000);
+        vm->regs().put_int(0, 2);
+        vm->regs().put_int(1, 3);
+        vm->set_output(&out);
+        while (vm->step());
+        assertEquals(out.data(), "5");
+    }
+    assertEquals(pool.idle(), 1);
+
+    // Same VM comes back clean, with handlers and heap memory
+    impl::VMPool::Lease vm = pool.acquire();
+    assertEquals(pool.idle(), 0);
+    assertEquals(&*vm, first);
+    assertEquals(vm->regs().get_int(0), 0);
+    assertEquals(vm->ticks(), 0);
+    assertEquals(vm->heap_size(), 0);
+    vm->load(code, sizeof(code));
+    vm->add_heap(10);
+    assertEquals(vm->heap(0).capacity(), 1000);
+    core::BufferOutput out;
+    vm->set_output(&out);
+    vm->regs().put_int(1, 7);
+    while (vm->step());
+    assertEquals(out.data(), "7");
+
+    // Moved lease goes back once
+    impl::VMPool::Lease other = pool.acquire();
+    assert(&*other != first);
+    {
+        impl::VMPool::Lease moved(std::move(other));
+    }
+    assertEquals(pool.idle(), 1);
+}
+
+static void test_vmpool_limit()
+{
+    impl::VMPool pool(1);
+    {
+        impl::VMPool::Lease a = pool.acquire();
+        impl::VMPool::Lease b = pool.acquire();
+    }
+    assertEquals(pool.idle(), 1);
+}
+
+static void test_vmpool_failed_flush()
+{
+    impl::VMPool pool;
+    bool broken = true;
+    unsigned tries = 0;
+    core::CallbackOutput out([&](const char *, uint64_t) {
+        ++tries;
+        if (broken)
+            throw std::string("Output write failed");
+    });
+    {
+        impl::VMPool::Lease vm = pool.acquire();
+        vm->set_output(&out);
+        vm->output().write("left", 4);
+    }
+    assertEquals(tries, 1);
+    assertEquals(pool.idle(), 1);
+    broken = false;
+
+    // Returned VM doesn't point to the failed output anymore
+    impl::VMPool::Lease vm = pool.acquire();
+    assert(&vm->output() != &out);
+}
+
+static void test_vmpool_threads()
+{
+    impl::VMPool pool;
+    std::vector<std::thread> threads;
+    std::vector<uint64_t> sums(4);
+    for (unsigned t = 0; t < sums.size(); ++t) {
+        threads.emplace_back([&, t]() {
+            for (uint64_t i = 0; i < 200; ++i) {
+                core::BufferOutput out;
+                impl::VMPool::Lease vm = pool.acquire();
+                vm->load(code, sizeof(code));
+                vm->regs().put_int(0, t);
+                vm->regs().put_int(1, i);
+                vm->set_output(&out);
+                while (vm->step());
+                sums[t] += std::stoull(out.data());
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    for (unsigned t = 0; t < sums.size(); ++t)
+        assertEquals(sums[t], 200 * t + 199 * 100);
+    assert(pool.idle() >= 1);
+    assert(pool.idle() <= 4);
+}
+
+void test_vmpool()
+{
+    TEST_CASE(test_vmpool_reuse);
+    TEST_CASE(test_vmpool_limit);
+    TEST_CASE(test_vmpool_failed_flush);
+    TEST_CASE(test_vmpool_threads);
+}